@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <memory_resource>
+
+namespace easymrc {
+
+// Per-worker monotonic arena for transient check data.
+// Allocation is a pointer bump, deallocation is a no-op and reset() rewinds
+// the arena while keeping its memory, so after warm-up a worker performs no
+// global heap allocations at all. Not thread-safe: one arena per worker.
+class WorkerArena : public std::pmr::memory_resource {
+ public:
+  explicit WorkerArena(
+      size_t initial_block_size = 256 * 1024,
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+      : upstream_(upstream), current_(0), offset_(0),
+        allocations_(0), bytes_allocated_(0) {
+    add_block(std::max<size_t>(initial_block_size, 64));
+  }
+
+  ~WorkerArena() override {
+    release_blocks();
+  }
+
+  WorkerArena(const WorkerArena&) = delete;
+  WorkerArena& operator=(const WorkerArena&) = delete;
+
+  // Make all memory available again. If the last cycle spilled into more
+  // than one block, the blocks are merged into one large enough for the
+  // whole cycle so the next cycle stays in a single block.
+  void reset() {
+    if (current_ > 0) {
+      size_t total = 0;
+      for (const auto& block : blocks_) total += block.size;
+      release_blocks();
+      add_block(total);
+    }
+    current_ = 0;
+    offset_ = 0;
+  }
+
+  // Statistics since construction
+  size_t allocations() const { return allocations_; }
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  size_t capacity() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) total += block.size;
+    return total;
+  }
+
+ private:
+  struct Block {
+    std::byte* data;
+    size_t size;
+  };
+
+  std::pmr::memory_resource* upstream_;
+  std::vector<Block> blocks_;
+  size_t current_;  // Index of the block being filled
+  size_t offset_;   // Fill position within blocks_[current_]
+  size_t allocations_;
+  size_t bytes_allocated_;
+
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    allocations_++;
+    bytes_allocated_ += bytes;
+
+    while (true) {
+      Block& block = blocks_[current_];
+      // Align the address, not the offset: blocks are only aligned to
+      // max_align_t
+      uintptr_t start = reinterpret_cast<uintptr_t>(block.data);
+      uintptr_t address = (start + offset_ + alignment - 1) &
+                          ~uintptr_t(alignment - 1);
+      size_t aligned = address - start;
+      if (aligned + bytes <= block.size) {
+        offset_ = aligned + bytes;
+        return block.data + aligned;
+      }
+
+      // Move on to the next block, growing geometrically; bytes + alignment
+      // fit from any start address
+      if (current_ + 1 == blocks_.size()) {
+        add_block(std::max(block.size * 2, bytes + alignment));
+      }
+      current_++;
+      offset_ = 0;
+    }
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {}
+
+  bool do_is_equal(const std::pmr::memory_resource& other)
+      const noexcept override {
+    return this == &other;
+  }
+
+  void add_block(size_t size) {
+    auto* data = static_cast<std::byte*>(
+        upstream_->allocate(size, alignof(std::max_align_t)));
+    blocks_.push_back({data, size});
+  }
+
+  void release_blocks() {
+    for (const auto& block : blocks_) {
+      upstream_->deallocate(block.data, block.size,
+                            alignof(std::max_align_t));
+    }
+    blocks_.clear();
+  }
+};
+
+}  // namespace easymrc
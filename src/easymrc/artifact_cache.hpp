@@ -0,0 +1,259 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+#include "types.hpp"
+#include "layout_store.hpp"
+#include "candidate_pairs.hpp"
+#include "sampling.hpp"
+#include "scheduling.hpp"
+#include "mapped_file.hpp"
+#include "topology.hpp"
+#include "component_labeling.hpp"
+
+namespace easymrc {
+
+// The rule-dependent precomputation of a layout: its candidate pairs for a
+// rule distance R and its per-polygon sampling data (SamplingTable) for a
+// radius multiplier. Neither depends on which checks are enabled or on
+// the output, so once saved it serves every later run of the same layout
+// and rules, which then skip the candidate sweep and the radius and cost
+// estimates. Representatives themselves are sampled per pair, at the
+// larger radius of the two polygons, and are not kept.
+//
+// Artifacts are keyed by the layout's content hash (LayoutCache::
+// layout_hash()) together with R and the multiplier, bit for bit. File
+// layout, native byte order, 8-byte aligned sections:
+//   Header
+//   int32           pairs[pairs][2]
+//   double          radius[polygons]
+//   PolygonCostInfo info[polygons]
+// The sampling arrays are used in place from the mapping.
+class RuleArtifacts {
+ public:
+  static constexpr uint32_t kVersion = 1;
+
+  struct Key {
+    uint64_t content_hash;
+    double rule_distance;
+    double multiplier;
+
+    Key() : content_hash(0), rule_distance(0.0), multiplier(0.0) {}
+    Key(uint64_t hash, double R, double m)
+        : content_hash(hash), rule_distance(R), multiplier(m) {}
+
+    bool operator==(const Key& other) const {
+      return content_hash == other.content_hash &&
+             bits(rule_distance) == bits(other.rule_distance) &&
+             bits(multiplier) == bits(other.multiplier);
+    }
+  };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    Key key;
+    uint64_t polygons;
+    uint64_t pairs;
+  };
+
+  RuleArtifacts()
+      : num_polygons_(0), radius_(nullptr), info_(nullptr) {}
+
+  RuleArtifacts(RuleArtifacts&&) = default;
+  RuleArtifacts& operator=(RuleArtifacts&&) = default;
+
+  // Candidate sweep and sampling data of polygons, the latter on
+  // num_threads threads (0 = one per usable CPU)
+  static RuleArtifacts compute(const PolygonSource& polygons,
+                               const Key& key, int num_threads = 0) {
+    RuleArtifacts artifacts;
+    artifacts.key_ = key;
+    artifacts.num_polygons_ = polygons.size();
+    artifacts.pairs_ = candidate_pair_generation(polygons, key.rule_distance);
+
+    artifacts.owned_radius_.resize(polygons.size());
+    artifacts.owned_info_.resize(polygons.size());
+    if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+    const size_t chunk = 1024;
+    labeling_detail::parallel_for(num_threads,
+                                  (polygons.size() + chunk - 1) / chunk,
+                                  [&](size_t k) {
+      size_t end = std::min(polygons.size(), (k + 1) * chunk);
+      for (size_t i = k * chunk; i < end; ++i) {
+        artifacts.owned_radius_[i] =
+            calculate_sampling_radius(polygons[i], key.multiplier);
+        artifacts.owned_info_[i] =
+            compute_polygon_cost_info(polygons[i], key.multiplier);
+      }
+    });
+    artifacts.radius_ = artifacts.owned_radius_.data();
+    artifacts.info_ = artifacts.owned_info_.data();
+    return artifacts;
+  }
+
+  // File of the artifacts for key inside directory
+  static std::string filename(const std::string& directory, const Key& key) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%016llx-%016llx.mrca",
+                  static_cast<unsigned long long>(key.content_hash),
+                  static_cast<unsigned long long>(bits(key.rule_distance)),
+                  static_cast<unsigned long long>(bits(key.multiplier)));
+    if (directory.empty()) return name;
+    return directory + "/" + name;
+  }
+
+  // Written beside filename and renamed over it, as LayoutCache::write()
+  void save(const std::string& filename) const {
+    Header header = make_header();
+    header.key = key_;
+    header.polygons = num_polygons_;
+    header.pairs = pairs_.size();
+
+    std::vector<int32_t> pairs(pairs_.size() * 2);
+    for (size_t i = 0; i < pairs_.size(); ++i) {
+      pairs[i * 2] = pairs_[i].first;
+      pairs[i * 2 + 1] = pairs_[i].second;
+    }
+
+    const std::string temp = filename + ".tmp";
+    {
+      std::ofstream out(temp, std::ios::binary);
+      if (!out.is_open()) {
+        throw std::runtime_error("Cannot create rule artifacts: " + filename);
+      }
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      out.write(reinterpret_cast<const char*>(pairs.data()),
+                pairs.size() * sizeof(int32_t));
+      out.write(reinterpret_cast<const char*>(radius_),
+                num_polygons_ * sizeof(double));
+      out.write(reinterpret_cast<const char*>(info_),
+                num_polygons_ * sizeof(PolygonCostInfo));
+      if (!out) {
+        out.close();
+        std::remove(temp.c_str());
+        throw std::runtime_error("Failed to write rule artifacts: " +
+                                 filename);
+      }
+    }
+    if (std::rename(temp.c_str(), filename.c_str()) != 0) {
+      std::remove(temp.c_str());
+      throw std::runtime_error("Failed to write rule artifacts: " + filename);
+    }
+  }
+
+  // Map the artifacts saved in filename. Returns false if the file is
+  // missing, of another version or key, malformed, or computed for another
+  // number of polygons.
+  bool load(const std::string& filename, const Key& key,
+            size_t num_polygons) {
+    MappedFile file;
+    try {
+      file = MappedFile(filename);
+    } catch (const std::runtime_error&) {
+      return false;
+    }
+    if (file.size() < sizeof(Header)) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(file.data());
+    Header expected = make_header();
+    if (std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) ||
+        header->version != kVersion ||
+        header->byte_order != expected.byte_order || !(header->key == key) ||
+        header->polygons != num_polygons) {
+      return false;
+    }
+
+    const uint64_t limit = file.size();
+    const uint64_t n = header->polygons, p = header->pairs;
+    if (n > limit / sizeof(double) || p > limit / (2 * sizeof(int32_t))) {
+      return false;
+    }
+    size_t radius = sizeof(Header) + p * 2 * sizeof(int32_t);
+    size_t info = radius + n * sizeof(double);
+    if (info + n * sizeof(PolygonCostInfo) != limit) return false;
+
+    const int32_t* pairs =
+        reinterpret_cast<const int32_t*>(file.data() + sizeof(Header));
+    std::vector<std::pair<int, int>> loaded(p);
+    for (uint64_t i = 0; i < p; ++i) {
+      int32_t a = pairs[i * 2], b = pairs[i * 2 + 1];
+      if (a < 0 || b < 0 || static_cast<uint64_t>(a) >= n ||
+          static_cast<uint64_t>(b) >= n) {
+        return false;
+      }
+      loaded[i] = std::make_pair(a, b);
+    }
+
+    key_ = key;
+    num_polygons_ = n;
+    pairs_ = std::move(loaded);
+    owned_radius_.clear();
+    owned_info_.clear();
+    file_ = std::move(file);
+    radius_ = reinterpret_cast<const double*>(file_.data() + radius);
+    info_ = reinterpret_cast<const PolygonCostInfo*>(file_.data() + info);
+    return true;
+  }
+
+  const Key& key() const { return key_; }
+  size_t num_polygons() const { return num_polygons_; }
+
+  // Whether these artifacts may stand in for the computation on
+  // num_polygons polygons checked with rule distance R and multiplier
+  bool matches(size_t num_polygons, double R, double multiplier) const {
+    return num_polygons == num_polygons_ &&
+           bits(R) == bits(key_.rule_distance) &&
+           bits(multiplier) == bits(key_.multiplier);
+  }
+
+  const std::vector<std::pair<int, int>>& pairs() const { return pairs_; }
+
+  SamplingTable sampling() const {
+    return SamplingTable(radius_, info_, num_polygons_);
+  }
+
+ private:
+  static_assert(std::is_trivially_copyable<PolygonCostInfo>::value &&
+                    sizeof(PolygonCostInfo) % 8 == 0,
+                "PolygonCostInfo is stored as raw 8-byte aligned records");
+  static_assert(sizeof(Header) % 8 == 0, "Header must keep 8-byte alignment");
+
+  static constexpr char kMagic[8] = {'E', 'M', 'R', 'C', 'A', 'R', 'T',
+                                     'F'};
+  static constexpr uint32_t kByteOrder = 0x01020304;
+
+  Key key_;
+  size_t num_polygons_;
+  std::vector<std::pair<int, int>> pairs_;
+  std::vector<double> owned_radius_;       // Computed, or empty when mapped
+  std::vector<PolygonCostInfo> owned_info_;
+  MappedFile file_;
+  const double* radius_;                   // Into owned_radius_ or file_
+  const PolygonCostInfo* info_;
+
+  static uint64_t bits(double value) {
+    uint64_t b;
+    std::memcpy(&b, &value, sizeof(b));
+    return b;
+  }
+
+  static Header make_header() {
+    Header header = Header();
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrder;
+    return header;
+  }
+};
+
+}  // namespace easymrc
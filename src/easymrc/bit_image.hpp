@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace easymrc {
+
+// One-bit-per-pixel mask image.
+//
+// Each row is stored as 64-bit words with a whole zero word on either side
+// and there is an all-zero row above and below the image, so get(x, y) is
+// valid without bounds checks for -1 <= x <= width and -1 <= y <= height.
+// Bit (x & 63) of word x / 64 holds pixel x, which lets row scans and
+// neighbour tests work on 64 pixels at a time.
+class BitImage {
+ public:
+  BitImage() : width_(0), height_(0), words_per_row_(2) {}
+
+  BitImage(int width, int height)
+      : width_(width), height_(height),
+        words_per_row_((width + 63) / 64 + 2),
+        words_(static_cast<size_t>(words_per_row_) * (height + 2), 0) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  // Words per stored row, including the two padding words
+  int words_per_row() const { return words_per_row_; }
+
+  // Number of data words per row (without padding)
+  int row_words() const { return words_per_row_ - 2; }
+
+  // Pixel words of row y (-1 <= y <= height); index -1 and row_words()
+  // are the zero padding words
+  const uint64_t* row(int y) const {
+    return words_.data() + static_cast<size_t>(y + 1) * words_per_row_ + 1;
+  }
+
+  uint64_t* row(int y) {
+    return words_.data() + static_cast<size_t>(y + 1) * words_per_row_ + 1;
+  }
+
+  bool get(int x, int y) const {
+    int word = ((x + 64) >> 6) - 1;  // Floor division, x may be -1
+    return (row(y)[word] >> (x & 63)) & 1;
+  }
+
+  void set(int x, int y) {
+    row(y)[x >> 6] |= uint64_t(1) << (x & 63);
+  }
+
+  void clear(int x, int y) {
+    row(y)[x >> 6] &= ~(uint64_t(1) << (x & 63));
+  }
+
+  // Number of set pixels
+  size_t count() const {
+    size_t total = 0;
+    for (uint64_t word : words_) total += __builtin_popcountll(word);
+    return total;
+  }
+
+  // Memory used by the pixel words
+  size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+  // Pack a row of 8-bit pixels: bit x is set where pixels[x] >= threshold.
+  // SSE2 compares 16 pixels per instruction and gathers the results with
+  // movemask; the remainder is handled by the scalar loop.
+  static void pack_row(const unsigned char* pixels, int width,
+                       unsigned char threshold, uint64_t* out) {
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold));
+    for (; x + 64 <= width; x += 64) {
+      uint64_t word = 0;
+      for (int part = 0; part < 4; ++part) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(pixels + x + part * 16));
+        // v >= limit  <=>  max(v, limit) == v  (unsigned)
+        __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, limit), v);
+        word |= static_cast<uint64_t>(
+                    static_cast<uint16_t>(_mm_movemask_epi8(ge)))
+                << (part * 16);
+      }
+      out[x >> 6] = word;
+    }
+#endif
+    for (; x < width; x += 64) {
+      int end = std::min(width, x + 64);
+      uint64_t word = 0;
+      for (int i = x; i < end; ++i) {
+        word |= static_cast<uint64_t>(pixels[i] >= threshold) << (i - x);
+      }
+      out[x >> 6] = word;
+    }
+  }
+
+  // Pack a row of 8-bit pixels: bit x is set where pixels[x] == value
+  static void pack_row_equal(const unsigned char* pixels, int width,
+                             unsigned char value, uint64_t* out) {
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i level = _mm_set1_epi8(static_cast<char>(value));
+    for (; x + 64 <= width; x += 64) {
+      uint64_t word = 0;
+      for (int part = 0; part < 4; ++part) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(pixels + x + part * 16));
+        __m128i eq = _mm_cmpeq_epi8(v, level);
+        word |= static_cast<uint64_t>(
+                    static_cast<uint16_t>(_mm_movemask_epi8(eq)))
+                << (part * 16);
+      }
+      out[x >> 6] = word;
+    }
+#endif
+    for (; x < width; x += 64) {
+      int end = std::min(width, x + 64);
+      uint64_t word = 0;
+      for (int i = x; i < end; ++i) {
+        word |= static_cast<uint64_t>(pixels[i] == value) << (i - x);
+      }
+      out[x >> 6] = word;
+    }
+  }
+
+  // Threshold any image offering width, height and row(y) (8-bit pixels,
+  // y up). Rows are split across num_threads threads for large images.
+  template <typename Image>
+  static BitImage threshold(const Image& img, unsigned char threshold = 255,
+                            int num_threads = 1) {
+    BitImage bits(img.width, img.height);
+    for_rows(img.width, img.height, num_threads,
+             [&img, &bits, threshold](int y) {
+      pack_row(img.row(y), img.width, threshold, bits.row(y));
+    });
+    return bits;
+  }
+
+  // Masks of layers encoded as gray levels of one image: mask k holds the
+  // pixels equal to levels[k]. Each row is read once for all levels, while
+  // it is in cache.
+  template <typename Image>
+  static std::vector<BitImage> select_levels(
+      const Image& img, const std::vector<unsigned char>& levels,
+      int num_threads = 1) {
+    std::vector<BitImage> masks(levels.size(),
+                                BitImage(img.width, img.height));
+    for_rows(img.width, img.height, num_threads,
+             [&img, &levels, &masks](int y) {
+      const unsigned char* pixels = img.row(y);
+      for (size_t k = 0; k < levels.size(); ++k) {
+        pack_row_equal(pixels, img.width, levels[k], masks[k].row(y));
+      }
+    });
+    return masks;
+  }
+
+ private:
+  int width_;
+  int height_;
+  int words_per_row_;
+  std::vector<uint64_t> words_;
+
+  // Call pack(y) for every row, split across num_threads threads for
+  // large images
+  template <typename Pack>
+  static void for_rows(int width, int height, int num_threads, Pack pack) {
+    auto pack_rows = [&pack](int begin, int end) {
+      for (int y = begin; y < end; ++y) pack(y);
+    };
+
+    size_t pixels = static_cast<size_t>(width) * height;
+    int workers = std::max(1, std::min<int>(num_threads,
+                                            pixels / (1 << 22)));
+    if (workers == 1) {
+      pack_rows(0, height);
+    } else {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < workers; ++t) {
+        threads.emplace_back(pack_rows, height * t / workers,
+                             height * (t + 1) / workers);
+      }
+      for (auto& thread : threads) thread.join();
+    }
+  }
+};
+
+}  // namespace easymrc
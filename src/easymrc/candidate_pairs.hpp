@@ -3,7 +3,10 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include "types.hpp"
+#include "layout_store.hpp"
 
 namespace easymrc {
 
@@ -13,15 +16,16 @@ enum EventType {
   RIGHT_EVENT = 1
 };
 
+// Events and intervals hold the int64 coordinates of ExactBoxes
 struct Event {
-  double x;
+  int64_t x;
   EventType type;
   int polygon_id;
-  double y_min, y_max;
+  int64_t y_min, y_max;
 
   Event() : x(0), type(LEFT_EVENT), polygon_id(-1), y_min(0), y_max(0) {}
 
-  Event(double x_coord, EventType t, int pid, double ymin, double ymax)
+  Event(int64_t x_coord, EventType t, int pid, int64_t ymin, int64_t ymax)
       : x(x_coord), type(t), polygon_id(pid), y_min(ymin), y_max(ymax) {}
 
   bool operator<(const Event& other) const {
@@ -32,12 +36,12 @@ struct Event {
 };
 
 struct Interval {
-  double y_min, y_max;
+  int64_t y_min, y_max;
   int polygon_id;
 
   Interval() : y_min(0), y_max(0), polygon_id(-1) {}
 
-  Interval(double ymin, double ymax, int pid)
+  Interval(int64_t ymin, int64_t ymax, int pid)
       : y_min(ymin), y_max(ymax), polygon_id(pid) {}
 
   bool overlaps(const Interval& other) const {
@@ -53,18 +57,37 @@ struct Interval {
 
 class CandidatePairGenerator {
  public:
-  CandidatePairGenerator(const std::vector<Polygon>& polygons, double R)
+  CandidatePairGenerator(const PolygonSource& polygons, double R)
       : polygons_(polygons), rule_distance_(R) {}
 
   std::vector<std::pair<int, int>> generate() {
-    // Step 1: Compute and expand bounding boxes
-    std::vector<BoundingBox> bboxes;
-    for (const auto& poly : polygons_) {
-      BoundingBox bbox = compute_bounding_box(poly);
+    // Step 1: Compute and expand bounding boxes. Pairs refer to polygons
+    // by their index in polygons_, which need not equal Polygon::id when
+    // checking a subset of a layout. A LayoutStore has the boxes cached.
+    std::vector<ExactBox> bboxes;
+    bboxes.reserve(polygons_.size());
+    for (size_t i = 0; i < polygons_.size(); ++i) {
+      ExactBox bbox(polygons_[i].bbox());
       bbox.expand(rule_distance_);
+      bbox.polygon_id = i;
       bboxes.push_back(bbox);
     }
 
+    // Steps 2-4: Sweep over the expanded boxes
+    std::set<std::pair<int, int>> candidate_pairs_set;
+    sweep(bboxes, 0, candidate_pairs_set);
+
+    // Convert set to vector
+    std::vector<std::pair<int, int>> candidate_pairs(
+        candidate_pairs_set.begin(), candidate_pairs_set.end());
+
+    return candidate_pairs;
+  }
+
+  // Sweep over expanded bounding boxes and add every overlapping pair
+  // {id1 < id2} of polygon_ids with id2 >= first_new
+  static void sweep(const std::vector<ExactBox>& bboxes, int first_new,
+                    std::set<std::pair<int, int>>& candidate_pairs_set) {
     // Step 2: Generate events
     std::vector<Event> events;
     for (const auto& bbox : bboxes) {
@@ -79,7 +102,6 @@ class CandidatePairGenerator {
 
     // Step 4: Sweepline scan
     std::set<Interval> active_intervals;
-    std::set<std::pair<int, int>> candidate_pairs_set;
 
     for (const auto& event : events) {
       if (event.type == LEFT_EVENT) {
@@ -95,7 +117,7 @@ class CandidatePairGenerator {
             // Ensure i < j to avoid duplicates
             if (id1 != id2) {
               if (id1 > id2) std::swap(id1, id2);
-              candidate_pairs_set.insert({id1, id2});
+              if (id2 >= first_new) candidate_pairs_set.insert({id1, id2});
             }
           }
         }
@@ -109,12 +131,6 @@ class CandidatePairGenerator {
         active_intervals.erase(to_remove);
       }
     }
-
-    // Convert set to vector
-    std::vector<std::pair<int, int>> candidate_pairs(
-        candidate_pairs_set.begin(), candidate_pairs_set.end());
-
-    return candidate_pairs;
   }
 
   // Get statistics
@@ -142,21 +158,73 @@ class CandidatePairGenerator {
   }
 
  private:
-  const std::vector<Polygon>& polygons_;
+  PolygonSource polygons_;
   double rule_distance_;
 };
 
 // Main function for candidate pair generation
 inline std::vector<std::pair<int, int>> candidate_pair_generation(
-    const std::vector<Polygon>& polygons, double R) {
+    const PolygonSource& polygons, double R) {
 
   CandidatePairGenerator generator(polygons, R);
   return generator.generate();
 }
 
+// Candidate pairs of polygons arriving in batches ordered by y, e.g. from
+// a banded image scan. Polygons are numbered consecutively as they are
+// added and pairs refer to these numbers. Polygons that no later polygon
+// can reach are retired, so the sweep only holds a window of the layout.
+class IncrementalPairSweep {
+ public:
+  explicit IncrementalPairSweep(double R) : rule_distance_(R), next_id_(0) {}
+
+  // Add a batch (numbered next_id() onwards) and append its candidate
+  // pairs with itself and with the retained polygons
+  void add(const std::vector<Polygon>& batch,
+           std::vector<std::pair<int, int>>& pairs) {
+    if (batch.empty()) return;
+    int first_new = next_id_;
+    for (const auto& poly : batch) {
+      ExactBox bbox(compute_bounding_box(poly));
+      bbox.expand(rule_distance_);
+      bbox.polygon_id = next_id_++;
+      retained_.push_back(bbox);
+    }
+
+    std::set<std::pair<int, int>> found;
+    CandidatePairGenerator::sweep(retained_, first_new, found);
+    pairs.insert(pairs.end(), found.begin(), found.end());
+  }
+
+  // Retire the polygons out of reach of any polygon whose bounding box
+  // starts at y_min or above; their numbers are appended to retired
+  void retire_below(double y_min, std::vector<int>* retired = nullptr) {
+    // Expanded boxes reach up by 2R: retained ones must get to the first
+    // integer row a later box can start on
+    const int64_t limit = static_cast<int64_t>(std::ceil(y_min));
+    auto keep = std::stable_partition(
+        retained_.begin(), retained_.end(),
+        [limit](const ExactBox& bbox) { return bbox.max_y >= limit; });
+    if (retired) {
+      for (auto it = keep; it != retained_.end(); ++it) {
+        retired->push_back(it->polygon_id);
+      }
+    }
+    retained_.erase(keep, retained_.end());
+  }
+
+  int next_id() const { return next_id_; }
+  size_t retained() const { return retained_.size(); }
+
+ private:
+  double rule_distance_;
+  int next_id_;
+  std::vector<ExactBox> retained_;  // Expanded, polygon_id = number
+};
+
 // Get statistics about candidate pairs
 inline auto get_candidate_pair_statistics(
-    const std::vector<Polygon>& polygons,
+    const PolygonSource& polygons,
     const std::vector<std::pair<int, int>>& pairs) {
 
   struct Stats {
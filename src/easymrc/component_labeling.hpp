@@ -0,0 +1,263 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include "bit_image.hpp"
+#include "topology.hpp"
+
+namespace easymrc {
+
+// Horizontal run of set pixels x0 .. x1 - 1 in row y
+struct PixelRun {
+  int x0, x1;
+  int y;
+};
+
+// Append the runs of mask row `row` as runs of row y, scanning whole
+// words for run ends
+inline void append_row_runs(const BitImage& mask, int row, int y,
+                            std::vector<PixelRun>& out) {
+  const uint64_t* bits = mask.row(row);
+  int open = -1;
+  for (int w = 0; w < mask.row_words(); ++w) {
+    uint64_t word = bits[w];
+    if (open < 0 ? word == 0 : word == ~uint64_t(0)) continue;
+    int base = w * 64;
+    int bit = 0;
+    while (bit < 64) {
+      uint64_t rest = (open < 0 ? word : ~word) >> bit;
+      if (!rest) break;
+      bit += __builtin_ctzll(rest);
+      if (open < 0) {
+        open = base + bit;
+      } else {
+        out.push_back({open, base + bit, y});
+        open = -1;
+      }
+    }
+  }
+  if (open >= 0) out.push_back({open, mask.width(), y});
+}
+
+namespace labeling_detail {
+
+// Call body(i) for i in [0, count) on up to num_threads threads
+template <typename Body>
+void parallel_for(int num_threads, size_t count, Body&& body) {
+  int workers = static_cast<int>(
+      std::min<size_t>(std::max(1, num_threads), count));
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; ++i) body(i);
+    return;
+  }
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < workers; ++t) {
+    threads.emplace_back([&next, &body, count]() {
+      for (size_t i = next++; i < count; i = next++) body(i);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace labeling_detail
+
+// Two-pass connected-component labelling (4-connectivity) of a mask's runs.
+//
+// The mask is cut into horizontal bands of rows, one per thread. Pass 1
+// extracts the runs of each band and joins overlapping runs of adjacent
+// rows with a union-find confined to the band's run range; the few unions
+// across band boundaries are then stitched serially. Pass 2 numbers the
+// components on all bands at once. Union-find roots are always the
+// smallest run index of their set, so components are numbered in raster
+// order of their lowest-leftmost pixel (bottom row first) whatever the
+// number of bands.
+class ComponentLabeling {
+ public:
+  // num_threads = 0: one per usable CPU
+  explicit ComponentLabeling(const BitImage& mask, int num_threads = 0)
+      : mask_(mask), num_threads_(num_threads), bands_(0),
+        num_components_(0) {
+    if (num_threads_ <= 0) num_threads_ = cpu_topology().effective_cpus();
+    component_start_.assign(1, 0);
+    if (mask_.width() == 0 || mask_.height() == 0) return;
+
+    // Bands of at least 64 rows
+    const int height = mask_.height();
+    bands_ = std::max(1, std::min(num_threads_, height / 64));
+    band_start_.resize(bands_ + 1);
+    for (int b = 0; b <= bands_; ++b) {
+      band_start_[b] = static_cast<int>(static_cast<int64_t>(height) * b /
+                                        bands_);
+    }
+
+    collect_runs();
+    std::vector<size_t> parent = join_runs();
+    number_components(parent);
+    group_runs();
+  }
+
+  size_t num_runs() const { return runs_.size(); }
+  size_t num_components() const { return component_start_.size() - 1; }
+  int bands() const { return bands_; }
+
+  // All runs in raster order, and the component of each
+  const std::vector<PixelRun>& runs() const { return runs_; }
+  const std::vector<int>& labels() const { return labels_; }
+
+  // Runs of component c in raster order; the first is its lowest-leftmost
+  const PixelRun* component_begin(size_t c) const {
+    return grouped_.data() + component_start_[c];
+  }
+
+  const PixelRun* component_end(size_t c) const {
+    return grouped_.data() + component_start_[c + 1];
+  }
+
+ private:
+  const BitImage& mask_;
+  int num_threads_;
+  int bands_;
+  std::vector<int> band_start_;       // First row of each band
+  std::vector<size_t> band_run_;      // First run of each band
+  std::vector<PixelRun> runs_;
+  std::vector<size_t> row_start_;     // First run of each row, height + 1
+  std::vector<int> labels_;
+  size_t num_components_;
+  std::vector<PixelRun> grouped_;     // Runs grouped by component
+  std::vector<size_t> component_start_;
+
+  template <typename Body>
+  void for_each_band(Body&& body) const {
+    labeling_detail::parallel_for(num_threads_, bands_, body);
+  }
+
+  void collect_runs() {
+    std::vector<std::vector<PixelRun>> band_runs(bands_);
+    row_start_.assign(mask_.height() + 1, 0);
+
+    // Row offsets are band-relative until the bands are concatenated
+    for_each_band([&](size_t b) {
+      for (int y = band_start_[b]; y < band_start_[b + 1]; ++y) {
+        row_start_[y] = band_runs[b].size();
+        append_row_runs(mask_, y, y, band_runs[b]);
+      }
+    });
+
+    band_run_.assign(bands_ + 1, 0);
+    for (int b = 0; b < bands_; ++b) {
+      band_run_[b + 1] = band_run_[b] + band_runs[b].size();
+    }
+    runs_.resize(band_run_[bands_]);
+    for_each_band([&](size_t b) {
+      std::copy(band_runs[b].begin(), band_runs[b].end(),
+                runs_.begin() + band_run_[b]);
+      std::vector<PixelRun>().swap(band_runs[b]);
+      for (int y = band_start_[b]; y < band_start_[b + 1]; ++y) {
+        row_start_[y] += band_run_[b];
+      }
+    });
+    row_start_[mask_.height()] = runs_.size();
+  }
+
+  // parent[i] <= i always holds, so roots are the smallest index of a set
+  static size_t find(std::vector<size_t>& parent, size_t i) {
+    while (parent[i] != i) {
+      parent[i] = parent[parent[i]];
+      i = parent[i];
+    }
+    return i;
+  }
+
+  static void unite(std::vector<size_t>& parent, size_t a, size_t b) {
+    a = find(parent, a);
+    b = find(parent, b);
+    if (a < b) {
+      parent[b] = a;
+    } else if (b < a) {
+      parent[a] = b;
+    }
+  }
+
+  // Join the runs of row y with the overlapping runs of row y - 1
+  void join_rows(std::vector<size_t>& parent, int y) const {
+    size_t i = row_start_[y - 1], i_end = row_start_[y];
+    size_t j = row_start_[y], j_end = row_start_[y + 1];
+    while (i < i_end && j < j_end) {
+      if (runs_[i].x0 < runs_[j].x1 && runs_[j].x0 < runs_[i].x1) {
+        unite(parent, i, j);
+      }
+      // Advance whichever run ends first
+      if (runs_[i].x1 < runs_[j].x1) {
+        i++;
+      } else {
+        j++;
+      }
+    }
+  }
+
+  // Pass 1: band-local unions, then the band boundaries
+  std::vector<size_t> join_runs() {
+    std::vector<size_t> parent(runs_.size());
+    for_each_band([&](size_t b) {
+      for (size_t i = band_run_[b]; i < band_run_[b + 1]; ++i) parent[i] = i;
+      for (int y = band_start_[b] + 1; y < band_start_[b + 1]; ++y) {
+        join_rows(parent, y);
+      }
+    });
+    for (int b = 1; b < bands_; ++b) {
+      join_rows(parent, band_start_[b]);
+    }
+    return parent;
+  }
+
+  // Pass 2: roots are numbered per band from an offset, then every other
+  // run looks up its root (read-only, so bands can share the parent links)
+  void number_components(const std::vector<size_t>& parent) {
+    std::vector<size_t> band_roots(bands_ + 1, 0);
+    for_each_band([&](size_t b) {
+      for (size_t i = band_run_[b]; i < band_run_[b + 1]; ++i) {
+        band_roots[b + 1] += parent[i] == i;
+      }
+    });
+    for (int b = 0; b < bands_; ++b) band_roots[b + 1] += band_roots[b];
+
+    labels_.resize(runs_.size());
+    num_components_ = band_roots[bands_];
+    for_each_band([&](size_t b) {
+      size_t id = band_roots[b];
+      for (size_t i = band_run_[b]; i < band_run_[b + 1]; ++i) {
+        if (parent[i] == i) {
+          labels_[i] = static_cast<int>(id++);
+        }
+      }
+    });
+    for_each_band([&](size_t b) {
+      for (size_t i = band_run_[b]; i < band_run_[b + 1]; ++i) {
+        size_t root = i;
+        while (parent[root] != root) root = parent[root];
+        labels_[i] = labels_[root];
+      }
+    });
+  }
+
+  // Counting sort of the runs by component, keeping raster order
+  void group_runs() {
+    component_start_.assign(num_components_ + 1, 0);
+    for (int label : labels_) component_start_[label + 1]++;
+    for (size_t c = 0; c < num_components_; ++c) {
+      component_start_[c + 1] += component_start_[c];
+    }
+    grouped_.resize(runs_.size());
+    std::vector<size_t> cursor(component_start_.begin(),
+                               component_start_.end() - 1);
+    for (size_t i = 0; i < runs_.size(); ++i) {
+      grouped_[cursor[labels_[i]]++] = runs_[i];
+    }
+  }
+};
+
+}  // namespace easymrc
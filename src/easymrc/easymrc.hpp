@@ -4,13 +4,24 @@
 // Main include file
 
 #include "types.hpp"
+#include "layout_store.hpp"
 #include "format_conversion.hpp"
 #include "candidate_pairs.hpp"
 #include "sampling.hpp"
 #include "type_a_violations.hpp"
 #include "type_b_violations.hpp"
 #include "width_check.hpp"
+#include "scheduling.hpp"
+#include "topology.hpp"
 #include "parallel.hpp"
+#include "task_graph.hpp"
+#include "progress.hpp"
+#include "artifact_cache.hpp"
+#include "layout_cache.hpp"
+
+#include <future>
+#include <memory>
+#include <stdexcept>
 
 namespace easymrc {
 
@@ -24,6 +35,9 @@ class EasyMRC {
     bool enable_space_check;
     bool enable_width_check;
     bool enable_parallel;
+    size_t arena_block_size;            // Per-worker arena, 0 = disabled
+    AffinityPolicy affinity;            // Worker thread pinning
+    bool concurrent_phases;             // Overlap space and width checks
 
     Config()
         : rule_distance_R(50.0),
@@ -31,7 +45,10 @@ class EasyMRC {
           num_threads(0),
           enable_space_check(true),
           enable_width_check(true),
-          enable_parallel(true) {}
+          enable_parallel(true),
+          arena_block_size(ParallelOptions().arena_block_size),
+          affinity(AffinityPolicy::NONE),
+          concurrent_phases(true) {}
   };
 
   struct Results {
@@ -39,6 +56,19 @@ class EasyMRC {
     std::vector<ViolationTypeB> space_violations_type_b;
     std::vector<WidthViolation> width_violations;
 
+    // Per-thread busy time of the parallel phases (empty when sequential)
+    LoadStats space_load;
+    LoadStats width_load;
+
+    // GDSII file of a background export checked with the run (empty when
+    // none) and the reason its write failed (empty when it succeeded)
+    std::string gdsii_file;
+    std::string gdsii_error;
+
+    bool gdsii_written() const {
+      return !gdsii_file.empty() && gdsii_error.empty();
+    }
+
     int total_space_violations() const {
       return space_violations_type_a.size() +
              space_violations_type_b.size();
@@ -49,22 +79,155 @@ class EasyMRC {
     }
   };
 
-  EasyMRC(const Config& config = Config()) : config_(config) {}
+  // Handle to a run started with run_async(). Polls progress, requests
+  // cooperative cancellation and retrieves the results. Destroying a handle
+  // whose results were not retrieved, or assigning over it, cancels the run
+  // and waits for it. A default-constructed or moved-from handle has no
+  // run: its progress stays PENDING, cancel() does nothing, ready() is
+  // false and wait(), wait_for() and get() throw std::logic_error, as they
+  // do once get() has returned.
+  class RunHandle {
+   public:
+    RunHandle() = default;
+    RunHandle(RunHandle&&) = default;
 
-  Results run(const std::vector<Polygon>& polygons) {
-    Results results;
+    RunHandle& operator=(RunHandle&& other) {
+      if (this != &other) {
+        abandon();
+        state_ = std::move(other.state_);
+        future_ = std::move(other.future_);
+      }
+      return *this;
+    }
+
+    ~RunHandle() { abandon(); }
+
+    bool valid() const { return future_.valid(); }
+
+    ProgressSnapshot progress() const {
+      return state_ ? state_->progress.snapshot() : ProgressSnapshot();
+    }
+
+    // Ask the workers to stop; they finish their current chunk first
+    void cancel() {
+      if (state_) state_->cancellation.cancel();
+    }
+
+    bool ready() const {
+      return future_.valid() &&
+             future_.wait_for(std::chrono::seconds(0)) ==
+                 std::future_status::ready;
+    }
+
+    void wait() const {
+      require_run();
+      future_.wait();
+    }
+
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+      require_run();
+      return future_.wait_for(timeout) == std::future_status::ready;
+    }
+
+    // Wait for the results. Throws RunCancelled if the run was cancelled,
+    // or the exception that made it fail.
+    Results get() {
+      require_run();
+      return future_.get();
+    }
+
+   private:
+    friend class EasyMRC;
+
+    struct State {
+      ProgressTracker progress;
+      CancellationToken cancellation;
+    };
 
-    if (config_.enable_space_check) {
-      check_space_rules(polygons, results);
+    std::shared_ptr<State> state_;
+    std::future<Results> future_;
+
+    void require_run() const {
+      if (!future_.valid()) {
+        throw std::logic_error("RunHandle has no run to wait for");
+      }
     }
 
-    if (config_.enable_width_check) {
-      check_width_rules(polygons, results);
+    void abandon() {
+      if (future_.valid()) {
+        cancel();
+        future_.wait();
+      }
     }
+  };
+
+  EasyMRC(const Config& config = Config())
+      : config_(config), progress_(nullptr), sampling_(nullptr) {}
+
+  // Check polygons given as a std::vector<Polygon> or a LayoutStore
+  Results run(const PolygonSource& polygons) {
+    return run_checks(polygons, nullptr);
+  }
+
+  // Check precomputed candidate pairs (indices into polygons) instead of
+  // running the candidate sweep, e.g. on one part of a partitioned layout
+  Results run(const PolygonSource& polygons,
+              const std::vector<std::pair<int, int>>& pairs) {
+    return run_checks(polygons, &pairs);
+  }
 
+  // Check with saved rule artifacts of these polygons instead of running
+  // the candidate sweep and the per-polygon sampling estimates.
+  // content_hash is LayoutCache::layout_hash() of the polygons, which the
+  // caller already has from a LayoutCache or the key it loaded the
+  // artifacts with. Throws if they were computed for other polygons
+  // (another count or content hash), R or multiplier.
+  Results run(const PolygonSource& polygons, const RuleArtifacts& artifacts,
+              uint64_t content_hash) {
+    check_artifacts(polygons, artifacts, content_hash);
+    return run_with(polygons, artifacts);
+  }
+
+  // Check the polygons of a background GDSII export while it is written.
+  // The results are returned once the write has finished or failed, with
+  // its outcome recorded.
+  Results run(GdsiiExport& pending) {
+    Results results = run(pending.polygons());
+    results.gdsii_file = pending.filename();
+    results.gdsii_error = pending.finish();
     return results;
   }
 
+  // Run on a background thread and return immediately. polygons must stay
+  // alive until the handle's results are retrieved or it is destroyed.
+  RunHandle run_async(const PolygonSource& polygons) const {
+    return start_async([polygons](EasyMRC& checker) {
+      return checker.run(polygons);
+    });
+  }
+
+  // run_async() with saved rule artifacts; both must stay alive as above.
+  // Artifacts of other polygons or rules throw here, before the run starts.
+  RunHandle run_async(const PolygonSource& polygons,
+                      const RuleArtifacts& artifacts,
+                      uint64_t content_hash) const {
+    check_artifacts(polygons, artifacts, content_hash);
+    return start_async([polygons, &artifacts](EasyMRC& checker) {
+      return checker.run_with(polygons, artifacts);
+    });
+  }
+
+  // run_async() on the polygons of a background GDSII export, which the
+  // handle keeps alive; its results are available once the write has
+  // finished or failed.
+  RunHandle run_async(GdsiiExport pending) const {
+    auto exported = std::make_shared<GdsiiExport>(std::move(pending));
+    return start_async([exported](EasyMRC& checker) {
+      return checker.run(*exported);
+    });
+  }
+
   // Run MRC from image file
   Results run_from_image(const std::string& image_file) {
     auto polygons = format_conversion(image_file);
@@ -73,73 +236,285 @@ class EasyMRC {
 
  private:
   Config config_;
+  ProgressTracker* progress_;       // Set by run_async(), otherwise null
+  CancellationToken cancellation_;
+  const SamplingTable* sampling_;   // Set while checking with artifacts
+
+  void check_artifacts(const PolygonSource& polygons,
+                       const RuleArtifacts& artifacts,
+                       uint64_t content_hash) const {
+    if (!artifacts.matches(polygons.size(), config_.rule_distance_R,
+                           config_.sampling_radius_multiplier) ||
+        artifacts.key().content_hash != content_hash) {
+      throw std::runtime_error(
+          "Rule artifacts were computed for other polygons or rules");
+    }
+  }
+
+  // run() with artifacts already checked against the polygons and rules
+  Results run_with(const PolygonSource& polygons,
+                   const RuleArtifacts& artifacts) {
+    SamplingTable sampling = artifacts.sampling();
+    struct Reset {
+      const SamplingTable*& table;
+      ~Reset() { table = nullptr; }
+    } reset{sampling_};
+    sampling_ = &sampling;
+    return run_checks(polygons, &artifacts.pairs());
+  }
+
+  ParallelOptions parallel_options() const {
+    ParallelOptions options;
+    options.num_threads = config_.num_threads;
+    options.arena_block_size = config_.arena_block_size;
+    options.affinity = config_.affinity;
+    options.progress = progress_;
+    options.cancellation = cancellation_;
+    options.sampling = sampling_;
+    return options;
+  }
 
-  void check_space_rules(const std::vector<Polygon>& polygons,
+  // Per-polygon sampling data, precomputed when checking with artifacts
+  double sampling_radius(const PolygonSource& polygons,
+                         size_t i) const {
+    return polygon_sampling_radius(polygons, i,
+                                   config_.sampling_radius_multiplier,
+                                   sampling_);
+  }
+
+  PolygonCostInfo cost_info(const PolygonSource& polygons,
+                            size_t i) const {
+    return polygon_cost_info(polygons, i, config_.sampling_radius_multiplier,
+                             sampling_);
+  }
+
+  // Call check(checker) on a background thread with a checker reporting
+  // to the handle's progress and cancellation state
+  template <typename Check>
+  RunHandle start_async(Check check) const {
+    RunHandle handle;
+    auto state = std::make_shared<RunHandle::State>();
+    handle.state_ = state;
+
+    Config config = config_;
+    handle.future_ = std::async(std::launch::async,
+                                [config, state, check]() {
+      EasyMRC checker(config);
+      checker.progress_ = &state->progress;
+      checker.cancellation_ = state->cancellation;
+      try {
+        return check(checker);
+      } catch (const RunCancelled&) {
+        throw;
+      } catch (...) {
+        state->progress.set_phase(RunPhase::FAILED);
+        throw;
+      }
+    });
+    return handle;
+  }
+
+  void set_phase(RunPhase phase) {
+    if (progress_) progress_->set_phase(phase);
+  }
+
+  Results run_checks(const PolygonSource& polygons,
+                     const std::vector<std::pair<int, int>>* given_pairs) {
+    Results results;
+    if (progress_) {
+      progress_->start(config_.enable_space_check +
+                       config_.enable_width_check);
+    }
+
+    if (config_.enable_parallel && config_.concurrent_phases &&
+        config_.enable_space_check && config_.enable_width_check) {
+      run_task_graph(polygons, given_pairs, results);
+    } else {
+      if (config_.enable_space_check) {
+        check_space_rules(polygons, given_pairs, results);
+      }
+
+      if (config_.enable_width_check) {
+        set_phase(RunPhase::CHECKING);
+        check_width_rules(polygons, results);
+      }
+    }
+
+    if (cancellation_.cancelled()) {
+      set_phase(RunPhase::CANCELLED);
+      throw RunCancelled();
+    }
+    set_phase(RunPhase::DONE);
+    return results;
+  }
+
+  // Space and width checks as one task graph on a shared pool:
+  //
+  //   candidates -> space pairs -> space merge
+  //   width schedule -> width polygons -> width merge
+  //
+  // Width checking needs only the polygons, so its chunks keep the other
+  // workers busy while the serial candidate sweep and merges run. Space
+  // nodes are added first and therefore win whenever both have work.
+  void run_task_graph(const PolygonSource& polygons,
+                      const std::vector<std::pair<int, int>>* given_pairs,
+                      Results& results) {
+    ParallelOptions options = parallel_options();
+    int num_workers = resolve_num_threads(options.num_threads);
+    double R = config_.rule_distance_R;
+    double multiplier = config_.sampling_radius_multiplier;
+
+    std::vector<std::pair<int, int>> generated;
+    const std::vector<std::pair<int, int>>* pairs_ptr = given_pairs;
+    std::unique_ptr<ParallelSpaceChecker> space;
+    std::unique_ptr<ParallelWidthChecker> width;
+
+    TaskGraph graph;
+
+    auto candidates = graph.add_serial("candidates", [&]() {
+      if (!pairs_ptr) {
+        generated = candidate_pair_generation(polygons, R);
+        pairs_ptr = &generated;
+      }
+      set_phase(RunPhase::CHECKING);
+      const auto& pairs = *pairs_ptr;
+      if (pairs.size() > 10) {
+        space.reset(new ParallelSpaceChecker(polygons, pairs, R, multiplier,
+                                             options));
+        space->prepare(num_workers);
+      } else {
+        check_space_sequential(polygons, pairs, results);
+      }
+    });
+    auto space_pairs = graph.add_parallel("space", [&](int worker) {
+      return space && space->work_chunk(worker);
+    }, {candidates});
+    graph.add_serial("space_merge", [&]() {
+      if (!space) return;
+      space->merge(results.space_violations_type_a,
+                   results.space_violations_type_b);
+      results.space_load = space->load_stats();
+    }, {space_pairs});
+
+    auto width_schedule = graph.add_serial("width_schedule", [&]() {
+      if (polygons.size() > 10) {
+        width.reset(new ParallelWidthChecker(polygons, R, multiplier,
+                                             options));
+        width->prepare(num_workers);
+      } else {
+        check_width_sequential(polygons, results);
+      }
+    });
+    auto width_polygons = graph.add_parallel("width", [&](int worker) {
+      return width && width->work_chunk(worker);
+    }, {width_schedule});
+    graph.add_serial("width_merge", [&]() {
+      if (!width) return;
+      width->merge(results.width_violations);
+      results.width_load = width->load_stats();
+    }, {width_polygons});
+
+    graph.run(num_workers, options.affinity);
+  }
+
+  void check_space_rules(const PolygonSource& polygons,
+                        const std::vector<std::pair<int, int>>* given_pairs,
                         Results& results) {
 
     // 候補ペア生成
-    auto pairs = candidate_pair_generation(polygons, config_.rule_distance_R);
+    std::vector<std::pair<int, int>> generated;
+    if (!given_pairs) {
+      generated = candidate_pair_generation(polygons, config_.rule_distance_R);
+      given_pairs = &generated;
+    }
+    const auto& pairs = *given_pairs;
+    set_phase(RunPhase::CHECKING);
 
     if (config_.enable_parallel && pairs.size() > 10) {
       // 並列処理でチェック
-      parallel_space_check(polygons, pairs, config_.rule_distance_R,
-                          results.space_violations_type_a,
-                          results.space_violations_type_b,
-                          config_.sampling_radius_multiplier,
-                          config_.num_threads);
+      ParallelSpaceChecker checker(polygons, pairs, config_.rule_distance_R,
+                                   config_.sampling_radius_multiplier,
+                                   parallel_options());
+      checker.check_parallel(results.space_violations_type_a,
+                             results.space_violations_type_b);
+      results.space_load = checker.load_stats();
     } else {
-      // 逐次処理でチェック
+      check_space_sequential(polygons, pairs, results);
+    }
+  }
+
+  // 逐次処理でチェック
+  void check_space_sequential(const PolygonSource& polygons,
+                              const std::vector<std::pair<int, int>>& pairs,
+                              Results& results) {
+    // Progress is weighted with the same cost model as the parallel path
+    std::vector<double> costs;
+    if (progress_) {
       for (const auto& pair : pairs) {
-        const auto& poly1 = polygons[pair.first];
-        const auto& poly2 = polygons[pair.second];
-
-        double r1 = calculate_sampling_radius(poly1,
-                                             config_.sampling_radius_multiplier);
-        double r2 = calculate_sampling_radius(poly2,
-                                             config_.sampling_radius_multiplier);
-        double r = std::max(r1, r2);
-
-        std::vector<RepresentativePoint> rep_points_1, rep_points_2;
-        std::vector<RepresentativeEdge> rep_edges_1, rep_edges_2;
-
-        sample_representatives(poly1, r, rep_points_1, rep_edges_1);
-        sample_representatives(poly2, r, rep_points_2, rep_edges_2);
-
-        auto vio_a = detect_type_a_violations(rep_points_1, rep_points_2,
-                                              config_.rule_distance_R, r);
-        auto vio_b = detect_type_b_violations(rep_points_1, rep_points_2,
-                                              rep_edges_1, rep_edges_2,
-                                              config_.rule_distance_R, r);
-
-        results.space_violations_type_a.insert(
-            results.space_violations_type_a.end(),
-            vio_a.begin(), vio_a.end());
-
-        results.space_violations_type_b.insert(
-            results.space_violations_type_b.end(),
-            vio_b.begin(), vio_b.end());
+        costs.push_back(estimate_pair_cost(cost_info(polygons, pair.first),
+                                           cost_info(polygons, pair.second)));
       }
+      progress_->plan_pairs(pairs.size(), total_cost(costs));
+    }
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      if (cancellation_.cancelled()) return;
+      const auto& pair = pairs[i];
+      const auto& poly1 = polygons[pair.first];
+      const auto& poly2 = polygons[pair.second];
+
+      double r1 = sampling_radius(polygons, pair.first);
+      double r2 = sampling_radius(polygons, pair.second);
+      double r = std::max(r1, r2);
+
+      RepresentativePoints rep_points_1, rep_points_2;
+      RepresentativeEdges rep_edges_1, rep_edges_2;
+
+      sample_representatives(poly1, r, rep_points_1, rep_edges_1);
+      sample_representatives(poly2, r, rep_points_2, rep_edges_2);
+
+      detect_type_a_violations(rep_points_1, rep_points_2,
+                               config_.rule_distance_R, r,
+                               results.space_violations_type_a);
+      detect_type_b_violations(rep_points_1, rep_points_2,
+                               rep_edges_1, rep_edges_2,
+                               config_.rule_distance_R, r,
+                               results.space_violations_type_b);
+      if (progress_) progress_->pairs_done(1, costs[i]);
     }
   }
 
-  void check_width_rules(const std::vector<Polygon>& polygons,
+  void check_width_rules(const PolygonSource& polygons,
                         Results& results) {
 
     if (config_.enable_parallel && polygons.size() > 10) {
-      results.width_violations = parallel_width_check(
-          polygons, config_.rule_distance_R,
-          config_.sampling_radius_multiplier,
-          config_.num_threads);
+      ParallelWidthChecker checker(polygons, config_.rule_distance_R,
+                                   config_.sampling_radius_multiplier,
+                                   parallel_options());
+      results.width_violations = checker.check_parallel();
+      results.width_load = checker.load_stats();
     } else {
-      for (const auto& poly : polygons) {
-        double r = calculate_sampling_radius(poly,
-                                             config_.sampling_radius_multiplier);
-        auto violations = check_width_violations(poly,
-                                                config_.rule_distance_R, r);
-
-        results.width_violations.insert(results.width_violations.end(),
-                                       violations.begin(), violations.end());
+      check_width_sequential(polygons, results);
+    }
+  }
+
+  void check_width_sequential(const PolygonSource& polygons,
+                              Results& results) {
+    std::vector<double> costs;
+    if (progress_) {
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        costs.push_back(estimate_polygon_cost(cost_info(polygons, i)));
       }
+      progress_->plan_polygons(polygons.size(), total_cost(costs));
+    }
+
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      if (cancellation_.cancelled()) return;
+      const auto& poly = polygons[i];
+      double r = sampling_radius(polygons, i);
+      check_width_violations(poly, config_.rule_distance_R, r,
+                             results.width_violations);
+      if (progress_) progress_->polygons_done(1, costs[i]);
     }
   }
 };
@@ -3,28 +3,71 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <map>
 #include <fstream>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
 #include "types.hpp"
+#include "mapped_file.hpp"
+#include "topology.hpp"
+#include "bit_image.hpp"
+#include "scanline_extraction.hpp"
+#include "png_decoder.hpp"
+#include "gdsii_stream.hpp"
+#include "gdsii_index.hpp"
+#include "gdsii_writer.hpp"
+#include "oasis_reader.hpp"
 
 namespace easymrc {
 
 // Simple image structure (replaces OpenCV for simplicity)
+//
+// Pixel (x, y) lives at pixels()[origin + y * stride + x]. A negative
+// stride stores the rows top-down, as in a PGM file, while y still counts
+// up from the bottom, so files can be used without flipping them. The
+// pixels are either owned (data) or external, e.g. a read-only file
+// mapping kept alive by storage; only owned pixels may be modified.
 struct Image {
   int width;
   int height;
   std::vector<unsigned char> data;
+  std::ptrdiff_t origin;
+  std::ptrdiff_t stride;
+  std::shared_ptr<const unsigned char> storage;
 
-  Image() : width(0), height(0) {}
-  Image(int w, int h) : width(w), height(h), data(w * h, 0) {}
+  Image() : width(0), height(0), origin(0), stride(0) {}
+  Image(int w, int h)
+      : width(w), height(h), data(static_cast<size_t>(w) * h, 0),
+        origin(0), stride(w) {}
 
+  const unsigned char* pixels() const {
+    return storage ? storage.get() : data.data();
+  }
+
+  const unsigned char* row(int y) const {
+    return pixels() + origin + y * stride;
+  }
+
+  // Writable access; the pixels must be owned (a mapped image is read-only)
   unsigned char& at(int x, int y) {
-    return data[y * width + x];
+    return const_cast<unsigned char*>(row(y))[x];
   }
 
   const unsigned char& at(int x, int y) const {
-    return data[y * width + x];
+    return row(y)[x];
   }
 
   bool is_mask_pixel(int x, int y) const {
@@ -33,9 +76,9 @@ struct Image {
   }
 };
 
-// Read PGM (Portable GrayMap) format - simple text-based format
-// This is a simplified alternative to PNG for testing
-inline Image read_pgm(const std::string& filename) {
+// Read PGM through an input stream, one value at a time. Kept as the
+// reference implementation for read_pgm_mapped().
+inline Image read_pgm_stream(const std::string& filename) {
   std::ifstream file(filename, std::ios::binary);
   if (!file.is_open()) {
     throw std::runtime_error("Cannot open image file: " + filename);
@@ -75,364 +118,236 @@ inline Image read_pgm(const std::string& filename) {
   return img;
 }
 
-// GDSII Binary Format Support
-// Reference: gdsii_to_text.cpp
-
-namespace gdsii {
-  // Record types
-  enum RecordType : uint8_t {
-    HEADER    = 0x00,
-    BGNLIB    = 0x01,
-    LIBNAME   = 0x02,
-    UNITS     = 0x03,
-    ENDLIB    = 0x04,
-    BGNSTR    = 0x05,
-    STRNAME   = 0x06,
-    ENDSTR    = 0x07,
-    BOUNDARY  = 0x08,
-    LAYER     = 0x0D,
-    DATATYPE  = 0x0E,
-    XY        = 0x10,
-    ENDEL     = 0x11
-  };
-
-  // Data types
-  enum DataType : uint8_t {
-    NO_DATA   = 0x00,
-    BIT_ARRAY = 0x01,
-    INT16     = 0x02,
-    INT32     = 0x03,
-    REAL64    = 0x05,
-    ASCII     = 0x06
-  };
+namespace pgm_detail {
 
-  // Helper functions to write GDSII records
-  inline void write_record_header(std::ofstream& file, uint16_t length,
-                                   uint8_t rtype, uint8_t dtype) {
-    uint8_t header[4];
-    header[0] = (length >> 8) & 0xFF;
-    header[1] = length & 0xFF;
-    header[2] = rtype;
-    header[3] = dtype;
-    file.write(reinterpret_cast<char*>(header), 4);
-  }
+inline bool is_space(unsigned char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t' ||
+         c == '\v' || c == '\f';
+}
 
-  inline void write_int16(std::ofstream& file, int16_t value) {
-    uint8_t bytes[2];
-    bytes[0] = (value >> 8) & 0xFF;
-    bytes[1] = value & 0xFF;
-    file.write(reinterpret_cast<char*>(bytes), 2);
-  }
+struct PgmHeader {
+  bool binary;
+  int width, height, max_val;
+  size_t data_offset;
+};
 
-  inline void write_int32(std::ofstream& file, int32_t value) {
-    uint8_t bytes[4];
-    bytes[0] = (value >> 24) & 0xFF;
-    bytes[1] = (value >> 16) & 0xFF;
-    bytes[2] = (value >> 8) & 0xFF;
-    bytes[3] = value & 0xFF;
-    file.write(reinterpret_cast<char*>(bytes), 4);
+// Parse "P2|P5 <width> <height> <maxval>" with '#' comments
+inline PgmHeader parse_pgm_header(const unsigned char* data, size_t size,
+                                  const std::string& filename) {
+  if (size < 2 || data[0] != 'P' || (data[1] != '2' && data[1] != '5')) {
+    throw std::runtime_error("Unsupported PGM format: " + filename);
   }
 
-  inline void write_string(std::ofstream& file, const std::string& str) {
-    file.write(str.c_str(), str.length());
-    if (str.length() % 2 == 1) {
-      file.put('\0');  // Padding for odd-length strings
-    }
-  }
+  PgmHeader header;
+  header.binary = (data[1] == '5');
+  size_t pos = 2;
+  int* fields[3] = {&header.width, &header.height, &header.max_val};
 
-  inline void write_real64(std::ofstream& file, double value) {
-    // GDSII uses a special 64-bit floating point format
-    // For simplicity, we'll just store 0.0 for now
-    // A full implementation would convert IEEE 754 to GDSII format
-    uint8_t bytes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    if (value != 0.0) {
-      // Simple conversion (not fully accurate for all values)
-      int sign = value < 0 ? 1 : 0;
-      value = std::abs(value);
-      int exponent = 64;  // Base exponent
-      while (value >= 1.0 && exponent < 127) {
-        value /= 16.0;
-        exponent++;
-      }
-      while (value < 0.0625 && exponent > 0) {
-        value *= 16.0;
-        exponent--;
-      }
-      uint64_t mantissa = static_cast<uint64_t>(value * (1ULL << 56));
-      uint64_t result = (static_cast<uint64_t>(sign) << 63) |
-                        (static_cast<uint64_t>(exponent) << 56) |
-                        (mantissa & 0x00FFFFFFFFFFFFFFULL);
-      for (int i = 0; i < 8; ++i) {
-        bytes[i] = (result >> (56 - i * 8)) & 0xFF;
+  for (int* field : fields) {
+    while (pos < size && (is_space(data[pos]) || data[pos] == '#')) {
+      if (data[pos] == '#') {
+        while (pos < size && data[pos] != '\n') pos++;
+      } else {
+        pos++;
       }
     }
-    file.write(reinterpret_cast<char*>(bytes), 8);
-  }
-
-  inline int16_t read_int16(std::ifstream& file) {
-    uint8_t bytes[2];
-    file.read(reinterpret_cast<char*>(bytes), 2);
-    return (static_cast<int16_t>(bytes[0]) << 8) | static_cast<int16_t>(bytes[1]);
-  }
-
-  inline int32_t read_int32(std::ifstream& file) {
-    uint8_t bytes[4];
-    file.read(reinterpret_cast<char*>(bytes), 4);
-    return (static_cast<int32_t>(bytes[0]) << 24) |
-           (static_cast<int32_t>(bytes[1]) << 16) |
-           (static_cast<int32_t>(bytes[2]) << 8) |
-           static_cast<int32_t>(bytes[3]);
+    const char* first = reinterpret_cast<const char*>(data + pos);
+    const char* last = reinterpret_cast<const char*>(data + size);
+    auto result = std::from_chars(first, last, *field);
+    if (result.ec != std::errc() || *field <= 0) {
+      throw std::runtime_error("Invalid PGM header: " + filename);
+    }
+    pos += result.ptr - first;
   }
 
-  inline std::string read_string(std::ifstream& file, int length) {
-    std::vector<char> buffer(length);
-    file.read(buffer.data(), length);
-    std::string str(buffer.begin(), buffer.end());
-    // Remove null padding
-    size_t pos = str.find('\0');
-    if (pos != std::string::npos) {
-      str = str.substr(0, pos);
+  // Exactly one whitespace character separates the header from the pixels
+  if (pos >= size || !is_space(data[pos])) {
+    if (pos != size || header.binary) {
+      throw std::runtime_error("Invalid PGM header: " + filename);
     }
-    return str;
   }
+  header.data_offset = std::min(pos + 1, size);
+  return header;
 }
 
-// Write polygons to GDSII binary format
-inline void write_gdsii(const std::vector<Polygon>& polygons,
-                        const std::string& filename) {
-  std::ofstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
-    throw std::runtime_error("Cannot open GDSII file for writing: " + filename);
+inline size_t count_tokens(const unsigned char* begin,
+                           const unsigned char* end) {
+  size_t count = 0;
+  bool in_token = false;
+  for (const unsigned char* p = begin; p < end; ++p) {
+    bool token = !is_space(*p);
+    count += token && !in_token;
+    in_token = token;
   }
+  return count;
+}
 
-  // HEADER record
-  gdsii::write_record_header(file, 6, gdsii::HEADER, gdsii::INT16);
-  gdsii::write_int16(file, 600);  // Version 6.0.0
-
-  // BGNLIB record (12 modification/access times, all zeros for simplicity)
-  gdsii::write_record_header(file, 28, gdsii::BGNLIB, gdsii::INT16);
-  for (int i = 0; i < 12; ++i) {
-    gdsii::write_int16(file, 0);
+// Parse the P2 pixel text on several threads. The text is cut into chunks
+// at line ends; a counting pass gives every chunk the index of its first
+// value, then each chunk parses its values straight into place.
+inline void parse_p2_pixels(const unsigned char* text, size_t size,
+                            unsigned char* out, size_t num_pixels,
+                            int num_threads, const std::string& filename) {
+  const size_t min_chunk = 1 << 20;
+  size_t num_chunks = std::max<size_t>(1, std::min<size_t>(
+      static_cast<size_t>(num_threads) * 4, size / min_chunk));
+  int workers = static_cast<int>(std::min<size_t>(num_threads, num_chunks));
+
+  std::vector<size_t> bounds(num_chunks + 1, size);
+  bounds[0] = 0;
+  for (size_t c = 1; c < num_chunks; ++c) {
+    size_t pos = std::max(bounds[c - 1], size * c / num_chunks);
+    while (pos < size && text[pos] != '\n') pos++;
+    bounds[c] = pos;
   }
 
-  // LIBNAME record
-  std::string libname = "EASYMRC_LIB";
-  int libname_len = libname.length();
-  if (libname_len % 2 == 1) libname_len++;  // Padding
-  gdsii::write_record_header(file, 4 + libname_len, gdsii::LIBNAME, gdsii::ASCII);
-  gdsii::write_string(file, libname);
-
-  // UNITS record (database unit and user unit)
-  gdsii::write_record_header(file, 20, gdsii::UNITS, gdsii::REAL64);
-  gdsii::write_real64(file, 0.001);  // User unit: 0.001 (1 unit = 1nm if meter-based)
-  gdsii::write_real64(file, 1e-9);   // Database unit in meters: 1nm
-
-  // Write each polygon as a separate structure
-  for (const auto& poly : polygons) {
-    // BGNSTR record
-    gdsii::write_record_header(file, 28, gdsii::BGNSTR, gdsii::INT16);
-    for (int i = 0; i < 12; ++i) {
-      gdsii::write_int16(file, 0);
-    }
-
-    // STRNAME record
-    std::string strname = "POLY_" + std::to_string(poly.id);
-    int strname_len = strname.length();
-    if (strname_len % 2 == 1) strname_len++;  // Padding
-    gdsii::write_record_header(file, 4 + strname_len, gdsii::STRNAME, gdsii::ASCII);
-    gdsii::write_string(file, strname);
-
-    // BOUNDARY record
-    gdsii::write_record_header(file, 4, gdsii::BOUNDARY, gdsii::NO_DATA);
-
-    // LAYER record
-    gdsii::write_record_header(file, 6, gdsii::LAYER, gdsii::INT16);
-    gdsii::write_int16(file, 0);  // Layer 0
-
-    // DATATYPE record
-    gdsii::write_record_header(file, 6, gdsii::DATATYPE, gdsii::INT16);
-    gdsii::write_int16(file, 0);  // Datatype 0
-
-    // XY record (coordinates)
-    // GDSII requires polygons to be closed (first point == last point)
-    int num_points = poly.vertices.size();
-    bool needs_closing = (num_points > 0 &&
-                          (poly.vertices[0].x() != poly.vertices[num_points-1].x() ||
-                           poly.vertices[0].y() != poly.vertices[num_points-1].y()));
-    int total_points = needs_closing ? num_points + 1 : num_points;
-
-    gdsii::write_record_header(file, 4 + total_points * 8, gdsii::XY, gdsii::INT32);
-    for (const auto& vertex : poly.vertices) {
-      gdsii::write_int32(file, vertex.x());
-      gdsii::write_int32(file, vertex.y());
+  auto run_chunks = [workers, num_chunks](auto&& body) {
+    if (workers <= 1) {
+      for (size_t c = 0; c < num_chunks; ++c) body(c);
+      return;
     }
-    if (needs_closing) {
-      gdsii::write_int32(file, poly.vertices[0].x());
-      gdsii::write_int32(file, poly.vertices[0].y());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < workers; ++t) {
+      threads.emplace_back([&next, &body, num_chunks]() {
+        for (size_t c = next++; c < num_chunks; c = next++) body(c);
+      });
     }
+    for (auto& thread : threads) thread.join();
+  };
 
-    // ENDEL record
-    gdsii::write_record_header(file, 4, gdsii::ENDEL, gdsii::NO_DATA);
-
-    // ENDSTR record
-    gdsii::write_record_header(file, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+  // Pass 1: values per chunk
+  std::vector<size_t> first_index(num_chunks + 1, 0);
+  run_chunks([&](size_t c) {
+    first_index[c + 1] = count_tokens(text + bounds[c], text + bounds[c + 1]);
+  });
+  for (size_t c = 0; c < num_chunks; ++c) {
+    first_index[c + 1] += first_index[c];
   }
-
-  // ENDLIB record
-  gdsii::write_record_header(file, 4, gdsii::ENDLIB, gdsii::NO_DATA);
-
-  file.close();
-}
-
-// Read polygons from GDSII binary format
-inline std::vector<Polygon> read_gdsii(const std::string& filename) {
-  std::ifstream file(filename, std::ios::binary);
-  if (!file.is_open()) {
-    throw std::runtime_error("Cannot open GDSII file for reading: " + filename);
+  if (first_index.back() < num_pixels) {
+    throw std::runtime_error("Truncated PGM pixel data: " + filename);
   }
 
-  std::vector<Polygon> polygons;
-  int current_polygon_id = 0;
-  Polygon current_poly;
-  bool in_boundary = false;
-  std::vector<Point> current_vertices;
-
-  while (file.peek() != EOF) {
-    // Read record header
-    uint8_t header[4];
-    file.read(reinterpret_cast<char*>(header), 4);
-    if (file.gcount() < 4) break;
-
-    uint16_t record_length = (static_cast<uint16_t>(header[0]) << 8) |
-                             static_cast<uint16_t>(header[1]);
-    uint8_t rtype = header[2];
-    // uint8_t dtype = header[3];  // Not used in current implementation
-
-    int payload_size = record_length - 4;
-
-    // Process record based on type
-    switch (rtype) {
-      case gdsii::BGNSTR: {
-        // Start of structure - skip timestamp data
-        file.seekg(payload_size, std::ios::cur);
-        current_poly = Polygon(current_polygon_id++);
-        current_vertices.clear();
-        break;
-      }
-
-      case gdsii::STRNAME: {
-        // Structure name - skip for now
-        file.seekg(payload_size, std::ios::cur);
-        break;
-      }
-
-      case gdsii::BOUNDARY: {
-        // Start of boundary element
-        in_boundary = true;
-        current_vertices.clear();
-        break;
-      }
-
-      case gdsii::LAYER:
-      case gdsii::DATATYPE: {
-        // Layer/datatype - skip
-        file.seekg(payload_size, std::ios::cur);
-        break;
-      }
-
-      case gdsii::XY: {
-        // Read coordinates
-        int num_points = payload_size / 8;
-        for (int i = 0; i < num_points; ++i) {
-          int32_t x = gdsii::read_int32(file);
-          int32_t y = gdsii::read_int32(file);
-          current_vertices.push_back(Point(x, y));
-        }
-        break;
-      }
-
-      case gdsii::ENDEL: {
-        // End of element
-        if (in_boundary && !current_vertices.empty()) {
-          // Remove the last point if it's a duplicate of the first (GDSII closing)
-          if (current_vertices.size() > 1) {
-            const Point& first = current_vertices[0];
-            const Point& last = current_vertices[current_vertices.size() - 1];
-            if (first.x() == last.x() && first.y() == last.y()) {
-              current_vertices.pop_back();
-            }
-          }
-
-          // Add vertices to polygon
-          for (const auto& vertex : current_vertices) {
-            current_poly.add_vertex(vertex);
-          }
-
-          // Build segments from vertices
-          current_poly.build_segments();
-
-          current_vertices.clear();
-          in_boundary = false;
-        }
-        break;
-      }
-
-      case gdsii::ENDSTR: {
-        // End of structure
-        if (!current_poly.vertices.empty()) {
-          polygons.push_back(current_poly);
-        }
-        break;
+  // Pass 2: parse in place
+  std::atomic<bool> malformed(false);
+  run_chunks([&](size_t c) {
+    const char* p = reinterpret_cast<const char*>(text + bounds[c]);
+    const char* end = reinterpret_cast<const char*>(text + bounds[c + 1]);
+    size_t index = first_index[c];
+    while (index < num_pixels) {
+      while (p < end && is_space(static_cast<unsigned char>(*p))) p++;
+      if (p == end) break;
+      int value = 0;
+      auto result = std::from_chars(p, end, value);
+      if (result.ec != std::errc()) {
+        malformed = true;
+        return;
       }
+      out[index++] = static_cast<unsigned char>(value);
+      p = result.ptr;
+    }
+  });
+  if (malformed) {
+    throw std::runtime_error("Malformed PGM pixel data: " + filename);
+  }
+}
 
-      case gdsii::ENDLIB: {
-        // End of library
-        break;
-      }
+}  // namespace pgm_detail
+
+// Read PGM through a memory mapping. P5 pixels are used in place: the
+// image refers to the mapping and addresses the rows bottom-up, so nothing
+// is copied or flipped. P2 text is parsed in parallel with from_chars
+// (num_threads = 0: one per usable CPU). Only 8-bit images are supported.
+inline Image read_pgm_mapped(const std::string& filename,
+                             int num_threads = 0) {
+  auto file = std::make_shared<MappedFile>(filename);
+  auto header = pgm_detail::parse_pgm_header(file->data(), file->size(),
+                                             filename);
+  if (header.max_val > 255) {
+    throw std::runtime_error("16-bit PGM is not supported: " + filename);
+  }
 
-      default: {
-        // Skip unknown records
-        file.seekg(payload_size, std::ios::cur);
-        break;
-      }
+  size_t width = header.width;
+  size_t height = header.height;
+  size_t num_pixels = width * height;
+  const unsigned char* payload = file->data() + header.data_offset;
+  size_t payload_size = file->size() - header.data_offset;
+
+  Image img;
+  img.width = header.width;
+  img.height = header.height;
+  img.origin = static_cast<std::ptrdiff_t>((height - 1) * width);
+  img.stride = -static_cast<std::ptrdiff_t>(width);
+
+  if (header.binary) {
+    if (payload_size < num_pixels) {
+      throw std::runtime_error("Truncated PGM pixel data: " + filename);
     }
+    // Aliasing constructor: points at the pixels, owns the mapping
+    img.storage = std::shared_ptr<const unsigned char>(file, payload);
+  } else {
+    if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+    img.data.resize(num_pixels);
+    pgm_detail::parse_p2_pixels(payload, payload_size, img.data.data(),
+                                num_pixels, num_threads, filename);
   }
 
-  file.close();
-  return polygons;
+  return img;
 }
 
-// Direction enumeration for clockwise traversal
-enum Direction { RIGHT = 0, DOWN = 1, LEFT = 2, UP = 3 };
+// Read PGM (Portable GrayMap) format - simple text-based format
+// This is a simplified alternative to PNG for testing
+inline Image read_pgm(const std::string& filename) {
+  return read_pgm_mapped(filename);
+}
 
-// Direction vectors: right, down, left, up
-const int dx[] = {1, 0, -1, 0};
-const int dy[] = {0, -1, 0, 1};
+// Thresholded mask of an image file: PNG is decoded straight into the mask,
+// anything else is read as PGM and then thresholded (num_threads = 0: one
+// per usable CPU)
+inline BitImage read_mask(const std::string& filename,
+                          unsigned char threshold = 255,
+                          int num_threads = 0) {
+  if (png_detail::is_png_file(filename)) {
+    return read_png_mask(filename, threshold);
+  }
+  if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+  // The 8-bit image is only needed until it has been thresholded
+  Image img = read_pgm(filename);
+  return BitImage::threshold(img, threshold, num_threads);
+}
+
+// Masks of the layers encoded as gray levels of an image file, decoded in
+// a single pass: mask k holds the pixels equal to levels[k] (num_threads =
+// 0: one per usable CPU)
+inline std::vector<BitImage> read_level_masks(
+    const std::string& filename, const std::vector<unsigned char>& levels,
+    int num_threads = 0) {
+  if (png_detail::is_png_file(filename)) {
+    return read_png_levels(filename, levels);
+  }
+  if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+  Image img = read_pgm(filename);
+  return BitImage::select_levels(img, levels, num_threads);
+}
 
 class FormatConverter {
  public:
-  FormatConverter(const Image& img) : image_(img) {
-    visited_.resize(img.height, std::vector<bool>(img.width, false));
-  }
+  FormatConverter(const Image& img, int num_threads = 0)
+      : FormatConverter(BitImage::threshold(img), num_threads) {}
+
+  // Convert an already thresholded mask (num_threads = 0: one per CPU)
+  FormatConverter(BitImage mask, int num_threads = 0)
+      : mask_(std::move(mask)), num_threads_(num_threads) {}
+
+  const BitImage& mask() const { return mask_; }
 
   // Convert PGM image to polygons
   // If gdsii_filename is provided, the flow is: PGM -> GDSII (save) -> Polygon
   // Otherwise, direct conversion: PGM -> Polygon
   std::vector<Polygon> convert(const std::string& gdsii_filename = "") {
-    std::vector<Polygon> polygons;
-    int polygon_id = 0;
-
-    // Scan from bottom-left to top-right
-    for (int y = 0; y < image_.height; ++y) {
-      for (int x = 0; x < image_.width; ++x) {
-        if (image_.is_mask_pixel(x, y) && !visited_[y][x]) {
-          Polygon poly = trace_polygon(x, y, polygon_id++);
-          if (!poly.segments.empty()) {
-            polygons.push_back(poly);
-          }
-        }
-      }
-    }
+    ScanlineExtractor extractor(mask_, num_threads_);
+    std::vector<Polygon> polygons = extractor.extract();
+    statistics_ = extractor.statistics();
 
     // If GDSII filename is provided, write to GDSII and read back
     if (!gdsii_filename.empty()) {
@@ -443,118 +358,60 @@ class FormatConverter {
     return polygons;
   }
 
- private:
-  const Image& image_;
-  std::vector<std::vector<bool>> visited_;
-
-  Polygon trace_polygon(int start_x, int start_y, int polygon_id) {
-    Polygon poly(polygon_id);
-
-    int x = start_x;
-    int y = start_y;
-    Direction dir = RIGHT;  // Start going right
-
-    Point start_corner(x, y);  // Bottom-left corner of pixel
-    Point current_corner = start_corner;
-
-    std::vector<Point> corners;
-    corners.push_back(current_corner);
-
-    // Mark starting pixel as visited
-    visited_[y][x] = true;
-
-    // Trace boundary clockwise
-    bool first_iteration = true;
-    Direction prev_dir = dir;
-
-    do {
-      // Try to continue in current direction
-      int next_x = x + dx[dir];
-      int next_y = y + dy[dir];
-
-      if (image_.is_mask_pixel(next_x, next_y) &&
-          (first_iteration || next_x != start_x || next_y != start_y ||
-           corners.size() < 4)) {
-        // Move to next pixel
-        x = next_x;
-        y = next_y;
-        visited_[y][x] = true;
-
-        // Update corner position based on direction
-        current_corner = get_next_corner(current_corner, dir);
-
-        // Try to turn right (clockwise)
-        Direction new_dir = static_cast<Direction>((dir + 3) % 4);
-
-        // Check if we can turn right
-        int turn_x = x + dx[new_dir];
-        int turn_y = y + dy[new_dir];
-
-        if (image_.is_mask_pixel(turn_x, turn_y)) {
-          // Record corner when direction changes
-          if (new_dir != dir) {
-            corners.push_back(current_corner);
-          }
-          dir = new_dir;
-        } else if (prev_dir != dir) {
-          // Direction changed, record corner
-          corners.push_back(current_corner);
-        }
-
-        prev_dir = dir;
-        first_iteration = false;
-
-      } else {
-        // Can't continue, turn left
-        dir = static_cast<Direction>((dir + 1) % 4);
-      }
-
-      // Safety check to prevent infinite loop
-      if (corners.size() > (size_t)(image_.width * image_.height)) {
-        break;
-      }
-
-    } while (current_corner.x() != start_corner.x() ||
-             current_corner.y() != start_corner.y() ||
-             first_iteration);
-
-    // Build polygon from corners
-    for (size_t i = 0; i < corners.size(); ++i) {
-      poly.vertices.push_back(corners[i]);
-    }
-
-    poly.build_segments();
-
-    return poly;
+  // Convert to polygons and write them to gdsii_filename on a background
+  // thread. Unlike convert(gdsii_filename) the file is not read back: the
+  // traced polygons are available at once from the returned export.
+  GdsiiExport convert_exporting(const std::string& gdsii_filename) {
+    return GdsiiExport(convert(), gdsii_filename);
   }
 
-  Point get_next_corner(const Point& corner, Direction dir) {
-    switch (dir) {
-      case RIGHT:
-        return Point(corner.x() + 1, corner.y());
-      case DOWN:
-        return Point(corner.x(), corner.y() - 1);
-      case LEFT:
-        return Point(corner.x() - 1, corner.y());
-      case UP:
-        return Point(corner.x(), corner.y() + 1);
-      default:
-        return corner;
-    }
+  // Runs, components and edges of the last conversion
+  const ScanlineExtractor::Statistics& statistics() const {
+    return statistics_;
   }
+
+ private:
+  BitImage mask_;
+  int num_threads_;
+  ScanlineExtractor::Statistics statistics_;
 };
 
 // Main conversion function
-// If gdsii_filename is provided, the flow is: PGM -> GDSII (save) -> Polygon
-// Otherwise, direct conversion: PGM -> Polygon
+// (PGM or PNG). If gdsii_filename is provided, the flow is:
+// image -> GDSII (save) -> Polygon; otherwise image -> Polygon directly
 inline std::vector<Polygon> format_conversion(
     const std::string& image_file,
     const std::string& gdsii_filename = "") {
-  Image img = read_pgm(image_file);
-  FormatConverter converter(img);
+  FormatConverter converter(read_mask(image_file));
   return converter.convert(gdsii_filename);
 }
 
+// Conversion returning the polygons at once while they are written to
+// gdsii_filename in the background: image -> Polygon (-> GDSII)
+inline GdsiiExport format_conversion_exporting(
+    const std::string& image_file, const std::string& gdsii_filename) {
+  FormatConverter converter(read_mask(image_file));
+  return converter.convert_exporting(gdsii_filename);
+}
+
+// Conversion of an image holding several layers as gray levels: the pixels
+// are decoded once, and layer k is traced from the pixels equal to
+// levels[k]. Polygons of each layer are numbered from 0.
+inline std::vector<std::vector<Polygon>> format_conversion_levels(
+    const std::string& image_file, const std::vector<unsigned char>& levels,
+    int num_threads = 0) {
+  std::vector<BitImage> masks = read_level_masks(image_file, levels,
+                                                 num_threads);
+  std::vector<std::vector<Polygon>> layers;
+  layers.reserve(masks.size());
+  for (auto& mask : masks) {
+    // Each mask is released with its converter once it has been traced
+    FormatConverter converter(std::move(mask), num_threads);
+    layers.push_back(converter.convert());
+  }
+  return layers;
+}
+
 // Alternative: convert from raw pixel data
 inline std::vector<Polygon> format_conversion_from_data(
     const std::vector<std::vector<unsigned char>>& pixel_data) {
@@ -0,0 +1,686 @@
+#pragma once
+
+#include <vector>
+#include <set>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "types.hpp"
+#include "mapped_file.hpp"
+#include "topology.hpp"
+#include "component_labeling.hpp"
+#include "gdsii_stream.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace easymrc {
+
+// Layers to read from a GDSII file: whole layers, or single datatypes of a
+// layer. An empty selection keeps every layer.
+class LayerSelection {
+ public:
+  LayerSelection() = default;
+
+  // datatype = -1: every datatype of the layer
+  void add(int layer, int datatype = -1) {
+    selected_.insert(std::make_pair(layer, datatype));
+  }
+
+  bool empty() const { return selected_.empty(); }
+
+  bool contains(int layer, int datatype) const {
+    return selected_.empty() ||
+           selected_.count(std::make_pair(layer, -1)) > 0 ||
+           selected_.count(std::make_pair(layer, datatype)) > 0;
+  }
+
+  // Comma-separated layers or layer/datatype pairs, e.g. "1, 5/0, 17"
+  static LayerSelection parse(const std::string& text) {
+    LayerSelection selection;
+    size_t start = 0;
+    while (start <= text.size()) {
+      size_t comma = std::min(text.find(',', start), text.size());
+      std::string item = text.substr(start, comma - start);
+      item.erase(0, item.find_first_not_of(" \t"));
+      item.erase(item.find_last_not_of(" \t") + 1);
+      if (!item.empty()) {
+        int layer = 0, datatype = -1;
+        size_t slash = item.find('/');
+        const char* end = item.data() + item.size();
+        const char* layer_end = item.data() + std::min(slash, item.size());
+        auto parsed = std::from_chars(item.data(), layer_end, layer);
+        bool ok = parsed.ec == std::errc() && parsed.ptr == layer_end &&
+                  layer >= 0;
+        if (ok && slash != std::string::npos) {
+          parsed = std::from_chars(layer_end + 1, end, datatype);
+          ok = parsed.ec == std::errc() && parsed.ptr == end && datatype >= 0;
+        }
+        if (!ok) {
+          throw std::runtime_error(
+              "Invalid layer '" + item +
+              "' (expected <layer> or <layer>/<datatype>)");
+        }
+        selection.add(layer, datatype);
+      }
+      start = comma + 1;
+    }
+    return selection;
+  }
+
+ private:
+  std::set<std::pair<int, int>> selected_;
+};
+
+namespace gdsii_detail {
+
+inline uint16_t load_be16(const unsigned char* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline int32_t load_be32(const unsigned char* p) {
+  return static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 24) |
+                              (static_cast<uint32_t>(p[1]) << 16) |
+                              (static_cast<uint32_t>(p[2]) << 8) |
+                              static_cast<uint32_t>(p[3]));
+}
+
+// GDSII 8-byte real: sign bit, excess-64 base-16 exponent and a 56-bit
+// mantissa
+inline double load_real64(const unsigned char* p) {
+  uint64_t bits = 0;
+  for (int i = 0; i < 8; ++i) bits = (bits << 8) | p[i];
+  double mantissa = static_cast<double>(bits & 0x00FFFFFFFFFFFFFFULL);
+  int exponent = static_cast<int>((bits >> 56) & 0x7F) - 64;
+  double value = std::ldexp(mantissa, 4 * exponent - 56);
+  return (bits >> 63) ? -value : value;
+}
+
+// Convert count big-endian (x, y) int32 pairs to points. SSE2 converts two
+// points at a time: bytes are swapped within 16-bit lanes, then the 16-bit
+// halves of each 32-bit lane.
+inline void load_xy(const unsigned char* src, size_t count, Point* out) {
+  static_assert(sizeof(Point) == 2 * sizeof(int32_t),
+                "Point must be two packed 32-bit coordinates");
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 2 <= count; i += 2) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 8));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+  }
+#endif
+  for (; i < count; ++i) {
+    out[i] = Point(load_be32(src + i * 8), load_be32(src + i * 8 + 4));
+  }
+}
+
+// Byte ranges [begin, end) of the structures of a GDSII stream
+struct StructureIndex {
+  std::vector<size_t> begin, end;
+};
+
+// First pass: walk the record headers only, skipping payloads
+inline StructureIndex index_structures(const unsigned char* data,
+                                       size_t size,
+                                       const std::string& filename) {
+  StructureIndex index;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t length = pos + 4 <= size ? load_be16(data + pos) : 0;
+    if (length < 4 || pos + length > size) {
+      throw std::runtime_error("Malformed GDSII record at offset " +
+                               std::to_string(pos) + ": " + filename);
+    }
+    uint8_t rtype = data[pos + 2];
+    if (rtype == gdsii::BGNSTR) {
+      if (!index.begin.empty()) index.end.push_back(pos);
+      index.begin.push_back(pos);
+    } else if (rtype == gdsii::ENDLIB) {
+      break;
+    }
+    pos += length;
+  }
+  if (!index.begin.empty()) index.end.push_back(pos);
+  return index;
+}
+
+// Boundary element of a structure: records [begin, end) from BOUNDARY
+// through ENDEL, its layer and datatype, and its number of XY points
+struct BoundaryElement {
+  size_t begin, end;
+  int layer, datatype;
+  size_t points;
+};
+
+// Call visit(element) for each boundary in the records [begin, end),
+// reading only record headers and the LAYER and DATATYPE values, and
+// reference(first, last) for the records [first, last) of each SREF or
+// AREF element
+template <typename Visit, typename Reference>
+void for_each_element(const unsigned char* data, size_t begin, size_t end,
+                      Visit&& visit, Reference&& reference) {
+  BoundaryElement element{0, 0, 0, 0, 0};
+  bool in_boundary = false, in_reference = false;
+  size_t reference_begin = 0;
+  for (size_t pos = begin; pos < end; pos += load_be16(data + pos)) {
+    size_t length = load_be16(data + pos);
+    switch (data[pos + 2]) {
+      case gdsii::BOUNDARY:
+        in_boundary = true;
+        in_reference = false;
+        element = BoundaryElement{pos, pos, 0, 0, 0};
+        break;
+      case gdsii::SREF:
+      case gdsii::AREF:
+        in_boundary = false;
+        in_reference = true;
+        reference_begin = pos;
+        break;
+      case gdsii::LAYER:
+        if (in_boundary && length >= 6) {
+          element.layer = load_be16(data + pos + 4);
+        }
+        break;
+      case gdsii::DATATYPE:
+        if (in_boundary && length >= 6) {
+          element.datatype = load_be16(data + pos + 4);
+        }
+        break;
+      case gdsii::XY:
+        if (in_boundary) element.points += (length - 4) / 8;
+        break;
+      case gdsii::ENDEL:
+        if (in_boundary) {
+          element.end = pos + length;
+          visit(element);
+        } else if (in_reference) {
+          reference(reference_begin, pos + length);
+        }
+        in_boundary = in_reference = false;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+template <typename Visit>
+void for_each_boundary(const unsigned char* data, size_t begin, size_t end,
+                       Visit&& visit) {
+  for_each_element(data, begin, end, visit, [](size_t, size_t) {});
+}
+
+// Call xy(payload, count) for each XY record of one boundary element.
+// Records must lie within the element, which an outdated layer index may
+// violate.
+template <typename Xy>
+void for_each_xy(const unsigned char* data, const BoundaryElement& element,
+                 Xy&& xy) {
+  for (size_t pos = element.begin; pos < element.end;) {
+    size_t length = pos + 4 <= element.end ? load_be16(data + pos) : 0;
+    if (length < 4 || pos + length > element.end) {
+      throw std::runtime_error("Malformed GDSII element at offset " +
+                               std::to_string(pos));
+    }
+    if (data[pos + 2] == gdsii::XY) xy(data + pos + 4, (length - 4) / 8);
+    pos += length;
+  }
+}
+
+// Convert the XY points of one boundary element to vertices at out,
+// without its GDSII closing point; returns the number of vertices
+inline size_t decode_boundary(const unsigned char* data,
+                              const BoundaryElement& element, Point* out) {
+  size_t used = 0;
+  for_each_xy(data, element, [&](const unsigned char* xy, size_t count) {
+    load_xy(xy, count, out + used);
+    used += count;
+  });
+  if (used > 1 && out[0].x() == out[used - 1].x() &&
+      out[0].y() == out[used - 1].y()) {
+    used--;
+  }
+  return used;
+}
+
+// Decode the boundaries of one structure on the selected layers into
+// poly: the XY points of all of them, each without its closing point (as
+// read_gdsii_stream). Boundaries on other layers are skipped over without
+// touching their XY payloads. elements is scratch space.
+inline void decode_structure(const unsigned char* data, size_t begin,
+                             size_t end, const LayerSelection& layers,
+                             Polygon& poly,
+                             std::vector<BoundaryElement>& elements) {
+  // Size the vertices from the XY record lengths, then convert in place
+  elements.clear();
+  size_t total = 0;
+  for_each_boundary(data, begin, end, [&](const BoundaryElement& element) {
+    if (layers.contains(element.layer, element.datatype)) {
+      elements.push_back(element);
+      total += element.points;
+    }
+  });
+  if (total == 0) return;
+
+  poly.vertices.resize(total);
+  size_t used = 0;
+  for (const auto& element : elements) {
+    used += decode_boundary(data, element, poly.vertices.data() + used);
+  }
+  poly.vertices.resize(used);
+  poly.build_segments();
+}
+
+}  // namespace gdsii_detail
+
+// Read GDSII through a memory mapping. A first pass over the record
+// headers indexes the structures; they are then decoded on num_threads
+// threads (0 = one per usable CPU), converting XY coordinates straight
+// into each polygon's vertices. Polygon i is structure i, as in
+// read_gdsii_stream(); structures without boundaries are dropped. Only
+// boundaries on the selected layers are decoded; the XY payloads of the
+// others are skipped.
+inline std::vector<Polygon> read_gdsii_mapped(
+    const std::string& filename, int num_threads = 0,
+    const LayerSelection& layers = LayerSelection()) {
+  MappedFile file(filename, MappedFile::Access::SEQUENTIAL);
+  const unsigned char* data = file.data();
+  auto index = gdsii_detail::index_structures(data, file.size(), filename);
+  const size_t num_structures = index.begin.size();
+
+  std::vector<Polygon> polygons(num_structures);
+  if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+  size_t num_chunks = std::min<size_t>(num_structures,
+                                       static_cast<size_t>(num_threads) * 8);
+  labeling_detail::parallel_for(num_threads, num_chunks, [&](size_t c) {
+    size_t first = num_structures * c / num_chunks;
+    size_t last = num_structures * (c + 1) / num_chunks;
+    std::vector<gdsii_detail::BoundaryElement> elements;
+    for (size_t s = first; s < last; ++s) {
+      polygons[s].id = static_cast<int>(s);
+      gdsii_detail::decode_structure(data, index.begin[s], index.end[s],
+                                     layers, polygons[s], elements);
+    }
+  });
+
+  polygons.erase(std::remove_if(polygons.begin(), polygons.end(),
+                                [](const Polygon& poly) {
+                                  return poly.vertices.empty();
+                                }),
+                 polygons.end());
+  return polygons;
+}
+
+// Read polygons from GDSII binary format, optionally only some layers
+inline std::vector<Polygon> read_gdsii(
+    const std::string& filename,
+    const LayerSelection& layers = LayerSelection()) {
+  return read_gdsii_mapped(filename, 0, layers);
+}
+
+// Byte ranges of the boundary elements of a GDSII file, grouped by layer
+// and datatype, and of each structure's header (BGNSTR and STRNAME) and
+// references. Saved beside the file, it lets later reads of a few layers
+// go straight to their elements, without walking the rest of the file.
+//
+// Index file: magic, then uint64 version, source size, source mtime (ns),
+// structure count, layer count, element count and reference count; the
+// Layer table; the Element table, grouped by layer and in file order
+// within a layer; the structure headers; the references, in file order.
+class GdsiiLayerIndex {
+ public:
+  struct Layer {
+    int32_t layer, datatype;
+    uint64_t first, count;  // Range of elements
+  };
+
+  struct Element {
+    uint64_t offset;     // BOUNDARY record
+    uint32_t length;     // Bytes through ENDEL
+    uint32_t structure;  // Structure number, the polygon id
+  };
+
+  static constexpr uint64_t kVersion = 2;
+
+  // Index filename for a GDSII file
+  static std::string sidecar(const std::string& gdsii_filename) {
+    return gdsii_filename + ".lidx";
+  }
+
+  // Walk the record headers of gdsii_filename on num_threads threads
+  // (0 = one per usable CPU)
+  static GdsiiLayerIndex build(const std::string& gdsii_filename,
+                               int num_threads = 0) {
+    using namespace gdsii_detail;
+    GdsiiLayerIndex index;
+    file_stamp(gdsii_filename, index.source_size_, index.source_mtime_);
+    MappedFile file(gdsii_filename, MappedFile::Access::SEQUENTIAL);
+    auto structures = index_structures(file.data(), file.size(),
+                                       gdsii_filename);
+    const size_t num_structures = structures.begin.size();
+    if (num_structures > UINT32_MAX) {
+      throw std::runtime_error("Too many structures to index: " +
+                               gdsii_filename);
+    }
+    index.num_structures_ = num_structures;
+    index.headers_.resize(num_structures);
+
+    struct Found {
+      int layer, datatype;
+      Element element;
+    };
+    if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+    size_t num_chunks = std::min<size_t>(num_structures,
+                                         static_cast<size_t>(num_threads) * 8);
+    std::vector<std::vector<Found>> found(num_chunks);
+    std::vector<std::vector<Element>> references(num_chunks);
+    labeling_detail::parallel_for(num_threads, num_chunks, [&](size_t c) {
+      size_t first = num_structures * c / num_chunks;
+      size_t last = num_structures * (c + 1) / num_chunks;
+      for (size_t s = first; s < last; ++s) {
+        const uint32_t structure = static_cast<uint32_t>(s);
+        size_t begin = structures.begin[s];
+        size_t header_end = begin + load_be16(file.data() + begin);
+        if (header_end < structures.end[s] &&
+            file.data()[header_end + 2] == gdsii::STRNAME) {
+          header_end += load_be16(file.data() + header_end);
+        }
+        index.headers_[s] = {begin, static_cast<uint32_t>(header_end - begin),
+                             structure};
+        for_each_element(file.data(), begin, structures.end[s],
+                         [&](const BoundaryElement& e) {
+          Element element{e.begin, static_cast<uint32_t>(e.end - e.begin),
+                          structure};
+          found[c].push_back({e.layer, e.datatype, element});
+        }, [&](size_t first, size_t last) {
+          references[c].push_back(
+              {first, static_cast<uint32_t>(last - first), structure});
+        });
+      }
+    });
+    for (const auto& chunk : references) {
+      index.references_.insert(index.references_.end(), chunk.begin(),
+                               chunk.end());
+    }
+
+    // Chunks are in file order, so a stable sort keeps it within a layer
+    std::vector<Found> all;
+    for (auto& chunk : found) all.insert(all.end(), chunk.begin(), chunk.end());
+    std::stable_sort(all.begin(), all.end(),
+                     [](const Found& a, const Found& b) {
+                       return std::make_pair(a.layer, a.datatype) <
+                              std::make_pair(b.layer, b.datatype);
+                     });
+    for (size_t i = 0; i < all.size(); ++i) {
+      if (i == 0 || all[i].layer != all[i - 1].layer ||
+          all[i].datatype != all[i - 1].datatype) {
+        index.layers_.push_back({all[i].layer, all[i].datatype, i, 0});
+      }
+      index.layers_.back().count++;
+      index.elements_.push_back(all[i].element);
+    }
+    return index;
+  }
+
+  void save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out.is_open()) {
+      throw std::runtime_error("Cannot create GDSII layer index: " + filename);
+    }
+    uint64_t header[7] = {kVersion, source_size_, source_mtime_,
+                          num_structures_, layers_.size(), elements_.size(),
+                          references_.size()};
+    out.write(kMagic, sizeof(kMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(layers_.data()),
+              layers_.size() * sizeof(Layer));
+    out.write(reinterpret_cast<const char*>(elements_.data()),
+              elements_.size() * sizeof(Element));
+    out.write(reinterpret_cast<const char*>(headers_.data()),
+              headers_.size() * sizeof(Element));
+    out.write(reinterpret_cast<const char*>(references_.data()),
+              references_.size() * sizeof(Element));
+    if (!out) {
+      throw std::runtime_error("Failed to write GDSII layer index: " +
+                               filename);
+    }
+  }
+
+  // Load an index saved for gdsii_filename. Returns false if it is
+  // missing, of another version or older than the GDSII file.
+  bool load(const std::string& filename, const std::string& gdsii_filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) return false;
+    char magic[sizeof(kMagic)];
+    uint64_t header[7];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::memcmp(magic, kMagic, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != kVersion) {
+      return false;
+    }
+    uint64_t size = 0, mtime = 0;
+    file_stamp(gdsii_filename, size, mtime);
+    if (header[1] != size || header[2] != mtime) return false;
+
+    // Table sizes must match the file before anything is allocated
+    in.seekg(0, std::ios::end);
+    uint64_t expected = sizeof(kMagic) + sizeof(header);
+    if (header[4] > (UINT64_MAX - expected) / sizeof(Layer)) return false;
+    expected += header[4] * sizeof(Layer);
+    for (int table : {5, 3, 6}) {
+      if (header[table] > (UINT64_MAX - expected) / sizeof(Element)) {
+        return false;
+      }
+      expected += header[table] * sizeof(Element);
+    }
+    if (static_cast<uint64_t>(in.tellg()) != expected) return false;
+    in.seekg(sizeof(kMagic) + sizeof(header));
+
+    std::vector<Layer> layers(header[4]);
+    std::vector<Element> elements(header[5]);
+    std::vector<Element> headers(header[3]);
+    std::vector<Element> references(header[6]);
+    in.read(reinterpret_cast<char*>(layers.data()),
+            layers.size() * sizeof(Layer));
+    for (auto* table : {&elements, &headers, &references}) {
+      in.read(reinterpret_cast<char*>(table->data()),
+              table->size() * sizeof(Element));
+    }
+    if (!in) return false;
+    for (const Layer& layer : layers) {
+      if (layer.first > elements.size() ||
+          layer.count > elements.size() - layer.first) {
+        return false;
+      }
+    }
+    for (const auto* table : {&elements, &headers, &references}) {
+      for (const Element& element : *table) {
+        if (element.offset > size ||
+            element.length > size - element.offset ||
+            element.structure >= header[3]) {
+          return false;
+        }
+      }
+    }
+    for (size_t s = 0; s < headers.size(); ++s) {
+      if (headers[s].structure != s) return false;
+    }
+
+    source_size_ = size;
+    source_mtime_ = mtime;
+    num_structures_ = header[3];
+    layers_ = std::move(layers);
+    elements_ = std::move(elements);
+    headers_ = std::move(headers);
+    references_ = std::move(references);
+    return true;
+  }
+
+  // The index saved beside gdsii_filename, built (and saved, if it can
+  // be) when it is missing or out of date. The index is only a cache: a
+  // read-only location does not fail the read.
+  static GdsiiLayerIndex open(const std::string& gdsii_filename,
+                              int num_threads = 0) {
+    GdsiiLayerIndex index;
+    const std::string index_file = sidecar(gdsii_filename);
+    if (!index.load(index_file, gdsii_filename)) {
+      index = build(gdsii_filename, num_threads);
+      try {
+        index.save(index_file);
+      } catch (const std::runtime_error&) {
+        // Read-only location: read without saving the index
+      }
+    }
+    return index;
+  }
+
+  const std::vector<Layer>& layers() const { return layers_; }
+  const std::vector<Element>& elements() const { return elements_; }
+  const std::vector<Element>& headers() const { return headers_; }
+  const std::vector<Element>& references() const { return references_; }
+  size_t num_structures() const { return num_structures_; }
+  uint64_t source_size() const { return source_size_; }
+
+  // What a reader of the selected layers visits, in file order: every
+  // structure's header and references and its selected boundaries. Each
+  // structure starts with its header.
+  std::vector<Element> structure_elements(
+      const LayerSelection& selection) const {
+    std::vector<Element> result(headers_);
+    result.insert(result.end(), references_.begin(), references_.end());
+    for (const Layer& layer : layers_) {
+      if (!selection.contains(layer.layer, layer.datatype)) continue;
+      result.insert(result.end(), elements_.begin() + layer.first,
+                    elements_.begin() + layer.first + layer.count);
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Element& a, const Element& b) {
+                return a.offset < b.offset;
+              });
+    return result;
+  }
+
+  // Same polygons as read_gdsii_mapped(gdsii_filename, num_threads,
+  // layers), decoding only the selected layers' elements
+  std::vector<Polygon> read(const std::string& gdsii_filename,
+                            const LayerSelection& selection,
+                            int num_threads = 0) const {
+    using namespace gdsii_detail;
+    MappedFile file(gdsii_filename);
+    if (file.size() != source_size_) {
+      throw std::runtime_error("GDSII layer index is out of date: " +
+                               gdsii_filename);
+    }
+
+    // Selected elements in file order, so that those of one structure are
+    // adjacent and in the order read_gdsii_mapped() decodes them
+    std::vector<Element> selected;
+    for (const Layer& layer : layers_) {
+      if (!selection.contains(layer.layer, layer.datatype)) continue;
+      selected.insert(selected.end(), elements_.begin() + layer.first,
+                      elements_.begin() + layer.first + layer.count);
+    }
+    std::sort(selected.begin(), selected.end(),
+              [](const Element& a, const Element& b) {
+                return a.offset < b.offset;
+              });
+    std::vector<size_t> group_start;
+    for (size_t i = 0; i < selected.size(); ++i) {
+      if (i == 0 || selected[i].structure != selected[i - 1].structure) {
+        group_start.push_back(i);
+      }
+    }
+    const size_t num_groups = group_start.size();
+    group_start.push_back(selected.size());
+
+    std::vector<Polygon> polygons(num_groups);
+    if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+    size_t num_chunks = std::min<size_t>(num_groups,
+                                         static_cast<size_t>(num_threads) * 8);
+    // Workers must not throw: a malformed element is reported afterwards
+    std::vector<std::string> errors(num_chunks);
+    labeling_detail::parallel_for(num_threads, num_chunks, [&](size_t c) {
+      size_t first = num_groups * c / num_chunks;
+      size_t last = num_groups * (c + 1) / num_chunks;
+      try {
+        for (size_t g = first; g < last; ++g) {
+          polygons[g].id =
+              static_cast<int>(selected[group_start[g]].structure);
+          decode_group(file.data(), &selected[group_start[g]],
+                       &selected[group_start[g + 1]], polygons[g]);
+        }
+      } catch (const std::exception& e) {
+        errors[c] = e.what();
+      }
+    });
+    for (const auto& error : errors) {
+      if (!error.empty()) {
+        throw std::runtime_error(error + ": " + gdsii_filename);
+      }
+    }
+
+    polygons.erase(std::remove_if(polygons.begin(), polygons.end(),
+                                  [](const Polygon& poly) {
+                                    return poly.vertices.empty();
+                                  }),
+                   polygons.end());
+    return polygons;
+  }
+
+ private:
+  static constexpr char kMagic[8] = {'E', 'M', 'R', 'C', 'L', 'I', 'D', 'X'};
+
+  uint64_t source_size_ = 0;
+  uint64_t source_mtime_ = 0;
+  uint64_t num_structures_ = 0;
+  std::vector<Layer> layers_;
+  std::vector<Element> elements_;
+  std::vector<Element> headers_;     // One per structure
+  std::vector<Element> references_;
+
+  // Decode the elements [begin, end) of one structure into poly
+  static void decode_group(const unsigned char* data, const Element* begin,
+                           const Element* end, Polygon& poly) {
+    using namespace gdsii_detail;
+    auto boundary = [](const Element& e) {
+      return BoundaryElement{e.offset, e.offset + e.length, 0, 0, 0};
+    };
+    size_t total = 0;
+    for (const Element* e = begin; e < end; ++e) {
+      for_each_xy(data, boundary(*e),
+                  [&total](const unsigned char*, size_t count) {
+                    total += count;
+                  });
+    }
+    poly.vertices.resize(total);
+    size_t used = 0;
+    for (const Element* e = begin; e < end; ++e) {
+      used += decode_boundary(data, boundary(*e), poly.vertices.data() + used);
+    }
+    poly.vertices.resize(used);
+    poly.build_segments();
+  }
+
+};
+
+// Read the selected layers of a GDSII file through its sidecar layer index
+// (GdsiiLayerIndex::open())
+inline std::vector<Polygon> read_gdsii_indexed(
+    const std::string& filename, const LayerSelection& layers,
+    int num_threads = 0) {
+  return GdsiiLayerIndex::open(filename, num_threads)
+      .read(filename, layers, num_threads);
+}
+
+}  // namespace easymrc
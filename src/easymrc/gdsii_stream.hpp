@@ -0,0 +1,375 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "types.hpp"
+
+namespace easymrc {
+
+// GDSII Binary Format Support
+// Reference: gdsii_to_text.cpp
+
+namespace gdsii {
+  // Record types
+  enum RecordType : uint8_t {
+    HEADER    = 0x00,
+    BGNLIB    = 0x01,
+    LIBNAME   = 0x02,
+    UNITS     = 0x03,
+    ENDLIB    = 0x04,
+    BGNSTR    = 0x05,
+    STRNAME   = 0x06,
+    ENDSTR    = 0x07,
+    BOUNDARY  = 0x08,
+    SREF      = 0x0A,
+    AREF      = 0x0B,
+    TEXT      = 0x0C,
+    LAYER     = 0x0D,
+    DATATYPE  = 0x0E,
+    XY        = 0x10,
+    ENDEL     = 0x11,
+    SNAME     = 0x12,
+    COLROW    = 0x13,
+    TEXTTYPE  = 0x16,
+    STRING    = 0x19,
+    STRANS    = 0x1A,
+    MAG       = 0x1B,
+    ANGLE     = 0x1C
+  };
+
+  // Data types
+  enum DataType : uint8_t {
+    NO_DATA   = 0x00,
+    BIT_ARRAY = 0x01,
+    INT16     = 0x02,
+    INT32     = 0x03,
+    REAL64    = 0x05,
+    ASCII     = 0x06
+  };
+
+  // Helper functions to write GDSII records
+  inline void write_record_header(std::ofstream& file, uint16_t length,
+                                   uint8_t rtype, uint8_t dtype) {
+    uint8_t header[4];
+    header[0] = (length >> 8) & 0xFF;
+    header[1] = length & 0xFF;
+    header[2] = rtype;
+    header[3] = dtype;
+    file.write(reinterpret_cast<char*>(header), 4);
+  }
+
+  inline void write_int16(std::ofstream& file, int16_t value) {
+    uint8_t bytes[2];
+    bytes[0] = (value >> 8) & 0xFF;
+    bytes[1] = value & 0xFF;
+    file.write(reinterpret_cast<char*>(bytes), 2);
+  }
+
+  inline void write_int32(std::ofstream& file, int32_t value) {
+    uint8_t bytes[4];
+    bytes[0] = (value >> 24) & 0xFF;
+    bytes[1] = (value >> 16) & 0xFF;
+    bytes[2] = (value >> 8) & 0xFF;
+    bytes[3] = value & 0xFF;
+    file.write(reinterpret_cast<char*>(bytes), 4);
+  }
+
+  inline void write_string(std::ofstream& file, const std::string& str) {
+    file.write(str.c_str(), str.length());
+    if (str.length() % 2 == 1) {
+      file.put('\0');  // Padding for odd-length strings
+    }
+  }
+
+  inline void encode_real64(double value, uint8_t bytes[8]) {
+    // GDSII uses a special 64-bit floating point format
+    // A full implementation would convert IEEE 754 to GDSII format
+    std::fill(bytes, bytes + 8, 0);
+    if (value != 0.0) {
+      // Simple conversion (not fully accurate for all values)
+      int sign = value < 0 ? 1 : 0;
+      value = std::abs(value);
+      int exponent = 64;  // Base exponent
+      while (value >= 1.0 && exponent < 127) {
+        value /= 16.0;
+        exponent++;
+      }
+      while (value < 0.0625 && exponent > 0) {
+        value *= 16.0;
+        exponent--;
+      }
+      uint64_t mantissa = static_cast<uint64_t>(value * (1ULL << 56));
+      uint64_t result = (static_cast<uint64_t>(sign) << 63) |
+                        (static_cast<uint64_t>(exponent) << 56) |
+                        (mantissa & 0x00FFFFFFFFFFFFFFULL);
+      for (int i = 0; i < 8; ++i) {
+        bytes[i] = (result >> (56 - i * 8)) & 0xFF;
+      }
+    }
+  }
+
+  inline void write_real64(std::ofstream& file, double value) {
+    uint8_t bytes[8];
+    encode_real64(value, bytes);
+    file.write(reinterpret_cast<char*>(bytes), 8);
+  }
+
+  inline int16_t read_int16(std::ifstream& file) {
+    uint8_t bytes[2];
+    file.read(reinterpret_cast<char*>(bytes), 2);
+    return (static_cast<int16_t>(bytes[0]) << 8) | static_cast<int16_t>(bytes[1]);
+  }
+
+  inline int32_t read_int32(std::ifstream& file) {
+    uint8_t bytes[4];
+    file.read(reinterpret_cast<char*>(bytes), 4);
+    return (static_cast<int32_t>(bytes[0]) << 24) |
+           (static_cast<int32_t>(bytes[1]) << 16) |
+           (static_cast<int32_t>(bytes[2]) << 8) |
+           static_cast<int32_t>(bytes[3]);
+  }
+
+  inline std::string read_string(std::ifstream& file, int length) {
+    std::vector<char> buffer(length);
+    file.read(buffer.data(), length);
+    std::string str(buffer.begin(), buffer.end());
+    // Remove null padding
+    size_t pos = str.find('\0');
+    if (pos != std::string::npos) {
+      str = str.substr(0, pos);
+    }
+    return str;
+  }
+}
+
+namespace gdsii {
+  // HEADER, BGNLIB, LIBNAME and UNITS records
+  inline void write_library_header(std::ofstream& file) {
+    // HEADER record
+    write_record_header(file, 6, HEADER, INT16);
+    write_int16(file, 600);  // Version 6.0.0
+
+    // BGNLIB record (12 modification/access times, all zeros for simplicity)
+    write_record_header(file, 28, BGNLIB, INT16);
+    for (int i = 0; i < 12; ++i) {
+      write_int16(file, 0);
+    }
+
+    // LIBNAME record
+    std::string libname = "EASYMRC_LIB";
+    int libname_len = libname.length();
+    if (libname_len % 2 == 1) libname_len++;  // Padding
+    write_record_header(file, 4 + libname_len, LIBNAME, ASCII);
+    write_string(file, libname);
+
+    // UNITS record (database unit and user unit)
+    write_record_header(file, 20, UNITS, REAL64);
+    write_real64(file, 0.001);  // User unit: 0.001 (1 unit = 1nm if meter-based)
+    write_real64(file, 1e-9);   // Database unit in meters: 1nm
+  }
+
+  // BGNSTR and STRNAME records
+  inline void write_structure_header(std::ofstream& file,
+                                     const std::string& strname) {
+    // BGNSTR record
+    write_record_header(file, 28, BGNSTR, INT16);
+    for (int i = 0; i < 12; ++i) {
+      write_int16(file, 0);
+    }
+
+    // STRNAME record
+    int strname_len = strname.length();
+    if (strname_len % 2 == 1) strname_len++;  // Padding
+    write_record_header(file, 4 + strname_len, STRNAME, ASCII);
+    write_string(file, strname);
+  }
+
+  // BOUNDARY element on layer 0
+  inline void write_boundary(std::ofstream& file, const Polygon& poly) {
+    // BOUNDARY record
+    write_record_header(file, 4, BOUNDARY, NO_DATA);
+
+    // LAYER record
+    write_record_header(file, 6, LAYER, INT16);
+    write_int16(file, 0);  // Layer 0
+
+    // DATATYPE record
+    write_record_header(file, 6, DATATYPE, INT16);
+    write_int16(file, 0);  // Datatype 0
+
+    // XY record (coordinates)
+    // GDSII requires polygons to be closed (first point == last point)
+    int num_points = poly.vertices.size();
+    bool needs_closing = (num_points > 0 &&
+                          (poly.vertices[0].x() != poly.vertices[num_points-1].x() ||
+                           poly.vertices[0].y() != poly.vertices[num_points-1].y()));
+    int total_points = needs_closing ? num_points + 1 : num_points;
+
+    write_record_header(file, 4 + total_points * 8, XY, INT32);
+    for (const auto& vertex : poly.vertices) {
+      write_int32(file, vertex.x());
+      write_int32(file, vertex.y());
+    }
+    if (needs_closing) {
+      write_int32(file, poly.vertices[0].x());
+      write_int32(file, poly.vertices[0].y());
+    }
+
+    // ENDEL record
+    write_record_header(file, 4, ENDEL, NO_DATA);
+  }
+}
+
+// Write polygons to GDSII binary format through an output stream, one
+// field at a time. Kept as the reference implementation for
+// write_gdsii_buffered().
+inline void write_gdsii_stream(const std::vector<Polygon>& polygons,
+                               const std::string& filename) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open GDSII file for writing: " + filename);
+  }
+
+  gdsii::write_library_header(file);
+
+  // Write each polygon as a separate structure
+  for (const auto& poly : polygons) {
+    gdsii::write_structure_header(file, "POLY_" + std::to_string(poly.id));
+    gdsii::write_boundary(file, poly);
+
+    // ENDSTR record
+    gdsii::write_record_header(file, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+  }
+
+  // ENDLIB record
+  gdsii::write_record_header(file, 4, gdsii::ENDLIB, gdsii::NO_DATA);
+
+  file.close();
+}
+
+// Read polygons from GDSII binary format through an input stream, one
+// record at a time. Kept as the reference implementation for
+// read_gdsii_mapped().
+inline std::vector<Polygon> read_gdsii_stream(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open GDSII file for reading: " + filename);
+  }
+
+  std::vector<Polygon> polygons;
+  int current_polygon_id = 0;
+  Polygon current_poly;
+  bool in_boundary = false;
+  std::vector<Point> current_vertices;
+
+  while (file.peek() != EOF) {
+    // Read record header
+    uint8_t header[4];
+    file.read(reinterpret_cast<char*>(header), 4);
+    if (file.gcount() < 4) break;
+
+    uint16_t record_length = (static_cast<uint16_t>(header[0]) << 8) |
+                             static_cast<uint16_t>(header[1]);
+    uint8_t rtype = header[2];
+    // uint8_t dtype = header[3];  // Not used in current implementation
+
+    int payload_size = record_length - 4;
+
+    // Process record based on type
+    switch (rtype) {
+      case gdsii::BGNSTR: {
+        // Start of structure - skip timestamp data
+        file.seekg(payload_size, std::ios::cur);
+        current_poly = Polygon(current_polygon_id++);
+        current_vertices.clear();
+        break;
+      }
+
+      case gdsii::STRNAME: {
+        // Structure name - skip for now
+        file.seekg(payload_size, std::ios::cur);
+        break;
+      }
+
+      case gdsii::BOUNDARY: {
+        // Start of boundary element
+        in_boundary = true;
+        current_vertices.clear();
+        break;
+      }
+
+      case gdsii::LAYER:
+      case gdsii::DATATYPE: {
+        // Layer/datatype - skip
+        file.seekg(payload_size, std::ios::cur);
+        break;
+      }
+
+      case gdsii::XY: {
+        // Read coordinates
+        int num_points = payload_size / 8;
+        for (int i = 0; i < num_points; ++i) {
+          int32_t x = gdsii::read_int32(file);
+          int32_t y = gdsii::read_int32(file);
+          current_vertices.push_back(Point(x, y));
+        }
+        break;
+      }
+
+      case gdsii::ENDEL: {
+        // End of element
+        if (in_boundary && !current_vertices.empty()) {
+          // Remove the last point if it's a duplicate of the first (GDSII closing)
+          if (current_vertices.size() > 1) {
+            const Point& first = current_vertices[0];
+            const Point& last = current_vertices[current_vertices.size() - 1];
+            if (first.x() == last.x() && first.y() == last.y()) {
+              current_vertices.pop_back();
+            }
+          }
+
+          // Add vertices to polygon
+          for (const auto& vertex : current_vertices) {
+            current_poly.add_vertex(vertex);
+          }
+
+          // Build segments from vertices
+          current_poly.build_segments();
+
+          current_vertices.clear();
+          in_boundary = false;
+        }
+        break;
+      }
+
+      case gdsii::ENDSTR: {
+        // End of structure
+        if (!current_poly.vertices.empty()) {
+          polygons.push_back(current_poly);
+        }
+        break;
+      }
+
+      case gdsii::ENDLIB: {
+        // End of library
+        break;
+      }
+
+      default: {
+        // Skip unknown records
+        file.seekg(payload_size, std::ios::cur);
+        break;
+      }
+    }
+  }
+
+  file.close();
+  return polygons;
+}
+
+}  // namespace easymrc
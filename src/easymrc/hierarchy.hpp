@@ -0,0 +1,916 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <tuple>
+#include <limits>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include "easymrc.hpp"
+#include "tiling.hpp"
+
+namespace easymrc {
+
+// Placement transform of a cell: optional reflection about the x axis,
+// counter-clockwise rotation by a multiple of 90 degrees, then translation
+// (the GDSII order). Stored as p' = M p + d with M a signed permutation
+// matrix, so transforms compose and invert exactly in integers.
+struct CellTransform {
+  int xx, xy, yx, yy;
+  int dx, dy;
+
+  CellTransform() : xx(1), xy(0), yx(0), yy(1), dx(0), dy(0) {}
+
+  static CellTransform placement(const Point& origin, bool reflect,
+                                 int quarter_turns) {
+    CellTransform t;
+    if (reflect) t.yy = -1;
+    for (int k = 0; k < (quarter_turns & 3); ++k) {
+      // (x, y) -> (-y, x)
+      CellTransform r = t;
+      t.xx = -r.yx;
+      t.xy = -r.yy;
+      t.yx = r.xx;
+      t.yy = r.xy;
+    }
+    t.dx = origin.x();
+    t.dy = origin.y();
+    return t;
+  }
+
+  Point apply(const Point& p) const {
+    return Point(xx * p.x() + xy * p.y() + dx, yx * p.x() + yy * p.y() + dy);
+  }
+
+  Segment apply(const Segment& s) const {
+    return Segment(apply(s.start), apply(s.end));
+  }
+
+  // Opposite corners stay opposite under a signed permutation
+  BoundingBox apply(const BoundingBox& b) const {
+    Point p = apply(Point((int)b.min_x, (int)b.min_y));
+    Point q = apply(Point((int)b.max_x, (int)b.max_y));
+    return BoundingBox(std::min(p.x(), q.x()), std::min(p.y(), q.y()),
+                       std::max(p.x(), q.x()), std::max(p.y(), q.y()),
+                       b.polygon_id);
+  }
+
+  bool reflects() const { return xx * yy - xy * yx < 0; }
+
+  // other first, then this
+  CellTransform operator*(const CellTransform& other) const {
+    CellTransform t;
+    t.xx = xx * other.xx + xy * other.yx;
+    t.xy = xx * other.xy + xy * other.yy;
+    t.yx = yx * other.xx + yy * other.yx;
+    t.yy = yx * other.xy + yy * other.yy;
+    t.dx = xx * other.dx + xy * other.dy + dx;
+    t.dy = yx * other.dx + yy * other.dy + dy;
+    return t;
+  }
+
+  // M is orthogonal, so its inverse is its transpose
+  CellTransform inverse() const {
+    CellTransform t;
+    t.xx = xx;
+    t.xy = yx;
+    t.yx = xy;
+    t.yy = yy;
+    t.dx = -(t.xx * dx + t.xy * dy);
+    t.dy = -(t.yx * dx + t.yy * dy);
+    return t;
+  }
+
+  std::tuple<int, int, int, int, int, int> key() const {
+    return std::make_tuple(xx, xy, yx, yy, dx, dy);
+  }
+};
+
+// Polygon placed with t. A reflection reverses the vertex order (keeping
+// the first vertex) so that outlines keep their orientation.
+inline Polygon transform_polygon(const Polygon& poly, const CellTransform& t,
+                                 int id) {
+  Polygon placed(id);
+  placed.vertices.reserve(poly.vertices.size());
+  for (const auto& v : poly.vertices) placed.vertices.push_back(t.apply(v));
+  if (t.reflects() && placed.vertices.size() > 2) {
+    std::reverse(placed.vertices.begin() + 1, placed.vertices.end());
+  }
+  placed.build_segments();
+  return placed;
+}
+
+// Placement of a cell: a single instance (SREF) or a columns x rows array
+// (AREF) whose elements are offset by column_step and row_step
+struct CellReference {
+  int cell;
+  Point origin;
+  bool reflect;
+  int quarter_turns;
+  int columns, rows;
+  Point column_step, row_step;
+
+  CellReference()
+      : cell(-1), reflect(false), quarter_turns(0), columns(1), rows(1) {}
+
+  size_t elements() const { return static_cast<size_t>(columns) * rows; }
+
+  // Transform of element e = row * columns + column
+  CellTransform element(size_t e) const {
+    int column = static_cast<int>(e % columns);
+    int row = static_cast<int>(e / columns);
+    Point at(origin.x() + column * column_step.x() + row * row_step.x(),
+             origin.y() + column * column_step.y() + row * row_step.y());
+    return CellTransform::placement(at, reflect, quarter_turns);
+  }
+};
+
+// Cell definition: its own polygons (id = index) and its placements
+struct LayoutCell {
+  std::string name;
+  std::vector<Polygon> polygons;
+  std::vector<CellReference> references;
+};
+
+// Cell definitions and placements of a hierarchical layout.
+//
+// Flat numbering: the flat polygons of a cell are its own polygons, then
+// the flat polygons of each element of each reference in order. The
+// polygons of the root cell numbered this way are the flat layout, as
+// returned by flatten().
+class HierarchicalLayout {
+ public:
+  HierarchicalLayout() : root_(-1), virtual_root_(false) {}
+
+  int add_cell(const std::string& name) {
+    if (!names_.emplace(name, static_cast<int>(cells_.size())).second) {
+      throw std::runtime_error("Duplicate cell name: " + name);
+    }
+    cells_.emplace_back();
+    cells_.back().name = name;
+    return static_cast<int>(cells_.size()) - 1;
+  }
+
+  // Index of the named cell, -1 if there is none
+  int find_cell(const std::string& name) const {
+    auto it = names_.find(name);
+    return it == names_.end() ? -1 : it->second;
+  }
+
+  LayoutCell& cell(int c) { return cells_[c]; }
+  const LayoutCell& cell(int c) const { return cells_[c]; }
+  int num_cells() const { return static_cast<int>(cells_.size()); }
+
+  // Resolve the hierarchy once every cell is added: order the cells
+  // bottom-up, count their flat polygons and compute their extents. The
+  // root is the cell no other cell places; if there are several such top
+  // cells, a root cell placing each of them is added. Throws on recursive
+  // references.
+  void finalize() {
+    order_.clear();
+    std::vector<char> state(cells_.size(), 0);  // 1 = visiting, 2 = done
+    std::vector<char> placed(cells_.size(), 0);
+    for (int c = 0; c < num_cells(); ++c) {
+      for (const auto& ref : cells_[c].references) {
+        if (ref.cell < 0 || ref.cell >= num_cells()) {
+          throw std::runtime_error("Invalid cell reference in " +
+                                   cells_[c].name);
+        }
+        placed[ref.cell] = 1;
+      }
+    }
+
+    std::vector<int> tops;
+    for (int c = 0; c < num_cells(); ++c) {
+      visit(c, state);
+      if (!placed[c]) tops.push_back(c);
+    }
+    if (tops.size() == 1) {
+      root_ = tops[0];
+      virtual_root_ = false;
+    } else {
+      root_ = add_cell("");
+      virtual_root_ = true;
+      for (int top : tops) {
+        CellReference ref;
+        ref.cell = top;
+        cells_[root_].references.push_back(ref);
+      }
+      order_.push_back(root_);
+    }
+
+    flat_size_.assign(cells_.size(), 0);
+    reference_base_.assign(cells_.size(), std::vector<size_t>());
+    extent_.assign(cells_.size(), BoundingBox());
+    own_extent_.assign(cells_.size(), BoundingBox());
+    polygon_boxes_.assign(cells_.size(), std::vector<BoundingBox>());
+    for (int c : order_) summarize(c);
+  }
+
+  int root() const { return root_; }
+
+  // True if the root was added by finalize() rather than read
+  bool virtual_root() const { return virtual_root_; }
+
+  // Cells with every cell after the cells it places
+  const std::vector<int>& bottom_up() const { return order_; }
+
+  size_t flat_size(int c) const { return flat_size_[c]; }
+
+  // Extent of the flat polygons of c, and of its own polygons
+  const BoundingBox& extent(int c) const { return extent_[c]; }
+  const BoundingBox& own_extent(int c) const { return own_extent_[c]; }
+  const BoundingBox& polygon_box(int c, size_t i) const {
+    return polygon_boxes_[c][i];
+  }
+
+  // Flat number, within cell c, of the first polygon of element e of
+  // reference r
+  size_t element_base(int c, size_t r, size_t e) const {
+    return reference_base_[c][r] +
+           e * flat_size_[cells_[c].references[r].cell];
+  }
+
+  // Append the flat polygons of cell c placed with t whose bounding box
+  // overlaps region (all if region is null), numbered from base
+  void flatten_cell(int c, const CellTransform& t, size_t base,
+                    const BoundingBox* region,
+                    std::vector<Polygon>& out) const {
+    const LayoutCell& cell = cells_[c];
+    for (size_t i = 0; i < cell.polygons.size(); ++i) {
+      if (region && !region->overlaps(t.apply(polygon_boxes_[c][i]))) {
+        continue;
+      }
+      out.push_back(transform_polygon(cell.polygons[i], t,
+                                      static_cast<int>(base + i)));
+    }
+    for (size_t r = 0; r < cell.references.size(); ++r) {
+      const CellReference& ref = cell.references[r];
+      if (flat_size_[ref.cell] == 0) continue;
+      for (size_t e = 0; e < ref.elements(); ++e) {
+        CellTransform placed = t * ref.element(e);
+        if (region && !region->overlaps(placed.apply(extent_[ref.cell]))) {
+          continue;
+        }
+        flatten_cell(ref.cell, placed, base + element_base(c, r, e), region,
+                     out);
+      }
+    }
+  }
+
+  // The flat layout, polygon i having id i
+  std::vector<Polygon> flatten() const {
+    std::vector<Polygon> polygons;
+    if (root_ < 0) return polygons;
+    check_flat_ids(flat_size_[root_]);
+    polygons.reserve(flat_size_[root_]);
+    flatten_cell(root_, CellTransform(), 0, nullptr, polygons);
+    return polygons;
+  }
+
+  // Polygon ids are int
+  static void check_flat_ids(size_t count) {
+    if (count > static_cast<size_t>(std::numeric_limits<int>::max())) {
+      throw std::runtime_error("Flat layout too large for polygon ids");
+    }
+  }
+
+ private:
+  std::vector<LayoutCell> cells_;
+  std::unordered_map<std::string, int> names_;
+  std::vector<int> order_;
+  std::vector<size_t> flat_size_;
+  std::vector<std::vector<size_t>> reference_base_;
+  std::vector<BoundingBox> extent_;
+  std::vector<BoundingBox> own_extent_;
+  std::vector<std::vector<BoundingBox>> polygon_boxes_;
+  int root_;
+  bool virtual_root_;
+
+  void visit(int c, std::vector<char>& state) {
+    if (state[c] == 2) return;
+    if (state[c] == 1) {
+      throw std::runtime_error("Recursive cell reference: " + cells_[c].name);
+    }
+    state[c] = 1;
+    for (const auto& ref : cells_[c].references) visit(ref.cell, state);
+    state[c] = 2;
+    order_.push_back(c);
+  }
+
+  static void include(BoundingBox& extent, bool& empty,
+                      const BoundingBox& box) {
+    if (empty) {
+      extent = box;
+      empty = false;
+    } else {
+      extent.min_x = std::min(extent.min_x, box.min_x);
+      extent.min_y = std::min(extent.min_y, box.min_y);
+      extent.max_x = std::max(extent.max_x, box.max_x);
+      extent.max_y = std::max(extent.max_y, box.max_y);
+    }
+  }
+
+  // Flat size, reference bases and extents of c; its children are done
+  void summarize(int c) {
+    const LayoutCell& cell = cells_[c];
+    bool empty = true;
+    for (const auto& poly : cell.polygons) {
+      BoundingBox box = compute_bounding_box(poly);
+      polygon_boxes_[c].push_back(box);
+      include(own_extent_[c], empty, box);
+    }
+    extent_[c] = own_extent_[c];
+
+    size_t size = cell.polygons.size();
+    for (const auto& ref : cell.references) {
+      reference_base_[c].push_back(size);
+      size += ref.elements() * flat_size_[ref.cell];
+      if (flat_size_[ref.cell] == 0) continue;
+      // The corner elements bound an array
+      size_t last = ref.elements() - 1;
+      for (size_t e : {size_t(0), size_t(ref.columns - 1),
+                       last - (ref.columns - 1), last}) {
+        include(extent_[c], empty,
+                ref.element(e).apply(extent_[ref.cell]));
+      }
+    }
+    flat_size_[c] = size;
+  }
+};
+
+namespace hierarchy_detail {
+
+// Append the violations of from, placed with t and renumbered with map
+template <typename IdMap>
+void append_placed(const EasyMRC::Results& from, const CellTransform& t,
+                   IdMap&& map, EasyMRC::Results& to) {
+  for (const auto& v : from.space_violations_type_a) {
+    to.space_violations_type_a.emplace_back(
+        t.apply(v.point1), t.apply(v.point2), v.distance,
+        map(v.polygon_id_1), map(v.polygon_id_2));
+  }
+  for (const auto& v : from.space_violations_type_b) {
+    to.space_violations_type_b.emplace_back(
+        t.apply(v.point), t.apply(v.edge), v.distance, map(v.polygon_id_1),
+        map(v.polygon_id_2));
+  }
+  for (const auto& v : from.width_violations) {
+    to.width_violations.emplace_back(
+        t.apply(v.edge1), t.apply(v.edge2), v.distance,
+        t.apply(v.closest_point_on_edge1), t.apply(v.closest_point_on_edge2),
+        map(v.polygon_id));
+  }
+}
+
+}  // namespace hierarchy_detail
+
+// Results of a hierarchical check, stored once per unique cell and per
+// unique interaction. flatten() places them for every instance.
+class HierarchicalResults {
+ public:
+  // A part of a cell: its own polygons (reference -1) or one element of
+  // one of its references
+  struct Part {
+    int reference;
+    size_t element;
+  };
+
+  // Space violations between the polygons of two parts, in the frame of
+  // the first. Polygon ids below first_b are flat numbers within the first
+  // part; the others are first_b + flat numbers within the second.
+  struct Interaction {
+    EasyMRC::Results results;
+    size_t first_b;
+  };
+
+  // Parts a and b of a cell whose interaction found violations
+  struct Occurrence {
+    size_t interaction;
+    Part a, b;
+  };
+
+  // The layout is read by flatten() and must outlive the results
+  explicit HierarchicalResults(const HierarchicalLayout& layout)
+      : cell_results(layout.num_cells()),
+        occurrences(layout.num_cells()),
+        layout_(&layout) {}
+
+  std::vector<EasyMRC::Results> cell_results;      // Own polygons, per cell
+  std::vector<Interaction> interactions;
+  std::vector<std::vector<Occurrence>> occurrences;  // Per cell
+
+  // Violations of the flat layout, counted without flattening
+  size_t total_violations() const {
+    std::vector<size_t> count(layout_->num_cells(), 0);
+    for (int c : layout_->bottom_up()) {
+      count[c] = cell_results[c].total_violations();
+      for (const auto& occurrence : occurrences[c]) {
+        count[c] += interactions[occurrence.interaction]
+                        .results.total_violations();
+      }
+      for (const auto& ref : layout_->cell(c).references) {
+        count[c] += ref.elements() * count[ref.cell];
+      }
+    }
+    return layout_->root() < 0 ? 0 : count[layout_->root()];
+  }
+
+  // Violations of the flat layout with flat polygon ids, in canonical order
+  EasyMRC::Results flatten() const {
+    EasyMRC::Results results;
+    if (layout_->root() < 0) return results;
+    HierarchicalLayout::check_flat_ids(layout_->flat_size(layout_->root()));
+    place(layout_->root(), CellTransform(), 0, results);
+    sort_results(results);
+    return results;
+  }
+
+  // Transform and first flat number of a part within cell c
+  CellTransform part_transform(int c, const Part& part) const {
+    if (part.reference < 0) return CellTransform();
+    return layout_->cell(c).references[part.reference].element(part.element);
+  }
+
+  size_t part_base(int c, const Part& part) const {
+    if (part.reference < 0) return 0;
+    return layout_->element_base(c, part.reference, part.element);
+  }
+
+ private:
+  const HierarchicalLayout* layout_;
+
+  void place(int c, const CellTransform& t, size_t base,
+             EasyMRC::Results& results) const {
+    hierarchy_detail::append_placed(cell_results[c], t, [base](int id) {
+      return static_cast<int>(base + id);
+    }, results);
+
+    for (const auto& occurrence : occurrences[c]) {
+      const Interaction& interaction = interactions[occurrence.interaction];
+      size_t base_a = base + part_base(c, occurrence.a);
+      size_t base_b = base + part_base(c, occurrence.b);
+      size_t first_b = interaction.first_b;
+      hierarchy_detail::append_placed(
+          interaction.results, t * part_transform(c, occurrence.a),
+          [base_a, base_b, first_b](int id) {
+            size_t local = static_cast<size_t>(id);
+            return static_cast<int>(local < first_b
+                                        ? base_a + local
+                                        : base_b + (local - first_b));
+          },
+          results);
+    }
+
+    const LayoutCell& cell = layout_->cell(c);
+    for (size_t r = 0; r < cell.references.size(); ++r) {
+      const CellReference& ref = cell.references[r];
+      if (layout_->flat_size(ref.cell) == 0) continue;
+      for (size_t e = 0; e < ref.elements(); ++e) {
+        place(ref.cell, t * ref.element(e),
+              base + layout_->element_base(c, r, e), results);
+      }
+    }
+  }
+};
+
+// Hierarchical rule checking.
+//
+// Cells are checked once each, bottom-up, in their own coordinates. The
+// width and space rules of a cell's own polygons are checked as one flat
+// layout. Then every pair of the cell's parts (its own polygons, each
+// placed element) whose extents come within R is checked for the space
+// violations between the two, flattening only the polygons near the other
+// part. Such an interaction depends only on the two cells and their
+// relative placement, so it is checked once per distinct combination: all
+// neighbours in an array share a few. Every violation of the flat layout
+// is found at the one level where its two polygons first meet, and the
+// work follows the unique content rather than the number of placements.
+class HierarchicalChecker {
+ public:
+  struct Statistics {
+    size_t cells;                 // Cells with polygons
+    size_t cell_polygons;         // Own polygons checked, over all cells
+    size_t flat_polygons;         // Polygons of the flat layout
+    size_t interactions;          // Part pairs within R, over all cells
+    size_t unique_interactions;   // Of which checked
+    size_t interaction_polygons;  // Polygons flattened for those checks
+
+    Statistics()
+        : cells(0), cell_polygons(0), flat_polygons(0), interactions(0),
+          unique_interactions(0), interaction_polygons(0) {}
+  };
+
+  explicit HierarchicalChecker(const EasyMRC::Config& config =
+                                   EasyMRC::Config())
+      : config_(config) {}
+
+  // layout must be finalized and outlive the results
+  HierarchicalResults run(const HierarchicalLayout& layout) {
+    HierarchicalResults results(layout);
+    stats_ = Statistics();
+    if (layout.root() < 0) return results;
+    stats_.flat_polygons = layout.flat_size(layout.root());
+
+    // Interaction cache: first part (own polygons of a cell c as ~c, or a
+    // cell), second cell and relative transform
+    std::map<std::tuple<int, int, std::tuple<int, int, int, int, int, int>>,
+             size_t> cache;
+
+    for (int c : layout.bottom_up()) {
+      if (layout.flat_size(c) == 0) continue;
+      stats_.cells++;
+      const LayoutCell& cell = layout.cell(c);
+      if (!cell.polygons.empty()) {
+        results.cell_results[c] = EasyMRC(config_).run(cell.polygons);
+        stats_.cell_polygons += cell.polygons.size();
+      }
+      if (!config_.enable_space_check) continue;
+
+      // Parts of c and their R-expanded extents
+      std::vector<HierarchicalResults::Part> parts;
+      std::vector<ExactBox> boxes;
+      if (!cell.polygons.empty()) {
+        parts.push_back({-1, 0});
+        boxes.push_back(ExactBox(layout.own_extent(c)));
+      }
+      for (size_t r = 0; r < cell.references.size(); ++r) {
+        const CellReference& ref = cell.references[r];
+        if (layout.flat_size(ref.cell) == 0) continue;
+        for (size_t e = 0; e < ref.elements(); ++e) {
+          parts.push_back({static_cast<int>(r), e});
+          boxes.push_back(
+              ExactBox(ref.element(e).apply(layout.extent(ref.cell))));
+        }
+      }
+      for (size_t i = 0; i < boxes.size(); ++i) {
+        boxes[i].expand(config_.rule_distance_R);
+        boxes[i].polygon_id = static_cast<int>(i);
+      }
+      std::set<std::pair<int, int>> touching;
+      CandidatePairGenerator::sweep(boxes, 0, touching);
+
+      for (const auto& pair : touching) {
+        const auto& a = parts[pair.first];
+        const auto& b = parts[pair.second];
+        int first = a.reference < 0
+                        ? ~c
+                        : cell.references[a.reference].cell;
+        int second = cell.references[b.reference].cell;
+        CellTransform relative = results.part_transform(c, a).inverse() *
+                                 results.part_transform(c, b);
+        stats_.interactions++;
+
+        auto key = std::make_tuple(first, second, relative.key());
+        auto it = cache.find(key);
+        if (it == cache.end()) {
+          results.interactions.push_back(
+              check_interaction(layout, first, second, relative));
+          it = cache.emplace(key, results.interactions.size() - 1).first;
+          stats_.unique_interactions++;
+        }
+        if (results.interactions[it->second].results.total_violations() > 0) {
+          results.occurrences[c].push_back({it->second, a, b});
+        }
+      }
+    }
+    return results;
+  }
+
+  const Statistics& statistics() const { return stats_; }
+
+ private:
+  EasyMRC::Config config_;
+  Statistics stats_;
+
+  // Space violations between part `first` (a cell, or ~c for the own
+  // polygons of c) in its own frame and cell `second` placed with relative
+  HierarchicalResults::Interaction check_interaction(
+      const HierarchicalLayout& layout, int first, int second,
+      const CellTransform& relative) {
+    double R = config_.rule_distance_R;
+    bool own = first < 0;
+    int c = own ? ~first : first;
+    BoundingBox extent_a = own ? layout.own_extent(c) : layout.extent(c);
+
+    // Candidate pairs need expanded boxes to overlap: only polygons within
+    // 2R of the other part can take part
+    BoundingBox near_a = relative.apply(layout.extent(second));
+    near_a.expand(2 * R);
+    BoundingBox near_b = extent_a;
+    near_b.expand(2 * R);
+
+    HierarchicalResults::Interaction interaction;
+    std::vector<Polygon> polygons;
+    if (own) {
+      const LayoutCell& cell = layout.cell(c);
+      for (size_t i = 0; i < cell.polygons.size(); ++i) {
+        if (near_a.overlaps(layout.polygon_box(c, i))) {
+          polygons.push_back(cell.polygons[i]);
+        }
+      }
+      interaction.first_b = cell.polygons.size();
+    } else {
+      layout.flatten_cell(c, CellTransform(), 0, &near_a, polygons);
+      interaction.first_b = layout.flat_size(c);
+    }
+    HierarchicalLayout::check_flat_ids(interaction.first_b +
+                                       layout.flat_size(second));
+    size_t num_a = polygons.size();
+    layout.flatten_cell(second, relative, interaction.first_b, &near_b,
+                        polygons);
+    stats_.interaction_polygons += polygons.size();
+
+    // Only pairs across the two parts; the rest belong to the cells
+    auto pairs = candidate_pair_generation(polygons, R);
+    pairs.erase(std::remove_if(pairs.begin(), pairs.end(),
+                               [num_a](const std::pair<int, int>& pair) {
+                                 return !((size_t)pair.first < num_a &&
+                                          (size_t)pair.second >= num_a);
+                               }),
+                pairs.end());
+    if (pairs.empty()) return interaction;
+
+    EasyMRC::Config space_config = config_;
+    space_config.enable_width_check = false;
+    interaction.results = EasyMRC(space_config).run(polygons, pairs);
+    return interaction;
+  }
+};
+
+// Read the cells of a GDSII library with their placements. Each boundary
+// is a polygon of its structure; SREF and AREF elements are references.
+// Placements must be Manhattan: rotations by multiples of 90 degrees and
+// magnification 1, with no absolute angle or magnification. Paths, text
+// and boxes are skipped, as are the XY payloads of boundaries outside
+// layers. With a layer selection, the sidecar layer index
+// (GdsiiLayerIndex::open()) lists the records worth decoding, so only the
+// structure headers, references and selected boundaries are visited.
+inline HierarchicalLayout read_gdsii_hierarchy(
+    const std::string& filename, int num_threads = 0,
+    const LayerSelection& layers = LayerSelection()) {
+  using namespace gdsii_detail;
+  MappedFile file(filename, MappedFile::Access::SEQUENTIAL);
+  const unsigned char* data = file.data();
+
+  // Record ranges [first, second) to decode; those of structure s are
+  // ranges[first[s]] up to (excluding) ranges[first[s + 1]]
+  std::vector<std::pair<size_t, size_t>> ranges;
+  std::vector<size_t> first;
+  if (layers.empty()) {
+    auto index = index_structures(data, file.size(), filename);
+    for (size_t s = 0; s < index.begin.size(); ++s) {
+      first.push_back(ranges.size());
+      ranges.emplace_back(index.begin[s], index.end[s]);
+    }
+  } else {
+    GdsiiLayerIndex index = GdsiiLayerIndex::open(filename, num_threads);
+    if (file.size() != index.source_size()) {
+      throw std::runtime_error("GDSII layer index is out of date: " +
+                               filename);
+    }
+    for (const auto& e : index.structure_elements(layers)) {
+      if (first.size() <= e.structure) first.push_back(ranges.size());
+      ranges.emplace_back(e.offset, e.offset + e.length);
+    }
+  }
+  const size_t num_structures = first.size();
+  first.push_back(ranges.size());
+
+  struct Reference {
+    std::string cell;
+    CellReference placement;
+  };
+  struct Structure {
+    LayoutCell cell;
+    std::vector<Reference> references;
+    std::string error;
+    bool malformed = false;
+  };
+  std::vector<Structure> structures(num_structures);
+
+  // Structures decode independently; names are resolved afterwards
+  auto decode = [&](size_t s) {
+    Structure& out = structures[s];
+    enum { NONE, BOUNDARY, REFERENCE } element = NONE;
+    bool array = false;
+    int layer = 0, datatype = 0;
+    Reference ref;
+    std::vector<Point> points;
+    auto payload_string = [data](size_t pos) {
+      size_t length = load_be16(data + pos) - 4;
+      std::string str(reinterpret_cast<const char*>(data + pos + 4), length);
+      return str.substr(0, str.find('\0'));
+    };
+
+    for (size_t r = first[s]; r < first[s + 1]; ++r) {
+      const size_t end = ranges[r].second;
+      for (size_t pos = ranges[r].first; pos < end;
+           pos += load_be16(data + pos)) {
+        // Index ranges are checked here, the structures by index_structures()
+        if (pos + 4 > end || load_be16(data + pos) < 4 ||
+            pos + load_be16(data + pos) > end) {
+          out.malformed = true;
+          return;
+        }
+        size_t length = load_be16(data + pos) - 4;
+        const unsigned char* payload = data + pos + 4;
+        switch (data[pos + 2]) {
+          case gdsii::STRNAME:
+            out.cell.name = payload_string(pos);
+            break;
+          case gdsii::BOUNDARY:
+            element = BOUNDARY;
+            layer = datatype = 0;
+            points.clear();
+            break;
+          case gdsii::LAYER:
+            if (length >= 2) layer = load_be16(payload);
+            break;
+          case gdsii::DATATYPE:
+            if (length >= 2) datatype = load_be16(payload);
+            break;
+          case gdsii::SREF:
+          case gdsii::AREF:
+            element = REFERENCE;
+            array = data[pos + 2] == gdsii::AREF;
+            ref = Reference();
+            points.clear();
+            break;
+          case gdsii::SNAME:
+            ref.cell = payload_string(pos);
+            break;
+          // Transformations of texts (and anything but references) are
+          // ignored with their elements
+          case gdsii::STRANS:
+            if (element == REFERENCE && length >= 2) {
+              uint16_t flags = load_be16(payload);
+              ref.placement.reflect = (flags & 0x8000) != 0;
+              if (flags & 0x0006) {
+                out.error = "absolute magnification or angle";
+              }
+            }
+            break;
+          case gdsii::MAG:
+            if (element == REFERENCE && length >= 8 &&
+                load_real64(payload) != 1.0) {
+              out.error = "magnification other than 1";
+            }
+            break;
+          case gdsii::ANGLE:
+            if (element == REFERENCE && length >= 8) {
+              double angle = load_real64(payload);
+              long turns = std::lround(angle / 90.0);
+              if (std::abs(angle - turns * 90.0) > 1e-9) {
+                out.error = "angle not a multiple of 90 degrees";
+              }
+              ref.placement.quarter_turns =
+                  static_cast<int>(((turns % 4) + 4) % 4);
+            }
+            break;
+          case gdsii::COLROW:
+            if (element == REFERENCE && length >= 4) {
+              ref.placement.columns = static_cast<int16_t>(load_be16(payload));
+              ref.placement.rows = static_cast<int16_t>(load_be16(payload + 2));
+            }
+            break;
+          case gdsii::XY:
+            if (element == BOUNDARY && !layers.contains(layer, datatype)) {
+              element = NONE;  // Not decoded
+            }
+            if (element != NONE) {
+              points.resize(length / 8);
+              load_xy(payload, points.size(), points.data());
+            }
+            break;
+          case gdsii::ENDEL:
+            if (element == BOUNDARY && !points.empty()) {
+              if (points.size() > 1 &&
+                  points.front().x() == points.back().x() &&
+                  points.front().y() == points.back().y()) {
+                points.pop_back();  // GDSII closing point
+              }
+              Polygon poly(static_cast<int>(out.cell.polygons.size()));
+              poly.vertices = points;
+              poly.build_segments();
+              out.cell.polygons.push_back(std::move(poly));
+            } else if (element == REFERENCE) {
+              CellReference& p = ref.placement;
+              if (points.size() < (array ? 3u : 1u) ||
+                  (array && (p.columns < 1 || p.rows < 1))) {
+                out.error = "malformed reference to " + ref.cell;
+              } else {
+                p.origin = points[0];
+                if (array) {
+                  const Point& o = points[0];
+                  p.column_step = Point((points[1].x() - o.x()) / p.columns,
+                                        (points[1].y() - o.y()) / p.columns);
+                  p.row_step = Point((points[2].x() - o.x()) / p.rows,
+                                     (points[2].y() - o.y()) / p.rows);
+                } else {
+                  p.columns = p.rows = 1;
+                }
+                out.references.push_back(ref);
+              }
+            }
+            element = NONE;
+            break;
+          default:
+            break;
+        }
+      }
+    }
+  };
+
+  if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+  labeling_detail::parallel_for(num_threads, num_structures, decode);
+
+  HierarchicalLayout layout;
+  for (auto& structure : structures) {
+    if (structure.malformed) {
+      throw std::runtime_error("Malformed GDSII element (outdated layer "
+                               "index?): " + filename);
+    }
+    if (!structure.error.empty()) {
+      throw std::runtime_error("Unsupported GDSII placement in " +
+                               structure.cell.name + ": " + structure.error);
+    }
+    int c = layout.add_cell(structure.cell.name);
+    layout.cell(c).polygons = std::move(structure.cell.polygons);
+  }
+  for (size_t s = 0; s < num_structures; ++s) {
+    for (auto& ref : structures[s].references) {
+      ref.placement.cell = layout.find_cell(ref.cell);
+      if (ref.placement.cell < 0) {
+        throw std::runtime_error("Reference to undefined cell " + ref.cell +
+                                 " in " + structures[s].cell.name);
+      }
+      layout.cell(static_cast<int>(s)).references.push_back(ref.placement);
+    }
+  }
+  layout.finalize();
+  return layout;
+}
+
+// Write a layout's cells as GDSII structures with SREF and AREF placements
+// (a root added by finalize() is not written)
+inline void write_gdsii_hierarchy(const HierarchicalLayout& layout,
+                                  const std::string& filename) {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Cannot open GDSII file for writing: " + filename);
+  }
+
+  gdsii::write_library_header(file);
+  for (int c = 0; c < layout.num_cells(); ++c) {
+    if (layout.virtual_root() && c == layout.root()) continue;
+    const LayoutCell& cell = layout.cell(c);
+    gdsii::write_structure_header(file, cell.name);
+    for (const auto& poly : cell.polygons) gdsii::write_boundary(file, poly);
+
+    for (const auto& ref : cell.references) {
+      bool array = ref.elements() > 1;
+      const std::string& sname = layout.cell(ref.cell).name;
+      gdsii::write_record_header(file, 4, array ? gdsii::AREF : gdsii::SREF,
+                                 gdsii::NO_DATA);
+      gdsii::write_record_header(file, 4 + sname.length() + sname.length() % 2,
+                                 gdsii::SNAME, gdsii::ASCII);
+      gdsii::write_string(file, sname);
+      if (ref.reflect || ref.quarter_turns != 0) {
+        gdsii::write_record_header(file, 6, gdsii::STRANS, gdsii::BIT_ARRAY);
+        gdsii::write_int16(file, ref.reflect ? int16_t(0x8000) : 0);
+      }
+      if (ref.quarter_turns != 0) {
+        gdsii::write_record_header(file, 12, gdsii::ANGLE, gdsii::REAL64);
+        gdsii::write_real64(file, 90.0 * ref.quarter_turns);
+      }
+
+      std::vector<Point> points = {ref.origin};
+      if (array) {
+        gdsii::write_record_header(file, 8, gdsii::COLROW, gdsii::INT16);
+        gdsii::write_int16(file, ref.columns);
+        gdsii::write_int16(file, ref.rows);
+        points.emplace_back(ref.origin.x() + ref.columns * ref.column_step.x(),
+                            ref.origin.y() + ref.columns * ref.column_step.y());
+        points.emplace_back(ref.origin.x() + ref.rows * ref.row_step.x(),
+                            ref.origin.y() + ref.rows * ref.row_step.y());
+      }
+      gdsii::write_record_header(file, 4 + points.size() * 8, gdsii::XY,
+                                 gdsii::INT32);
+      for (const auto& p : points) {
+        gdsii::write_int32(file, p.x());
+        gdsii::write_int32(file, p.y());
+      }
+      gdsii::write_record_header(file, 4, gdsii::ENDEL, gdsii::NO_DATA);
+    }
+
+    gdsii::write_record_header(file, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+  }
+  gdsii::write_record_header(file, 4, gdsii::ENDLIB, gdsii::NO_DATA);
+}
+
+}  // namespace easymrc
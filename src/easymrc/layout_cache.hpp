@@ -0,0 +1,294 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "types.hpp"
+#include "layout_store.hpp"
+#include "mapped_file.hpp"
+#include "topology.hpp"
+#include "component_labeling.hpp"
+
+namespace easymrc {
+
+// Binary layout cache, read in place from a memory mapping.
+//
+// A layout decoded once (from an image, GDSII or OASIS file) is saved as
+// the arrays of its LayoutStore, so a later run maps the file and checks
+// the polygons without parsing or copying them: store() returns a
+// LayoutStore borrowing the arrays from the mapping. Only polygons(), for
+// the stages that take a std::vector<Polygon>, copies the vertices out.
+// The header records the size and modification time of the source file,
+// so a cache of an edited source is refused.
+//
+// File layout, native byte order, every section 8-byte aligned:
+//   Header
+//   int32  ids[polygons]
+//   uint64 offsets[polygons + 1]      First vertex of each polygon
+//   int32  bboxes[polygons][4]        min_x, min_y, max_x, max_y
+//   double perimeter[polygons]
+//   int32  x[vertices]
+//   int32  y[vertices]
+//   double edge_length[vertices]      Edge from the vertex to the next
+class LayoutCache {
+ public:
+  static constexpr uint32_t kVersion = 2;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;     // kByteOrder as stored by the writer
+    uint64_t source_size;    // Source file stamp (0, 0: none)
+    uint64_t source_mtime;
+    uint64_t content_hash;   // layout_hash() of the polygons
+    uint64_t polygons;
+    uint64_t vertices;
+    int32_t extent[4];       // Box of all vertices
+  };
+
+  LayoutCache() : header_(nullptr) {}
+
+  // Save the arrays of store to cache_filename, stamped with
+  // source_filename when given. The file is written beside the target and
+  // renamed over it, so a concurrent reader never maps a partial cache.
+  static void write(const LayoutStore& store,
+                    const std::string& cache_filename,
+                    const std::string& source_filename = "") {
+    Header header = make_header();
+    if (!source_filename.empty()) {
+      file_stamp(source_filename, header.source_size, header.source_mtime);
+    }
+    const LayoutStore::Arrays a = store.arrays();
+    header.polygons = a.polygons;
+    header.vertices = a.vertices;
+    header.content_hash = layout_hash(store);
+    for (size_t k = 0; k < a.vertices; ++k) {
+      if (k == 0) {
+        header.extent[0] = header.extent[2] = a.x[0];
+        header.extent[1] = header.extent[3] = a.y[0];
+      }
+      header.extent[0] = std::min(header.extent[0], a.x[k]);
+      header.extent[1] = std::min(header.extent[1], a.y[k]);
+      header.extent[2] = std::max(header.extent[2], a.x[k]);
+      header.extent[3] = std::max(header.extent[3], a.y[k]);
+    }
+
+    const std::string temp = cache_filename + ".tmp";
+    {
+      std::ofstream out(temp, std::ios::binary);
+      if (!out.is_open()) {
+        throw std::runtime_error("Cannot create layout cache: " +
+                                 cache_filename);
+      }
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      write_section(out, a.ids, a.polygons);
+      write_section(out, a.offsets, a.polygons + 1);
+      write_section(out, a.bboxes, a.polygons * 4);
+      write_section(out, a.perimeter, a.polygons);
+      write_section(out, a.x, a.vertices);
+      write_section(out, a.y, a.vertices);
+      write_section(out, a.edge_length, a.vertices);
+      if (!out) {
+        out.close();
+        std::remove(temp.c_str());
+        throw std::runtime_error("Failed to write layout cache: " +
+                                 cache_filename);
+      }
+    }
+    if (std::rename(temp.c_str(), cache_filename.c_str()) != 0) {
+      std::remove(temp.c_str());
+      throw std::runtime_error("Failed to write layout cache: " +
+                               cache_filename);
+    }
+  }
+
+  static void write(const std::vector<Polygon>& polygons,
+                    const std::string& cache_filename,
+                    const std::string& source_filename = "") {
+    write(LayoutStore(polygons), cache_filename, source_filename);
+  }
+
+  // Map cache_filename. Returns false, leaving the cache closed, if it is
+  // missing, of another version or byte order, malformed, or (when
+  // source_filename is given) stamped with another size or modification
+  // time than that file.
+  bool open(const std::string& cache_filename,
+            const std::string& source_filename = "") {
+    close();
+    MappedFile file;
+    try {
+      file = MappedFile(cache_filename);
+    } catch (const std::runtime_error&) {
+      return false;
+    }
+    if (file.size() < sizeof(Header)) return false;
+
+    const Header* header = reinterpret_cast<const Header*>(file.data());
+    Header expected = make_header();
+    if (std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) ||
+        header->version != kVersion ||
+        header->byte_order != expected.byte_order) {
+      return false;
+    }
+    if (!source_filename.empty()) {
+      uint64_t size = 0, mtime = 0;
+      file_stamp(source_filename, size, mtime);
+      if (header->source_size != size || header->source_mtime != mtime) {
+        return false;
+      }
+    }
+
+    // Section sizes must add up to the file size exactly
+    const uint64_t n = header->polygons, v = header->vertices;
+    const uint64_t limit = file.size();
+    if (n > limit / 4 || v > limit / 4) return false;
+    size_t ids = sizeof(Header);
+    size_t offsets = ids + padded(n * sizeof(int32_t));
+    size_t bboxes = offsets + (n + 1) * sizeof(uint64_t);
+    size_t perimeter = bboxes + n * 4 * sizeof(int32_t);
+    size_t x = perimeter + n * sizeof(double);
+    size_t y = x + padded(v * sizeof(int32_t));
+    size_t edge_length = y + padded(v * sizeof(int32_t));
+    if (edge_length + v * sizeof(double) != limit) return false;
+
+    const unsigned char* data = file.data();
+    const uint64_t* offset = reinterpret_cast<const uint64_t*>(data + offsets);
+    if (offset[0] != 0 || offset[n] != v) return false;
+    for (uint64_t i = 0; i < n; ++i) {
+      if (offset[i + 1] < offset[i]) return false;
+    }
+
+    file_ = std::move(file);
+    header_ = header;
+    arrays_ = LayoutStore::Arrays();
+    arrays_.polygons = n;
+    arrays_.vertices = v;
+    arrays_.ids = reinterpret_cast<const int32_t*>(data + ids);
+    arrays_.offsets = offset;
+    arrays_.bboxes = reinterpret_cast<const int32_t*>(data + bboxes);
+    arrays_.perimeter = reinterpret_cast<const double*>(data + perimeter);
+    arrays_.x = reinterpret_cast<const int32_t*>(data + x);
+    arrays_.y = reinterpret_cast<const int32_t*>(data + y);
+    arrays_.edge_length =
+        reinterpret_cast<const double*>(data + edge_length);
+    return true;
+  }
+
+  void close() {
+    file_ = MappedFile();
+    header_ = nullptr;
+  }
+
+  bool is_open() const { return header_ != nullptr; }
+  const Header& header() const { return *header_; }
+
+  size_t size() const { return header_->polygons; }
+  size_t num_vertices() const { return header_->vertices; }
+  uint64_t content_hash() const { return header_->content_hash; }
+
+  BoundingBox extent() const {
+    const int32_t* e = header_->extent;
+    return BoundingBox(e[0], e[1], e[2], e[3]);
+  }
+
+  // Polygon i, in place
+  int id(size_t i) const { return arrays_.ids[i]; }
+  size_t num_vertices(size_t i) const {
+    return arrays_.offsets[i + 1] - arrays_.offsets[i];
+  }
+
+  BoundingBox bbox(size_t i) const {
+    const int32_t* box = arrays_.bboxes + i * 4;
+    return BoundingBox(box[0], box[1], box[2], box[3], arrays_.ids[i]);
+  }
+
+  // The polygons as a LayoutStore borrowing the mapped arrays, without a
+  // copy. The store is valid while the cache stays open.
+  LayoutStore store() const { return LayoutStore::borrow(arrays_); }
+
+  // Copy the polygons out with their segments, on num_threads threads
+  // (0 = one per usable CPU)
+  std::vector<Polygon> polygons(int num_threads = 0) const {
+    if (num_threads <= 0) num_threads = cpu_topology().effective_cpus();
+    const size_t n = size();
+    std::vector<Polygon> polygons(n);
+    const size_t chunk = 1024;
+    labeling_detail::parallel_for(num_threads, (n + chunk - 1) / chunk,
+                                  [&](size_t k) {
+      size_t end = std::min(n, (k + 1) * chunk);
+      for (size_t i = k * chunk; i < end; ++i) {
+        polygons[i].id = arrays_.ids[i];
+        polygons[i].vertices.reserve(num_vertices(i));
+        for (uint64_t k = arrays_.offsets[i]; k < arrays_.offsets[i + 1];
+             ++k) {
+          polygons[i].vertices.emplace_back(arrays_.x[k], arrays_.y[k]);
+        }
+        polygons[i].build_segments();
+      }
+    });
+    return polygons;
+  }
+
+  // 64-bit hash of the polygon ids and vertices, in order
+  static uint64_t layout_hash(const PolygonSource& polygons) {
+    uint64_t hash = 0x6a09e667f3bcc909ULL ^ polygons.size();
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      const PolygonView poly = polygons[i];
+      hash = mix(hash, (static_cast<uint64_t>(poly.id()) << 32) ^
+                           poly.size());
+      for (size_t k = 0; k < poly.size(); ++k) {
+        const Point p = poly.vertex(k);
+        hash = mix(hash, (static_cast<uint64_t>(
+                              static_cast<uint32_t>(p.x())) << 32) |
+                             static_cast<uint32_t>(p.y()));
+      }
+    }
+    return hash;
+  }
+
+ private:
+  static_assert(sizeof(Header) % 8 == 0, "Header must keep 8-byte alignment");
+
+  static constexpr char kMagic[8] = {'E', 'M', 'R', 'C', 'L', 'C', 'A',
+                                     'C'};
+  static constexpr uint32_t kByteOrder = 0x01020304;
+
+  MappedFile file_;
+  const Header* header_;
+  LayoutStore::Arrays arrays_;
+
+  static Header make_header() {
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrder;
+    return header;
+  }
+
+  static size_t padded(size_t bytes) { return (bytes + 7) & ~size_t(7); }
+
+  template <typename T>
+  static void write_section(std::ofstream& out, const T* values,
+                            size_t count) {
+    size_t bytes = count * sizeof(T);
+    out.write(reinterpret_cast<const char*>(values), bytes);
+    static const char zeros[8] = {};
+    out.write(zeros, padded(bytes) - bytes);
+  }
+
+  // splitmix64 finalizer over the running hash and the next word
+  static uint64_t mix(uint64_t hash, uint64_t word) {
+    uint64_t z = hash ^ (word + 0x9e3779b97f4a7c15ULL + (hash << 6));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+};
+
+}  // namespace easymrc
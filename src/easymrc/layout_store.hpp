@@ -0,0 +1,277 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "types.hpp"
+
+namespace easymrc {
+
+// Flat structure-of-arrays store of a layout's polygons.
+//
+// A std::vector<Polygon> keeps two heap vectors per polygon, its vertices
+// and its segments, which repeat every vertex twice more. The store keeps
+// the vertices of all polygons in one pair of x[] and y[] arrays, delimited
+// by per-polygon offsets, together with what the checks would otherwise
+// recompute from the segments: the length of every edge, the perimeter
+// (their sum, in edge order) and the bounding box. Edges are derived from
+// consecutive vertices when a stage asks for them, so the store needs two
+// allocations per array rather than two per polygon and is scanned
+// sequentially.
+//
+// Polygons are accessed through PolygonView. Cached values are computed
+// with the same operations, in the same order, as the Polygon path, so a
+// check gives identical results on either.
+//
+// A store can also borrow its arrays from elsewhere, such as a mapped
+// LayoutCache, instead of holding them; it then only reads them.
+class LayoutStore {
+ public:
+  // The arrays of a store, laid out as described above
+  struct Arrays {
+    size_t polygons = 0;
+    size_t vertices = 0;
+    const int32_t* x = nullptr;
+    const int32_t* y = nullptr;
+    const double* edge_length = nullptr;
+    const uint64_t* offsets = nullptr;  // polygons + 1 entries
+    const int32_t* ids = nullptr;
+    const int32_t* bboxes = nullptr;
+    const double* perimeter = nullptr;
+  };
+
+  LayoutStore() : offsets_(1, 0) {}
+
+  // A store reading arrays it does not own; they must outlive it
+  static LayoutStore borrow(const Arrays& arrays) {
+    LayoutStore store;
+    store.borrowed_ = true;
+    store.arrays_ = arrays;
+    return store;
+  }
+
+  explicit LayoutStore(const std::vector<Polygon>& polygons)
+      : offsets_(1, 0) {
+    reserve(polygons);
+    for (const auto& poly : polygons) add(poly);
+  }
+
+  // Build from polygons, releasing the memory of each as it is copied
+  explicit LayoutStore(std::vector<Polygon>&& polygons) : offsets_(1, 0) {
+    reserve(polygons);
+    for (auto& poly : polygons) {
+      add(poly);
+      Polygon().vertices.swap(poly.vertices);
+      Polygon().segments.swap(poly.segments);
+    }
+    std::vector<Polygon>().swap(polygons);
+  }
+
+  void reserve(size_t num_polygons, size_t num_vertices) {
+    x_.reserve(num_vertices);
+    y_.reserve(num_vertices);
+    edge_length_.reserve(num_vertices);
+    offsets_.reserve(num_polygons + 1);
+    ids_.reserve(num_polygons);
+    bboxes_.reserve(num_polygons * 4);
+    perimeter_.reserve(num_polygons);
+  }
+
+  // Append a polygon with vertices [begin, end)
+  void add(int id, const Point* begin, const Point* end) {
+    if (borrowed_) {
+      throw std::logic_error("Cannot add to a LayoutStore borrowing its "
+                             "arrays");
+    }
+    const size_t count = end - begin;
+    const size_t first = x_.size();
+    for (const Point* p = begin; p < end; ++p) {
+      x_.push_back(p->x());
+      y_.push_back(p->y());
+    }
+    offsets_.push_back(x_.size());
+    ids_.push_back(id);
+
+    // Edge lengths, perimeter and box as PolygonView computes them
+    PolygonView view(id, x_.data() + first, y_.data() + first, count,
+                     nullptr, -1.0, nullptr);
+    for (size_t i = 0; i < view.num_edges(); ++i) {
+      edge_length_.push_back(view.edge_length(i));
+    }
+    edge_length_.resize(x_.size(), 0.0);
+    perimeter_.push_back(view.perimeter());
+    BoundingBox box = view.bbox();
+    bboxes_.push_back(static_cast<int32_t>(box.min_x));
+    bboxes_.push_back(static_cast<int32_t>(box.min_y));
+    bboxes_.push_back(static_cast<int32_t>(box.max_x));
+    bboxes_.push_back(static_cast<int32_t>(box.max_y));
+  }
+
+  void add(const Polygon& poly) {
+    add(poly.id, poly.vertices.data(),
+        poly.vertices.data() + poly.vertices.size());
+  }
+
+  size_t size() const {
+    return borrowed_ ? arrays_.polygons : ids_.size();
+  }
+  bool empty() const { return size() == 0; }
+  size_t num_vertices() const {
+    return borrowed_ ? arrays_.vertices : x_.size();
+  }
+  size_t num_vertices(size_t i) const {
+    const uint64_t* offsets = offsets_data();
+    return offsets[i + 1] - offsets[i];
+  }
+
+  int id(size_t i) const { return ids_data()[i]; }
+  BoundingBox bbox(size_t i) const { return view(i).bbox(); }
+  double perimeter(size_t i) const { return perimeter_data()[i]; }
+  double average_edge_length(size_t i) const {
+    return view(i).average_edge_length();
+  }
+
+  // Polygon i, in place
+  PolygonView view(size_t i) const {
+    const size_t first = offsets_data()[i];
+    return PolygonView(ids_data()[i], x_data() + first, y_data() + first,
+                       num_vertices(i), edge_length_data() + first,
+                       perimeter_data()[i], bboxes_data() + i * 4);
+  }
+
+  PolygonView operator[](size_t i) const { return view(i); }
+
+  // Polygon i copied out, with its segments
+  Polygon polygon(size_t i) const {
+    Polygon poly(id(i));
+    poly.vertices.reserve(num_vertices(i));
+    const int32_t* x = x_data();
+    const int32_t* y = y_data();
+    for (size_t k = offsets_data()[i]; k < offsets_data()[i + 1]; ++k) {
+      poly.vertices.emplace_back(x[k], y[k]);
+    }
+    poly.build_segments();
+    return poly;
+  }
+
+  std::vector<Polygon> polygons() const {
+    std::vector<Polygon> result;
+    result.reserve(size());
+    for (size_t i = 0; i < size(); ++i) result.push_back(polygon(i));
+    return result;
+  }
+
+  // The arrays read, held or borrowed
+  Arrays arrays() const {
+    Arrays arrays;
+    arrays.polygons = size();
+    arrays.vertices = num_vertices();
+    arrays.x = x_data();
+    arrays.y = y_data();
+    arrays.edge_length = edge_length_data();
+    arrays.offsets = offsets_data();
+    arrays.ids = ids_data();
+    arrays.bboxes = bboxes_data();
+    arrays.perimeter = perimeter_data();
+    return arrays;
+  }
+
+  bool borrowed() const { return borrowed_; }
+
+  // Bytes held by the arrays (none when they are borrowed)
+  size_t bytes() const {
+    if (borrowed_) return 0;
+    return (x_.capacity() + y_.capacity()) * sizeof(int32_t) +
+           edge_length_.capacity() * sizeof(double) +
+           offsets_.capacity() * sizeof(uint64_t) +
+           (ids_.capacity() + bboxes_.capacity()) * sizeof(int32_t) +
+           perimeter_.capacity() * sizeof(double);
+  }
+
+  // Bytes a std::vector<Polygon> holds for the same polygons: the
+  // vectors themselves, their vertices and segments
+  static size_t bytes(const std::vector<Polygon>& polygons) {
+    size_t total = polygons.capacity() * sizeof(Polygon);
+    for (const auto& poly : polygons) {
+      total += poly.vertices.capacity() * sizeof(Point) +
+               poly.segments.capacity() * sizeof(Segment);
+    }
+    return total;
+  }
+
+ private:
+  static_assert(sizeof(int) == sizeof(int32_t), "int must be 32 bits");
+
+  // Per vertex
+  std::vector<int32_t> x_, y_;
+  std::vector<double> edge_length_;  // Edge from the vertex to the next
+  // Per polygon
+  std::vector<uint64_t> offsets_;    // First vertex, plus one past the last
+  std::vector<int32_t> ids_;
+  std::vector<int32_t> bboxes_;      // min_x, min_y, max_x, max_y
+  std::vector<double> perimeter_;
+
+  // Arrays read instead of the vectors when borrowed
+  bool borrowed_ = false;
+  Arrays arrays_;
+
+  const int32_t* x_data() const {
+    return borrowed_ ? arrays_.x : x_.data();
+  }
+  const int32_t* y_data() const {
+    return borrowed_ ? arrays_.y : y_.data();
+  }
+  const double* edge_length_data() const {
+    return borrowed_ ? arrays_.edge_length : edge_length_.data();
+  }
+  const uint64_t* offsets_data() const {
+    return borrowed_ ? arrays_.offsets : offsets_.data();
+  }
+  const int32_t* ids_data() const {
+    return borrowed_ ? arrays_.ids : ids_.data();
+  }
+  const int32_t* bboxes_data() const {
+    return borrowed_ ? arrays_.bboxes : bboxes_.data();
+  }
+  const double* perimeter_data() const {
+    return borrowed_ ? arrays_.perimeter : perimeter_.data();
+  }
+
+  void reserve(const std::vector<Polygon>& polygons) {
+    size_t vertices = 0;
+    for (const auto& poly : polygons) vertices += poly.vertices.size();
+    reserve(polygons.size(), vertices);
+  }
+};
+
+// The polygons a check runs on: a std::vector<Polygon>, viewed in place,
+// or a LayoutStore. Converts implicitly from either, so stages taking a
+// PolygonSource accept both; it only points at them, and they must outlive
+// it.
+class PolygonSource {
+ public:
+  PolygonSource(const std::vector<Polygon>& polygons)
+      : polygons_(&polygons), store_(nullptr) {}
+  PolygonSource(const LayoutStore& store)
+      : polygons_(nullptr), store_(&store) {}
+
+  size_t size() const {
+    return polygons_ ? polygons_->size() : store_->size();
+  }
+  bool empty() const { return size() == 0; }
+
+  PolygonView operator[](size_t i) const {
+    return polygons_ ? PolygonView((*polygons_)[i]) : store_->view(i);
+  }
+
+  // The vector viewed, or null for a store
+  const std::vector<Polygon>* polygons() const { return polygons_; }
+  const LayoutStore* store() const { return store_; }
+
+ private:
+  const std::vector<Polygon>* polygons_;
+  const LayoutStore* store_;
+};
+
+}  // namespace easymrc
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace easymrc {
+
+// Read-only memory mapping of a whole file (RAII, move-only)
+class MappedFile {
+ public:
+  enum class Access {
+    NORMAL,
+    SEQUENTIAL  // Hint the kernel to read ahead aggressively
+  };
+
+  MappedFile() : data_(nullptr), size_(0) {}
+
+  explicit MappedFile(const std::string& filename,
+                      Access access = Access::NORMAL)
+      : data_(nullptr), size_(0) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("Cannot open file: " + filename + " (" +
+                               std::strerror(errno) + ")");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Cannot stat file: " + filename);
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+      void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Cannot map file: " + filename + " (" +
+                                 std::strerror(errno) + ")");
+      }
+      data_ = static_cast<const unsigned char*>(addr);
+      if (access == Access::SEQUENTIAL) {
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+      }
+    }
+    ::close(fd);  // The mapping keeps the file referenced
+  }
+
+  ~MappedFile() { unmap(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      unmap();
+      data_ = other.data_;
+      size_ = other.size_;
+      other.data_ = nullptr;
+      other.size_ = 0;
+    }
+    return *this;
+  }
+
+  const unsigned char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  const unsigned char* data_;
+  size_t size_;
+
+  void unmap() {
+    if (data_) {
+      ::munmap(const_cast<unsigned char*>(data_), size_);
+      data_ = nullptr;
+      size_ = 0;
+    }
+  }
+};
+
+// Size and modification time (ns) of a file, identifying its contents for
+// caches kept beside it
+inline void file_stamp(const std::string& filename, uint64_t& size,
+                       uint64_t& mtime) {
+  struct stat st;
+  if (::stat(filename.c_str(), &st) != 0) {
+    throw std::runtime_error("Cannot stat file: " + filename);
+  }
+  size = static_cast<uint64_t>(st.st_size);
+  mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL +
+          static_cast<uint64_t>(st.st_mtim.tv_nsec);
+}
+
+}  // namespace easymrc
@@ -0,0 +1,928 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "types.hpp"
+#include "mapped_file.hpp"
+
+namespace easymrc {
+
+namespace oasis {
+  // Record types (SEMI P39)
+  enum RecordType : uint8_t {
+    PAD                 = 0,
+    START               = 1,
+    END                 = 2,
+    CELLNAME            = 3,
+    CELLNAME_REF        = 4,
+    TEXTSTRING          = 5,
+    TEXTSTRING_REF      = 6,
+    PROPNAME            = 7,
+    PROPNAME_REF        = 8,
+    PROPSTRING          = 9,
+    PROPSTRING_REF      = 10,
+    LAYERNAME           = 11,
+    LAYERNAME_TEXT      = 12,
+    CELL_REF            = 13,
+    CELL                = 14,
+    XYABSOLUTE          = 15,
+    XYRELATIVE          = 16,
+    PLACEMENT           = 17,
+    PLACEMENT_TRANSFORM = 18,
+    TEXT                = 19,
+    RECTANGLE           = 20,
+    POLYGON             = 21,
+    PATH                = 22,
+    TRAPEZOID           = 23,
+    TRAPEZOID_A         = 24,
+    TRAPEZOID_B         = 25,
+    CTRAPEZOID          = 26,
+    CIRCLE              = 27,
+    PROPERTY            = 28,
+    PROPERTY_REPEAT     = 29,
+    XNAME               = 30,
+    XNAME_REF           = 31,
+    XELEMENT            = 32,
+    XGEOMETRY           = 33,
+    CBLOCK              = 34
+  };
+
+  // Every file starts with this string, before the START record
+  constexpr char MAGIC[] = "%SEMI-OASIS\r\n";
+  constexpr size_t MAGIC_LENGTH = 13;
+}
+
+namespace oasis_detail {
+
+struct Delta {
+  int64_t x, y;
+};
+
+// Reads OASIS primitives from a mapped file; malformed data (including
+// reads past the end) throws with the offset. Coordinates and
+// displacements are limited to +-2^32 so that sums and repetition
+// products cannot overflow before the final range check.
+class Cursor {
+ public:
+  Cursor(const unsigned char* data, size_t size, const std::string& filename)
+      : data_(data), size_(size), pos_(0), filename_(filename) {}
+
+  size_t remaining() const { return size_ - pos_; }
+
+  [[noreturn]] void fail(const std::string& what) const {
+    throw std::runtime_error("Malformed OASIS file " + filename_ + ": " +
+                             what + " at offset " + std::to_string(pos_));
+  }
+
+  uint8_t byte() {
+    if (pos_ >= size_) fail("unexpected end of file");
+    return data_[pos_++];
+  }
+
+  const unsigned char* bytes(uint64_t count) {
+    if (count > remaining()) fail("unexpected end of file");
+    pos_ += count;
+    return data_ + pos_ - count;
+  }
+
+  // 7 bits per byte, least significant group first
+  uint64_t uint() {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      uint8_t b = byte();
+      if (shift > 63 || (shift == 63 && (b & 0x7e))) fail("integer overflow");
+      value |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return value;
+    }
+  }
+
+  // Sign in the lowest bit of the unsigned encoding
+  int64_t sint() {
+    uint64_t u = uint();
+    int64_t magnitude = static_cast<int64_t>(u >> 1);
+    return (u & 1) ? -magnitude : magnitude;
+  }
+
+  int64_t coordinate(int64_t value) const {
+    const int64_t limit = int64_t(1) << 32;
+    if (value > limit || value < -limit) fail("coordinate out of range");
+    return value;
+  }
+
+  int64_t ucoordinate() {
+    uint64_t u = uint();
+    if (u > (uint64_t(1) << 32)) fail("coordinate out of range");
+    return static_cast<int64_t>(u);
+  }
+
+  int64_t scoordinate() { return coordinate(sint()); }
+
+  // Displacement times a repetition grid step
+  int64_t scaled(int64_t value, int64_t grid) const {
+    const int64_t limit = int64_t(1) << 32;
+    if (grid != 0 && (value > limit / grid || value < -limit / grid)) {
+      fail("coordinate out of range");
+    }
+    return value * grid;
+  }
+
+  // Real of the given type: integers, reciprocals, ratios or IEEE floats
+  // (little-endian)
+  double real(uint64_t type) {
+    switch (type) {
+      case 0: return static_cast<double>(uint());
+      case 1: return -static_cast<double>(uint());
+      case 2: return 1.0 / static_cast<double>(uint());
+      case 3: return -1.0 / static_cast<double>(uint());
+      case 4:
+      case 5: {
+        double numerator = static_cast<double>(uint());
+        double ratio = numerator / static_cast<double>(uint());
+        return type == 4 ? ratio : -ratio;
+      }
+      case 6: {
+        const unsigned char* b = bytes(4);
+        uint32_t bits = 0;
+        for (int i = 3; i >= 0; --i) bits = (bits << 8) | b[i];
+        float value;
+        std::memcpy(&value, &bits, 4);
+        return value;
+      }
+      case 7: {
+        const unsigned char* b = bytes(8);
+        uint64_t bits = 0;
+        for (int i = 7; i >= 0; --i) bits = (bits << 8) | b[i];
+        double value;
+        std::memcpy(&value, &bits, 8);
+        return value;
+      }
+      default:
+        fail("invalid real type");
+    }
+  }
+
+  double real() { return real(uint()); }
+
+  std::string string() {
+    uint64_t length = uint();
+    return std::string(reinterpret_cast<const char*>(bytes(length)),
+                       length);
+  }
+
+  void skip_string() { bytes(uint()); }
+
+  // One of the eight octangular directions (east, north, west, south,
+  // then the diagonals NE, NW, SW, SE) times a magnitude
+  Delta octangular(unsigned direction, uint64_t magnitude) {
+    static const int dx[8] = {1, 0, -1, 0, 1, -1, -1, 1};
+    static const int dy[8] = {0, 1, 0, -1, 1, 1, -1, -1};
+    if (magnitude > (uint64_t(1) << 32)) fail("coordinate out of range");
+    int64_t m = static_cast<int64_t>(magnitude);
+    return {dx[direction] * m, dy[direction] * m};
+  }
+
+  // g-delta: octangular in one integer, or free (x, y) in two
+  Delta g_delta() {
+    uint64_t u = uint();
+    if (!(u & 1)) return octangular((u >> 1) & 7, u >> 4);
+    int64_t x = coordinate(static_cast<int64_t>(u >> 2));
+    uint64_t v = uint();
+    int64_t y = coordinate(static_cast<int64_t>(v >> 1));
+    return {(u & 2) ? -x : x, (v & 1) ? -y : y};
+  }
+
+ private:
+  const unsigned char* data_;
+  size_t size_;
+  size_t pos_;
+  const std::string& filename_;
+};
+
+// Offsets of the elements of a repetition, the first being (0, 0). Type 0
+// reuses the previous repetition, left in offsets.
+inline void read_repetition(Cursor& in, std::vector<Delta>& offsets) {
+  uint64_t type = in.uint();
+  if (type == 0) {
+    if (offsets.empty()) in.fail("repetition reused before definition");
+    return;
+  }
+  offsets.clear();
+
+  // nx x ny elements (ids are int, so at most 2^31). Products stay below
+  // 2^63 as the larger of nx and ny is at most 2^30 when both exceed 1.
+  auto lattice = [&](uint64_t nx, uint64_t ny, Delta a, Delta b) {
+    const uint64_t limit = uint64_t(1) << 31;
+    if (nx > limit || ny > limit || nx * ny > limit) {
+      in.fail("repetition too large");
+    }
+    offsets.reserve(nx * ny);
+    for (uint64_t j = 0; j < ny; ++j) {
+      for (uint64_t i = 0; i < nx; ++i) {
+        int64_t si = static_cast<int64_t>(i), sj = static_cast<int64_t>(j);
+        offsets.push_back({in.coordinate(a.x * si + b.x * sj),
+                           in.coordinate(a.y * si + b.y * sj)});
+      }
+    }
+  };
+
+  switch (type) {
+    case 1: {
+      uint64_t nx = in.uint() + 2, ny = in.uint() + 2;
+      int64_t sx = in.ucoordinate(), sy = in.ucoordinate();
+      lattice(nx, ny, {sx, 0}, {0, sy});
+      break;
+    }
+    case 2: {
+      uint64_t nx = in.uint() + 2;
+      lattice(nx, 1, {in.ucoordinate(), 0}, {0, 0});
+      break;
+    }
+    case 3: {
+      uint64_t ny = in.uint() + 2;
+      lattice(1, ny, {0, 0}, {0, in.ucoordinate()});
+      break;
+    }
+    case 4:
+    case 5:
+    case 6:
+    case 7: {
+      // Irregular spacings along x (4, 5) or y (6, 7), on a grid (5, 7)
+      uint64_t n = in.uint() + 2;
+      int64_t grid = (type == 5 || type == 7) ? in.ucoordinate() : 1;
+      Delta position{0, 0};
+      offsets.push_back(position);
+      for (uint64_t k = 1; k < n; ++k) {
+        int64_t space = in.scaled(in.ucoordinate(), grid);
+        if (type <= 5) {
+          position.x = in.coordinate(position.x + space);
+        } else {
+          position.y = in.coordinate(position.y + space);
+        }
+        offsets.push_back(position);
+      }
+      break;
+    }
+    case 8: {
+      uint64_t n = in.uint() + 2, m = in.uint() + 2;
+      Delta a = in.g_delta();
+      Delta b = in.g_delta();
+      lattice(n, m, a, b);
+      break;
+    }
+    case 9: {
+      uint64_t n = in.uint() + 2;
+      lattice(n, 1, in.g_delta(), {0, 0});
+      break;
+    }
+    case 10:
+    case 11: {
+      // Arbitrary displacements, on a grid (11)
+      uint64_t n = in.uint() + 2;
+      int64_t grid = type == 11 ? in.ucoordinate() : 1;
+      Delta position{0, 0};
+      offsets.push_back(position);
+      for (uint64_t k = 1; k < n; ++k) {
+        Delta d = in.g_delta();
+        position.x = in.coordinate(position.x + in.scaled(d.x, grid));
+        position.y = in.coordinate(position.y + in.scaled(d.y, grid));
+        offsets.push_back(position);
+      }
+      break;
+    }
+    default:
+      in.fail("invalid repetition type");
+  }
+}
+
+// Vertices of a point list relative to its first, (0, 0). In polygons the
+// Manhattan types 0 and 1 leave the last vertex implicit.
+inline void read_point_list(Cursor& in, std::vector<Delta>& points,
+                            bool polygon) {
+  uint64_t type = in.uint();
+  uint64_t count = in.uint();
+  if (count > in.remaining()) in.fail("point list too long");
+  points.clear();
+  points.reserve(count + 2);
+  Delta p{0, 0};
+  points.push_back(p);
+  auto step = [&](Delta d) {
+    p.x = in.coordinate(p.x + d.x);
+    p.y = in.coordinate(p.y + d.y);
+    points.push_back(p);
+  };
+
+  switch (type) {
+    case 0:
+    case 1: {
+      // Alternating horizontal and vertical deltas
+      bool horizontal = type == 0;
+      for (uint64_t k = 0; k < count; ++k) {
+        int64_t d = in.scoordinate();
+        step(horizontal ? Delta{d, 0} : Delta{0, d});
+        horizontal = !horizontal;
+      }
+      if (polygon) {
+        points.push_back(horizontal ? Delta{0, p.y} : Delta{p.x, 0});
+      }
+      break;
+    }
+    case 2:
+      for (uint64_t k = 0; k < count; ++k) {
+        uint64_t u = in.uint();
+        step(in.octangular(u & 3, u >> 2));
+      }
+      break;
+    case 3:
+      for (uint64_t k = 0; k < count; ++k) {
+        uint64_t u = in.uint();
+        step(in.octangular(u & 7, u >> 3));
+      }
+      break;
+    case 4:
+      for (uint64_t k = 0; k < count; ++k) step(in.g_delta());
+      break;
+    case 5: {
+      // Each g-delta changes the previous displacement
+      Delta d{0, 0};
+      for (uint64_t k = 0; k < count; ++k) {
+        Delta change = in.g_delta();
+        d.x = in.coordinate(d.x + change.x);
+        d.y = in.coordinate(d.y + change.y);
+        step(d);
+      }
+      break;
+    }
+    default:
+      in.fail("invalid point list type");
+  }
+}
+
+// Optional layer and datatype fields (L and D bits of the info byte)
+inline void skip_layer(Cursor& in, uint8_t info) {
+  if (info & 0x01) in.uint();
+  if (info & 0x02) in.uint();
+}
+
+// Layer or datatype interval of a LAYERNAME record
+inline void skip_interval(Cursor& in) {
+  switch (in.uint()) {
+    case 0:
+      break;
+    case 1:
+    case 2:
+    case 3:
+      in.uint();
+      break;
+    case 4:
+      in.uint();
+      in.uint();
+      break;
+    default:
+      in.fail("invalid interval type");
+  }
+}
+
+inline void skip_property_value(Cursor& in) {
+  uint64_t type = in.uint();
+  if (type <= 7) {
+    in.real(type);
+  } else if (type == 8 || type >= 13) {
+    if (type > 15) in.fail("invalid property value type");
+    in.uint();  // Unsigned integer or string reference
+  } else if (type == 9) {
+    in.sint();
+  } else {
+    in.skip_string();
+  }
+}
+
+// Placement of a cell: reflection about the x axis, counter-clockwise
+// rotation by a multiple of 90 degrees, then translation, as p' = M p + d
+// with M a signed permutation matrix
+struct Transform {
+  int64_t xx = 1, xy = 0, yx = 0, yy = 1;
+  int64_t dx = 0, dy = 0;
+
+  static Transform placement(int64_t x, int64_t y, bool flip,
+                             int quarter_turns) {
+    Transform t;
+    if (flip) t.yy = -1;
+    for (int k = 0; k < (quarter_turns & 3); ++k) {
+      // (x, y) -> (-y, x)
+      Transform r = t;
+      t.xx = -r.yx;
+      t.xy = -r.yy;
+      t.yx = r.xx;
+      t.yy = r.xy;
+    }
+    t.dx = x;
+    t.dy = y;
+    return t;
+  }
+
+  // other first, then this
+  Transform operator*(const Transform& other) const {
+    Transform t;
+    t.xx = xx * other.xx + xy * other.yx;
+    t.xy = xx * other.xy + xy * other.yy;
+    t.yx = yx * other.xx + yy * other.yx;
+    t.yy = yx * other.xy + yy * other.yy;
+    t.dx = xx * other.dx + xy * other.dy + dx;
+    t.dy = yx * other.dx + yy * other.dy + dy;
+    return t;
+  }
+
+  bool reflects() const { return xx * yy - xy * yx < 0; }
+};
+
+}  // namespace oasis_detail
+
+// Read polygons from an OASIS file through a memory mapping. RECTANGLE and
+// POLYGON elements are decoded with their point lists and repetitions
+// straight into polygon vertices of their cell, one polygon per element
+// instance. PLACEMENT and PLACEMENT_TRANSFORM records are expanded as
+// read_gdsii_hierarchy() places references: the result is each cell that
+// no other places, in file order, with its own polygons (in file order)
+// followed by its placed instances. A file without placements therefore
+// gives its polygons numbered in file order. Placements must be Manhattan:
+// rotations by multiples of 90 degrees and magnification 1. Paths,
+// trapezoids, circles, text and properties are parsed but not represented,
+// as read_gdsii() only keeps boundaries. Compressed (CBLOCK) records are
+// not supported.
+inline std::vector<Polygon> read_oasis(const std::string& filename) {
+  using oasis_detail::Delta;
+  MappedFile file(filename, MappedFile::Access::SEQUENTIAL);
+  if (file.size() < oasis::MAGIC_LENGTH ||
+      std::memcmp(file.data(), oasis::MAGIC, oasis::MAGIC_LENGTH) != 0) {
+    throw std::runtime_error("Not an OASIS file: " + filename);
+  }
+  oasis_detail::Cursor in(file.data(), file.size(), filename);
+  in.bytes(oasis::MAGIC_LENGTH);
+
+  if (in.uint() != oasis::START) in.fail("missing START record");
+  if (in.string() != "1.0") in.fail("unsupported version");
+  in.real();  // Database units per micron; coordinates are kept as is
+  if (in.uint() == 0) {
+    for (int i = 0; i < 12; ++i) in.uint();  // Table offsets
+  }
+
+  // Cells, named by a string or by the reference number of a CELLNAME
+  // record, with their polygons and placements
+  struct CellName {
+    bool numbered = false;
+    uint64_t number = 0;
+    std::string name;
+  };
+  struct Placement {
+    CellName cell;
+    oasis_detail::Transform transform;
+    std::vector<Delta> offsets;
+  };
+  struct Cell {
+    CellName name;
+    std::vector<Polygon> polygons;
+    std::vector<Placement> placements;
+  };
+  std::vector<Cell> cells;
+  std::map<uint64_t, std::string> cell_names;
+  uint64_t next_cell_name = 0;
+  auto current_cell = [&]() -> Cell& {
+    if (cells.empty()) in.fail("element outside a cell");
+    return cells.back();
+  };
+
+  // Modal variables, reset by each CELL record
+  int64_t geometry_x = 0, geometry_y = 0;
+  int64_t geometry_w = 0, geometry_h = 0;
+  int64_t placement_x = 0, placement_y = 0;
+  CellName placement_cell;
+  bool placement_cell_set = false;
+  bool relative = false;
+  std::vector<Delta> polygon_points, path_points, repetition, rectangle(4);
+  auto reset = [&]() {
+    geometry_x = geometry_y = 0;
+    placement_x = placement_y = 0;
+    placement_cell_set = false;
+    relative = false;
+    polygon_points.clear();
+    path_points.clear();
+    repetition.clear();
+  };
+
+  // Geometry position from the X and Y fields, absolute or relative
+  auto read_position = [&](uint8_t info, uint8_t x_bit, uint8_t y_bit) {
+    if (info & x_bit) {
+      int64_t x = in.scoordinate();
+      geometry_x = in.coordinate(relative ? geometry_x + x : x);
+    }
+    if (info & y_bit) {
+      int64_t y = in.scoordinate();
+      geometry_y = in.coordinate(relative ? geometry_y + y : y);
+    }
+  };
+  auto skip_position = [&](uint8_t info, uint8_t x_bit, uint8_t y_bit) {
+    if (info & x_bit) in.sint();
+    if (info & y_bit) in.sint();
+  };
+  auto read_repetition = [&](uint8_t info, uint8_t r_bit) {
+    if (!(info & r_bit)) return false;
+    oasis_detail::read_repetition(in, repetition);
+    return true;
+  };
+
+  const std::vector<Delta> single(1, Delta{0, 0});
+  auto emit = [&](const std::vector<Delta>& shape, bool repeated) {
+    std::vector<Polygon>& polygons = current_cell().polygons;
+    size_t count = shape.size();
+    if (count > 1 && shape.back().x == 0 && shape.back().y == 0) count--;
+    for (const Delta& offset : repeated ? repetition : single) {
+      if (polygons.size() >= static_cast<size_t>(INT32_MAX)) {
+        in.fail("too many polygons");
+      }
+      Polygon poly(static_cast<int>(polygons.size()));
+      poly.vertices.reserve(count);
+      for (size_t k = 0; k < count; ++k) {
+        int64_t x = geometry_x + offset.x + shape[k].x;
+        int64_t y = geometry_y + offset.y + shape[k].y;
+        if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN ||
+            y > INT32_MAX) {
+          in.fail("coordinate out of range");
+        }
+        poly.vertices.emplace_back(static_cast<int>(x), static_cast<int>(y));
+      }
+      poly.build_segments();
+      polygons.push_back(std::move(poly));
+    }
+  };
+
+  for (bool ended = false; !ended;) {
+    uint64_t type = in.uint();
+    switch (type) {
+      case oasis::PAD:
+      case oasis::PROPERTY_REPEAT:
+        break;
+
+      case oasis::END:
+        ended = true;
+        break;
+
+      case oasis::CELLNAME:
+        cell_names[next_cell_name++] = in.string();
+        break;
+
+      case oasis::CELLNAME_REF: {
+        std::string name = in.string();
+        cell_names[in.uint()] = name;
+        break;
+      }
+
+      case oasis::TEXTSTRING:
+      case oasis::PROPNAME:
+      case oasis::PROPSTRING:
+        in.skip_string();
+        break;
+
+      case oasis::TEXTSTRING_REF:
+      case oasis::PROPNAME_REF:
+      case oasis::PROPSTRING_REF:
+        in.skip_string();
+        in.uint();
+        break;
+
+      case oasis::LAYERNAME:
+      case oasis::LAYERNAME_TEXT:
+        in.skip_string();
+        oasis_detail::skip_interval(in);
+        oasis_detail::skip_interval(in);
+        break;
+
+      case oasis::CELL_REF:
+      case oasis::CELL:
+        cells.emplace_back();
+        cells.back().name.numbered = type == oasis::CELL_REF;
+        if (type == oasis::CELL_REF) {
+          cells.back().name.number = in.uint();
+        } else {
+          cells.back().name.name = in.string();
+        }
+        reset();
+        break;
+
+      case oasis::XYABSOLUTE:
+        relative = false;
+        break;
+
+      case oasis::XYRELATIVE:
+        relative = true;
+        break;
+
+      case oasis::PLACEMENT:
+      case oasis::PLACEMENT_TRANSFORM: {
+        // CNXYRAAF, or CNXYRMAF with magnification and angle
+        uint8_t info = in.byte();
+        if (info & 0x80) {
+          placement_cell = CellName();
+          placement_cell.numbered = (info & 0x40) != 0;
+          if (placement_cell.numbered) {
+            placement_cell.number = in.uint();
+          } else {
+            placement_cell.name = in.string();
+          }
+          placement_cell_set = true;
+        } else if (!placement_cell_set) {
+          in.fail("placement cell reused before definition");
+        }
+        int quarter_turns = (info >> 1) & 3;
+        if (type == oasis::PLACEMENT_TRANSFORM) {
+          quarter_turns = 0;
+          if ((info & 0x04) && in.real() != 1.0) {
+            in.fail("magnification other than 1");
+          }
+          if (info & 0x02) {
+            double angle = in.real();
+            long turns = std::lround(angle / 90.0);
+            if (std::abs(angle - turns * 90.0) > 1e-9) {
+              in.fail("angle not a multiple of 90 degrees");
+            }
+            quarter_turns = static_cast<int>(((turns % 4) + 4) % 4);
+          }
+        }
+        if (info & 0x20) {
+          int64_t x = in.scoordinate();
+          placement_x = in.coordinate(relative ? placement_x + x : x);
+        }
+        if (info & 0x10) {
+          int64_t y = in.scoordinate();
+          placement_y = in.coordinate(relative ? placement_y + y : y);
+        }
+        bool repeated = read_repetition(info, 0x08);
+        Placement placement;
+        placement.cell = placement_cell;
+        placement.transform = oasis_detail::Transform::placement(
+            placement_x, placement_y, (info & 0x01) != 0, quarter_turns);
+        placement.offsets = repeated ? repetition : single;
+        current_cell().placements.push_back(std::move(placement));
+        break;
+      }
+
+      case oasis::TEXT: {
+        // 0CNXYRTL
+        uint8_t info = in.byte();
+        if (info & 0x40) {
+          if (info & 0x20) {
+            in.uint();
+          } else {
+            in.skip_string();
+          }
+        }
+        oasis_detail::skip_layer(in, info);
+        skip_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::RECTANGLE: {
+        // SWHXYRDL: a square (S) has the height of its width
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x40) geometry_w = in.ucoordinate();
+        if (info & 0x80) {
+          if (info & 0x20) in.fail("square with a height");
+          geometry_h = geometry_w;
+        } else if (info & 0x20) {
+          geometry_h = in.ucoordinate();
+        }
+        read_position(info, 0x10, 0x08);
+        bool repeated = read_repetition(info, 0x04);
+        rectangle[1] = {geometry_w, 0};
+        rectangle[2] = {geometry_w, geometry_h};
+        rectangle[3] = {0, geometry_h};
+        emit(rectangle, repeated);
+        break;
+      }
+
+      case oasis::POLYGON: {
+        // 00PXYRDL
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x20) {
+          oasis_detail::read_point_list(in, polygon_points, true);
+        } else if (polygon_points.empty()) {
+          in.fail("point list reused before definition");
+        }
+        read_position(info, 0x10, 0x08);
+        bool repeated = read_repetition(info, 0x04);
+        emit(polygon_points, repeated);
+        break;
+      }
+
+      case oasis::PATH: {
+        // EWPXYRDL; extension scheme 0000SSEE with explicit lengths (3)
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x40) in.uint();
+        if (info & 0x80) {
+          uint64_t scheme = in.uint();
+          if (((scheme >> 2) & 3) == 3) in.sint();
+          if ((scheme & 3) == 3) in.sint();
+        }
+        if (info & 0x20) {
+          oasis_detail::read_point_list(in, path_points, false);
+        }
+        read_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::TRAPEZOID:
+      case oasis::TRAPEZOID_A:
+      case oasis::TRAPEZOID_B: {
+        // OWHXYRDL, then delta-a and/or delta-b
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x40) geometry_w = in.ucoordinate();
+        if (info & 0x20) geometry_h = in.ucoordinate();
+        in.sint();
+        if (type == oasis::TRAPEZOID) in.sint();
+        read_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::CTRAPEZOID: {
+        // TWHXYRDL
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x80) in.uint();
+        if (info & 0x40) geometry_w = in.ucoordinate();
+        if (info & 0x20) geometry_h = in.ucoordinate();
+        read_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::CIRCLE: {
+        // 00rXYRDL
+        uint8_t info = in.byte();
+        oasis_detail::skip_layer(in, info);
+        if (info & 0x20) in.uint();
+        read_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::PROPERTY: {
+        // UUUUVCNS: U values unless V reuses the last ones (U = 15: count
+        // follows)
+        uint8_t info = in.byte();
+        if (info & 0x04) {
+          if (info & 0x02) {
+            in.uint();
+          } else {
+            in.skip_string();
+          }
+        }
+        if (!(info & 0x08)) {
+          uint64_t count = info >> 4;
+          if (count == 15) count = in.uint();
+          for (uint64_t k = 0; k < count; ++k) {
+            oasis_detail::skip_property_value(in);
+          }
+        }
+        break;
+      }
+
+      case oasis::XNAME:
+      case oasis::XELEMENT:
+        in.uint();
+        in.skip_string();
+        break;
+
+      case oasis::XNAME_REF:
+        in.uint();
+        in.skip_string();
+        in.uint();
+        break;
+
+      case oasis::XGEOMETRY: {
+        // 000XYRDL
+        uint8_t info = in.byte();
+        in.uint();
+        oasis_detail::skip_layer(in, info);
+        in.skip_string();
+        read_position(info, 0x10, 0x08);
+        read_repetition(info, 0x04);
+        break;
+      }
+
+      case oasis::CBLOCK:
+        in.fail("compressed CBLOCK records are not supported");
+
+      case oasis::START:
+        in.fail("repeated START record");
+
+      default:
+        in.fail("unknown record type " + std::to_string(type));
+    }
+  }
+
+  // Cells by name; references by number are resolved through CELLNAME
+  auto resolve = [&](const CellName& cell) -> const std::string& {
+    if (!cell.numbered) return cell.name;
+    auto it = cell_names.find(cell.number);
+    if (it == cell_names.end()) {
+      in.fail("undefined cell reference number " +
+              std::to_string(cell.number));
+    }
+    return it->second;
+  };
+  std::map<std::string, size_t> cell_index;
+  for (size_t c = 0; c < cells.size(); ++c) {
+    if (!cell_index.emplace(resolve(cells[c].name), c).second) {
+      in.fail("cell " + resolve(cells[c].name) + " defined twice");
+    }
+  }
+  std::vector<std::vector<size_t>> placed(cells.size());
+  std::vector<bool> is_top(cells.size(), true);
+  for (size_t c = 0; c < cells.size(); ++c) {
+    for (const auto& placement : cells[c].placements) {
+      auto it = cell_index.find(resolve(placement.cell));
+      if (it == cell_index.end()) {
+        in.fail("placement of undefined cell " + resolve(placement.cell));
+      }
+      placed[c].push_back(it->second);
+      is_top[it->second] = false;
+    }
+  }
+
+  // Recursive placements never end
+  std::vector<int> state(cells.size(), 0);  // 1: being visited, 2: done
+  auto visit = [&](auto& self, size_t c) -> void {
+    if (state[c] == 2) return;
+    if (state[c] == 1) in.fail("recursive placement of cell " +
+                               resolve(cells[c].name));
+    state[c] = 1;
+    for (size_t child : placed[c]) self(self, child);
+    state[c] = 2;
+  };
+  for (size_t c = 0; c < cells.size(); ++c) visit(visit, c);
+
+  // Top cells are placed once, as they are; their polygons are moved
+  std::vector<Polygon> polygons;
+  auto next_id = [&]() {
+    if (polygons.size() >= static_cast<size_t>(INT32_MAX)) {
+      in.fail("too many polygons");
+    }
+    return static_cast<int>(polygons.size());
+  };
+  auto expand = [&](auto& self, size_t c, const oasis_detail::Transform& t,
+                    bool top) -> void {
+    for (Polygon& poly : cells[c].polygons) {
+      if (top) {
+        poly.id = next_id();
+        polygons.push_back(std::move(poly));
+        continue;
+      }
+      Polygon instance(next_id());
+      instance.vertices.reserve(poly.vertices.size());
+      for (const Point& v : poly.vertices) {
+        int64_t x = t.xx * v.x() + t.xy * v.y() + t.dx;
+        int64_t y = t.yx * v.x() + t.yy * v.y() + t.dy;
+        if (x < INT32_MIN || x > INT32_MAX || y < INT32_MIN ||
+            y > INT32_MAX) {
+          in.fail("coordinate out of range");
+        }
+        instance.vertices.emplace_back(static_cast<int>(x),
+                                       static_cast<int>(y));
+      }
+      // Outlines keep their orientation, as in transform_polygon()
+      if (t.reflects() && instance.vertices.size() > 2) {
+        std::reverse(instance.vertices.begin() + 1, instance.vertices.end());
+      }
+      instance.build_segments();
+      polygons.push_back(std::move(instance));
+    }
+    for (size_t k = 0; k < placed[c].size(); ++k) {
+      const Placement& placement = cells[c].placements[k];
+      for (const Delta& offset : placement.offsets) {
+        oasis_detail::Transform element = placement.transform;
+        element.dx = in.coordinate(element.dx + offset.x);
+        element.dy = in.coordinate(element.dy + offset.y);
+        self(self, placed[c][k], t * element, false);
+      }
+    }
+  };
+  for (size_t c = 0; c < cells.size(); ++c) {
+    if (is_top[c]) expand(expand, c, oasis_detail::Transform(), true);
+  }
+  return polygons;
+}
+
+}  // namespace easymrc
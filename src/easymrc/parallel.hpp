@@ -2,84 +2,182 @@
 
 #include <vector>
 #include <thread>
+#include <memory>
 #include <algorithm>
 #include "types.hpp"
+#include "layout_store.hpp"
 #include "type_a_violations.hpp"
 #include "type_b_violations.hpp"
 #include "width_check.hpp"
 #include "sampling.hpp"
+#include "scheduling.hpp"
+#include "arena.hpp"
+#include "topology.hpp"
+#include "progress.hpp"
 
 namespace easymrc {
 
+// Resolve a requested thread count (0 = auto-detect from the CPUs this
+// process may use: affinity mask and cgroup quota)
+inline int resolve_num_threads(int num_threads) {
+  if (num_threads > 0) return num_threads;
+  return cpu_topology().effective_cpus();
+}
+
+// Settings shared by the parallel checkers
+struct ParallelOptions {
+  int num_threads;          // 0 = auto-detect
+  size_t arena_block_size;  // Initial per-worker arena size (0 = no arena)
+  AffinityPolicy affinity;  // Worker thread pinning
+  ProgressTracker* progress;         // Receives finished work, may be null
+  CancellationToken cancellation;    // Checked before every chunk
+  const SamplingTable* sampling;     // Precomputed per polygon, may be null
+
+  ParallelOptions()
+      : num_threads(0), arena_block_size(256 * 1024),
+        affinity(AffinityPolicy::NONE), progress(nullptr),
+        sampling(nullptr) {}
+};
+
+// The precomputed sampling table of options, if it covers every polygon
+inline const SamplingTable* usable_sampling(const ParallelOptions& options,
+                                            size_t num_polygons) {
+  if (!options.sampling || options.sampling->size != num_polygons) {
+    return nullptr;
+  }
+  return options.sampling;
+}
+
+inline ParallelOptions options_with_threads(int num_threads) {
+  ParallelOptions options;
+  options.num_threads = num_threads;
+  return options;
+}
+
+// Location of one task's results inside its worker's buffer
+struct TaskSlot {
+  size_t worker;
+  size_t offset;
+  size_t count;
+
+  TaskSlot() : worker(0), offset(0), count(0) {}
+};
+
+// Concatenate per-worker result buffers in task order rather than worker
+// order, so the output does not depend on which worker ran which task.
+// slots[i] records where task i left its results (tasks that never ran
+// have count 0). Two passes: the slot counts are prefix-summed in task
+// order and the output grown once, then it is filled in parallel, split
+// evenly by element count. The buffers are released afterwards.
+template <typename T>
+void ordered_concat(std::vector<std::vector<T>>& parts,
+                    const std::vector<TaskSlot>& slots,
+                    std::vector<T>& out,
+                    int num_threads) {
+  std::vector<size_t> offsets(slots.size() + 1, 0);
+  for (size_t i = 0; i < slots.size(); ++i) {
+    offsets[i + 1] = offsets[i] + slots[i].count;
+  }
+  size_t total = offsets.back();
+  size_t base = out.size();
+  out.resize(base + total);
+
+  // Fill the global range [begin, end) of the ordered output
+  auto fill = [&parts, &slots, &offsets, &out, base](size_t begin,
+                                                     size_t end) {
+    size_t i = std::upper_bound(offsets.begin(), offsets.end(), begin) -
+               offsets.begin() - 1;
+    while (begin < end) {
+      size_t task_end = std::min(end, offsets[i + 1]);
+      const TaskSlot& slot = slots[i];
+      auto src = parts[slot.worker].begin() + slot.offset +
+                 (begin - offsets[i]);
+      std::move(src, src + (task_end - begin), out.begin() + base + begin);
+      begin = task_end;
+      i++;
+    }
+  };
+
+  const size_t min_per_thread = 1 << 16;
+  int workers = std::max<int>(1, std::min<size_t>(num_threads,
+                                                  total / min_per_thread));
+
+  if (workers == 1) {
+    fill(0, total);
+  } else {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < workers; ++t) {
+      threads.emplace_back(fill, total * t / workers,
+                           total * (t + 1) / workers);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  parts.clear();
+}
+
+// Memory resource for one worker's transient data: a monotonic arena that
+// is reset after every task, or the global allocator when disabled.
+class WorkerMemory {
+ public:
+  explicit WorkerMemory(size_t arena_block_size) {
+    if (arena_block_size > 0) {
+      arena_.reset(new WorkerArena(arena_block_size));
+    }
+  }
+
+  std::pmr::memory_resource* resource() {
+    if (arena_) return arena_.get();
+    return std::pmr::get_default_resource();
+  }
+
+  // Release everything allocated for the finished task
+  void reset() {
+    if (arena_) arena_->reset();
+  }
+
+ private:
+  std::unique_ptr<WorkerArena> arena_;
+};
+
 // Parallel space checking for multiple polygon pairs
 class ParallelSpaceChecker {
  public:
-  ParallelSpaceChecker(const std::vector<Polygon>& polygons,
+  ParallelSpaceChecker(const PolygonSource& polygons,
+                       const std::vector<std::pair<int, int>>& pairs,
+                       double R,
+                       double multiplier,
+                       const ParallelOptions& options)
+      : polygons_(polygons), pairs_(pairs),
+        rule_distance_(R), radius_multiplier_(multiplier),
+        num_threads_(resolve_num_threads(options.num_threads)),
+        arena_block_size_(options.arena_block_size),
+        affinity_(options.affinity),
+        progress_(options.progress),
+        cancellation_(options.cancellation),
+        sampling_(usable_sampling(options, polygons.size())) {}
+
+  ParallelSpaceChecker(const PolygonSource& polygons,
                        const std::vector<std::pair<int, int>>& pairs,
                        double R,
                        double multiplier = 4.0,
                        int num_threads = 0)
-      : polygons_(polygons), pairs_(pairs),
-        rule_distance_(R), radius_multiplier_(multiplier) {
-
-    if (num_threads <= 0) {
-      num_threads_ = std::thread::hardware_concurrency();
-      if (num_threads_ == 0) num_threads_ = 4;  // Default fallback
-    } else {
-      num_threads_ = num_threads;
-    }
-  }
+      : ParallelSpaceChecker(polygons, pairs, R, multiplier,
+                             options_with_threads(num_threads)) {}
 
   void check_parallel(std::vector<Violation>& violations_a,
                      std::vector<ViolationTypeB>& violations_b) {
-
-    int total_pairs = pairs_.size();
-    int pairs_per_thread = (total_pairs + num_threads_ - 1) / num_threads_;
+    prepare(num_threads_);
+    int workers = std::min<int>(num_threads_, schedule_->num_chunks());
+    load_stats_.reset(workers);
 
     std::vector<std::thread> threads;
-    std::vector<std::vector<Violation>> thread_results_a(num_threads_);
-    std::vector<std::vector<ViolationTypeB>> thread_results_b(num_threads_);
-
-    for (int t = 0; t < num_threads_; ++t) {
-      int start_idx = t * pairs_per_thread;
-      int end_idx = std::min((t + 1) * pairs_per_thread, total_pairs);
-
-      if (start_idx >= end_idx) break;  // No work for this thread
-
-      threads.emplace_back([this, start_idx, end_idx, t,
-                           &thread_results_a, &thread_results_b]() {
-        for (int i = start_idx; i < end_idx; ++i) {
-          int poly1_id = pairs_[i].first;
-          int poly2_id = pairs_[i].second;
-
-          const auto& poly1 = polygons_[poly1_id];
-          const auto& poly2 = polygons_[poly2_id];
-
-          // Calculate sampling radius
-          double r1 = calculate_sampling_radius(poly1, radius_multiplier_);
-          double r2 = calculate_sampling_radius(poly2, radius_multiplier_);
-          double r = std::max(r1, r2);
-
-          // Sample representatives
-          std::vector<RepresentativePoint> rep_points_1, rep_points_2;
-          std::vector<RepresentativeEdge> rep_edges_1, rep_edges_2;
-
-          sample_representatives(poly1, r, rep_points_1, rep_edges_1);
-          sample_representatives(poly2, r, rep_points_2, rep_edges_2);
-
-          // Check type (a) violations
-          auto vio_a = detect_type_a_violations(rep_points_1, rep_points_2,
-                                                rule_distance_, r);
-          thread_results_a[t].insert(thread_results_a[t].end(),
-                                     vio_a.begin(), vio_a.end());
-
-          // Check type (b) violations
-          auto vio_b = detect_type_b_violations(rep_points_1, rep_points_2,
-                                                rep_edges_1, rep_edges_2,
-                                                rule_distance_, r);
-          thread_results_b[t].insert(thread_results_b[t].end(),
-                                     vio_b.begin(), vio_b.end());
-        }
+    for (int t = 0; t < workers; ++t) {
+      threads.emplace_back([this, t]() {
+        pin_worker(t, affinity_);
+        while (work_chunk(t)) {}
       });
     }
 
@@ -88,67 +186,185 @@ class ParallelSpaceChecker {
       thread.join();
     }
 
-    // Aggregate results
-    for (const auto& result : thread_results_a) {
-      violations_a.insert(violations_a.end(), result.begin(), result.end());
+    merge(violations_a, violations_b);
+  }
+
+  // The three steps of check_parallel(), for callers that run the workers
+  // themselves (see TaskGraph).
+  //
+  // Estimate the cost of every pair, schedule longest-first and set up
+  // buffers for worker ids 0..num_workers-1.
+  void prepare(int num_workers) {
+    wall_start_ = std::chrono::steady_clock::now();
+
+    std::vector<PolygonCostInfo> infos(polygons_.size());
+    for (size_t i = 0; i < polygons_.size(); ++i) {
+      infos[i] = polygon_cost_info(polygons_, i, radius_multiplier_,
+                                   sampling_);
     }
 
-    for (const auto& result : thread_results_b) {
-      violations_b.insert(violations_b.end(), result.begin(), result.end());
+    costs_.resize(pairs_.size());
+    for (size_t i = 0; i < pairs_.size(); ++i) {
+      costs_[i] = estimate_pair_cost(infos[pairs_[i].first],
+                                     infos[pairs_[i].second]);
     }
+
+    schedule_.reset(new CostSchedule(costs_, num_workers));
+    if (progress_) progress_->plan_pairs(pairs_.size(), total_cost(costs_));
+    results_a_.assign(num_workers, {});
+    results_b_.assign(num_workers, {});
+    slots_a_.assign(pairs_.size(), TaskSlot());
+    slots_b_.assign(pairs_.size(), TaskSlot());
+    memory_.clear();
+    memory_.resize(num_workers);
+    load_stats_.reset(num_workers);
+  }
+
+  // Claim and check one chunk of pairs on behalf of `worker`.
+  // Returns false once the schedule is exhausted or the run is cancelled.
+  bool work_chunk(int worker) {
+    size_t begin, end;
+    if (cancellation_.cancelled()) return false;
+    if (!schedule_->next(begin, end)) return false;
+
+    auto chunk_start = std::chrono::steady_clock::now();
+    if (!memory_[worker]) {
+      memory_[worker].reset(new WorkerMemory(arena_block_size_));
+    }
+    WorkerMemory& memory = *memory_[worker];
+
+    auto& out_a = results_a_[worker];
+    auto& out_b = results_b_[worker];
+    for (size_t k = begin; k < end; ++k) {
+      size_t pair_idx = schedule_->order()[k];
+      TaskSlot& slot_a = slots_a_[pair_idx];
+      TaskSlot& slot_b = slots_b_[pair_idx];
+      slot_a.worker = slot_b.worker = worker;
+      slot_a.offset = out_a.size();
+      slot_b.offset = out_b.size();
+
+      check_pair(pair_idx, memory.resource(), out_a, out_b);
+      memory.reset();
+
+      slot_a.count = out_a.size() - slot_a.offset;
+      slot_b.count = out_b.size() - slot_b.offset;
+    }
+
+    load_stats_.busy_ms[worker] += elapsed_ms(chunk_start);
+    load_stats_.tasks_done[worker] += end - begin;
+    if (progress_) {
+      progress_->pairs_done(end - begin,
+                            chunk_cost(*schedule_, costs_, begin, end));
+    }
+    return true;
+  }
+
+  // Aggregate the per-worker results in pair order (the order of a
+  // sequential run, independent of the thread count) and release the
+  // worker memory
+  void merge(std::vector<Violation>& violations_a,
+             std::vector<ViolationTypeB>& violations_b) {
+    ordered_concat(results_a_, slots_a_, violations_a, num_threads_);
+    ordered_concat(results_b_, slots_b_, violations_b, num_threads_);
+    std::vector<TaskSlot>().swap(slots_a_);
+    std::vector<TaskSlot>().swap(slots_b_);
+    memory_.clear();
+
+    load_stats_.wall_ms = elapsed_ms(wall_start_);
   }
 
+  // Per-thread busy time of the last check_parallel() call
+  const LoadStats& load_stats() const { return load_stats_; }
+
  private:
-  const std::vector<Polygon>& polygons_;
+  PolygonSource polygons_;
   const std::vector<std::pair<int, int>>& pairs_;
   double rule_distance_;
   double radius_multiplier_;
   int num_threads_;
+  size_t arena_block_size_;
+  AffinityPolicy affinity_;
+  LoadStats load_stats_;
+
+  ProgressTracker* progress_;
+  CancellationToken cancellation_;
+  const SamplingTable* sampling_;
+
+  std::vector<double> costs_;
+  std::unique_ptr<CostSchedule> schedule_;
+  std::vector<std::vector<Violation>> results_a_;
+  std::vector<std::vector<ViolationTypeB>> results_b_;
+  std::vector<TaskSlot> slots_a_;  // Per pair
+  std::vector<TaskSlot> slots_b_;
+  std::vector<std::unique_ptr<WorkerMemory>> memory_;
+  std::chrono::steady_clock::time_point wall_start_;
+
+  void check_pair(size_t pair_idx,
+                  std::pmr::memory_resource* resource,
+                  std::vector<Violation>& out_a,
+                  std::vector<ViolationTypeB>& out_b) const {
+    const auto& poly1 = polygons_[pairs_[pair_idx].first];
+    const auto& poly2 = polygons_[pairs_[pair_idx].second];
+
+    // Calculate sampling radius
+    double r1 = polygon_sampling_radius(polygons_, pairs_[pair_idx].first,
+                                        radius_multiplier_, sampling_);
+    double r2 = polygon_sampling_radius(polygons_, pairs_[pair_idx].second,
+                                        radius_multiplier_, sampling_);
+    double r = std::max(r1, r2);
+
+    // Sample representatives
+    RepresentativePoints rep_points_1(resource), rep_points_2(resource);
+    RepresentativeEdges rep_edges_1(resource), rep_edges_2(resource);
+
+    sample_representatives(poly1, r, rep_points_1, rep_edges_1);
+    sample_representatives(poly2, r, rep_points_2, rep_edges_2);
+
+    // Check type (a) violations
+    detect_type_a_violations(rep_points_1, rep_points_2,
+                             rule_distance_, r, out_a, resource);
+
+    // Check type (b) violations
+    detect_type_b_violations(rep_points_1, rep_points_2,
+                             rep_edges_1, rep_edges_2,
+                             rule_distance_, r, out_b, resource);
+  }
 };
 
 // Parallel width checking for multiple polygons
 class ParallelWidthChecker {
  public:
-  ParallelWidthChecker(const std::vector<Polygon>& polygons,
+  ParallelWidthChecker(const PolygonSource& polygons,
                        double R,
-                       double multiplier = 4.0,
-                       int num_threads = 0)
+                       double multiplier,
+                       const ParallelOptions& options)
       : polygons_(polygons),
         rule_distance_(R),
-        radius_multiplier_(multiplier) {
-
-    if (num_threads <= 0) {
-      num_threads_ = std::thread::hardware_concurrency();
-      if (num_threads_ == 0) num_threads_ = 4;
-    } else {
-      num_threads_ = num_threads;
-    }
-  }
+        radius_multiplier_(multiplier),
+        num_threads_(resolve_num_threads(options.num_threads)),
+        arena_block_size_(options.arena_block_size),
+        affinity_(options.affinity),
+        progress_(options.progress),
+        cancellation_(options.cancellation),
+        sampling_(usable_sampling(options, polygons.size())) {}
+
+  ParallelWidthChecker(const PolygonSource& polygons,
+                       double R,
+                       double multiplier = 4.0,
+                       int num_threads = 0)
+      : ParallelWidthChecker(polygons, R, multiplier,
+                             options_with_threads(num_threads)) {}
 
   std::vector<WidthViolation> check_parallel() {
-    int total_polys = polygons_.size();
-    int polys_per_thread = (total_polys + num_threads_ - 1) / num_threads_;
+    prepare(num_threads_);
+    int workers = std::min<int>(num_threads_, schedule_->num_chunks());
+    load_stats_.reset(workers);
 
     std::vector<std::thread> threads;
-    std::vector<std::vector<WidthViolation>> thread_results(num_threads_);
-
-    for (int t = 0; t < num_threads_; ++t) {
-      int start_idx = t * polys_per_thread;
-      int end_idx = std::min((t + 1) * polys_per_thread, total_polys);
-
-      if (start_idx >= end_idx) break;
-
-      threads.emplace_back([this, start_idx, end_idx, t,
-                           &thread_results]() {
-        for (int i = start_idx; i < end_idx; ++i) {
-          const auto& poly = polygons_[i];
-          double r = calculate_sampling_radius(poly, radius_multiplier_);
-
-          auto violations = check_width_violations(poly, rule_distance_, r);
-
-          thread_results[t].insert(thread_results[t].end(),
-                                  violations.begin(), violations.end());
-        }
+    for (int t = 0; t < workers; ++t) {
+      threads.emplace_back([this, t]() {
+        pin_worker(t, affinity_);
+        while (work_chunk(t)) {}
       });
     }
 
@@ -157,46 +373,142 @@ class ParallelWidthChecker {
       thread.join();
     }
 
-    // Aggregate results
     std::vector<WidthViolation> all_violations;
-    for (const auto& result : thread_results) {
-      all_violations.insert(all_violations.end(),
-                           result.begin(), result.end());
+    merge(all_violations);
+    return all_violations;
+  }
+
+  // The three steps of check_parallel(), as in ParallelSpaceChecker.
+  //
+  // Estimate the cost of every polygon, schedule longest-first and set up
+  // buffers for worker ids 0..num_workers-1.
+  void prepare(int num_workers) {
+    wall_start_ = std::chrono::steady_clock::now();
+
+    costs_.resize(polygons_.size());
+    for (size_t i = 0; i < polygons_.size(); ++i) {
+      costs_[i] = estimate_polygon_cost(
+          polygon_cost_info(polygons_, i, radius_multiplier_, sampling_));
     }
 
-    return all_violations;
+    schedule_.reset(new CostSchedule(costs_, num_workers));
+    if (progress_) {
+      progress_->plan_polygons(polygons_.size(), total_cost(costs_));
+    }
+    results_.assign(num_workers, {});
+    slots_.assign(polygons_.size(), TaskSlot());
+    memory_.clear();
+    memory_.resize(num_workers);
+    load_stats_.reset(num_workers);
+  }
+
+  // Claim and check one chunk of polygons on behalf of `worker`.
+  // Returns false once the schedule is exhausted or the run is cancelled.
+  bool work_chunk(int worker) {
+    size_t begin, end;
+    if (cancellation_.cancelled()) return false;
+    if (!schedule_->next(begin, end)) return false;
+
+    auto chunk_start = std::chrono::steady_clock::now();
+    if (!memory_[worker]) {
+      memory_[worker].reset(new WorkerMemory(arena_block_size_));
+    }
+    WorkerMemory& memory = *memory_[worker];
+
+    auto& out = results_[worker];
+    for (size_t k = begin; k < end; ++k) {
+      size_t poly_idx = schedule_->order()[k];
+      TaskSlot& slot = slots_[poly_idx];
+      slot.worker = worker;
+      slot.offset = out.size();
+
+      check_polygon(poly_idx, memory.resource(), out);
+      memory.reset();
+
+      slot.count = out.size() - slot.offset;
+    }
+
+    load_stats_.busy_ms[worker] += elapsed_ms(chunk_start);
+    load_stats_.tasks_done[worker] += end - begin;
+    if (progress_) {
+      progress_->polygons_done(end - begin,
+                               chunk_cost(*schedule_, costs_, begin, end));
+    }
+    return true;
   }
 
+  // Aggregate the per-worker results in polygon order and release the
+  // worker memory
+  void merge(std::vector<WidthViolation>& violations) {
+    ordered_concat(results_, slots_, violations, num_threads_);
+    std::vector<TaskSlot>().swap(slots_);
+    memory_.clear();
+
+    load_stats_.wall_ms = elapsed_ms(wall_start_);
+  }
+
+  // Per-thread busy time of the last check_parallel() call
+  const LoadStats& load_stats() const { return load_stats_; }
+
  private:
-  const std::vector<Polygon>& polygons_;
+  PolygonSource polygons_;
   double rule_distance_;
   double radius_multiplier_;
   int num_threads_;
+  size_t arena_block_size_;
+  AffinityPolicy affinity_;
+  LoadStats load_stats_;
+
+  ProgressTracker* progress_;
+  CancellationToken cancellation_;
+  const SamplingTable* sampling_;
+
+  std::vector<double> costs_;
+  std::unique_ptr<CostSchedule> schedule_;
+  std::vector<std::vector<WidthViolation>> results_;
+  std::vector<TaskSlot> slots_;  // Per polygon
+  std::vector<std::unique_ptr<WorkerMemory>> memory_;
+  std::chrono::steady_clock::time_point wall_start_;
+
+  void check_polygon(size_t poly_idx,
+                     std::pmr::memory_resource* resource,
+                     std::vector<WidthViolation>& out) const {
+    const auto& poly = polygons_[poly_idx];
+    double r = polygon_sampling_radius(polygons_, poly_idx,
+                                       radius_multiplier_, sampling_);
+
+    check_width_violations(poly, rule_distance_, r, out, resource);
+  }
 };
 
 
 inline void parallel_space_check(
-    const std::vector<Polygon>& polygons,
+    const PolygonSource& polygons,
     const std::vector<std::pair<int, int>>& pairs,
     double R,
     std::vector<Violation>& violations_a,
     std::vector<ViolationTypeB>& violations_b,
     double multiplier = 4.0,
-    int num_threads = 0) {
+    int num_threads = 0,
+    LoadStats* load_stats = nullptr) {
 
   ParallelSpaceChecker checker(polygons, pairs, R, multiplier, num_threads);
   checker.check_parallel(violations_a, violations_b);
+  if (load_stats) *load_stats = checker.load_stats();
 }
 
 // Main parallel width checking function
 inline std::vector<WidthViolation> parallel_width_check(
-    const std::vector<Polygon>& polygons,
+    const PolygonSource& polygons,
     double R,
     double multiplier = 4.0,
-    int num_threads = 0) {
+    int num_threads = 0,
+    LoadStats* load_stats = nullptr) {
 
   ParallelWidthChecker checker(polygons, R, multiplier, num_threads);
-  return checker.check_parallel();
+  auto violations = checker.check_parallel();
+  if (load_stats) *load_stats = checker.load_stats();
+  return violations;
 }
 
 }  // namespace easymrc
@@ -0,0 +1,757 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include "bit_image.hpp"
+#include "mapped_file.hpp"
+
+namespace easymrc {
+
+// PNG Support
+//
+// PNG images are decoded in-tree: the IDAT chunks of the mapped file are
+// inflated as one zlib stream, and each scanline is unfiltered as soon as
+// it is complete, converted to 8-bit gray and thresholded straight into the
+// bit-packed mask. Besides the mask only two scanlines and the inflate
+// window are held, never the decoded image.
+
+namespace png_detail {
+
+const unsigned char SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                    '\n'};
+
+enum ColorType {
+  GRAY = 0,
+  RGB = 2,
+  PALETTE = 3,
+  GRAY_ALPHA = 4,
+  RGB_ALPHA = 6
+};
+
+inline uint32_t load_be32(const unsigned char* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// CRC-32 of chunk types and data (ISO 3309, as zlib's crc32())
+inline uint32_t crc32(const unsigned char* data, size_t size) {
+  static const std::vector<uint32_t> table = [] {
+    std::vector<uint32_t> t(256);
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[n] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
+
+// Byte range of the mapped file
+struct Span {
+  const unsigned char* data;
+  size_t size;
+};
+
+// Chunks of a PNG file needed for decoding
+struct PngInfo {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int bit_depth = 0;
+  int color_type = 0;
+  bool interlaced = false;
+  Span palette = {nullptr, 0};        // PLTE data
+  Span transparency = {nullptr, 0};   // tRNS data
+  std::vector<Span> image_data;       // IDAT data, in order
+};
+
+// Walk the chunks of a PNG file, checking every CRC. Unknown ancillary
+// chunks are skipped; unknown critical ones are an error.
+inline PngInfo parse_chunks(const unsigned char* data, size_t size,
+                            const std::string& filename) {
+  auto fail = [&filename](const std::string& what) {
+    throw std::runtime_error("Malformed PNG file " + filename + ": " + what);
+  };
+  if (size < 8 || std::memcmp(data, SIGNATURE, 8) != 0) {
+    throw std::runtime_error("Not a PNG file: " + filename);
+  }
+
+  PngInfo info;
+  size_t pos = 8;
+  bool header = false, end = false;
+  while (!end) {
+    if (size - pos < 12) fail("truncated chunk at offset " +
+                              std::to_string(pos));
+    uint32_t length = load_be32(data + pos);
+    if (length > 0x7fffffffu || size - pos - 12 < length) {
+      fail("truncated chunk at offset " + std::to_string(pos));
+    }
+    const unsigned char* type = data + pos + 4;
+    const unsigned char* body = type + 4;
+    if (crc32(type, length + 4) != load_be32(body + length)) {
+      fail("CRC mismatch at offset " + std::to_string(pos));
+    }
+    std::string name(reinterpret_cast<const char*>(type), 4);
+    if (!header && name != "IHDR") fail("IHDR must come first");
+
+    if (name == "IHDR") {
+      if (header || length != 13) fail("invalid IHDR chunk");
+      header = true;
+      info.width = load_be32(body);
+      info.height = load_be32(body + 4);
+      info.bit_depth = body[8];
+      info.color_type = body[9];
+      info.interlaced = body[12] != 0;
+      if (info.width == 0 || info.height == 0 ||
+          info.width > 0x7fffffffu || info.height > 0x7fffffffu) {
+        fail("invalid image size");
+      }
+      int d = info.bit_depth;
+      bool valid = false;
+      switch (info.color_type) {
+        case GRAY:
+          valid = d == 1 || d == 2 || d == 4 || d == 8 || d == 16;
+          break;
+        case PALETTE:
+          valid = d == 1 || d == 2 || d == 4 || d == 8;
+          break;
+        case RGB:
+        case GRAY_ALPHA:
+        case RGB_ALPHA:
+          valid = d == 8 || d == 16;
+          break;
+      }
+      if (!valid) fail("invalid color type and bit depth");
+      if (body[10] != 0 || body[11] != 0 || body[12] > 1) {
+        fail("unknown compression, filter or interlace method");
+      }
+    } else if (name == "PLTE") {
+      if (length == 0 || length % 3 != 0 || length > 768) {
+        fail("invalid PLTE chunk");
+      }
+      info.palette = {body, length};
+    } else if (name == "tRNS") {
+      info.transparency = {body, length};
+    } else if (name == "IDAT") {
+      info.image_data.push_back({body, length});
+    } else if (name == "IEND") {
+      end = true;
+    } else if (!(type[0] & 0x20)) {
+      fail("unknown critical chunk " + name);
+    }
+    pos += 12 + static_cast<size_t>(length);
+  }
+
+  if (info.color_type == PALETTE && info.palette.data == nullptr) {
+    fail("missing PLTE chunk");
+  }
+  if (info.image_data.empty()) fail("missing IDAT chunk");
+  return info;
+}
+
+// Canonical Huffman code of at most 15 bits, decoded with a single table
+// lookup on the next max_bits() input bits (least significant bit first).
+// Table entries are symbol << 4 | code length; 0 marks an unused code.
+class Huffman {
+ public:
+  Huffman() : max_bits_(1), table_(2, 0) {}
+
+  // Code lengths per symbol (0: unused). Returns false for over-subscribed
+  // lengths; incomplete codes are accepted, as zlib does for a single
+  // distance code.
+  bool build(const uint8_t* lengths, int count) {
+    int counts[16] = {0};
+    max_bits_ = 1;
+    for (int s = 0; s < count; ++s) {
+      counts[lengths[s]]++;
+      max_bits_ = std::max<int>(max_bits_, lengths[s]);
+    }
+    counts[0] = 0;
+    int left = 1;
+    int next[16] = {0};
+    for (int len = 1; len <= 15; ++len) {
+      left = (left << 1) - counts[len];
+      if (left < 0) return false;
+      next[len] = (next[len - 1] + counts[len - 1]) << 1;
+    }
+
+    table_.assign(size_t(1) << max_bits_, 0);
+    for (int s = 0; s < count; ++s) {
+      int len = lengths[s];
+      if (len == 0) continue;
+      // Codes are stored most significant bit first, the input is read
+      // least significant bit first
+      int code = next[len]++, reversed = 0;
+      for (int b = 0; b < len; ++b) {
+        reversed = (reversed << 1) | ((code >> b) & 1);
+      }
+      const uint16_t entry = static_cast<uint16_t>((s << 4) | len);
+      for (size_t i = reversed; i < table_.size(); i += size_t(1) << len) {
+        table_[i] = entry;
+      }
+    }
+    return true;
+  }
+
+  uint16_t lookup(uint64_t bits) const {
+    return table_[bits & ((uint64_t(1) << max_bits_) - 1)];
+  }
+
+ private:
+  int max_bits_;
+  std::vector<uint16_t> table_;
+};
+
+// Decoder of a zlib stream (RFC 1950/1951) spread over several input spans.
+// Output is handed to sink(data, size) in pieces as it is produced; only
+// the last 32 KB, which matches may refer to, are kept.
+class Inflater {
+ public:
+  Inflater(const std::vector<Span>& input, const std::string& filename)
+      : input_(input), filename_(filename), out_(kWindow + kChunk) {}
+
+  [[noreturn]] void fail(const std::string& what) const {
+    throw std::runtime_error("Malformed PNG file " + filename_ + ": " + what);
+  }
+
+  template <typename Sink>
+  void run(Sink& sink) {
+    uint32_t cmf = take(8), flg = take(8);
+    if ((cmf & 0x0f) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 != 0) {
+      fail("invalid zlib header");
+    }
+    if (flg & 0x20) fail("zlib preset dictionary is not supported");
+
+    bool last = false;
+    while (!last) {
+      last = take(1) != 0;
+      switch (take(2)) {
+        case 0:
+          stored_block(sink);
+          break;
+        case 1:
+          fixed_codes();
+          compressed_block(sink);
+          break;
+        case 2:
+          dynamic_codes();
+          compressed_block(sink);
+          break;
+        default:
+          fail("invalid deflate block type");
+      }
+    }
+    flush(sink);
+
+    // Adler-32 of the output follows, byte-aligned and big-endian
+    drop(num_bits_ % 8);
+    uint32_t adler = 0;
+    for (int i = 0; i < 4; ++i) adler = (adler << 8) | take(8);
+    if (adler != ((adler_b_ << 16) | adler_a_)) fail("zlib checksum mismatch");
+  }
+
+ private:
+  static constexpr size_t kWindow = 32768;
+  static constexpr size_t kChunk = 65536;  // Output passed on at a time
+  static constexpr size_t kMaxMatch = 258;
+
+  const std::vector<Span>& input_;
+  const std::string& filename_;
+  size_t span_ = 0, pos_ = 0;  // Next input byte
+  uint64_t bits_ = 0;          // Bit buffer, next bit in bit 0
+  int num_bits_ = 0;
+  int padding_ = 0;            // Zero bits appended past the end of input
+  Huffman literals_, distances_;
+  std::vector<unsigned char> out_;
+  size_t out_pos_ = 0;         // End of the output in out_
+  size_t flushed_ = 0;         // End of the output passed to the sink
+  uint64_t total_ = 0;         // Bytes produced
+  uint32_t adler_a_ = 1, adler_b_ = 0;
+
+  // Top the bit buffer up to at least 57 bits. Past the end of the input
+  // zero bytes are appended, so a table lookup may read ahead of the last
+  // code; consuming them is an error.
+  void refill() {
+    while (num_bits_ <= 56) {
+      while (span_ < input_.size() && pos_ == input_[span_].size) {
+        span_++;
+        pos_ = 0;
+      }
+      if (span_ < input_.size()) {
+        bits_ |= static_cast<uint64_t>(input_[span_].data[pos_++])
+                 << num_bits_;
+      } else {
+        padding_ += 8;
+      }
+      num_bits_ += 8;
+    }
+  }
+
+  void drop(int n) {
+    bits_ >>= n;
+    num_bits_ -= n;
+    if (num_bits_ < padding_) fail("unexpected end of image data");
+  }
+
+  uint32_t take(int n) {
+    if (num_bits_ < n) refill();
+    uint32_t value = static_cast<uint32_t>(bits_ & ((uint64_t(1) << n) - 1));
+    drop(n);
+    return value;
+  }
+
+  int decode(const Huffman& code) {
+    if (num_bits_ < 15) refill();
+    uint16_t entry = code.lookup(bits_);
+    if (entry == 0) fail("invalid Huffman code");
+    drop(entry & 15);
+    return entry >> 4;
+  }
+
+  // Pass the new output on, updating the Adler-32 in runs short enough
+  // not to overflow before the modulo
+  template <typename Sink>
+  void flush(Sink& sink) {
+    const unsigned char* data = out_.data() + flushed_;
+    const size_t size = out_pos_ - flushed_;
+    for (size_t done = 0; done < size;) {
+      size_t run = std::min<size_t>(size - done, 5552);
+      for (size_t i = 0; i < run; ++i) {
+        adler_a_ += data[done + i];
+        adler_b_ += adler_a_;
+      }
+      adler_a_ %= 65521;
+      adler_b_ %= 65521;
+      done += run;
+    }
+    flushed_ = out_pos_;
+    if (size > 0) sink(data, size);
+  }
+
+  // Make room for n more output bytes (n <= kChunk): once the buffer is
+  // full its output is passed on and the window moved to the front
+  template <typename Sink>
+  void reserve(Sink& sink, size_t n) {
+    if (out_pos_ + n <= out_.size()) return;
+    flush(sink);
+    size_t keep = std::min(out_pos_, kWindow);
+    std::memmove(out_.data(), out_.data() + out_pos_ - keep, keep);
+    out_pos_ = flushed_ = keep;
+  }
+
+  template <typename Sink>
+  void stored_block(Sink& sink) {
+    drop(num_bits_ % 8);
+    uint32_t length = take(16), complement = take(16);
+    if ((length ^ complement) != 0xffff) fail("invalid stored block length");
+    total_ += length;
+    while (length > 0) {
+      reserve(sink, 1);
+      size_t n = std::min<size_t>(length, out_.size() - out_pos_);
+      // Bytes left in the bit buffer first, then straight from the input
+      size_t i = 0;
+      for (; i < n && num_bits_ > padding_; ++i) {
+        out_[out_pos_ + i] = static_cast<unsigned char>(take(8));
+      }
+      while (i < n) {
+        if (span_ == input_.size()) fail("unexpected end of image data");
+        const Span& span = input_[span_];
+        size_t copy = std::min(n - i, span.size - pos_);
+        std::memcpy(out_.data() + out_pos_ + i, span.data + pos_, copy);
+        i += copy;
+        pos_ += copy;
+        if (pos_ == span.size) {
+          span_++;
+          pos_ = 0;
+        }
+      }
+      out_pos_ += n;
+      length -= static_cast<uint32_t>(n);
+    }
+  }
+
+  template <typename Sink>
+  void compressed_block(Sink& sink) {
+    static const uint16_t length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t length_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t distance_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+        193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+        6145, 8193, 12289, 16385, 24577};
+    static const uint8_t distance_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    for (;;) {
+      int symbol = decode(literals_);
+      if (symbol < 256) {
+        reserve(sink, 1);
+        out_[out_pos_++] = static_cast<unsigned char>(symbol);
+        total_++;
+        continue;
+      }
+      if (symbol == 256) return;
+      symbol -= 257;
+      if (symbol >= 29) fail("invalid length code");
+      size_t length = length_base[symbol] + take(length_extra[symbol]);
+      int code = decode(distances_);
+      if (code >= 30) fail("invalid distance code");
+      size_t distance = distance_base[code] + take(distance_extra[code]);
+      if (distance > total_) fail("distance too far back");
+
+      reserve(sink, kMaxMatch);
+      // Byte by byte: the match may overlap its own output
+      unsigned char* dst = out_.data() + out_pos_;
+      const unsigned char* src = dst - distance;
+      for (size_t i = 0; i < length; ++i) dst[i] = src[i];
+      out_pos_ += length;
+      total_ += length;
+    }
+  }
+
+  void fixed_codes() {
+    uint8_t lengths[288];
+    std::fill(lengths, lengths + 144, 8);
+    std::fill(lengths + 144, lengths + 256, 9);
+    std::fill(lengths + 256, lengths + 280, 7);
+    std::fill(lengths + 280, lengths + 288, 8);
+    literals_.build(lengths, 288);
+    std::fill(lengths, lengths + 32, 5);
+    distances_.build(lengths, 32);
+  }
+
+  void dynamic_codes() {
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5,
+                                      11, 4, 12, 3, 13, 2, 14, 1, 15};
+    int num_literals = take(5) + 257;
+    int num_distances = take(5) + 1;
+    int num_code_lengths = take(4) + 4;
+    if (num_literals > 286 || num_distances > 30) {
+      fail("invalid dynamic block header");
+    }
+
+    uint8_t lengths[286 + 30] = {0};
+    for (int i = 0; i < num_code_lengths; ++i) {
+      lengths[order[i]] = static_cast<uint8_t>(take(3));
+    }
+    Huffman code_lengths;
+    if (!code_lengths.build(lengths, 19)) fail("invalid code length code");
+
+    std::fill(lengths, lengths + 19, 0);
+    const int total = num_literals + num_distances;
+    for (int i = 0; i < total;) {
+      int symbol = decode(code_lengths);
+      if (symbol < 16) {
+        lengths[i++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+      uint8_t value = 0;
+      int repeat;
+      if (symbol == 16) {
+        if (i == 0) fail("repeated code length without a previous one");
+        value = lengths[i - 1];
+        repeat = 3 + take(2);
+      } else if (symbol == 17) {
+        repeat = 3 + take(3);
+      } else {
+        repeat = 11 + take(7);
+      }
+      if (i + repeat > total) fail("too many code lengths");
+      std::fill(lengths + i, lengths + i + repeat, value);
+      i += repeat;
+    }
+
+    if (lengths[256] == 0) fail("missing end-of-block code");
+    if (!literals_.build(lengths, num_literals) ||
+        !distances_.build(lengths + num_literals, num_distances)) {
+      fail("invalid Huffman code lengths");
+    }
+  }
+};
+
+// Consumer of the inflated image data: assembles scanlines, reverses their
+// filters against the previous scanline, converts them to 8-bit gray and
+// hands them to row(gray, y), top row (y = height - 1) first.
+template <typename Row>
+class ScanlineDecoder {
+ public:
+  ScanlineDecoder(const PngInfo& info, Row& row, const std::string& filename)
+      : info_(info), row_(row), filename_(filename),
+        channels_(channels(info.color_type)),
+        bits_per_pixel_(channels_ * info.bit_depth),
+        bpp_(std::max(1, bits_per_pixel_ / 8)),
+        row_bytes_((static_cast<size_t>(info.width) * bits_per_pixel_ + 7) / 8),
+        current_(row_bytes_ + 1), previous_(row_bytes_ + 1, 0),
+        gray_(info.width), fill_(0), rows_(0) {
+    build_palette();
+    build_key();
+  }
+
+  void operator()(const unsigned char* data, size_t size) {
+    while (size > 0) {
+      if (rows_ == info_.height) fail("too much image data");
+      size_t n = std::min(size, current_.size() - fill_);
+      std::memcpy(current_.data() + fill_, data, n);
+      fill_ += n;
+      data += n;
+      size -= n;
+      if (fill_ == current_.size()) {
+        unfilter();
+        to_gray(current_.data() + 1);
+        row_(gray_.data(), static_cast<int>(info_.height - 1 - rows_));
+        current_.swap(previous_);
+        fill_ = 0;
+        rows_++;
+      }
+    }
+  }
+
+  void finish() const {
+    if (rows_ != info_.height || fill_ != 0) fail("missing image data");
+  }
+
+ private:
+  const PngInfo& info_;
+  Row& row_;
+  const std::string& filename_;
+  int channels_;
+  int bits_per_pixel_;
+  int bpp_;                               // Filter byte distance
+  size_t row_bytes_;
+  std::vector<unsigned char> current_;    // Filter type and row bytes
+  std::vector<unsigned char> previous_;   // Unfiltered, zero before row 0
+  std::vector<unsigned char> gray_;
+  size_t fill_;
+  uint32_t rows_;
+  unsigned char palette_gray_[256] = {0};
+  bool has_key_ = false;                  // tRNS color key of gray or RGB
+  uint16_t key_[3] = {0, 0, 0};
+
+  [[noreturn]] void fail(const std::string& what) const {
+    throw std::runtime_error("Malformed PNG file " + filename_ + ": " + what);
+  }
+
+  static int channels(int color_type) {
+    switch (color_type) {
+      case RGB: return 3;
+      case GRAY_ALPHA: return 2;
+      case RGB_ALPHA: return 4;
+      default: return 1;
+    }
+  }
+
+  static unsigned char luma(unsigned r, unsigned g, unsigned b) {
+    return static_cast<unsigned char>((77 * r + 150 * g + 29 * b) >> 8);
+  }
+
+  // Transparent pixels are composited over black
+  static unsigned char over_black(unsigned value, unsigned alpha) {
+    return static_cast<unsigned char>((value * alpha + 127) / 255);
+  }
+
+  // Gray level of each palette entry, with its tRNS alpha applied
+  void build_palette() {
+    if (info_.color_type != PALETTE) return;
+    const unsigned char* p = info_.palette.data;
+    const size_t entries = info_.palette.size / 3;
+    for (size_t i = 0; i < entries; ++i) {
+      unsigned char v = luma(p[i * 3], p[i * 3 + 1], p[i * 3 + 2]);
+      if (i < info_.transparency.size) {
+        v = over_black(v, info_.transparency.data[i]);
+      }
+      palette_gray_[i] = v;
+    }
+  }
+
+  void build_key() {
+    const Span& t = info_.transparency;
+    int samples = info_.color_type == GRAY ? 1 :
+                  info_.color_type == RGB ? 3 : 0;
+    if (samples == 0 || t.size < static_cast<size_t>(samples) * 2) return;
+    has_key_ = true;
+    for (int i = 0; i < samples; ++i) {
+      key_[i] = static_cast<uint16_t>((t.data[i * 2] << 8) | t.data[i * 2 + 1]);
+    }
+  }
+
+  void unfilter() {
+    unsigned char* row = current_.data() + 1;
+    const unsigned char* prior = previous_.data() + 1;
+    const size_t n = row_bytes_;
+    const size_t bpp = bpp_;
+    switch (current_[0]) {
+      case 0:  // None
+        break;
+      case 1:  // Sub
+        for (size_t i = bpp; i < n; ++i) row[i] += row[i - bpp];
+        break;
+      case 2:  // Up
+        for (size_t i = 0; i < n; ++i) row[i] += prior[i];
+        break;
+      case 3:  // Average
+        for (size_t i = 0; i < n; ++i) {
+          unsigned left = i >= bpp ? row[i - bpp] : 0;
+          row[i] += static_cast<unsigned char>((left + prior[i]) >> 1);
+        }
+        break;
+      case 4:  // Paeth
+        for (size_t i = 0; i < n; ++i) {
+          int a = i >= bpp ? row[i - bpp] : 0;
+          int b = prior[i];
+          int c = i >= bpp ? prior[i - bpp] : 0;
+          int p = a + b - c;
+          int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+          row[i] += static_cast<unsigned char>(
+              pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+        }
+        break;
+      default:
+        fail("invalid filter type in row " + std::to_string(rows_));
+    }
+  }
+
+  void to_gray(const unsigned char* row) {
+    const size_t width = info_.width;
+    const int depth = info_.bit_depth;
+    unsigned char* out = gray_.data();
+
+    if (depth < 8) {
+      // Gray or palette samples packed most significant bits first
+      const unsigned mask = (1u << depth) - 1;
+      const unsigned scale = 255 / mask;
+      for (size_t x = 0; x < width; ++x) {
+        size_t bit = x * depth;
+        unsigned v = (row[bit >> 3] >> (8 - depth - (bit & 7))) & mask;
+        if (info_.color_type == PALETTE) {
+          out[x] = palette_gray_[v];
+        } else {
+          out[x] = has_key_ && v == key_[0] ? 0 :
+                   static_cast<unsigned char>(v * scale);
+        }
+      }
+      return;
+    }
+
+    // 8- or 16-bit samples; 16-bit ones are reduced to their high byte
+    const size_t step = depth / 8;
+    auto sample = [row, step](size_t i) -> unsigned {
+      return row[i * step];
+    };
+    auto full = [row, step](size_t i) -> unsigned {
+      return step == 2 ? (row[i * 2] << 8) | row[i * 2 + 1] : row[i];
+    };
+    switch (info_.color_type) {
+      case GRAY:
+        for (size_t x = 0; x < width; ++x) {
+          out[x] = has_key_ && full(x) == key_[0] ? 0 :
+                   static_cast<unsigned char>(sample(x));
+        }
+        break;
+      case PALETTE:
+        for (size_t x = 0; x < width; ++x) out[x] = palette_gray_[row[x]];
+        break;
+      case GRAY_ALPHA:
+        for (size_t x = 0; x < width; ++x) {
+          out[x] = over_black(sample(x * 2), sample(x * 2 + 1));
+        }
+        break;
+      case RGB:
+        for (size_t x = 0; x < width; ++x) {
+          size_t i = x * 3;
+          bool key = has_key_ && full(i) == key_[0] &&
+                     full(i + 1) == key_[1] && full(i + 2) == key_[2];
+          out[x] = key ? 0 : luma(sample(i), sample(i + 1), sample(i + 2));
+        }
+        break;
+      case RGB_ALPHA:
+        for (size_t x = 0; x < width; ++x) {
+          size_t i = x * 4;
+          out[x] = over_black(luma(sample(i), sample(i + 1), sample(i + 2)),
+                              sample(i + 3));
+        }
+        break;
+    }
+  }
+};
+
+// Decode a PNG file: begin(width, height) is called once the header has
+// been read, then row(gray, y) for every scanline, top row first. Color is
+// reduced to luma and transparency composited over black; 16-bit samples
+// are reduced to 8 bits. Interlaced images are not supported.
+template <typename Begin, typename Row>
+inline void decode(const std::string& filename, Begin&& begin, Row&& row) {
+  MappedFile file(filename, MappedFile::Access::SEQUENTIAL);
+  PngInfo info = parse_chunks(file.data(), file.size(), filename);
+  if (info.interlaced) {
+    throw std::runtime_error("Interlaced PNG is not supported: " + filename);
+  }
+
+  begin(static_cast<int>(info.width), static_cast<int>(info.height));
+  ScanlineDecoder<typename std::remove_reference<Row>::type> rows(
+      info, row, filename);
+  Inflater inflater(info.image_data, filename);
+  inflater.run(rows);
+  rows.finish();
+}
+
+inline bool is_png_file(const std::string& filename) {
+  std::string ext = filename.substr(filename.find_last_of('.') + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return ext == "png";
+}
+
+}  // namespace png_detail
+
+// Read a PNG image straight into a mask: pixel (x, y) is set where its gray
+// level is at least threshold
+inline BitImage read_png_mask(const std::string& filename,
+                              unsigned char threshold = 255) {
+  BitImage mask;
+  png_detail::decode(filename,
+                     [&mask](int width, int height) {
+                       mask = BitImage(width, height);
+                     },
+                     [&mask, threshold](const unsigned char* gray, int y) {
+                       BitImage::pack_row(gray, mask.width(), threshold,
+                                          mask.row(y));
+                     });
+  return mask;
+}
+
+// Read a PNG image straight into one mask per gray level, as
+// BitImage::select_levels()
+inline std::vector<BitImage> read_png_levels(
+    const std::string& filename, const std::vector<unsigned char>& levels) {
+  std::vector<BitImage> masks;
+  png_detail::decode(filename,
+                     [&masks, &levels](int width, int height) {
+                       masks.assign(levels.size(), BitImage(width, height));
+                     },
+                     [&masks, &levels](const unsigned char* gray, int y) {
+                       for (size_t k = 0; k < levels.size(); ++k) {
+                         BitImage::pack_row_equal(gray, masks[k].width(),
+                                                  levels[k], masks[k].row(y));
+                       }
+                     });
+  return masks;
+}
+
+}  // namespace easymrc
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+namespace easymrc {
+
+// Stage of a run, as reported by ProgressTracker
+enum class RunPhase {
+  PENDING,          // Not started yet
+  CANDIDATE_PAIRS,  // Serial candidate sweep
+  CHECKING,         // Space and width checks
+  DONE,
+  CANCELLED,
+  FAILED
+};
+
+inline const char* run_phase_name(RunPhase phase) {
+  switch (phase) {
+    case RunPhase::PENDING: return "pending";
+    case RunPhase::CANDIDATE_PAIRS: return "candidate pairs";
+    case RunPhase::CHECKING: return "checking";
+    case RunPhase::DONE: return "done";
+    case RunPhase::CANCELLED: return "cancelled";
+    default: return "failed";
+  }
+}
+
+// Thrown by a run that stopped because its token was cancelled
+class RunCancelled : public std::runtime_error {
+ public:
+  RunCancelled() : std::runtime_error("Run cancelled") {}
+};
+
+// Shared cancellation flag. Copies refer to the same flag; workers poll it
+// between chunks, so cancellation takes effect within one chunk.
+class CancellationToken {
+ public:
+  CancellationToken() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void cancel() const { flag_->store(true, std::memory_order_release); }
+
+  bool cancelled() const {
+    return flag_->load(std::memory_order_acquire);
+  }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+// Point-in-time copy of a run's progress
+struct ProgressSnapshot {
+  RunPhase phase;
+  size_t pairs_done, pairs_total;
+  size_t polygons_done, polygons_total;
+  double elapsed_ms;
+  double fraction;  // Share of the estimated work done, 0..1
+  double eta_ms;    // Estimated time to completion, -1 = unknown
+
+  ProgressSnapshot()
+      : phase(RunPhase::PENDING), pairs_done(0), pairs_total(0),
+        polygons_done(0), polygons_total(0), elapsed_ms(0.0),
+        fraction(0.0), eta_ms(-1.0) {}
+};
+
+// Progress counters updated by the workers and read from any thread.
+//
+// Work is weighted by the scheduler's cost estimates rather than counted,
+// since longest-first scheduling front-loads the expensive tasks and a
+// plain task count would make the ETA far too pessimistic. The ETA is
+// reported once every checker that will run has registered its total.
+class ProgressTracker {
+ public:
+  ProgressTracker()
+      : phase_(RunPhase::PENDING), expected_plans_(0), plans_(0),
+        pairs_done_(0), pairs_total_(0),
+        polygons_done_(0), polygons_total_(0),
+        cost_done_(0.0), cost_total_(0.0), start_ns_(now_ns()) {}
+
+  ProgressTracker(const ProgressTracker&) = delete;
+  ProgressTracker& operator=(const ProgressTracker&) = delete;
+
+  // Start a run in which expected_plans checkers will register their work
+  void start(int expected_plans) {
+    expected_plans_.store(expected_plans);
+    start_ns_.store(now_ns());
+    set_phase(RunPhase::CANDIDATE_PAIRS);
+  }
+
+  void set_phase(RunPhase phase) {
+    phase_.store(phase, std::memory_order_release);
+  }
+
+  RunPhase phase() const { return phase_.load(std::memory_order_acquire); }
+
+  // Register the work of one checker
+  void plan_pairs(size_t count, double cost) {
+    pairs_total_ += count;
+    plan(cost);
+  }
+
+  void plan_polygons(size_t count, double cost) {
+    polygons_total_ += count;
+    plan(cost);
+  }
+
+  // Report finished work
+  void pairs_done(size_t count, double cost) {
+    pairs_done_ += count;
+    add(cost_done_, cost);
+  }
+
+  void polygons_done(size_t count, double cost) {
+    polygons_done_ += count;
+    add(cost_done_, cost);
+  }
+
+  ProgressSnapshot snapshot() const {
+    ProgressSnapshot snapshot;
+    snapshot.phase = phase();
+    snapshot.pairs_done = pairs_done_.load();
+    snapshot.pairs_total = pairs_total_.load();
+    snapshot.polygons_done = polygons_done_.load();
+    snapshot.polygons_total = polygons_total_.load();
+
+    snapshot.elapsed_ms = (now_ns() - start_ns_.load()) / 1e6;
+
+    double total = cost_total_.load();
+    double done = cost_done_.load();
+    bool planned = plans_.load() >= expected_plans_.load();
+
+    if (snapshot.phase == RunPhase::DONE) {
+      snapshot.fraction = 1.0;
+      snapshot.eta_ms = 0.0;
+    } else if (planned && total > 0.0) {
+      snapshot.fraction = std::min(1.0, done / total);
+      if (done > 0.0) {
+        snapshot.eta_ms = snapshot.elapsed_ms *
+                          (1.0 - snapshot.fraction) / snapshot.fraction;
+      }
+    }
+    return snapshot;
+  }
+
+ private:
+  std::atomic<RunPhase> phase_;
+  std::atomic<int> expected_plans_;
+  std::atomic<int> plans_;
+  std::atomic<size_t> pairs_done_, pairs_total_;
+  std::atomic<size_t> polygons_done_, polygons_total_;
+  std::atomic<double> cost_done_, cost_total_;
+  std::atomic<int64_t> start_ns_;
+
+  void plan(double cost) {
+    add(cost_total_, cost);
+    plans_++;
+  }
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // std::atomic<double> has no fetch_add before C++20
+  static void add(std::atomic<double>& target, double value) {
+    double current = target.load(std::memory_order_relaxed);
+    while (!target.compare_exchange_weak(current, current + value,
+                                         std::memory_order_relaxed)) {}
+  }
+};
+
+}  // namespace easymrc
@@ -3,62 +3,72 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <iterator>
 #include "types.hpp"
+#include "layout_store.hpp"
 
 namespace easymrc {
 
 class RepresentativeSampler {
  public:
-  RepresentativeSampler(const Polygon& poly, double sampling_radius)
+  RepresentativeSampler(const PolygonView& poly, double sampling_radius)
       : polygon_(poly), r_(sampling_radius) {}
 
-  // Sample representative points and edges
-  void sample(std::vector<RepresentativePoint>& rep_points,
-              std::vector<RepresentativeEdge>& rep_edges) {
+  // Sample representative points and edges.
+  // Representatives, their shield lists and all scratch data are allocated
+  // from the memory resource of rep_points.
+  void sample(RepresentativePoints& rep_points,
+              RepresentativeEdges& rep_edges) {
 
-    if (polygon_.vertices.empty()) return;
+    if (polygon_.empty()) return;
+
+    std::pmr::memory_resource* resource =
+        rep_points.get_allocator().resource();
 
     // Select representative points
-    std::vector<int> rep_indices = select_representative_points();
+    std::pmr::vector<int> rep_indices = select_representative_points(resource);
+    rep_points.reserve(rep_points.size() + rep_indices.size());
 
     // Build representative points with shielded information
     for (int idx : rep_indices) {
-      RepresentativePoint rep_point(polygon_.vertices[idx], polygon_.id);
+      const Point rep = polygon_.vertex(idx);
+      rep_points.emplace_back(rep, polygon_.id());
+      RepresentativePoint& rep_point = rep_points.back();
 
       // Find shielded vertices (within distance r)
-      for (size_t i = 0; i < polygon_.vertices.size(); ++i) {
-        double dist = euclidean_distance(polygon_.vertices[idx],
-                                        polygon_.vertices[i]);
+      for (size_t i = 0; i < polygon_.size(); ++i) {
+        const Point vertex = polygon_.vertex(i);
+        double dist = euclidean_distance(rep, vertex);
         if (dist <= r_) {
-          rep_point.shielded_vertices.push_back(polygon_.vertices[i]);
+          rep_point.shielded_vertices.push_back(vertex);
         }
       }
 
       // Find shielded edges (within distance r)
-      for (const auto& seg : polygon_.segments) {
-        double dist = point_to_segment_distance(polygon_.vertices[idx], seg);
+      for (size_t e = 0; e < polygon_.num_edges(); ++e) {
+        const Segment seg = polygon_.edge(e);
+        double dist = point_to_segment_distance(rep, seg);
         if (dist <= r_) {
           rep_point.shielded_edges.push_back(seg);
         }
       }
-
-      rep_points.push_back(rep_point);
     }
 
     // Select representative edges (length > r)
-    for (const auto& seg : polygon_.segments) {
-      if (seg.length() > r_) {
-        RepresentativeEdge rep_edge(seg, polygon_.id);
+    for (size_t e = 0; e < polygon_.num_edges(); ++e) {
+      if (polygon_.edge_length(e) > r_) {
+        const Segment seg = polygon_.edge(e);
+        rep_edges.emplace_back(seg, polygon_.id());
+        RepresentativeEdge& rep_edge = rep_edges.back();
 
         // Find shielded vertices near this edge
-        for (const auto& vertex : polygon_.vertices) {
+        for (size_t i = 0; i < polygon_.size(); ++i) {
+          const Point vertex = polygon_.vertex(i);
           double dist = point_to_segment_distance(vertex, seg);
           if (dist <= r_) {
             rep_edge.shielded_vertices.push_back(vertex);
           }
         }
-
-        rep_edges.push_back(rep_edge);
       }
     }
   }
@@ -73,12 +83,12 @@ class RepresentativeSampler {
 
   SamplingStats get_statistics(int num_rep_points) const {
     SamplingStats stats;
-    stats.original_vertices = polygon_.vertices.size();
+    stats.original_vertices = polygon_.size();
     stats.representative_points = num_rep_points;
     stats.representative_edges = 0;
 
-    for (const auto& seg : polygon_.segments) {
-      if (seg.length() > r_) {
+    for (size_t e = 0; e < polygon_.num_edges(); ++e) {
+      if (polygon_.edge_length(e) > r_) {
         stats.representative_edges++;
       }
     }
@@ -94,31 +104,24 @@ class RepresentativeSampler {
   }
 
  private:
-  const Polygon& polygon_;
+  PolygonView polygon_;
   double r_;
 
   // Calculate average edge length
   double calculate_average_edge_length() const {
-    if (polygon_.segments.empty()) return 0.0;
-
-    double total_length = 0.0;
-    for (const auto& seg : polygon_.segments) {
-      total_length += seg.length();
-    }
-
-    return total_length / polygon_.segments.size();
+    return polygon_.average_edge_length();
   }
 
   // Calculate distance along boundary from vertex i to vertex j
   double distance_along_boundary(int start_idx, int end_idx) const {
     double dist = 0.0;
-    int n = polygon_.vertices.size();
+    int n = polygon_.size();
 
     int current = start_idx;
     while (current != end_idx) {
       int next = (current + 1) % n;
-      dist += euclidean_distance(polygon_.vertices[current],
-                                polygon_.vertices[next]);
+      dist += euclidean_distance(polygon_.vertex(current),
+                                polygon_.vertex(next));
       current = next;
 
       // Safety check
@@ -130,7 +133,7 @@ class RepresentativeSampler {
 
   // Find next representative point using greedy algorithm
   int find_next_representative(int current_idx) const {
-    int n = polygon_.vertices.size();
+    int n = polygon_.size();
     int max_dist_idx = (current_idx + 1) % n;
     double max_dist = 0.0;
 
@@ -151,13 +154,14 @@ class RepresentativeSampler {
   }
 
   // Select representative points using greedy algorithm
-  std::vector<int> select_representative_points() const {
-    std::vector<int> representatives;
+  std::pmr::vector<int> select_representative_points(
+      std::pmr::memory_resource* resource) const {
+    std::pmr::vector<int> representatives(resource);
 
-    if (polygon_.vertices.empty()) return representatives;
+    if (polygon_.empty()) return representatives;
 
-    int n = polygon_.vertices.size();
-    std::vector<bool> covered(n, false);
+    int n = polygon_.size();
+    std::pmr::vector<bool> covered(n, false, resource);
 
     int current = 0;
     representatives.push_back(current);
@@ -207,35 +211,42 @@ class RepresentativeSampler {
 
 // Main sampling function
 inline void sample_representatives(
-    const Polygon& polygon,
+    const PolygonView& polygon,
     double sampling_radius,
-    std::vector<RepresentativePoint>& rep_points,
-    std::vector<RepresentativeEdge>& rep_edges) {
+    RepresentativePoints& rep_points,
+    RepresentativeEdges& rep_edges) {
 
   RepresentativeSampler sampler(polygon, sampling_radius);
   sampler.sample(rep_points, rep_edges);
 }
 
-// Calculate optimal sampling radius (r = 4 * average_edge_length)
-inline double calculate_sampling_radius(const Polygon& polygon,
-                                        double multiplier = 4.0) {
-  if (polygon.segments.empty()) return 0.0;
+// Same, into std::vectors: sampled on the default resource and moved out
+inline void sample_representatives(
+    const PolygonView& polygon,
+    double sampling_radius,
+    std::vector<RepresentativePoint>& rep_points,
+    std::vector<RepresentativeEdge>& rep_edges) {
 
-  double total_length = 0.0;
-  for (const auto& seg : polygon.segments) {
-    total_length += seg.length();
-  }
+  RepresentativePoints points;
+  RepresentativeEdges edges;
+  sample_representatives(polygon, sampling_radius, points, edges);
+  std::move(points.begin(), points.end(), std::back_inserter(rep_points));
+  std::move(edges.begin(), edges.end(), std::back_inserter(rep_edges));
+}
 
-  double avg_length = total_length / polygon.segments.size();
-  return multiplier * avg_length;
+// Calculate optimal sampling radius (r = 4 * average_edge_length)
+inline double calculate_sampling_radius(const PolygonView& polygon,
+                                        double multiplier = 4.0) {
+  if (polygon.num_edges() == 0) return 0.0;
+  return multiplier * polygon.average_edge_length();
 }
 
 // Sample representatives for all polygons
 inline void sample_all_polygons(
-    const std::vector<Polygon>& polygons,
+    const PolygonSource& polygons,
     double multiplier,
-    std::vector<std::vector<RepresentativePoint>>& all_rep_points,
-    std::vector<std::vector<RepresentativeEdge>>& all_rep_edges) {
+    std::vector<RepresentativePoints>& all_rep_points,
+    std::vector<RepresentativeEdges>& all_rep_edges) {
 
   all_rep_points.resize(polygons.size());
   all_rep_edges.resize(polygons.size());
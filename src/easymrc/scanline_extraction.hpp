@@ -0,0 +1,224 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "types.hpp"
+#include "bit_image.hpp"
+#include "component_labeling.hpp"
+#include "topology.hpp"
+
+namespace easymrc {
+
+// Polygon extraction from horizontal runs.
+//
+// ComponentLabeling reduces the mask to runs of set pixels grouped into
+// 4-connected components; each component's boundary is then assembled
+// from its run sides and the parts of its run tops/bottoms not covered by
+// the neighbouring row. The work is proportional to the number of runs
+// rather than pixels: rows are scanned a 64-bit word at a time and each
+// run is visited a constant number of times.
+//
+// Components are traced independently on the thread pool and polygon i is
+// component i, numbered in raster order of its lowest-leftmost pixel
+// (bottom row first), so the result does not depend on the number of
+// threads. Each polygon is the outer boundary of its component,
+// counter-clockwise from its bottom-left corner; holes are not represented.
+class ScanlineExtractor {
+ public:
+  struct Statistics {
+    size_t runs;
+    size_t components;
+    size_t edges;
+    int bands;
+
+    Statistics() : runs(0), components(0), edges(0), bands(0) {}
+  };
+
+  // num_threads = 0: one per usable CPU
+  explicit ScanlineExtractor(const BitImage& mask, int num_threads = 0)
+      : mask_(mask), num_threads_(num_threads) {
+    if (num_threads_ <= 0) num_threads_ = cpu_topology().effective_cpus();
+  }
+
+  std::vector<Polygon> extract() {
+    ComponentLabeling labeling(mask_, num_threads_);
+    const size_t num_components = labeling.num_components();
+
+    stats_ = Statistics();
+    stats_.runs = labeling.num_runs();
+    stats_.components = num_components;
+    stats_.bands = labeling.bands();
+
+    std::vector<Polygon> polygons(num_components);
+    std::atomic<size_t> num_edges(0);
+    const size_t chunk = 64;
+    size_t num_chunks = (num_components + chunk - 1) / chunk;
+    labeling_detail::parallel_for(num_threads_, num_chunks, [&](size_t k) {
+      Workspace work;
+      size_t end = std::min(num_components, (k + 1) * chunk);
+      for (size_t c = k * chunk; c < end; ++c) {
+        polygons[c] = trace_outline(static_cast<int>(c),
+                                    labeling.component_begin(c),
+                                    labeling.component_end(c), work);
+        num_edges += work.edges.size();
+      }
+    });
+    stats_.edges = num_edges;
+    return polygons;
+  }
+
+  const Statistics& statistics() const { return stats_; }
+
+  // Outline of one component given its runs in raster order
+  static Polygon trace_component(int id, const PixelRun* begin,
+                                 const PixelRun* end) {
+    Workspace work;
+    return trace_outline(id, begin, end, work);
+  }
+
+ private:
+  // Directed boundary edge with the component on its left
+  struct Edge {
+    uint64_t from, to;  // Vertex keys
+  };
+
+  // Buffers reused across the components traced by one task
+  struct Workspace {
+    std::vector<Edge> edges;
+    std::vector<const PixelRun*> rows;  // First run of each row
+  };
+
+  const BitImage& mask_;
+  int num_threads_;
+  Statistics stats_;
+
+  static uint64_t vertex_key(int x, int y) {
+    return (static_cast<uint64_t>(y) << 32) | static_cast<uint32_t>(x);
+  }
+
+  static int key_x(uint64_t key) { return static_cast<int>(key & 0xffffffffu); }
+  static int key_y(uint64_t key) { return static_cast<int>(key >> 32); }
+
+  // Call piece(x0, x1) for the parts of run not covered by [cover,
+  // cover_end). Runs of a row are passed left to right, so cover is advanced
+  // past the runs that end before this one for the next call.
+  template <typename Piece>
+  static void uncovered(const PixelRun& run, const PixelRun*& cover,
+                        const PixelRun* cover_end, Piece&& piece) {
+    while (cover < cover_end && cover->x1 <= run.x0) cover++;
+    int cursor = run.x0;
+    for (const PixelRun* c = cover; c < cover_end && c->x0 < run.x1; ++c) {
+      if (c->x0 > cursor) piece(cursor, c->x0);
+      cursor = std::max(cursor, c->x1);
+    }
+    if (cursor < run.x1) piece(cursor, run.x1);
+  }
+
+  // Boundary edges of one component: both sides of every run, plus the
+  // parts of each run's bottom (top) not covered by the row below (above).
+  // Runs of other components never overlap, so only the component's own
+  // runs need to be consulted.
+  static void component_edges(const PixelRun* begin, const PixelRun* end,
+                              Workspace& work) {
+    work.edges.clear();
+    work.rows.clear();
+    for (const PixelRun* run = begin; run < end; ++run) {
+      if (run == begin || run->y != run[-1].y) work.rows.push_back(run);
+    }
+    work.rows.push_back(end);
+
+    const size_t num_rows = work.rows.size() - 1;
+    for (size_t r = 0; r < num_rows; ++r) {
+      const PixelRun* row = work.rows[r];
+      const PixelRun* row_end = work.rows[r + 1];
+      const int y = row->y;
+      // Runs of the adjacent rows (empty ranges if those rows have none)
+      const PixelRun* below = row;
+      const PixelRun* below_end = row;
+      if (r > 0 && work.rows[r - 1]->y == y - 1) below = work.rows[r - 1];
+      const PixelRun* above = row_end;
+      const PixelRun* above_end = row_end;
+      if (r + 1 < num_rows && row_end->y == y + 1) {
+        above_end = work.rows[r + 2];
+      }
+
+      for (const PixelRun* run = row; run < row_end; ++run) {
+        work.edges.push_back({vertex_key(run->x0, y + 1),
+                              vertex_key(run->x0, y)});  // Left side
+        work.edges.push_back({vertex_key(run->x1, y),
+                              vertex_key(run->x1, y + 1)});  // Right side
+        uncovered(*run, below, below_end, [&](int x0, int x1) {
+          work.edges.push_back({vertex_key(x0, y), vertex_key(x1, y)});
+        });
+        uncovered(*run, above, above_end, [&](int x0, int x1) {
+          work.edges.push_back({vertex_key(x1, y + 1), vertex_key(x0, y + 1)});
+        });
+      }
+    }
+  }
+
+  // Follow the outer boundary of a component from its lowest-leftmost
+  // corner, which only the outer boundary can pass through. Where two
+  // pixels of the component touch only at a corner, the walk turns left to
+  // stay on the current pixel, as they are not 4-connected.
+  static Polygon trace_outline(int id, const PixelRun* begin,
+                               const PixelRun* end, Workspace& work) {
+    component_edges(begin, end, work);
+    Edge* edges = work.edges.data();
+    Edge* edges_end = edges + work.edges.size();
+    auto by_from = [](const Edge& a, const Edge& b) { return a.from < b.from; };
+    std::sort(edges, edges_end, by_from);
+
+    auto outgoing = [edges, edges_end, &by_from](uint64_t vertex) {
+      return std::equal_range(edges, edges_end, Edge{vertex, 0}, by_from);
+    };
+    auto direction = [](const Edge& e, int& dx, int& dy) {
+      dx = (key_x(e.to) > key_x(e.from)) - (key_x(e.to) < key_x(e.from));
+      dy = (key_y(e.to) > key_y(e.from)) - (key_y(e.to) < key_y(e.from));
+    };
+
+    uint64_t start = vertex_key(begin->x0, begin->y);
+    Polygon poly(id);
+    poly.vertices.emplace_back(begin->x0, begin->y);
+
+    const Edge* edge = outgoing(start).first;
+    size_t steps = 0, limit = work.edges.size();
+    while (edge->to != start) {
+      auto range = outgoing(edge->to);
+      if (range.first == range.second || ++steps > limit) {
+        throw std::runtime_error("Unclosed polygon boundary");
+      }
+
+      int dx, dy;
+      direction(*edge, dx, dy);
+      const Edge* next = range.first;
+      for (const Edge* e = range.first; e != range.second; ++e) {
+        int ex, ey;
+        direction(*e, ex, ey);
+        if (dx * ey - dy * ex > 0) next = e;  // Left turn
+      }
+
+      int nx, ny;
+      direction(*next, nx, ny);
+      if (nx != dx || ny != dy) {
+        poly.vertices.emplace_back(key_x(edge->to), key_y(edge->to));
+      }
+      edge = next;
+    }
+
+    poly.build_segments();
+    return poly;
+  }
+};
+
+// Main function: polygons of a thresholded mask
+inline std::vector<Polygon> extract_polygons(const BitImage& mask,
+                                             int num_threads = 0) {
+  ScanlineExtractor extractor(mask, num_threads);
+  return extractor.extract();
+}
+
+}  // namespace easymrc
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include "types.hpp"
+#include "layout_store.hpp"
+#include "sampling.hpp"
+
+namespace easymrc {
+
+// Per-polygon quantities the cost model needs. Cheap to compute (one pass
+// over the edges) compared to the sampling and sweeps they predict.
+struct PolygonCostInfo {
+  int num_vertices;
+  int num_long_edges;  // Edges longer than the polygon's own radius
+  double perimeter;
+  double sampling_radius;
+
+  PolygonCostInfo()
+      : num_vertices(0), num_long_edges(0),
+        perimeter(0.0), sampling_radius(0.0) {}
+};
+
+inline PolygonCostInfo compute_polygon_cost_info(const PolygonView& poly,
+                                                 double multiplier) {
+  PolygonCostInfo info;
+  info.num_vertices = poly.size();
+  const size_t num_edges = poly.num_edges();
+  if (num_edges == 0) return info;
+
+  info.perimeter = poly.perimeter();
+  info.sampling_radius = multiplier * info.perimeter / num_edges;
+
+  for (size_t i = 0; i < num_edges; ++i) {
+    if (poly.edge_length(i) > info.sampling_radius) info.num_long_edges++;
+  }
+
+  return info;
+}
+
+// Per-polygon sampling data for one radius multiplier: the sampling radius
+// as calculate_sampling_radius() returns it and the cost model inputs. The
+// table only points at the arrays, which may live in a mapped file (see
+// RuleArtifacts).
+struct SamplingTable {
+  const double* radius;
+  const PolygonCostInfo* info;
+  size_t size;
+
+  SamplingTable() : radius(nullptr), info(nullptr), size(0) {}
+  SamplingTable(const double* r, const PolygonCostInfo* i, size_t n)
+      : radius(r), info(i), size(n) {}
+};
+
+// Sampling radius and cost model inputs of polygon i for multiplier, read
+// from sampling when a run has the table (see RuleArtifacts), otherwise
+// computed
+inline double polygon_sampling_radius(const PolygonSource& polygons,
+                                      size_t i, double multiplier,
+                                      const SamplingTable* sampling) {
+  if (sampling) return sampling->radius[i];
+  return calculate_sampling_radius(polygons[i], multiplier);
+}
+
+inline PolygonCostInfo polygon_cost_info(const PolygonSource& polygons,
+                                         size_t i, double multiplier,
+                                         const SamplingTable* sampling) {
+  if (sampling) return sampling->info[i];
+  return compute_polygon_cost_info(polygons[i], multiplier);
+}
+
+// Expected number of representative points for radius r. The greedy
+// selection advances at most r along the boundary per representative.
+inline double estimate_representative_count(const PolygonCostInfo& info,
+                                            double r) {
+  if (info.num_vertices == 0) return 0.0;
+  if (r <= 0.0) return info.num_vertices;
+  return std::max(1.0, std::min<double>(info.num_vertices,
+                                        info.perimeter / r));
+}
+
+// Expected number of shielded vertices per representative (vertices within
+// r of it, i.e. roughly a 2r window of boundary).
+inline double estimate_shield_size(const PolygonCostInfo& info, double r) {
+  if (info.num_vertices == 0) return 0.0;
+  if (info.perimeter <= 0.0) return info.num_vertices;
+  double fraction = std::min(1.0, 2.0 * r / info.perimeter);
+  return 1.0 + fraction * info.num_vertices;
+}
+
+// Sampling walks the boundary window of every vertex for each
+// representative and then scans all vertices/segments for its shield.
+inline double estimate_sampling_cost(const PolygonCostInfo& info, double r) {
+  double reps = estimate_representative_count(info, r);
+  double shield = estimate_shield_size(info, r);
+  double n = info.num_vertices;
+  return reps * n * (shield + 2.0) + info.num_long_edges * n;
+}
+
+// Cost of one candidate pair: sampling both polygons with r = max(r1, r2),
+// the type (a) sweep (whose deletions scan the whole active set) and the
+// shield-by-shield comparisons between nearby representatives.
+inline double estimate_pair_cost(const PolygonCostInfo& a,
+                                 const PolygonCostInfo& b) {
+  double r = std::max(a.sampling_radius, b.sampling_radius);
+  double reps_a = estimate_representative_count(a, r);
+  double reps_b = estimate_representative_count(b, r);
+  double shield_a = estimate_shield_size(a, r);
+  double shield_b = estimate_shield_size(b, r);
+
+  double total_reps = reps_a + reps_b;
+  return 1.0 + estimate_sampling_cost(a, r) + estimate_sampling_cost(b, r) +
+         total_reps * total_reps +
+         std::min(reps_a, reps_b) * shield_a * shield_b;
+}
+
+// Cost of the width check of one polygon: sampling plus the all-pairs
+// comparison of its representative edges.
+inline double estimate_polygon_cost(const PolygonCostInfo& info) {
+  double edges = info.num_long_edges;
+  return 1.0 + estimate_sampling_cost(info, info.sampling_radius) +
+         edges * edges;
+}
+
+inline double total_cost(const std::vector<double>& costs) {
+  return std::accumulate(costs.begin(), costs.end(), 0.0);
+}
+
+// Longest-first dynamic schedule. Tasks are ordered by decreasing estimated
+// cost and cut into chunks of roughly equal total cost, so expensive tasks
+// are handed out one at a time at the start and cheap ones are batched at
+// the end. Workers claim chunks with an atomic counter.
+class CostSchedule {
+ public:
+  CostSchedule(const std::vector<double>& costs, int num_workers,
+               int chunks_per_worker = 8)
+      : next_chunk_(0) {
+
+    order_.resize(costs.size());
+    std::iota(order_.begin(), order_.end(), 0);
+    std::stable_sort(order_.begin(), order_.end(),
+                     [&costs](size_t a, size_t b) {
+                       return costs[a] > costs[b];
+                     });
+
+    int target_chunks = std::max(1, num_workers * chunks_per_worker);
+    double target = total_cost(costs) / target_chunks;
+
+    chunk_starts_.push_back(0);
+    double accumulated = 0.0;
+    for (size_t k = 0; k < order_.size(); ++k) {
+      accumulated += costs[order_[k]];
+      if (accumulated >= target && k + 1 < order_.size()) {
+        chunk_starts_.push_back(k + 1);
+        accumulated = 0.0;
+      }
+    }
+    chunk_starts_.push_back(order_.size());
+  }
+
+  // Task indices, most expensive first
+  const std::vector<size_t>& order() const { return order_; }
+
+  size_t num_chunks() const { return chunk_starts_.size() - 1; }
+
+  // Claim the next chunk as a [begin, end) range into order().
+  // Returns false once all chunks have been handed out.
+  bool next(size_t& begin, size_t& end) {
+    size_t chunk = next_chunk_.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= num_chunks()) return false;
+    begin = chunk_starts_[chunk];
+    end = chunk_starts_[chunk + 1];
+    return true;
+  }
+
+ private:
+  std::vector<size_t> order_;
+  std::vector<size_t> chunk_starts_;
+  std::atomic<size_t> next_chunk_;
+};
+
+// Estimated cost of the tasks in [begin, end) of the schedule order
+inline double chunk_cost(const CostSchedule& schedule,
+                         const std::vector<double>& costs, size_t begin,
+                         size_t end) {
+  double cost = 0.0;
+  for (size_t k = begin; k < end; ++k) cost += costs[schedule.order()[k]];
+  return cost;
+}
+
+// Milliseconds elapsed since start
+inline double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// Per-worker busy time of one parallel phase
+struct LoadStats {
+  std::vector<double> busy_ms;      // Time spent processing tasks
+  std::vector<size_t> tasks_done;   // Number of tasks processed
+  double wall_ms;
+
+  LoadStats() : wall_ms(0.0) {}
+
+  void reset(int num_workers) {
+    busy_ms.assign(num_workers, 0.0);
+    tasks_done.assign(num_workers, 0);
+    wall_ms = 0.0;
+  }
+
+  double max_busy_ms() const {
+    if (busy_ms.empty()) return 0.0;
+    return *std::max_element(busy_ms.begin(), busy_ms.end());
+  }
+
+  double mean_busy_ms() const {
+    if (busy_ms.empty()) return 0.0;
+    return std::accumulate(busy_ms.begin(), busy_ms.end(), 0.0) /
+           busy_ms.size();
+  }
+
+  // max / mean busy time; 1.0 is a perfectly balanced phase
+  double imbalance() const {
+    double mean = mean_busy_ms();
+    return mean > 0.0 ? max_busy_ms() / mean : 1.0;
+  }
+};
+
+}  // namespace easymrc
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include "easymrc.hpp"
+#include "tiling.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace easymrc {
+
+// Reads horizontal bands of a binary (P5) PGM file with pread, so only one
+// band of pixels is in memory at a time
+class PgmBandReader {
+ public:
+  explicit PgmBandReader(const std::string& filename)
+      : filename_(filename), fd_(::open(filename.c_str(), O_RDONLY | O_CLOEXEC)) {
+    if (fd_ < 0) {
+      throw std::runtime_error("Cannot open file: " + filename + " (" +
+                               std::strerror(errno) + ")");
+    }
+    try {
+      read_header();
+    } catch (...) {
+      ::close(fd_);
+      throw;
+    }
+  }
+
+  ~PgmBandReader() { ::close(fd_); }
+
+  PgmBandReader(const PgmBandReader&) = delete;
+  PgmBandReader& operator=(const PgmBandReader&) = delete;
+
+  int width() const { return header_.width; }
+  int height() const { return header_.height; }
+
+  // Read rows [y0, y0 + rows) (y up, as in Image) into band, whose pixel
+  // buffer is reused between calls. The rows are contiguous in the file,
+  // top row first, and are addressed bottom-up through a negative stride.
+  void read(int y0, int rows, Image& band) const {
+    const size_t width = header_.width;
+    band.width = header_.width;
+    band.height = rows;
+    band.storage.reset();
+    band.data.resize(width * rows);
+    band.origin = static_cast<std::ptrdiff_t>((rows - 1) * width);
+    band.stride = -static_cast<std::ptrdiff_t>(width);
+
+    size_t first_file_row = header_.height - (y0 + rows);
+    off_t offset = static_cast<off_t>(header_.data_offset +
+                                      first_file_row * width);
+    size_t size = band.data.size();
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = ::pread(fd_, band.data.data() + done, size - done,
+                          offset + static_cast<off_t>(done));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        throw std::runtime_error("Truncated PGM pixel data: " + filename_);
+      }
+      done += n;
+    }
+  }
+
+ private:
+  std::string filename_;
+  int fd_;
+  pgm_detail::PgmHeader header_;
+
+  void read_header() {
+    // Headers are short, but comments may make them arbitrarily long
+    std::vector<unsigned char> buffer;
+    for (size_t size = 4096;; size *= 4) {
+      buffer.resize(size);
+      ssize_t n = ::pread(fd_, buffer.data(), size, 0);
+      if (n < 0) {
+        throw std::runtime_error("Cannot read file: " + filename_);
+      }
+      try {
+        header_ = pgm_detail::parse_pgm_header(buffer.data(), n, filename_);
+        break;
+      } catch (const std::runtime_error&) {
+        if (static_cast<size_t>(n) < size) throw;  // Whole file seen
+      }
+    }
+    if (!header_.binary) {
+      throw std::runtime_error("Streaming requires a binary (P5) PGM: " +
+                               filename_);
+    }
+    if (header_.max_val > 255) {
+      throw std::runtime_error("16-bit PGM is not supported: " + filename_);
+    }
+  }
+};
+
+// Connected-component labelling of a mask fed one row at a time, bottom
+// row first. Only the components still open on the last row are kept
+// (their runs are the carry-over into the next band); a component is
+// complete as soon as a row adds no run to it.
+class StreamingLabeler {
+ public:
+  StreamingLabeler() : prev_y_(INT_MIN), open_runs_(0) {}
+
+  // Add mask row `row` as image row y. Components that ended on the
+  // previous row are appended to completed as their runs, unordered.
+  void add_row(const BitImage& mask, int row, int y,
+               std::vector<std::vector<PixelRun>>& completed) {
+    cur_.clear();
+    append_row_runs(mask, row, y, cur_);
+    cur_label_.assign(cur_.size(), -1);
+
+    // Join with the overlapping runs of the previous row
+    if (prev_y_ == y - 1) {
+      size_t i = 0, j = 0;
+      while (i < prev_.size() && j < cur_.size()) {
+        if (prev_[i].x0 < cur_[j].x1 && cur_[j].x0 < prev_[i].x1) {
+          int label = find(prev_label_[i]);
+          cur_label_[j] = cur_label_[j] < 0 ? label
+                                            : unite(cur_label_[j], label);
+        }
+        if (prev_[i].x1 < cur_[j].x1) {
+          i++;
+        } else {
+          j++;
+        }
+      }
+    }
+
+    for (size_t j = 0; j < cur_.size(); ++j) {
+      int label = cur_label_[j] < 0 ? allocate(y) : find(cur_label_[j]);
+      cur_label_[j] = label;
+      components_[label].runs.push_back(cur_[j]);
+      components_[label].last_y = y;
+      open_runs_++;
+    }
+
+    close_untouched(y, completed);
+
+    // Absorbed components are no longer referenced by any label
+    free_.insert(free_.end(), merged_.begin(), merged_.end());
+    merged_.clear();
+
+    std::swap(prev_, cur_);
+    std::swap(prev_label_, cur_label_);
+    prev_y_ = y;
+  }
+
+  // Complete every open component (after the last row)
+  void finish(std::vector<std::vector<PixelRun>>& completed) {
+    close_untouched(INT_MIN, completed);
+    prev_.clear();
+    prev_label_.clear();
+    prev_y_ = INT_MIN;
+  }
+
+  // Lowest row of any open component (INT_MAX if none): every polygon
+  // still to come starts at this row or above
+  int open_min_y() const {
+    int min_y = INT_MAX;
+    for (int label : prev_label_) {
+      min_y = std::min(min_y, components_[label].min_y);
+    }
+    return min_y;
+  }
+
+  size_t open_runs() const { return open_runs_; }
+
+ private:
+  struct Component {
+    std::vector<PixelRun> runs;
+    int min_y;
+    int last_y;  // Last row that added a run
+  };
+
+  std::vector<Component> components_;
+  std::vector<int> parent_;
+  std::vector<int> free_;
+  std::vector<int> merged_;
+  std::vector<PixelRun> prev_, cur_;
+  std::vector<int> prev_label_, cur_label_;
+  int prev_y_;
+  size_t open_runs_;
+
+  int allocate(int y) {
+    int label;
+    if (!free_.empty()) {
+      label = free_.back();
+      free_.pop_back();
+    } else {
+      label = static_cast<int>(components_.size());
+      components_.emplace_back();
+      parent_.push_back(label);
+    }
+    parent_[label] = label;
+    components_[label].runs.clear();
+    components_[label].min_y = y;
+    components_[label].last_y = INT_MIN;
+    return label;
+  }
+
+  int find(int label) {
+    while (parent_[label] != label) {
+      parent_[label] = parent_[parent_[label]];
+      label = parent_[label];
+    }
+    return label;
+  }
+
+  // Merge the smaller run list into the larger; returns the new root
+  int unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return a;
+    if (components_[a].runs.size() < components_[b].runs.size()) {
+      std::swap(a, b);
+    }
+    auto& runs = components_[a].runs;
+    runs.insert(runs.end(), components_[b].runs.begin(),
+                components_[b].runs.end());
+    std::vector<PixelRun>().swap(components_[b].runs);
+    components_[a].min_y = std::min(components_[a].min_y,
+                                    components_[b].min_y);
+    parent_[b] = a;
+    merged_.push_back(b);
+    return a;
+  }
+
+  // Complete the components of the previous row that row y did not reach
+  void close_untouched(int y,
+                       std::vector<std::vector<PixelRun>>& completed) {
+    for (int label : prev_label_) {
+      int root = find(label);
+      Component& component = components_[root];
+      if (component.last_y == y || component.last_y == INT_MAX) continue;
+      open_runs_ -= component.runs.size();
+      completed.push_back(std::move(component.runs));
+      component.runs.clear();
+      component.last_y = INT_MAX;  // Completed, freed below
+    }
+    for (int label : prev_label_) {
+      int root = find(label);
+      if (components_[root].last_y == INT_MAX) {
+        components_[root].last_y = INT_MIN;
+        free_.push_back(root);
+      }
+    }
+  }
+};
+
+// Out-of-core MRC of a binary PGM mask.
+//
+// The image is read in horizontal bands, bottom band first. Each band is
+// thresholded and its rows are fed to a StreamingLabeler; components that
+// are complete are traced, numbered in completion order, width-checked,
+// and passed to an IncrementalPairSweep whose new candidate pairs are
+// space-checked right away. Polygons are dropped once no later polygon
+// can come within the rule distance, so peak memory is one band of pixels
+// plus the open components and the polygons within reach of the band, not
+// the whole image.
+class StreamingRunner {
+ public:
+  struct Options {
+    int band_rows;  // Rows read and thresholded at a time
+
+    Options() : band_rows(1024) {}
+  };
+
+  struct Statistics {
+    int bands;
+    size_t polygons;
+    size_t candidate_pairs;
+    size_t band_bytes;            // 8-bit band buffer plus its bit mask
+    size_t max_open_runs;         // Carry-over between bands
+    size_t max_retained_polygons; // Polygons kept for later pairs
+
+    Statistics()
+        : bands(0), polygons(0), candidate_pairs(0), band_bytes(0),
+          max_open_runs(0), max_retained_polygons(0) {}
+  };
+
+  StreamingRunner(const EasyMRC::Config& config,
+                  const Options& options = Options())
+      : config_(config), options_(options) {}
+
+  // Called with every polygon once it is complete, in id order
+  void set_polygon_callback(std::function<void(const Polygon&)> callback) {
+    on_polygon_ = std::move(callback);
+  }
+
+  EasyMRC::Results run(const std::string& pgm_file) {
+    stats_ = Statistics();
+    PgmBandReader reader(pgm_file);
+    const int height = reader.height();
+    const int band_rows = std::max(1, options_.band_rows);
+    int num_threads = config_.num_threads > 0
+                          ? config_.num_threads
+                          : cpu_topology().effective_cpus();
+
+    EasyMRC::Config width_config = config_;
+    width_config.enable_space_check = false;
+    EasyMRC::Config space_config = config_;
+    space_config.enable_width_check = false;
+
+    EasyMRC::Results results;
+    StreamingLabeler labeler;
+    IncrementalPairSweep sweep(config_.rule_distance_R);
+    std::unordered_map<int, Polygon> retained;
+    std::vector<std::vector<PixelRun>> completed;
+    std::vector<std::pair<int, int>> pairs;
+    std::vector<int> retired;
+    Image band;
+
+    for (int y0 = 0; y0 < height; y0 += band_rows) {
+      int rows = std::min(band_rows, height - y0);
+      reader.read(y0, rows, band);
+      BitImage bits = BitImage::threshold(band, 255, num_threads);
+      stats_.bands++;
+      stats_.band_bytes = std::max(stats_.band_bytes,
+                                   band.data.size() + bits.bytes());
+
+      completed.clear();
+      for (int row = 0; row < rows; ++row) {
+        labeler.add_row(bits, row, y0 + row, completed);
+      }
+      if (y0 + rows == height) labeler.finish(completed);
+      stats_.max_open_runs = std::max(stats_.max_open_runs,
+                                      labeler.open_runs());
+
+      // Trace the completed components on all threads
+      std::vector<Polygon> batch(completed.size());
+      int first_id = sweep.next_id();
+      labeling_detail::parallel_for(num_threads, completed.size(),
+                                    [&](size_t i) {
+        auto& runs = completed[i];
+        std::sort(runs.begin(), runs.end(),
+                  [](const PixelRun& a, const PixelRun& b) {
+                    return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+                  });
+        batch[i] = ScanlineExtractor::trace_component(
+            first_id + static_cast<int>(i), runs.data(),
+            runs.data() + runs.size());
+        std::vector<PixelRun>().swap(runs);
+      });
+
+      pairs.clear();
+      sweep.add(batch, pairs);
+      stats_.polygons += batch.size();
+      stats_.candidate_pairs += pairs.size();
+
+      if (config_.enable_width_check && !batch.empty()) {
+        append(results, EasyMRC(width_config).run(batch));
+      }
+      for (auto& poly : batch) {
+        if (on_polygon_) on_polygon_(poly);
+        int id = poly.id;
+        retained.emplace(id, std::move(poly));
+      }
+      if (config_.enable_space_check && !pairs.empty()) {
+        check_pairs(space_config, retained, pairs, results);
+      }
+
+      // Nothing still to come starts below the open components or the
+      // next band
+      retired.clear();
+      sweep.retire_below(std::min(labeler.open_min_y(), y0 + rows),
+                         &retired);
+      for (int id : retired) retained.erase(id);
+      stats_.max_retained_polygons = std::max(stats_.max_retained_polygons,
+                                              retained.size() +
+                                                  retired.size());
+    }
+
+    sort_results(results);
+    return results;
+  }
+
+  const Statistics& statistics() const { return stats_; }
+
+ private:
+  EasyMRC::Config config_;
+  Options options_;
+  Statistics stats_;
+  std::function<void(const Polygon&)> on_polygon_;
+
+  static void append(EasyMRC::Results& results, EasyMRC::Results&& part) {
+    auto move_into = [](auto& to, auto& from) {
+      to.insert(to.end(), std::make_move_iterator(from.begin()),
+                std::make_move_iterator(from.end()));
+    };
+    move_into(results.space_violations_type_a, part.space_violations_type_a);
+    move_into(results.space_violations_type_b, part.space_violations_type_b);
+    move_into(results.width_violations, part.width_violations);
+  }
+
+  // Space-check pairs of polygon ids, all of which are retained
+  static void check_pairs(const EasyMRC::Config& config,
+                          const std::unordered_map<int, Polygon>& retained,
+                          const std::vector<std::pair<int, int>>& pairs,
+                          EasyMRC::Results& results) {
+    std::vector<Polygon> polygons;
+    std::unordered_map<int, int> index;
+    auto local = [&](int id) {
+      auto inserted = index.emplace(id, static_cast<int>(polygons.size()));
+      if (inserted.second) polygons.push_back(retained.at(id));
+      return inserted.first->second;
+    };
+
+    std::vector<std::pair<int, int>> local_pairs;
+    local_pairs.reserve(pairs.size());
+    for (const auto& pair : pairs) {
+      int a = local(pair.first);
+      int b = local(pair.second);
+      local_pairs.emplace_back(a, b);
+    }
+    append(results, EasyMRC(config).run(polygons, local_pairs));
+  }
+};
+
+}  // namespace easymrc
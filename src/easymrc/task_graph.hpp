@@ -0,0 +1,165 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+#include "topology.hpp"
+
+namespace easymrc {
+
+// Small dependency graph executed by a fixed pool of worker threads.
+//
+// A node becomes ready once all of its dependencies are done. Parallel
+// nodes are entered repeatedly: each call of work(worker) processes one
+// chunk and returns false once there is nothing left to claim. After every
+// chunk the worker goes back to the scheduler, which hands it the ready
+// node added first, so nodes on the critical path should be added before
+// the filler work. A node is done when it has been drained and its last
+// active worker has returned.
+class TaskGraph {
+ public:
+  using NodeId = size_t;
+  using WorkFn = std::function<bool(int worker)>;
+
+  // Node whose work function is called concurrently by up to
+  // max_concurrency workers (0 = no limit)
+  NodeId add_parallel(const std::string& name, WorkFn work,
+                      const std::vector<NodeId>& deps = {},
+                      int max_concurrency = 0) {
+    Node node;
+    node.name = name;
+    node.work = std::move(work);
+    node.max_concurrency = max_concurrency;
+    node.deps = deps;
+    for (NodeId dep : deps) {
+      if (dep >= nodes_.size()) {
+        throw std::runtime_error("Task graph dependency of '" + name +
+                                 "' does not exist");
+      }
+    }
+    nodes_.push_back(std::move(node));
+    return nodes_.size() - 1;
+  }
+
+  // Node run once by a single worker
+  NodeId add_serial(const std::string& name, std::function<void()> fn,
+                    const std::vector<NodeId>& deps = {}) {
+    return add_parallel(name, [fn](int) { fn(); return false; }, deps, 1);
+  }
+
+  size_t size() const { return nodes_.size(); }
+  const std::string& name(NodeId id) const { return nodes_[id].name; }
+
+  // Execute the graph on num_workers threads (worker ids 0..num_workers-1)
+  // and block until every node is done. The first exception thrown by a
+  // node stops the graph and is rethrown here.
+  void run(int num_workers, AffinityPolicy affinity = AffinityPolicy::NONE) {
+    num_workers = std::max(1, num_workers);
+
+    for (auto& node : nodes_) {
+      node.pending = node.deps.size();
+      node.active = 0;
+      node.drained = false;
+      node.done = false;
+      node.dependents.clear();
+    }
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+      for (NodeId dep : nodes_[id].deps) {
+        nodes_[dep].dependents.push_back(id);
+      }
+    }
+    num_done_ = 0;
+    error_ = nullptr;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_workers; ++t) {
+      threads.emplace_back([this, t, affinity]() {
+        pin_worker(t, affinity);
+        worker_loop(t);
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (error_) std::rethrow_exception(error_);
+  }
+
+ private:
+  struct Node {
+    std::string name;
+    WorkFn work;
+    int max_concurrency;
+    std::vector<NodeId> deps;
+    std::vector<NodeId> dependents;
+    size_t pending;  // Dependencies not yet done
+    int active;      // Workers currently inside work()
+    bool drained;    // work() has reported that nothing is left
+    bool done;
+  };
+
+  std::vector<Node> nodes_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t num_done_;
+  std::exception_ptr error_;
+
+  bool runnable(const Node& node) const {
+    return node.pending == 0 && !node.drained &&
+           (node.max_concurrency <= 0 || node.active < node.max_concurrency);
+  }
+
+  void worker_loop(int worker) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (num_done_ < nodes_.size() && !error_) {
+      Node* node = nullptr;
+      for (auto& candidate : nodes_) {
+        if (runnable(candidate)) {
+          node = &candidate;
+          break;
+        }
+      }
+      if (!node) {
+        cv_.wait(lock);
+        continue;
+      }
+
+      node->active++;
+      lock.unlock();
+      bool more = false;
+      try {
+        more = node->work(worker);
+      } catch (...) {
+        lock.lock();
+        if (!error_) error_ = std::current_exception();
+        node->active--;
+        cv_.notify_all();
+        return;
+      }
+      lock.lock();
+      node->active--;
+
+      if (!more) node->drained = true;
+      if (node->drained && node->active == 0 && !node->done) {
+        node->done = true;
+        num_done_++;
+        for (NodeId dependent : node->dependents) {
+          nodes_[dependent].pending--;
+        }
+        cv_.notify_all();
+      } else if (more && node->max_concurrency > 0) {
+        cv_.notify_all();  // A concurrency slot has been freed
+      }
+    }
+
+    cv_.notify_all();
+  }
+};
+
+}  // namespace easymrc
@@ -0,0 +1,564 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <tuple>
+#include <type_traits>
+#include "easymrc.hpp"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+namespace easymrc {
+
+// Regular grid of tiles over the layout extent
+struct TileGrid {
+  double min_x, min_y;
+  double tile_width, tile_height;
+  int columns, rows;
+
+  TileGrid()
+      : min_x(0), min_y(0), tile_width(1), tile_height(1),
+        columns(1), rows(1) {}
+
+  int num_tiles() const { return columns * rows; }
+
+  // Tile containing (x, y); points outside the extent go to the nearest tile
+  int tile_index(double x, double y) const {
+    int col = (int)std::floor((x - min_x) / tile_width);
+    int row = (int)std::floor((y - min_y) / tile_height);
+    col = std::max(0, std::min(columns - 1, col));
+    row = std::max(0, std::min(rows - 1, row));
+    return row * columns + col;
+  }
+
+  BoundingBox tile_bounds(int tile) const {
+    int col = tile % columns;
+    int row = tile / columns;
+    return BoundingBox(min_x + col * tile_width, min_y + row * tile_height,
+                       min_x + (col + 1) * tile_width,
+                       min_y + (row + 1) * tile_height, tile);
+  }
+};
+
+// Union of the polygon bounding boxes
+inline BoundingBox layout_extent(const std::vector<Polygon>& polygons) {
+  BoundingBox extent;
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    BoundingBox bbox = compute_bounding_box(polygons[i]);
+    if (i == 0) {
+      extent = bbox;
+    } else {
+      extent.min_x = std::min(extent.min_x, bbox.min_x);
+      extent.min_y = std::min(extent.min_y, bbox.min_y);
+      extent.max_x = std::max(extent.max_x, bbox.max_x);
+      extent.max_y = std::max(extent.max_y, bbox.max_y);
+    }
+  }
+  extent.polygon_id = -1;
+  return extent;
+}
+
+// Split the extent into columns x rows tiles of whole-unit size
+inline TileGrid make_tile_grid(const BoundingBox& extent,
+                               int columns, int rows) {
+  if (columns < 1 || rows < 1) {
+    throw std::runtime_error("Tile grid needs at least one column and row");
+  }
+  TileGrid grid;
+  grid.min_x = extent.min_x;
+  grid.min_y = extent.min_y;
+  grid.columns = columns;
+  grid.rows = rows;
+  grid.tile_width =
+      std::max(1.0, std::ceil((extent.max_x - extent.min_x + 1) / columns));
+  grid.tile_height =
+      std::max(1.0, std::ceil((extent.max_y - extent.min_y + 1) / rows));
+  return grid;
+}
+
+// Ownership rules. Every candidate pair and every polygon's width check is
+// assigned to exactly one tile, so halo copies never produce duplicates.
+//
+// A pair belongs to the tile containing the min corner of the intersection
+// of the two R-expanded bounding boxes. That corner, clamped to the layout
+// extent, lies within R of both polygons, so both are loaded by the owner.
+inline int pair_owner(const TileGrid& grid, const BoundingBox& extent,
+                      const BoundingBox& expanded_1,
+                      const BoundingBox& expanded_2) {
+  double x = std::max(expanded_1.min_x, expanded_2.min_x);
+  double y = std::max(expanded_1.min_y, expanded_2.min_y);
+  x = std::max(extent.min_x, std::min(extent.max_x, x));
+  y = std::max(extent.min_y, std::min(extent.max_y, y));
+  return grid.tile_index(x, y);
+}
+
+// A polygon's width check belongs to the tile containing its bbox min corner
+inline int polygon_owner(const TileGrid& grid, const BoundingBox& bbox) {
+  return grid.tile_index(bbox.min_x, bbox.min_y);
+}
+
+// Canonical violation order, used when merging results from several
+// processes so that the output does not depend on the partitioning
+inline void sort_results(EasyMRC::Results& results) {
+  auto point_key = [](const Point& p) {
+    return std::make_tuple(p.x(), p.y());
+  };
+  auto segment_key = [&point_key](const Segment& s) {
+    return std::make_tuple(point_key(s.start), point_key(s.end));
+  };
+
+  std::sort(results.space_violations_type_a.begin(),
+            results.space_violations_type_a.end(),
+            [&](const Violation& a, const Violation& b) {
+              return std::make_tuple(a.polygon_id_1, a.polygon_id_2,
+                                     point_key(a.point1), point_key(a.point2),
+                                     a.distance) <
+                     std::make_tuple(b.polygon_id_1, b.polygon_id_2,
+                                     point_key(b.point1), point_key(b.point2),
+                                     b.distance);
+            });
+
+  std::sort(results.space_violations_type_b.begin(),
+            results.space_violations_type_b.end(),
+            [&](const ViolationTypeB& a, const ViolationTypeB& b) {
+              return std::make_tuple(a.polygon_id_1, a.polygon_id_2,
+                                     point_key(a.point), segment_key(a.edge),
+                                     a.distance) <
+                     std::make_tuple(b.polygon_id_1, b.polygon_id_2,
+                                     point_key(b.point), segment_key(b.edge),
+                                     b.distance);
+            });
+
+  std::sort(results.width_violations.begin(),
+            results.width_violations.end(),
+            [&](const WidthViolation& a, const WidthViolation& b) {
+              return std::make_tuple(a.polygon_id, segment_key(a.edge1),
+                                     segment_key(a.edge2), a.distance) <
+                     std::make_tuple(b.polygon_id, segment_key(b.edge1),
+                                     segment_key(b.edge2), b.distance);
+            });
+}
+
+namespace tiling_detail {
+
+const char kLayoutMagic[8] = {'E', 'M', 'R', 'C', 'P', 'O', 'L', 'Y'};
+
+template <typename T>
+void write_value(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read_value(std::ifstream& in, T& value) {
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+// Violations are plain structs; parent and children are the same binary
+template <typename T>
+void write_records(std::ofstream& out, const std::vector<T>& records) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "result records must be trivially copyable");
+  uint64_t count = records.size();
+  write_value(out, count);
+  out.write(reinterpret_cast<const char*>(records.data()),
+            count * sizeof(T));
+}
+
+template <typename T>
+void read_records(std::ifstream& in, std::vector<T>& records) {
+  uint64_t count = 0;
+  if (!read_value(in, count)) {
+    throw std::runtime_error("Truncated tile result file");
+  }
+  size_t base = records.size();
+  records.resize(base + count);
+  if (!in.read(reinterpret_cast<char*>(records.data() + base),
+               count * sizeof(T))) {
+    throw std::runtime_error("Truncated tile result file");
+  }
+}
+
+}  // namespace tiling_detail
+
+// Spill the polygons to a file that tile workers can filter without
+// loading it whole. Header: magic, polygon count, layout extent. Per
+// polygon: id, integer bbox, vertex count, vertices.
+inline void write_layout_spill(const std::vector<Polygon>& polygons,
+                               const std::string& filename) {
+  using namespace tiling_detail;
+  std::ofstream out(filename, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Cannot create layout spill file: " + filename);
+  }
+
+  BoundingBox extent = layout_extent(polygons);
+  int32_t extent_xy[4] = {(int32_t)extent.min_x, (int32_t)extent.min_y,
+                          (int32_t)extent.max_x, (int32_t)extent.max_y};
+  out.write(kLayoutMagic, sizeof(kLayoutMagic));
+  write_value(out, (uint64_t)polygons.size());
+  out.write(reinterpret_cast<const char*>(extent_xy), sizeof(extent_xy));
+
+  for (const auto& poly : polygons) {
+    BoundingBox bbox = compute_bounding_box(poly);
+    int32_t header[6] = {poly.id, (int32_t)bbox.min_x, (int32_t)bbox.min_y,
+                         (int32_t)bbox.max_x, (int32_t)bbox.max_y,
+                         (int32_t)poly.vertices.size()};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& v : poly.vertices) {
+      int32_t xy[2] = {v.x(), v.y()};
+      out.write(reinterpret_cast<const char*>(xy), sizeof(xy));
+    }
+  }
+
+  if (!out) {
+    throw std::runtime_error("Failed to write layout spill file: " + filename);
+  }
+}
+
+namespace tiling_detail {
+
+inline void read_spill_header(std::ifstream& in, const std::string& filename,
+                              uint64_t& count, BoundingBox& extent) {
+  char magic[sizeof(kLayoutMagic)];
+  int32_t extent_xy[4];
+  if (!in.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kLayoutMagic, sizeof(magic)) != 0 ||
+      !read_value(in, count) ||
+      !in.read(reinterpret_cast<char*>(extent_xy), sizeof(extent_xy))) {
+    throw std::runtime_error("Not a layout spill file: " + filename);
+  }
+  extent = BoundingBox(extent_xy[0], extent_xy[1], extent_xy[2],
+                       extent_xy[3]);
+}
+
+}  // namespace tiling_detail
+
+// Layout extent recorded in a spill file header
+inline BoundingBox read_layout_spill_extent(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::runtime_error("Cannot open layout spill file: " + filename);
+  }
+  uint64_t count = 0;
+  BoundingBox extent;
+  tiling_detail::read_spill_header(in, filename, count, extent);
+  return extent;
+}
+
+// Read the polygons whose bbox intersects region (all when region is null),
+// in file order. Vertices of other polygons are skipped, not read.
+inline std::vector<Polygon> read_layout_spill(const std::string& filename,
+                                              const BoundingBox* region) {
+  using namespace tiling_detail;
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::runtime_error("Cannot open layout spill file: " + filename);
+  }
+
+  uint64_t count = 0;
+  BoundingBox extent;
+  read_spill_header(in, filename, count, extent);
+
+  std::vector<Polygon> polygons;
+  for (uint64_t i = 0; i < count; ++i) {
+    int32_t header[6];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+      throw std::runtime_error("Truncated layout spill file: " + filename);
+    }
+    BoundingBox bbox(header[1], header[2], header[3], header[4], header[0]);
+    int32_t num_vertices = header[5];
+
+    if (region && !region->overlaps(bbox)) {
+      in.seekg((std::streamoff)num_vertices * 2 * sizeof(int32_t),
+               std::ios::cur);
+      continue;
+    }
+
+    Polygon poly(header[0]);
+    poly.vertices.reserve(num_vertices);
+    for (int32_t v = 0; v < num_vertices; ++v) {
+      int32_t xy[2];
+      if (!in.read(reinterpret_cast<char*>(xy), sizeof(xy))) {
+        throw std::runtime_error("Truncated layout spill file: " + filename);
+      }
+      poly.add_vertex(Point(xy[0], xy[1]));
+    }
+    poly.build_segments();
+    polygons.push_back(std::move(poly));
+  }
+
+  return polygons;
+}
+
+// Result file of one tile: the number of polygons the worker loaded,
+// then the type (a), type (b) and width violations
+inline void write_tile_results(const EasyMRC::Results& results,
+                               size_t polygons_loaded,
+                               const std::string& filename) {
+  std::ofstream out(filename, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Cannot create tile result file: " + filename);
+  }
+  tiling_detail::write_value(out, (uint64_t)polygons_loaded);
+  tiling_detail::write_records(out, results.space_violations_type_a);
+  tiling_detail::write_records(out, results.space_violations_type_b);
+  tiling_detail::write_records(out, results.width_violations);
+  if (!out) {
+    throw std::runtime_error("Failed to write tile result file: " + filename);
+  }
+}
+
+// Append the violations stored in filename to results. Returns the number
+// of polygons the worker loaded.
+inline size_t read_tile_results(const std::string& filename,
+                                EasyMRC::Results& results) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.is_open()) {
+    throw std::runtime_error("Cannot open tile result file: " + filename);
+  }
+  uint64_t polygons_loaded = 0;
+  if (!tiling_detail::read_value(in, polygons_loaded)) {
+    throw std::runtime_error("Truncated tile result file");
+  }
+  tiling_detail::read_records(in, results.space_violations_type_a);
+  tiling_detail::read_records(in, results.space_violations_type_b);
+  tiling_detail::read_records(in, results.width_violations);
+  return polygons_loaded;
+}
+
+// Multi-process tiled execution on one machine.
+//
+// The layout is spilled to a file and split into a grid of tiles. One
+// forked worker process per tile (at most `jobs` at a time) loads only
+// the polygons intersecting its tile plus an R-wide halo, checks the pairs
+// and polygons the tile owns and writes its violations to a result file.
+// The parent merges the files in canonical order; the result equals a
+// single-process run.
+class TiledRunner {
+ public:
+  struct Options {
+    int columns;
+    int rows;
+    int jobs;              // Concurrent worker processes, 0 = one per CPU
+    std::string work_dir;  // Spill and result files, empty = $TMPDIR
+
+    Options() : columns(2), rows(2), jobs(0) {}
+  };
+
+  struct Statistics {
+    int tiles;
+    int jobs;
+    size_t max_tile_polygons;  // Largest tile + halo polygon count
+  };
+
+  TiledRunner(const EasyMRC::Config& config, const Options& options)
+      : config_(config), options_(options) {}
+
+  EasyMRC::Results run(const std::vector<Polygon>& polygons) {
+    TempDir dir(options_.work_dir);
+    std::string layout_file = dir.path + "/layout.bin";
+    write_layout_spill(polygons, layout_file);
+    return run_spilled(layout_file, layout_extent(polygons), dir);
+  }
+
+  // Same, releasing the parent's copy of the layout once it is spilled so
+  // that only the workers hold polygons while the checks run
+  EasyMRC::Results run(std::vector<Polygon>&& polygons) {
+    TempDir dir(options_.work_dir);
+    std::string layout_file = dir.path + "/layout.bin";
+    write_layout_spill(polygons, layout_file);
+    BoundingBox extent = layout_extent(polygons);
+    std::vector<Polygon>().swap(polygons);
+    return run_spilled(layout_file, extent, dir);
+  }
+
+  // Check a layout already spilled with write_layout_spill()
+  EasyMRC::Results run(const std::string& layout_file) {
+    TempDir dir(options_.work_dir);
+    return run_spilled(layout_file, read_layout_spill_extent(layout_file),
+                       dir);
+  }
+
+  const Statistics& statistics() const { return stats_; }
+
+ private:
+  EasyMRC::Config config_;
+  Options options_;
+  Statistics stats_;
+
+  // Private directory for result files, removed with its contents
+  struct TempDir {
+    std::string path;
+    std::vector<std::string> files;
+
+    explicit TempDir(const std::string& parent) {
+      std::string base = parent;
+      if (base.empty()) {
+        const char* tmp = std::getenv("TMPDIR");
+        base = (tmp && *tmp) ? tmp : "/tmp";
+      }
+      std::string pattern = base + "/easymrc_tiles_XXXXXX";
+      std::vector<char> buffer(pattern.begin(), pattern.end());
+      buffer.push_back('\0');
+      if (!mkdtemp(buffer.data())) {
+        throw std::runtime_error("Cannot create work directory in " + base);
+      }
+      path = buffer.data();
+    }
+
+    ~TempDir() {
+      std::remove((path + "/layout.bin").c_str());
+      for (const auto& file : files) std::remove(file.c_str());
+      rmdir(path.c_str());
+    }
+  };
+
+  EasyMRC::Results run_spilled(const std::string& layout_file,
+                               const BoundingBox& extent, TempDir& dir) {
+    TileGrid grid = make_tile_grid(extent, options_.columns, options_.rows);
+    int num_tiles = grid.num_tiles();
+    int available = cpu_topology().effective_cpus();
+    int jobs = options_.jobs > 0 ? options_.jobs : available;
+    jobs = std::max(1, std::min(jobs, num_tiles));
+
+    // Split the threads between the concurrent workers
+    EasyMRC::Config worker_config = config_;
+    if (worker_config.num_threads <= 0) {
+      worker_config.num_threads = std::max(1, available / jobs);
+    }
+
+    stats_.tiles = num_tiles;
+    stats_.jobs = jobs;
+    stats_.max_tile_polygons = 0;
+
+    std::vector<std::string> result_files(num_tiles);
+    for (int tile = 0; tile < num_tiles; ++tile) {
+      result_files[tile] = dir.path + "/tile_" + std::to_string(tile) + ".bin";
+      dir.files.push_back(result_files[tile]);
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    std::unordered_map<pid_t, int> running;
+    std::string failure;
+    int next_tile = 0;
+    while (next_tile < num_tiles || !running.empty()) {
+      while (failure.empty() && next_tile < num_tiles &&
+             (int)running.size() < jobs) {
+        int tile = next_tile++;
+        pid_t pid = fork();
+        if (pid < 0) {
+          failure = "fork failed";
+          break;
+        }
+        if (pid == 0) {
+          _exit(run_worker(layout_file, grid, extent, tile, worker_config,
+                           result_files[tile]));
+        }
+        running[pid] = tile;
+      }
+      if (running.empty()) break;
+
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0) {
+        failure = "waitpid failed";
+        break;
+      }
+      auto it = running.find(pid);
+      if (it == running.end()) continue;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        failure = "worker for tile " + std::to_string(it->second) +
+                  " failed";
+      }
+      running.erase(it);
+    }
+
+    if (!failure.empty()) {
+      throw std::runtime_error("Tiled execution: " + failure);
+    }
+
+    EasyMRC::Results results;
+    for (int tile = 0; tile < num_tiles; ++tile) {
+      size_t loaded = read_tile_results(result_files[tile], results);
+      stats_.max_tile_polygons = std::max(stats_.max_tile_polygons, loaded);
+    }
+    sort_results(results);
+    return results;
+  }
+
+  // Body of a forked worker process; returns its exit status
+  static int run_worker(const std::string& layout_file, const TileGrid& grid,
+                        const BoundingBox& extent, int tile,
+                        const EasyMRC::Config& config,
+                        const std::string& result_file) {
+    try {
+      double R = config.rule_distance_R;
+
+      // One extra unit absorbs rounding at tile edges; extra polygons are
+      // harmless since only owned work is kept
+      BoundingBox region = grid.tile_bounds(tile);
+      region.expand(R + 1.0);
+      auto polygons = read_layout_spill(layout_file, &region);
+
+      std::vector<BoundingBox> expanded(polygons.size());
+      std::vector<Polygon> owned;
+      for (size_t i = 0; i < polygons.size(); ++i) {
+        BoundingBox bbox = compute_bounding_box(polygons[i]);
+        if (polygon_owner(grid, bbox) == tile) owned.push_back(polygons[i]);
+        bbox.expand(R);
+        expanded[i] = bbox;
+      }
+
+      // Keep only the pairs this tile owns
+      auto pairs = candidate_pair_generation(polygons, R);
+      pairs.erase(std::remove_if(pairs.begin(), pairs.end(),
+                                 [&](const std::pair<int, int>& pair) {
+                                   return pair_owner(grid, extent,
+                                                     expanded[pair.first],
+                                                     expanded[pair.second]) !=
+                                          tile;
+                                 }),
+                  pairs.end());
+
+      // Space rules over the halo as well; width rules only on the owned
+      // polygons, since halo polygons are width-checked by their own tile
+      EasyMRC::Results results;
+      if (config.enable_space_check) {
+        EasyMRC::Config space_config = config;
+        space_config.enable_width_check = false;
+        results = EasyMRC(space_config).run(polygons, pairs);
+      }
+      if (config.enable_width_check) {
+        EasyMRC::Config width_config = config;
+        width_config.enable_space_check = false;
+        auto width = EasyMRC(width_config).run(owned);
+        results.width_violations = std::move(width.width_violations);
+        results.width_load = std::move(width.width_load);
+      }
+
+      write_tile_results(results, polygons.size(), result_file);
+      return 0;
+
+    } catch (const std::exception& e) {
+      std::cerr << "Tile " << tile << ": " << e.what() << std::endl;
+      return 1;
+    }
+  }
+};
+
+}  // namespace easymrc
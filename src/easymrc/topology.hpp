@@ -0,0 +1,301 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+namespace easymrc {
+
+// Thread placement policy for worker threads
+enum class AffinityPolicy {
+  NONE,     // Let the OS schedule threads
+  COMPACT,  // Fill one L3 cache domain before moving to the next
+  SCATTER   // Round-robin workers across L3 cache domains
+};
+
+inline const char* affinity_policy_name(AffinityPolicy policy) {
+  switch (policy) {
+    case AffinityPolicy::COMPACT: return "compact";
+    case AffinityPolicy::SCATTER: return "scatter";
+    default: return "none";
+  }
+}
+
+inline AffinityPolicy parse_affinity_policy(const std::string& name) {
+  if (name == "compact") return AffinityPolicy::COMPACT;
+  if (name == "scatter") return AffinityPolicy::SCATTER;
+  if (name == "none" || name.empty()) return AffinityPolicy::NONE;
+  throw std::runtime_error("Unknown affinity policy: " + name);
+}
+
+// CPUs this process may actually use
+struct CpuTopology {
+  std::vector<int> allowed_cpus;             // sched_getaffinity mask
+  double quota_cpus;                         // cgroup CPU quota, 0 = none
+  std::string quota_source;                  // Where the quota came from
+  std::vector<std::vector<int>> l3_domains;  // Allowed CPUs by shared L3
+
+  CpuTopology() : quota_cpus(0.0) {}
+
+  // Number of worker threads that can run without oversubscription
+  int effective_cpus() const {
+    int cpus = std::max<int>(1, allowed_cpus.size());
+    if (quota_cpus > 0.0) {
+      cpus = std::min(cpus, std::max(1, (int)std::ceil(quota_cpus - 1e-9)));
+    }
+    return cpus;
+  }
+};
+
+namespace topology_detail {
+
+inline bool read_first_line(const std::string& path, std::string& line) {
+  std::ifstream file(path);
+  return file.is_open() && static_cast<bool>(std::getline(file, line));
+}
+
+// Parse a kernel CPU list such as "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) continue;
+    size_t dash = range.find('-');
+    try {
+      if (dash == std::string::npos) {
+        cpus.push_back(std::stoi(range));
+      } else {
+        int first = std::stoi(range.substr(0, dash));
+        int last = std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+      }
+    } catch (const std::exception&) {
+      // Ignore malformed entries
+    }
+  }
+  return cpus;
+}
+
+// cgroup v2 "cpu.max": "<quota> <period>" or "max <period>"
+inline double read_cgroup_v2_quota(const std::string& path) {
+  std::string line;
+  if (!read_first_line(path, line)) return -1.0;
+  std::stringstream ss(line);
+  std::string quota;
+  double period = 0.0;
+  ss >> quota >> period;
+  if (quota == "max" || period <= 0.0) return 0.0;
+  return std::stod(quota) / period;
+}
+
+// cgroup v1 "cpu.cfs_quota_us" / "cpu.cfs_period_us" (quota -1 = none)
+inline double read_cgroup_v1_quota(const std::string& dir) {
+  std::string quota_line, period_line;
+  if (!read_first_line(dir + "/cpu.cfs_quota_us", quota_line) ||
+      !read_first_line(dir + "/cpu.cfs_period_us", period_line)) {
+    return -1.0;
+  }
+  double quota = std::stod(quota_line);
+  double period = std::stod(period_line);
+  if (quota <= 0.0 || period <= 0.0) return 0.0;
+  return quota / period;
+}
+
+// Smallest CPU quota along this process's cgroup path (v2 or v1)
+inline double detect_cgroup_quota(std::string& source) {
+  std::ifstream cgroup_file("/proc/self/cgroup");
+  std::string line;
+  double best = 0.0;
+
+  auto consider = [&best, &source](double quota, const std::string& from) {
+    if (quota > 0.0 && (best == 0.0 || quota < best)) {
+      best = quota;
+      source = from;
+    }
+  };
+
+  while (std::getline(cgroup_file, line)) {
+    // Format: hierarchy-id:controllers:path
+    size_t first = line.find(':');
+    size_t second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) continue;
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    std::string path = line.substr(second + 1);
+
+    if (controllers.empty()) {
+      // cgroup v2: the limit may be set on any ancestor
+      std::string dir = path;
+      while (true) {
+        std::string file = "/sys/fs/cgroup" + dir + "/cpu.max";
+        consider(read_cgroup_v2_quota(file), "cgroup v2 " + file);
+        if (dir.empty() || dir == "/") break;
+        dir = dir.substr(0, dir.find_last_of('/'));
+      }
+    } else if (("," + controllers + ",").find(",cpu,") != std::string::npos) {
+      // cgroup v1: inside a container the hierarchy root is usually mounted
+      // directly, so also try the mount point itself
+      for (const char* mount : {"/sys/fs/cgroup/cpu,cpuacct",
+                                "/sys/fs/cgroup/cpu"}) {
+        std::string root(mount);
+        consider(read_cgroup_v1_quota(root), "cgroup v1 " + root);
+        if (path != "/") {
+          consider(read_cgroup_v1_quota(root + path),
+                   "cgroup v1 " + root + path);
+        }
+      }
+    }
+  }
+
+  return best;
+}
+
+// Group the allowed CPUs by the L3 cache they share
+inline std::vector<std::vector<int>> detect_l3_domains(
+    const std::vector<int>& allowed) {
+  std::vector<std::vector<int>> domains;
+  std::vector<bool> assigned(allowed.empty() ? 0 :
+                             *std::max_element(allowed.begin(),
+                                               allowed.end()) + 1, false);
+
+  for (int cpu : allowed) {
+    if (assigned[cpu]) continue;
+
+    std::vector<int> shared;
+    std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                       "/cache/index";
+    for (int index = 0; index < 8; ++index) {
+      std::string level;
+      if (!read_first_line(base + std::to_string(index) + "/level", level)) {
+        break;
+      }
+      if (level == "3") {
+        std::string list;
+        read_first_line(base + std::to_string(index) + "/shared_cpu_list",
+                        list);
+        shared = parse_cpu_list(list);
+        break;
+      }
+    }
+
+    // No L3 information: the CPU forms its own domain
+    std::vector<int> domain;
+    for (int other : allowed) {
+      bool same = (other == cpu) ||
+                  std::find(shared.begin(), shared.end(), other) !=
+                      shared.end();
+      if (same && !assigned[other]) {
+        domain.push_back(other);
+        assigned[other] = true;
+      }
+    }
+    domains.push_back(domain);
+  }
+
+  return domains;
+}
+
+}  // namespace topology_detail
+
+// Detect the CPUs available to this process: the affinity mask, cgroup
+// v1/v2 CPU quotas and L3 cache domains. Falls back to
+// hardware_concurrency() outside Linux.
+inline CpuTopology detect_cpu_topology() {
+  CpuTopology topology;
+
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) topology.allowed_cpus.push_back(cpu);
+    }
+  }
+
+  try {
+    topology.quota_cpus =
+        topology_detail::detect_cgroup_quota(topology.quota_source);
+  } catch (const std::exception&) {
+    topology.quota_cpus = 0.0;  // Unreadable quota files: assume no limit
+  }
+#endif
+
+  if (topology.allowed_cpus.empty()) {
+    int count = std::max(1u, std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < count; ++cpu) topology.allowed_cpus.push_back(cpu);
+  }
+
+#ifdef __linux__
+  topology.l3_domains =
+      topology_detail::detect_l3_domains(topology.allowed_cpus);
+#else
+  topology.l3_domains.push_back(topology.allowed_cpus);
+#endif
+
+  return topology;
+}
+
+// Topology of this process, detected once
+inline const CpuTopology& cpu_topology() {
+  static const CpuTopology topology = detect_cpu_topology();
+  return topology;
+}
+
+// CPU for each worker slot under the given policy. Worker i runs on
+// order[i % order.size()].
+inline std::vector<int> affinity_order(const CpuTopology& topology,
+                                       AffinityPolicy policy) {
+  std::vector<int> order;
+  if (policy == AffinityPolicy::COMPACT) {
+    for (const auto& domain : topology.l3_domains) {
+      order.insert(order.end(), domain.begin(), domain.end());
+    }
+  } else if (policy == AffinityPolicy::SCATTER) {
+    size_t longest = 0;
+    for (const auto& domain : topology.l3_domains) {
+      longest = std::max(longest, domain.size());
+    }
+    for (size_t i = 0; i < longest; ++i) {
+      for (const auto& domain : topology.l3_domains) {
+        if (i < domain.size()) order.push_back(domain[i]);
+      }
+    }
+  }
+  return order;
+}
+
+// Pin the calling thread to one CPU. Returns false if unsupported.
+inline bool pin_current_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+// Pin worker `worker` according to policy (no-op for NONE)
+inline void pin_worker(int worker, AffinityPolicy policy) {
+  if (policy == AffinityPolicy::NONE) return;
+  static const std::vector<int> compact =
+      affinity_order(cpu_topology(), AffinityPolicy::COMPACT);
+  static const std::vector<int> scatter =
+      affinity_order(cpu_topology(), AffinityPolicy::SCATTER);
+  const auto& order = (policy == AffinityPolicy::COMPACT) ? compact : scatter;
+  if (!order.empty()) pin_current_thread(order[worker % order.size()]);
+}
+
+}  // namespace easymrc
@@ -2,31 +2,41 @@
 
 #include <vector>
 #include <set>
+#include <memory_resource>
 #include <algorithm>
+#include <limits>
+#include <cstdint>
 #include "types.hpp"
 
 namespace easymrc {
 
-// Segment tree for efficient range queries
+// Segment tree for efficient range queries.
+// Stores pointers to representatives owned by the caller; tree nodes come
+// from the given memory resource.
 class SegmentTree {
  public:
   struct CompareByY {
-    bool operator()(const RepresentativePoint& a,
-                   const RepresentativePoint& b) const {
-      if (a.coordinates.y() != b.coordinates.y())
-        return a.coordinates.y() < b.coordinates.y();
-      return a.coordinates.x() < b.coordinates.x();
+    bool operator()(const RepresentativePoint* a,
+                   const RepresentativePoint* b) const {
+      if (a->coordinates.y() != b->coordinates.y())
+        return a->coordinates.y() < b->coordinates.y();
+      return a->coordinates.x() < b->coordinates.x();
     }
   };
 
+  explicit SegmentTree(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : tree_(resource) {}
+
   void insert(const RepresentativePoint& p) {
-    tree_.insert(p);
+    tree_.insert(&p);
   }
 
-  void erase_by_x(double x_threshold) {
+  // Remove points with x < x_threshold
+  void erase_by_x(int64_t x_threshold) {
     auto it = tree_.begin();
     while (it != tree_.end()) {
-      if (it->coordinates.x() < x_threshold) {
+      if ((*it)->coordinates.x() < x_threshold) {
         it = tree_.erase(it);
       } else {
         ++it;
@@ -34,21 +44,25 @@ class SegmentTree {
     }
   }
 
-  std::vector<RepresentativePoint> range_query(double y_min, double y_max) {
-    std::vector<RepresentativePoint> result;
+  // Collect points with y in [y_min, y_max] into result (cleared first)
+  void range_query(int64_t y_min, int64_t y_max,
+                   std::pmr::vector<const RepresentativePoint*>& result) {
+    result.clear();
+    if (y_min > std::numeric_limits<int>::max()) return;
 
-    // Create dummy point for lower_bound
+    // Create dummy point for lower_bound, before every point of row y_min
     RepresentativePoint dummy_low;
-    dummy_low.coordinates = Point(0, static_cast<int>(y_min));
+    dummy_low.coordinates = Point(
+        std::numeric_limits<int>::min(),
+        static_cast<int>(std::max<int64_t>(
+            y_min, std::numeric_limits<int>::min())));
 
-    auto start = tree_.lower_bound(dummy_low);
+    auto start = tree_.lower_bound(&dummy_low);
 
     for (auto it = start; it != tree_.end(); ++it) {
-      if (it->coordinates.y() > y_max) break;
+      if ((*it)->coordinates.y() > y_max) break;
       result.push_back(*it);
     }
-
-    return result;
   }
 
   size_t size() const { return tree_.size(); }
@@ -56,91 +70,95 @@ class SegmentTree {
   void clear() { tree_.clear(); }
 
  private:
-  std::set<RepresentativePoint, CompareByY> tree_;
+  std::pmr::set<const RepresentativePoint*, CompareByY> tree_;
 };
 
 class TypeAViolationDetector {
  public:
-  TypeAViolationDetector(const std::vector<RepresentativePoint>& points_p1,
-                         const std::vector<RepresentativePoint>& points_p2,
-                         double R, double r)
-      : p1_points_(points_p1), p2_points_(points_p2),
-        rule_distance_(R), sampling_radius_(r) {
-    R_prime_ = R + 2 * r;  // Extended rule distance
-  }
+  TypeAViolationDetector(
+      const RepresentativePoints& points_p1,
+      const RepresentativePoints& points_p2,
+      double R, double r,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : p1_points_(points_p1), p2_points_(points_p2), resource_(resource),
+        reach_(integer_reach(R + 2 * r)),  // Extended rule distance
+        limit_(squared_limit(R)) {}
 
   std::vector<Violation> detect() {
     std::vector<Violation> violations;
+    detect(violations);
+    return violations;
+  }
 
+  // Append violations to the caller's buffer (no intermediate copy)
+  void detect(std::vector<Violation>& violations) {
     // Step 1: Merge and sort all representative points by x-coordinate
     struct PointWithPolygon {
-      RepresentativePoint point;
+      const RepresentativePoint* point;
       int polygon_owner;  // 0 for p1, 1 for p2
 
       bool operator<(const PointWithPolygon& other) const {
-        if (point.coordinates.x() != other.point.coordinates.x())
-          return point.coordinates.x() < other.point.coordinates.x();
-        return point.coordinates.y() < other.point.coordinates.y();
+        if (point->coordinates.x() != other.point->coordinates.x())
+          return point->coordinates.x() < other.point->coordinates.x();
+        return point->coordinates.y() < other.point->coordinates.y();
       }
     };
 
-    std::vector<PointWithPolygon> all_points;
+    std::pmr::vector<PointWithPolygon> all_points(resource_);
+    all_points.reserve(p1_points_.size() + p2_points_.size());
     for (const auto& p : p1_points_) {
-      all_points.push_back({p, 0});
+      all_points.push_back({&p, 0});
     }
     for (const auto& p : p2_points_) {
-      all_points.push_back({p, 1});
+      all_points.push_back({&p, 1});
     }
 
     std::sort(all_points.begin(), all_points.end());
 
     // Step 2: Sweepline scan
-    SegmentTree tree_p1, tree_p2;
+    SegmentTree tree_p1(resource_), tree_p2(resource_);
+    std::pmr::vector<const RepresentativePoint*> found_points(resource_);
 
     for (const auto& current : all_points) {
-      double x = current.point.coordinates.x();
+      int64_t x = current.point->coordinates.x();
 
       // a) Delete points that are too far left
-      tree_p1.erase_by_x(x - R_prime_);
-      tree_p2.erase_by_x(x - R_prime_);
+      tree_p1.erase_by_x(x - reach_);
+      tree_p2.erase_by_x(x - reach_);
 
       // b) Search for nearby points
-      double y = current.point.coordinates.y();
-      double y_min = y - R_prime_;
-      double y_max = y + R_prime_;
-
-      std::vector<RepresentativePoint> found_points;
+      int64_t y = current.point->coordinates.y();
+      int64_t y_min = y - reach_;
+      int64_t y_max = y + reach_;
 
       if (current.polygon_owner == 0) {
         // Current point belongs to p1, search in p2
-        found_points = tree_p2.range_query(y_min, y_max);
+        tree_p2.range_query(y_min, y_max, found_points);
       } else {
         // Current point belongs to p2, search in p1
-        found_points = tree_p1.range_query(y_min, y_max);
+        tree_p1.range_query(y_min, y_max, found_points);
       }
 
       // c) Check violations for found points
-      for (const auto& found : found_points) {
-        check_violation(current.point, found, violations);
+      for (const auto* found : found_points) {
+        check_violation(*current.point, *found, violations);
       }
 
       // d) Insert current point into appropriate tree
       if (current.polygon_owner == 0) {
-        tree_p1.insert(current.point);
+        tree_p1.insert(*current.point);
       } else {
-        tree_p2.insert(current.point);
+        tree_p2.insert(*current.point);
       }
     }
-
-    return violations;
   }
 
  private:
-  const std::vector<RepresentativePoint>& p1_points_;
-  const std::vector<RepresentativePoint>& p2_points_;
-  double rule_distance_;
-  double sampling_radius_;
-  double R_prime_;
+  const RepresentativePoints& p1_points_;
+  const RepresentativePoints& p2_points_;
+  std::pmr::memory_resource* resource_;
+  int64_t reach_;  // integer_reach(R'), R' = R + 2r
+  int64_t limit_;  // squared_limit(R)
 
   void check_violation(const RepresentativePoint& v,
                       const RepresentativePoint& q,
@@ -149,10 +167,9 @@ class TypeAViolationDetector {
     // Check all pairs of shielded vertices
     for (const auto& point_v : v.shielded_vertices) {
       for (const auto& point_q : q.shielded_vertices) {
-        double distance = euclidean_distance(point_v, point_q);
-
-        if (distance < rule_distance_) {
-          violations.emplace_back(point_v, point_q, distance,
+        if (squared_distance(point_v, point_q) <= limit_) {
+          violations.emplace_back(point_v, point_q,
+                                 euclidean_distance(point_v, point_q),
                                  v.polygon_id, q.polygon_id);
         }
       }
@@ -161,25 +178,50 @@ class TypeAViolationDetector {
 };
 
 // Main function for type (a) violation detection
+inline std::vector<Violation> detect_type_a_violations(
+    const RepresentativePoints& points_p1,
+    const RepresentativePoints& points_p2,
+    double R, double r,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  TypeAViolationDetector detector(points_p1, points_p2, R, r, resource);
+  return detector.detect();
+}
+
+// Append type (a) violations directly to an output buffer
+inline void detect_type_a_violations(
+    const RepresentativePoints& points_p1,
+    const RepresentativePoints& points_p2,
+    double R, double r,
+    std::vector<Violation>& violations,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  TypeAViolationDetector detector(points_p1, points_p2, R, r, resource);
+  detector.detect(violations);
+}
+
+// Same, on representatives held in std::vectors (copied to the default
+// resource first)
 inline std::vector<Violation> detect_type_a_violations(
     const std::vector<RepresentativePoint>& points_p1,
     const std::vector<RepresentativePoint>& points_p2,
     double R, double r) {
 
-  TypeAViolationDetector detector(points_p1, points_p2, R, r);
-  return detector.detect();
+  return detect_type_a_violations(
+      RepresentativePoints(points_p1.begin(), points_p1.end()),
+      RepresentativePoints(points_p2.begin(), points_p2.end()), R, r);
 }
 
 // Check violations for a single polygon pair
 inline std::vector<Violation> check_space_violations_type_a(
-    const Polygon& poly1,
-    const Polygon& poly2,
+    const PolygonView& poly1,
+    const PolygonView& poly2,
     double R,
     double r) {
 
   // Sample representatives for both polygons
-  std::vector<RepresentativePoint> rep_points_1, rep_points_2;
-  std::vector<RepresentativeEdge> rep_edges_1, rep_edges_2;
+  RepresentativePoints rep_points_1, rep_points_2;
+  RepresentativeEdges rep_edges_1, rep_edges_2;
 
   sample_representatives(poly1, r, rep_points_1, rep_edges_1);
   sample_representatives(poly2, r, rep_points_2, rep_edges_2);
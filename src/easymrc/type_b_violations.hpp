@@ -2,7 +2,9 @@
 
 #include <vector>
 #include <set>
+#include <memory_resource>
 #include <algorithm>
+#include <cstdint>
 #include "types.hpp"
 
 namespace easymrc {
@@ -15,24 +17,26 @@ enum EdgeEventType {
   POINT_EVENT = 3
 };
 
+// Events are at integer coordinates: the ends of the reach of an edge are
+// offset by integer_reach() of the extended distances
 struct EdgeEvent {
-  double x;
+  int64_t x;
   EdgeEventType event_type;
   int entity_id;  // point index or edge index
-  double y_value;
-  double y_min, y_max;  // For vertical edges
+  int64_t y_value;
+  int64_t y_min, y_max;  // For vertical edges
   bool is_point;
 
   EdgeEvent()
       : x(0), event_type(POINT_EVENT), entity_id(-1),
         y_value(0), y_min(0), y_max(0), is_point(true) {}
 
-  EdgeEvent(double x_coord, EdgeEventType type, int id, double y)
+  EdgeEvent(int64_t x_coord, EdgeEventType type, int id, int64_t y)
       : x(x_coord), event_type(type), entity_id(id),
         y_value(y), y_min(0), y_max(0), is_point(true) {}
 
-  EdgeEvent(double x_coord, EdgeEventType type, int id,
-           double ymin, double ymax)
+  EdgeEvent(int64_t x_coord, EdgeEventType type, int id,
+           int64_t ymin, int64_t ymax)
       : x(x_coord), event_type(type), entity_id(id),
         y_value(0), y_min(ymin), y_max(ymax), is_point(false) {}
 
@@ -44,32 +48,40 @@ struct EdgeEvent {
 
 class TypeBViolationDetector {
  public:
-  TypeBViolationDetector(const std::vector<RepresentativePoint>& points_p1,
-                         const std::vector<RepresentativePoint>& points_p2,
-                         const std::vector<RepresentativeEdge>& edges_p1,
-                         const std::vector<RepresentativeEdge>& edges_p2,
-                         double R, double r)
+  TypeBViolationDetector(
+      const RepresentativePoints& points_p1,
+      const RepresentativePoints& points_p2,
+      const RepresentativeEdges& edges_p1,
+      const RepresentativeEdges& edges_p2,
+      double R, double r,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
       : p1_points_(points_p1), p2_points_(points_p2),
         p1_edges_(edges_p1), p2_edges_(edges_p2),
-        rule_distance_(R), sampling_radius_(r) {
-    R_prime_ = R + r;  // Extended rule distance for type (b)
-  }
+        resource_(resource), found_points_(resource),
+        reach_(integer_reach(R + r)),  // Extended rule distance for type (b)
+        sampling_reach_(integer_reach(r)),
+        limit_(squared_limit(R)) {}
 
   std::vector<ViolationTypeB> detect() {
     std::vector<ViolationTypeB> violations;
+    detect(violations);
+    return violations;
+  }
 
+  // Append violations to the caller's buffer (no intermediate copy)
+  void detect(std::vector<ViolationTypeB>& violations) {
     // Generate events
-    std::vector<EdgeEvent> events = generate_events();
+    std::pmr::vector<EdgeEvent> events = generate_events();
 
     // Sort events
     std::sort(events.begin(), events.end());
 
     // Sweepline scan
-    SegmentTree point_tree;
+    SegmentTree point_tree(resource_);
 
     for (const auto& event : events) {
       // Delete points that are too far left
-      point_tree.erase_by_x(event.x - R_prime_);
+      point_tree.erase_by_x(event.x - reach_);
 
       if (event.event_type == POINT_EVENT) {
         // Point event - insert into tree
@@ -85,21 +97,23 @@ class TypeBViolationDetector {
         handle_horizontal_edge_event(event, point_tree, violations);
       }
     }
-
-    return violations;
   }
 
  private:
-  const std::vector<RepresentativePoint>& p1_points_;
-  const std::vector<RepresentativePoint>& p2_points_;
-  const std::vector<RepresentativeEdge>& p1_edges_;
-  const std::vector<RepresentativeEdge>& p2_edges_;
-  double rule_distance_;
-  double sampling_radius_;
-  double R_prime_;
-
-  std::vector<EdgeEvent> generate_events() {
-    std::vector<EdgeEvent> events;
+  const RepresentativePoints& p1_points_;
+  const RepresentativePoints& p2_points_;
+  const RepresentativeEdges& p1_edges_;
+  const RepresentativeEdges& p2_edges_;
+  std::pmr::memory_resource* resource_;
+  std::pmr::vector<const RepresentativePoint*> found_points_;
+  int64_t reach_;           // integer_reach(R'), R' = R + r
+  int64_t sampling_reach_;  // integer_reach(r)
+  int64_t limit_;           // squared_limit(R)
+
+  std::pmr::vector<EdgeEvent> generate_events() {
+    std::pmr::vector<EdgeEvent> events(resource_);
+    events.reserve(p1_points_.size() + p2_points_.size() +
+                   2 * (p1_edges_.size() + p2_edges_.size()));
 
     // Add point events from p1
     for (size_t i = 0; i < p1_points_.size(); ++i) {
@@ -132,24 +146,24 @@ class TypeBViolationDetector {
   }
 
   void add_edge_events(const Segment& edge, int edge_id,
-                      std::vector<EdgeEvent>& events) {
+                      std::pmr::vector<EdgeEvent>& events) {
 
     if (edge.is_vertical()) {
       // Vertical edge: create LEFT and RIGHT events
-      double x0 = edge.start.x();
-      double y_min = std::min(edge.start.y(), edge.end.y());
-      double y_max = std::max(edge.start.y(), edge.end.y());
+      int64_t x0 = edge.start.x();
+      int64_t y_min = edge.min_y();
+      int64_t y_max = edge.max_y();
 
       events.emplace_back(x0, VERTICAL_LEFT, edge_id, y_min, y_max);
-      events.emplace_back(x0 + R_prime_, VERTICAL_RIGHT, edge_id,
+      events.emplace_back(x0 + reach_, VERTICAL_RIGHT, edge_id,
                          y_min, y_max);
 
     } else if (edge.is_horizontal()) {
       // Horizontal edge: create single event at right end
-      double x_max = std::max(edge.start.x(), edge.end.x());
-      double y0 = edge.start.y();
+      int64_t x_max = edge.max_x();
+      int64_t y0 = edge.start.y();
 
-      events.emplace_back(x_max + sampling_radius_, HORIZONTAL,
+      events.emplace_back(x_max + sampling_reach_, HORIZONTAL,
                          edge_id, y0);
     }
   }
@@ -159,10 +173,10 @@ class TypeBViolationDetector {
                                   std::vector<ViolationTypeB>& violations) {
 
     // Query points in y-range [y_min - r, y_max + r]
-    double y_min = event.y_min - sampling_radius_;
-    double y_max = event.y_max + sampling_radius_;
+    int64_t y_min = event.y_min - sampling_reach_;
+    int64_t y_max = event.y_max + sampling_reach_;
 
-    auto found_points = point_tree.range_query(y_min, y_max);
+    point_tree.range_query(y_min, y_max, found_points_);
 
     // Get the edge
     int edge_idx = event.entity_id;
@@ -177,8 +191,8 @@ class TypeBViolationDetector {
     if (!edge_ptr) return;
 
     // Check violations
-    for (const auto& point : found_points) {
-      check_point_edge_violation(point, *edge_ptr, violations);
+    for (const auto* point : found_points_) {
+      check_point_edge_violation(*point, *edge_ptr, violations);
     }
   }
 
@@ -187,11 +201,11 @@ class TypeBViolationDetector {
                                     std::vector<ViolationTypeB>& violations) {
 
     // Query points in y-range [y0 - R', y0 + R']
-    double y0 = event.y_value;
-    double y_min = y0 - R_prime_;
-    double y_max = y0 + R_prime_;
+    int64_t y0 = event.y_value;
+    int64_t y_min = y0 - reach_;
+    int64_t y_max = y0 + reach_;
 
-    auto found_points = point_tree.range_query(y_min, y_max);
+    point_tree.range_query(y_min, y_max, found_points_);
 
     // Get the edge
     int edge_idx = event.entity_id;
@@ -206,8 +220,8 @@ class TypeBViolationDetector {
     if (!edge_ptr) return;
 
     // Check violations
-    for (const auto& point : found_points) {
-      check_point_edge_violation(point, *edge_ptr, violations);
+    for (const auto* point : found_points_) {
+      check_point_edge_violation(*point, *edge_ptr, violations);
     }
   }
 
@@ -219,10 +233,9 @@ class TypeBViolationDetector {
     // of the edge
     for (const auto& point_v : point.shielded_vertices) {
       for (const auto& point_e : edge.shielded_vertices) {
-        double distance = euclidean_distance(point_v, point_e);
-
-        if (distance < rule_distance_) {
-          violations.emplace_back(point_v, edge.edge, distance,
+        if (squared_distance(point_v, point_e) <= limit_) {
+          violations.emplace_back(point_v, edge.edge,
+                                 euclidean_distance(point_v, point_e),
                                  point.polygon_id, edge.polygon_id);
         }
       }
@@ -231,6 +244,36 @@ class TypeBViolationDetector {
 };
 
 // Main function for type (b) violation detection
+inline std::vector<ViolationTypeB> detect_type_b_violations(
+    const RepresentativePoints& points_p1,
+    const RepresentativePoints& points_p2,
+    const RepresentativeEdges& edges_p1,
+    const RepresentativeEdges& edges_p2,
+    double R, double r,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  TypeBViolationDetector detector(points_p1, points_p2,
+                                  edges_p1, edges_p2, R, r, resource);
+  return detector.detect();
+}
+
+// Append type (b) violations directly to an output buffer
+inline void detect_type_b_violations(
+    const RepresentativePoints& points_p1,
+    const RepresentativePoints& points_p2,
+    const RepresentativeEdges& edges_p1,
+    const RepresentativeEdges& edges_p2,
+    double R, double r,
+    std::vector<ViolationTypeB>& violations,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  TypeBViolationDetector detector(points_p1, points_p2,
+                                  edges_p1, edges_p2, R, r, resource);
+  detector.detect(violations);
+}
+
+// Same, on representatives held in std::vectors (copied to the default
+// resource first)
 inline std::vector<ViolationTypeB> detect_type_b_violations(
     const std::vector<RepresentativePoint>& points_p1,
     const std::vector<RepresentativePoint>& points_p2,
@@ -238,23 +281,25 @@ inline std::vector<ViolationTypeB> detect_type_b_violations(
     const std::vector<RepresentativeEdge>& edges_p2,
     double R, double r) {
 
-  TypeBViolationDetector detector(points_p1, points_p2,
-                                  edges_p1, edges_p2, R, r);
-  return detector.detect();
+  return detect_type_b_violations(
+      RepresentativePoints(points_p1.begin(), points_p1.end()),
+      RepresentativePoints(points_p2.begin(), points_p2.end()),
+      RepresentativeEdges(edges_p1.begin(), edges_p1.end()),
+      RepresentativeEdges(edges_p2.begin(), edges_p2.end()), R, r);
 }
 
 // Check violations for a single polygon pair (both type a and b)
 inline void check_space_violations_complete(
-    const Polygon& poly1,
-    const Polygon& poly2,
+    const PolygonView& poly1,
+    const PolygonView& poly2,
     double R,
     double r,
     std::vector<Violation>& violations_a,
     std::vector<ViolationTypeB>& violations_b) {
 
   // Sample representatives for both polygons
-  std::vector<RepresentativePoint> rep_points_1, rep_points_2;
-  std::vector<RepresentativeEdge> rep_edges_1, rep_edges_2;
+  RepresentativePoints rep_points_1, rep_points_2;
+  RepresentativeEdges rep_edges_1, rep_edges_2;
 
   sample_representatives(poly1, r, rep_points_1, rep_edges_1);
   sample_representatives(poly2, r, rep_points_2, rep_edges_2);
@@ -6,6 +6,9 @@
 #include <cmath>
 #include <algorithm>
 #include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
 
 namespace easymrc {
 
@@ -124,29 +127,158 @@ inline BoundingBox compute_bounding_box(const Polygon& poly) {
   return bbox;
 }
 
+// Read-only view of one polygon, wherever its vertices are stored: the
+// Point array of a Polygon or the coordinate arrays of a LayoutStore.
+// Edges are derived from consecutive vertices on the fly, edge i running
+// from vertex i to the next (wrapping), as Polygon::build_segments() builds
+// them. Edge lengths, perimeter and bounding box come from the store's
+// caches when it has them and are computed otherwise, with the same
+// results.
+class PolygonView {
+ public:
+  // View of a Polygon's vertices (its segments are not consulted)
+  PolygonView(const Polygon& poly)
+      : id_(poly.id), size_(poly.vertices.size()),
+        points_(poly.vertices.data()), x_(nullptr), y_(nullptr),
+        edge_lengths_(nullptr), perimeter_(-1.0), box_(nullptr) {}
+
+  // View of coordinate arrays with cached edge lengths, perimeter and box
+  // (min_x, min_y, max_x, max_y)
+  PolygonView(int id, const int* x, const int* y, size_t size,
+              const double* edge_lengths, double perimeter, const int* box)
+      : id_(id), size_(size), points_(nullptr), x_(x), y_(y),
+        edge_lengths_(edge_lengths), perimeter_(perimeter), box_(box) {}
+
+  int id() const { return id_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  Point vertex(size_t i) const {
+    return points_ ? points_[i] : Point(x_[i], y_[i]);
+  }
+
+  // Number of edges: one per vertex, none below two vertices
+  size_t num_edges() const { return size_ < 2 ? 0 : size_; }
+
+  Segment edge(size_t i) const {
+    return Segment(vertex(i), vertex(i + 1 == size_ ? 0 : i + 1));
+  }
+
+  double edge_length(size_t i) const {
+    return edge_lengths_ ? edge_lengths_[i] : edge(i).length();
+  }
+
+  // Sum of the edge lengths, in edge order
+  double perimeter() const {
+    if (perimeter_ >= 0.0) return perimeter_;
+    double total = 0.0;
+    for (size_t i = 0; i < num_edges(); ++i) total += edge_length(i);
+    return total;
+  }
+
+  double average_edge_length() const {
+    size_t n = num_edges();
+    return n == 0 ? 0.0 : perimeter() / n;
+  }
+
+  // As compute_bounding_box() of the polygon
+  BoundingBox bbox() const {
+    if (num_edges() == 0) return BoundingBox();
+    if (box_) return BoundingBox(box_[0], box_[1], box_[2], box_[3], id_);
+    Point first = vertex(0);
+    BoundingBox box(first.x(), first.y(), first.x(), first.y(), id_);
+    for (size_t i = 1; i < size_; ++i) {
+      Point p = vertex(i);
+      box.min_x = std::min(box.min_x, (double)p.x());
+      box.min_y = std::min(box.min_y, (double)p.y());
+      box.max_x = std::max(box.max_x, (double)p.x());
+      box.max_y = std::max(box.max_y, (double)p.y());
+    }
+    return box;
+  }
+
+ private:
+  int id_;
+  size_t size_;
+  const Point* points_;         // Polygon vertices, or
+  const int* x_;                // store coordinates
+  const int* y_;
+  const double* edge_lengths_;  // Cached, or null
+  double perimeter_;            // Cached, or negative
+  const int* box_;              // Cached, or null
+};
+
 // Representative point structure
+// Allocator-aware so that a pmr container of representatives (and their
+// shield lists) can live entirely in a per-worker arena.
 struct RepresentativePoint {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
   Point coordinates;
-  std::vector<Point> shielded_vertices;
-  std::vector<Segment> shielded_edges;
+  std::pmr::vector<Point> shielded_vertices;
+  std::pmr::vector<Segment> shielded_edges;
   int polygon_id;
 
   RepresentativePoint() : polygon_id(-1) {}
-  RepresentativePoint(const Point& p, int pid)
-      : coordinates(p), polygon_id(pid) {}
+  explicit RepresentativePoint(const allocator_type& alloc)
+      : shielded_vertices(alloc), shielded_edges(alloc), polygon_id(-1) {}
+  RepresentativePoint(const Point& p, int pid,
+                      const allocator_type& alloc = {})
+      : coordinates(p), shielded_vertices(alloc), shielded_edges(alloc),
+        polygon_id(pid) {}
+
+  RepresentativePoint(const RepresentativePoint&) = default;
+  RepresentativePoint(RepresentativePoint&&) = default;
+  RepresentativePoint& operator=(const RepresentativePoint&) = default;
+  RepresentativePoint& operator=(RepresentativePoint&&) = default;
+
+  RepresentativePoint(const RepresentativePoint& other,
+                      const allocator_type& alloc)
+      : coordinates(other.coordinates),
+        shielded_vertices(other.shielded_vertices, alloc),
+        shielded_edges(other.shielded_edges, alloc),
+        polygon_id(other.polygon_id) {}
+  RepresentativePoint(RepresentativePoint&& other,
+                      const allocator_type& alloc)
+      : coordinates(other.coordinates),
+        shielded_vertices(std::move(other.shielded_vertices), alloc),
+        shielded_edges(std::move(other.shielded_edges), alloc),
+        polygon_id(other.polygon_id) {}
 };
 
 // Representative edge structure
 struct RepresentativeEdge {
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
   Segment edge;
-  std::vector<Point> shielded_vertices;
+  std::pmr::vector<Point> shielded_vertices;
   int polygon_id;
 
   RepresentativeEdge() : polygon_id(-1) {}
-  RepresentativeEdge(const Segment& e, int pid)
-      : edge(e), polygon_id(pid) {}
+  explicit RepresentativeEdge(const allocator_type& alloc)
+      : shielded_vertices(alloc), polygon_id(-1) {}
+  RepresentativeEdge(const Segment& e, int pid,
+                     const allocator_type& alloc = {})
+      : edge(e), shielded_vertices(alloc), polygon_id(pid) {}
+
+  RepresentativeEdge(const RepresentativeEdge&) = default;
+  RepresentativeEdge(RepresentativeEdge&&) = default;
+  RepresentativeEdge& operator=(const RepresentativeEdge&) = default;
+  RepresentativeEdge& operator=(RepresentativeEdge&&) = default;
+
+  RepresentativeEdge(const RepresentativeEdge& other,
+                     const allocator_type& alloc)
+      : edge(other.edge), shielded_vertices(other.shielded_vertices, alloc),
+        polygon_id(other.polygon_id) {}
+  RepresentativeEdge(RepresentativeEdge&& other, const allocator_type& alloc)
+      : edge(other.edge),
+        shielded_vertices(std::move(other.shielded_vertices), alloc),
+        polygon_id(other.polygon_id) {}
 };
 
+using RepresentativePoints = std::pmr::vector<RepresentativePoint>;
+using RepresentativeEdges = std::pmr::vector<RepresentativeEdge>;
+
 // Violation structures
 struct Violation {
   Point point1, point2;
@@ -226,4 +358,96 @@ inline double point_to_segment_distance(const Point& p, const Segment& seg) {
   return std::sqrt(dist_x * dist_x + dist_y * dist_y);
 }
 
+// Exact integer geometry.
+//
+// Coordinates are int, so squared distances between points are integers:
+// "distance < R" is decided as squared_distance() <= squared_limit(R), and
+// how far R reaches along one axis is the integer integer_reach(R). The
+// sweeps and predicates of the checks use only these, with no square root
+// or rounding, so which pairs are reported does not depend on the compiler
+// or its floating-point code generation. The distance itself
+// (euclidean_distance()) is computed only for the violations reported.
+
+// Largest integer n <= d, clamped to +-2^40 so that adding it to a
+// coordinate cannot overflow
+inline int64_t integer_reach(double d) {
+  const double kLimit = 1099511627776.0;  // 2^40
+  if (std::isnan(d)) return -1;
+  return static_cast<int64_t>(std::floor(std::max(-kLimit,
+                                                  std::min(kLimit, d))));
+}
+
+// Largest integer k with k < R^2, i.e. sqrt(k) < R (-1 when R <= 0). The
+// fused multiply-add rounds R * R - k once, which keeps its sign, so k is
+// exact while k is exactly representable (R below 2^26.5).
+inline int64_t squared_limit(double R) {
+  if (!(R > 0.0)) return -1;
+  const double square = R * R;
+  if (square >= 9007199254740992.0) {  // 2^53
+    if (square >= 9.0e18) return std::numeric_limits<int64_t>::max() - 1;
+    return static_cast<int64_t>(square);
+  }
+  int64_t k = static_cast<int64_t>(square);
+  while (k >= 0 && std::fma(R, R, -static_cast<double>(k)) <= 0.0) --k;
+  while (std::fma(R, R, -static_cast<double>(k + 1)) > 0.0) ++k;
+  return k;
+}
+
+// Squared distance between two points, saturated at INT64_MAX for points
+// 2^31 or more apart along an axis (beyond any squared_limit())
+inline int64_t squared_distance(const Point& p1, const Point& p2) {
+  const int64_t dx = static_cast<int64_t>(p2.x()) - p1.x();
+  const int64_t dy = static_cast<int64_t>(p2.y()) - p1.y();
+  const int64_t kFar = int64_t(1) << 31;
+  if (dx >= kFar || -dx >= kFar || dy >= kFar || -dy >= kFar) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return dx * dx + dy * dy;
+}
+
+// Squared distance from p to a horizontal or vertical segment, whose
+// closest point to p is p clamped into the segment's extent
+inline int64_t squared_distance(const Point& p, const Segment& seg) {
+  Point closest(std::max(seg.min_x(), std::min(seg.max_x(), p.x())),
+                std::max(seg.min_y(), std::min(seg.max_y(), p.y())));
+  return squared_distance(p, closest);
+}
+
+// Bounding box of the exact path: int64 corners, expanded and compared
+// without rounding
+struct ExactBox {
+  int64_t min_x, min_y, max_x, max_y;
+  int polygon_id;
+
+  ExactBox() : min_x(0), min_y(0), max_x(0), max_y(0), polygon_id(-1) {}
+
+  ExactBox(int64_t minx, int64_t miny, int64_t maxx, int64_t maxy,
+           int pid = -1)
+      : min_x(minx), min_y(miny), max_x(maxx), max_y(maxy),
+        polygon_id(pid) {}
+
+  // Box of integer coordinates, as compute_bounding_box() gives
+  explicit ExactBox(const BoundingBox& box)
+      : min_x(static_cast<int64_t>(box.min_x)),
+        min_y(static_cast<int64_t>(box.min_y)),
+        max_x(static_cast<int64_t>(box.max_x)),
+        max_y(static_cast<int64_t>(box.max_y)),
+        polygon_id(box.polygon_id) {}
+
+  // Expand for rule distance R: two expanded boxes overlap exactly when
+  // the boxes are at most 2R apart along both axes, as two BoundingBoxes
+  // each expanded by R. Only the max sides grow, by integer_reach(2R),
+  // which keeps the corners integers.
+  void expand(double R) {
+    const int64_t reach = integer_reach(2 * R);
+    max_x += reach;
+    max_y += reach;
+  }
+
+  bool overlaps(const ExactBox& other) const {
+    return !(max_x < other.min_x || other.max_x < min_x ||
+             max_y < other.min_y || other.max_y < min_y);
+  }
+};
+
 }  // namespace easymrc
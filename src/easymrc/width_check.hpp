@@ -2,7 +2,10 @@
 
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <memory_resource>
 #include "types.hpp"
+#include "layout_store.hpp"
 #include "type_a_violations.hpp"
 #include "type_b_violations.hpp"
 
@@ -74,8 +77,8 @@ inline double segment_to_segment_distance(const Segment& s1,
   double min_dist = std::numeric_limits<double>::max();
 
   // Try all endpoint combinations
-  std::vector<Point> points_s1 = {s1.start, s1.end};
-  std::vector<Point> points_s2 = {s2.start, s2.end};
+  const Point points_s1[2] = {s1.start, s1.end};
+  const Point points_s2[2] = {s2.start, s2.end};
 
   for (const auto& p1 : points_s1) {
     double dist = point_to_segment_distance(p1, s2);
@@ -102,15 +105,36 @@ inline double segment_to_segment_distance(const Segment& s1,
   return min_dist;
 }
 
+// Squared segment_to_segment_distance() of two horizontal or vertical
+// segments, in integers: the smallest squared distance from an endpoint of
+// one to the other
+inline int64_t squared_segment_distance(const Segment& s1,
+                                        const Segment& s2) {
+  return std::min(std::min(squared_distance(s1.start, s2),
+                           squared_distance(s1.end, s2)),
+                  std::min(squared_distance(s2.start, s1),
+                           squared_distance(s2.end, s1)));
+}
+
 class WidthChecker {
  public:
-  WidthChecker(const Polygon& poly, double R, double r)
-      : polygon_(poly), rule_distance_(R), sampling_radius_(r) {}
+  WidthChecker(
+      const PolygonView& poly, double R, double r,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : polygon_(poly), limit_(squared_limit(R)), sampling_radius_(r),
+        resource_(resource) {}
 
   std::vector<WidthViolation> check() {
+    std::vector<WidthViolation> violations;
+    check(violations);
+    return violations;
+  }
+
+  // Append violations to the caller's buffer (no intermediate copy)
+  void check(std::vector<WidthViolation>& violations) {
     // Step 1: Sample representatives
-    std::vector<RepresentativePoint> rep_points;
-    std::vector<RepresentativeEdge> rep_edges;
+    RepresentativePoints rep_points(resource_);
+    RepresentativeEdges rep_edges(resource_);
 
     sample_representatives(polygon_, sampling_radius_,
                           rep_points, rep_edges);
@@ -120,62 +144,68 @@ class WidthChecker {
 
     // For simplicity, we'll do a brute-force check for width violations
     // In practice, you would use the same sweepline algorithm
-    std::vector<WidthViolation> violations;
-
     // Check all pairs of representative edges
     for (size_t i = 0; i < rep_edges.size(); ++i) {
       for (size_t j = i + 1; j < rep_edges.size(); ++j) {
         const auto& edge1 = rep_edges[i].edge;
         const auto& edge2 = rep_edges[j].edge;
 
-        // Step 3: Filter - only check opposite edges
+        // Step 3: Filter - only check opposite edges, which are both
+        // horizontal or both vertical
         if (!are_opposite(edge1, edge2)) continue;
 
-        // Calculate minimum distance
+        // Step 4: Check if it violates the rule (exactly, in integers)
+        if (squared_segment_distance(edge1, edge2) > limit_) continue;
+
+        // Distance and closest points of the violation
         Point closest_p1, closest_p2;
         double dist = segment_to_segment_distance(edge1, edge2,
                                                   closest_p1, closest_p2);
-
-        // Step 4: Check if it violates the rule
-        if (dist < rule_distance_) {
-          violations.emplace_back(edge1, edge2, dist,
-                                 closest_p1, closest_p2,
-                                 polygon_.id);
-        }
+        violations.emplace_back(edge1, edge2, dist,
+                               closest_p1, closest_p2,
+                               polygon_.id());
       }
     }
-
-    return violations;
   }
 
  private:
-  const Polygon& polygon_;
-  double rule_distance_;
+  PolygonView polygon_;
+  int64_t limit_;  // squared_limit(R)
   double sampling_radius_;
+  std::pmr::memory_resource* resource_;
 };
 
 // Main width checking function
 inline std::vector<WidthViolation> check_width_violations(
-    const Polygon& polygon, double R, double r) {
+    const PolygonView& polygon, double R, double r,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
 
-  WidthChecker checker(polygon, R, r);
+  WidthChecker checker(polygon, R, r, resource);
   return checker.check();
 }
 
+// Append width violations directly to an output buffer
+inline void check_width_violations(
+    const PolygonView& polygon, double R, double r,
+    std::vector<WidthViolation>& violations,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+
+  WidthChecker checker(polygon, R, r, resource);
+  checker.check(violations);
+}
+
 // Check width violations for all polygons
 inline std::vector<WidthViolation> check_all_width_violations(
-    const std::vector<Polygon>& polygons,
+    const PolygonSource& polygons,
     double R,
     double multiplier = 4.0) {
 
   std::vector<WidthViolation> all_violations;
 
-  for (const auto& poly : polygons) {
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    const PolygonView poly = polygons[i];
     double r = calculate_sampling_radius(poly, multiplier);
-    auto violations = check_width_violations(poly, R, r);
-
-    all_violations.insert(all_violations.end(),
-                         violations.begin(), violations.end());
+    check_width_violations(poly, R, r, all_violations);
   }
 
   return all_violations;
@@ -1,9 +1,18 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <chrono>
+#include <csignal>
+
+#include <sys/stat.h>
 
 #include "easymrc/easymrc.hpp"
+#include "easymrc/tiling.hpp"
+#include "easymrc/streaming.hpp"
+#include "easymrc/hierarchy.hpp"
+#include "easymrc/layout_cache.hpp"
 
 using namespace easymrc;
 
@@ -15,14 +24,69 @@ std::string trim(const std::string& str) {
   return str.substr(start, end - start + 1);
 }
 
-// 設定ファイル読み込み
-EasyMRC::Config load_rule_file(const std::string& filename) {
+// 設定項目の代入 (未知のキーなら false)
+bool apply_rule(EasyMRC::Config& config, const std::string& key,
+                const std::string& value) {
+  if (key == "rule_distance") {
+    config.rule_distance_R = std::stod(value);
+
+  } else if (key == "sampling_multiplier") {
+    config.sampling_radius_multiplier = std::stod(value);
+
+  } else if (key == "threads") {
+    if (value == "auto" || value == "0") {
+      config.num_threads = 0;
+    } else {
+      config.num_threads = std::stoi(value);
+    }
+
+  } else if (key == "affinity") {
+    config.affinity = parse_affinity_policy(value);
+
+  } else if (key == "space_check") {
+    config.enable_space_check = (value == "true" || value == "1");
+
+  } else if (key == "width_check") {
+    config.enable_width_check = (value == "true" || value == "1");
+
+  } else if (key == "parallel") {
+    config.enable_parallel = (value == "true" || value == "1");
+
+  } else if (key == "concurrent_phases") {
+    config.concurrent_phases = (value == "true" || value == "1");
+
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// 階調レイヤー: 画像の画素値 level を 1 レイヤーとして独自のルールで検査
+struct LevelLayer {
+  std::string name;
+  unsigned char level;
+  EasyMRC::Config config;
+};
+
+// 設定ファイル読み込み (layers: の指定は layers へ、level.<画素値>:
+// <名前> と <名前>.<キー>: <値> の指定は level_layers へ)
+EasyMRC::Config load_rule_file(const std::string& filename,
+                               std::string* layers = nullptr,
+                               std::vector<LevelLayer>* level_layers =
+                                   nullptr) {
   std::ifstream file(filename);
   if (!file.is_open()) {
     throw std::runtime_error("Cannot open rule file: " + filename);
   }
 
   EasyMRC::Config config;
+  std::vector<LevelLayer> levels;
+  // レイヤー別の指定: 全体の設定が確定してから適用する
+  struct Override {
+    std::string layer, key, value;
+    int line_number;
+  };
+  std::vector<Override> overrides;
   std::string line;
   int line_number = 0;
 
@@ -48,36 +112,60 @@ EasyMRC::Config load_rule_file(const std::string& filename) {
 
     std::string key = trim(line.substr(0, colon_pos));
     std::string value = trim(line.substr(colon_pos + 1));
+    size_t dot_pos = key.find('.');
 
     // 設定項目ごとに代入
-    if (key == "rule_distance") {
-        config.rule_distance_R = std::stod(value);
-
-    } else if (key == "sampling_multiplier") {
-        config.sampling_radius_multiplier = std::stod(value);
-        
-    } else if (key == "threads") {
-        if (value == "auto" || value == "0") {
-            config.num_threads = 0;
-        } else {
-            config.num_threads = std::stoi(value);
+    if (key == "layers") {
+      if (layers) *layers = value;
+
+    } else if (key.compare(0, 6, "level.") == 0) {
+      size_t end = 0;
+      int level = -1;
+      try {
+        level = std::stoi(key.substr(6), &end);
+      } catch (const std::exception&) {
+      }
+      if (end != key.size() - 6 || level < 0 || level > 255 ||
+          value.empty()) {
+        throw std::runtime_error("Invalid level layer at line " +
+                                 std::to_string(line_number) + ": " + line);
+      }
+      for (const auto& other : levels) {
+        if (other.level == level || other.name == value) {
+          throw std::runtime_error("Duplicate level layer at line " +
+                                   std::to_string(line_number) + ": " +
+                                   line);
         }
+      }
+      levels.push_back({value, static_cast<unsigned char>(level), {}});
 
-    } else if (key == "space_check") {
-        config.enable_space_check = (value == "true" || value == "1");
+    } else if (dot_pos != std::string::npos) {
+      overrides.push_back({key.substr(0, dot_pos), key.substr(dot_pos + 1),
+                           value, line_number});
 
-    } else if (key == "width_check") {
-        config.enable_width_check = (value == "true" || value == "1");
+    } else if (!apply_rule(config, key, value)) {
+      std::cerr << "Warning: Unknown parameter '" << key
+                << "' at line " << line_number << std::endl;
+    }
 
-    } else if (key == "parallel") {
-        config.enable_parallel = (value == "true" || value == "1");
+  }
 
-    } else {
-        std::cerr << "Warning: Unknown parameter '" << key
-                  << "' at line " << line_number << std::endl;
+  // 各レイヤーは全体の設定に自分の指定を重ねたもの
+  for (auto& layer : levels) layer.config = config;
+  for (const auto& o : overrides) {
+    auto layer = std::find_if(levels.begin(), levels.end(),
+                              [&o](const LevelLayer& l) {
+                                return l.name == o.layer;
+                              });
+    if (layer == levels.end()) {
+      std::cerr << "Warning: Unknown layer '" << o.layer << "' at line "
+                << o.line_number << std::endl;
+    } else if (!apply_rule(layer->config, o.key, o.value)) {
+      std::cerr << "Warning: Unknown parameter '" << o.key
+                << "' at line " << o.line_number << std::endl;
     }
-
   }
+  if (level_layers) *level_layers = std::move(levels);
 
   file.close();
   return config;
@@ -85,121 +173,324 @@ EasyMRC::Config load_rule_file(const std::string& filename) {
 
 // 使用方法の表示
 void print_usage(const char* program_name) {
-  std::cerr << "Usage: " << program_name << " <input_file> <output_file> <rule_file>\n";
+  std::cerr << "Usage: " << program_name << " [options] <input_file> <output_file> <rule_file>\n";
   std::cerr << "\nArguments:\n";
-  std::cerr << "  input_file      Input image file (PGM, PNG, or PPM format)\n";
+  std::cerr << "  input_file      Input image file (PGM, PNG, or PPM format), or a\n";
+  std::cerr << "                  GDSII layout (.gds), checked cell by cell, or an\n";
+  std::cerr << "                  OASIS layout (.oas), checked flat\n";
   std::cerr << "  output_file     Output violations file (JSON format)\n";
   std::cerr << "  rule_file       Rule configuration file\n";
+  std::cerr << "\nOptions:\n";
+  std::cerr << "  --tiles <C>x<R> Split the layout into C x R tiles checked by\n";
+  std::cerr << "                  separate worker processes\n";
+  std::cerr << "  --jobs <N>      Concurrent tile workers (default: one per CPU)\n";
+  std::cerr << "  --band-rows <N> Stream a binary PGM in bands of N rows instead\n";
+  std::cerr << "                  of loading the whole image\n";
+  std::cerr << "  --gdsii <file>  Also write the extracted polygons to a GDSII\n";
+  std::cerr << "                  file, in the background while checking\n";
+  std::cerr << "  --cache <file>  Keep the decoded polygons of an image or OASIS\n";
+  std::cerr << "                  input in a binary layout cache, reused while\n";
+  std::cerr << "                  the input file is unchanged\n";
+  std::cerr << "  --artifacts <dir>\n";
+  std::cerr << "                  Keep the candidate pairs and sampling data of\n";
+  std::cerr << "                  each layout and rule set in a directory\n";
   std::cerr << "\nRule file format:\n";
   std::cerr << "  # Comment line\n";
   std::cerr << "  rule_distance: 50.0\n";
   std::cerr << "  sampling_multiplier: 4.0\n";
   std::cerr << "  threads: 8  # or 'auto'\n";
+  std::cerr << "  affinity: none  # or 'compact' / 'scatter'\n";
   std::cerr << "  space_check: true\n";
   std::cerr << "  width_check: true\n";
   std::cerr << "  parallel: true\n";
+  std::cerr << "  concurrent_phases: true\n";
+  std::cerr << "  layers: 1, 5/0  # GDSII layers (/datatype) to check, default all\n";
+  std::cerr << "  level.255: metal  # Image gray level checked as a layer\n";
+  std::cerr << "  metal.rule_distance: 30  # Rule of that layer only\n";
   std::cerr << "\nExamples:\n";
   std::cerr << "  " << program_name << " mask.pgm violations.json rules.txt\n";
   std::cerr << "  " << program_name << " test_pattern.pgm results.json my_rules.txt\n";
+  std::cerr << "  " << program_name << " --tiles 4x4 --jobs 8 reticle.pgm violations.json rules.txt\n";
+  std::cerr << "  " << program_name << " --band-rows 4096 wafer.pgm violations.json rules.txt\n";
+  std::cerr << "  " << program_name << " reticle.gds violations.json rules.txt\n";
+  std::cerr << "  " << program_name << " --gdsii mask.gds mask.pgm violations.json rules.txt\n";
+  std::cerr << "  " << program_name << " --cache mask.lcache mask.pgm violations.json rules.txt\n";
+  std::cerr << "  " << program_name << " --artifacts mrc_cache mask.pgm violations.json rules.txt\n";
 }
 
-// JSONログ出力
-void write_json_output(const std::string& filename,
-                      const EasyMRC::Results& results,
-                      double execution_time_ms) {
-  std::ofstream out(filename);
-  if (!out.is_open()) {
-    throw std::runtime_error("Cannot open output file: " + filename);
+// "--tiles 4x3" の解析
+bool parse_tiles(const std::string& value, int& columns, int& rows) {
+  size_t x_pos = value.find('x');
+  if (x_pos == std::string::npos) return false;
+  try {
+    columns = std::stoi(value.substr(0, x_pos));
+    rows = std::stoi(value.substr(x_pos + 1));
+  } catch (const std::exception&) {
+    return false;
   }
+  return columns > 0 && rows > 0;
+}
 
-  out << "{\n";
-  out << "  \"execution_time_ms\": " << execution_time_ms << ",\n";
-  out << "  \"space_violations\": {\n";
-  out << "    \"type_a\": [\n";
+// Ctrl-C / SIGTERM で協調的にキャンセル
+volatile std::sig_atomic_t g_interrupted = 0;
+
+void handle_interrupt(int) {
+  g_interrupted = 1;
+}
+
+// 進捗の表示
+void print_progress(const ProgressSnapshot& progress) {
+  std::cout << "  [" << run_phase_name(progress.phase) << "] pairs "
+            << progress.pairs_done << "/" << progress.pairs_total
+            << ", polygons " << progress.polygons_done << "/"
+            << progress.polygons_total << ", "
+            << (int)(progress.fraction * 100) << "%";
+  if (progress.eta_ms >= 0.0) {
+    std::cout << ", ETA " << progress.eta_ms / 1000.0 << " s";
+  }
+  std::cout << std::endl;
+}
+
+// スレッドごとの負荷分散の表示
+void print_load_stats(const std::string& phase, const LoadStats& stats) {
+  if (stats.busy_ms.empty()) return;
+  std::cout << "  " << phase << " load: " << stats.busy_ms.size()
+            << " threads, busy max " << stats.max_busy_ms()
+            << " ms / mean " << stats.mean_busy_ms()
+            << " ms (imbalance " << stats.imbalance() << ")\n";
+}
+
+// 検査結果の JSON 本体 (違反と集計、各行の先頭に pad)
+void write_results_json(std::ostream& out, const EasyMRC::Results& results,
+                        const std::string& pad) {
+  out << pad << "\"space_violations\": {\n";
+  out << pad << "  \"type_a\": [\n";
 
   for (size_t i = 0; i < results.space_violations_type_a.size(); ++i) {
     const auto& vio = results.space_violations_type_a[i];
-    out << "      {\n";
-    out << "        \"point1\": [" << vio.point1.x() << ", "
+    out << pad << "    {\n";
+    out << pad << "      \"point1\": [" << vio.point1.x() << ", "
         << vio.point1.y() << "],\n";
-    out << "        \"point2\": [" << vio.point2.x() << ", "
+    out << pad << "      \"point2\": [" << vio.point2.x() << ", "
         << vio.point2.y() << "],\n";
-    out << "        \"distance\": " << vio.distance << ",\n";
-    out << "        \"polygon_id_1\": " << vio.polygon_id_1 << ",\n";
-    out << "        \"polygon_id_2\": " << vio.polygon_id_2 << "\n";
-    out << "      }";
+    out << pad << "      \"distance\": " << vio.distance << ",\n";
+    out << pad << "      \"polygon_id_1\": " << vio.polygon_id_1 << ",\n";
+    out << pad << "      \"polygon_id_2\": " << vio.polygon_id_2 << "\n";
+    out << pad << "    }";
     if (i < results.space_violations_type_a.size() - 1) out << ",";
     out << "\n";
   }
 
-  out << "    ],\n";
-  out << "    \"type_b\": [\n";
+  out << pad << "  ],\n";
+  out << pad << "  \"type_b\": [\n";
 
   for (size_t i = 0; i < results.space_violations_type_b.size(); ++i) {
     const auto& vio = results.space_violations_type_b[i];
-    out << "      {\n";
-    out << "        \"point\": [" << vio.point.x() << ", "
+    out << pad << "    {\n";
+    out << pad << "      \"point\": [" << vio.point.x() << ", "
         << vio.point.y() << "],\n";
-    out << "        \"edge\": [[" << vio.edge.start.x() << ", "
+    out << pad << "      \"edge\": [[" << vio.edge.start.x() << ", "
         << vio.edge.start.y() << "], [" << vio.edge.end.x() << ", "
         << vio.edge.end.y() << "]],\n";
-    out << "        \"distance\": " << vio.distance << ",\n";
-    out << "        \"polygon_id_1\": " << vio.polygon_id_1 << ",\n";
-    out << "        \"polygon_id_2\": " << vio.polygon_id_2 << "\n";
-    out << "      }";
+    out << pad << "      \"distance\": " << vio.distance << ",\n";
+    out << pad << "      \"polygon_id_1\": " << vio.polygon_id_1 << ",\n";
+    out << pad << "      \"polygon_id_2\": " << vio.polygon_id_2 << "\n";
+    out << pad << "    }";
     if (i < results.space_violations_type_b.size() - 1) out << ",";
     out << "\n";
   }
 
-  out << "    ]\n";
-  out << "  },\n";
-  out << "  \"width_violations\": [\n";
+  out << pad << "  ]\n";
+  out << pad << "},\n";
+  out << pad << "\"width_violations\": [\n";
 
   for (size_t i = 0; i < results.width_violations.size(); ++i) {
     const auto& vio = results.width_violations[i];
-    out << "    {\n";
-    out << "      \"edge1\": [[" << vio.edge1.start.x() << ", "
+    out << pad << "  {\n";
+    out << pad << "    \"edge1\": [[" << vio.edge1.start.x() << ", "
         << vio.edge1.start.y() << "], [" << vio.edge1.end.x() << ", "
         << vio.edge1.end.y() << "]],\n";
-    out << "      \"edge2\": [[" << vio.edge2.start.x() << ", "
+    out << pad << "    \"edge2\": [[" << vio.edge2.start.x() << ", "
         << vio.edge2.start.y() << "], [" << vio.edge2.end.x() << ", "
         << vio.edge2.end.y() << "]],\n";
-    out << "      \"distance\": " << vio.distance << ",\n";
-    out << "      \"polygon_id\": " << vio.polygon_id << "\n";
-    out << "    }";
+    out << pad << "    \"distance\": " << vio.distance << ",\n";
+    out << pad << "    \"polygon_id\": " << vio.polygon_id << "\n";
+    out << pad << "  }";
     if (i < results.width_violations.size() - 1) out << ",";
     out << "\n";
   }
 
-  out << "  ],\n";
-  out << "  \"summary\": {\n";
-  out << "    \"total_space_violations\": "
+  out << pad << "],\n";
+  out << pad << "\"summary\": {\n";
+  out << pad << "  \"total_space_violations\": "
       << results.total_space_violations() << ",\n";
-  out << "    \"total_width_violations\": "
+  out << pad << "  \"total_width_violations\": "
       << results.width_violations.size() << ",\n";
-  out << "    \"total_violations\": " << results.total_violations() << "\n";
-  out << "  }\n";
+  out << pad << "  \"total_violations\": " << results.total_violations() << "\n";
+  out << pad << "}\n";
+}
+
+// JSONログ出力
+void write_json_output(const std::string& filename,
+                      const EasyMRC::Results& results,
+                      double execution_time_ms) {
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    throw std::runtime_error("Cannot open output file: " + filename);
+  }
+
+  out << "{\n";
+  out << "  \"execution_time_ms\": " << execution_time_ms << ",\n";
+  write_results_json(out, results, "  ");
   out << "}\n";
 
   out.close();
 }
 
+// 階調レイヤーごとの JSON 出力
+void write_layers_json_output(const std::string& filename,
+                              const std::vector<LevelLayer>& layers,
+                              const std::vector<EasyMRC::Results>& results,
+                              double execution_time_ms) {
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    throw std::runtime_error("Cannot open output file: " + filename);
+  }
+
+  out << "{\n";
+  out << "  \"execution_time_ms\": " << execution_time_ms << ",\n";
+  out << "  \"layers\": [\n";
+  for (size_t k = 0; k < layers.size(); ++k) {
+    out << "    {\n";
+    out << "      \"name\": \"" << layers[k].name << "\",\n";
+    out << "      \"level\": " << static_cast<int>(layers[k].level) << ",\n";
+    out << "      \"rule_distance\": " << layers[k].config.rule_distance_R
+        << ",\n";
+    write_results_json(out, results[k], "      ");
+    out << "    }";
+    if (k < layers.size() - 1) out << ",";
+    out << "\n";
+  }
+  out << "  ]\n";
+  out << "}\n";
+
+  out.close();
+}
+
+// 階調レイヤーのチェック: 画像は 1 回だけデコードし、
+// レイヤーごとに自分のルールで検査する
+void run_level_layers(const std::string& input_file,
+                      const std::string& output_file,
+                      const std::vector<LevelLayer>& layers,
+                      int num_threads) {
+  std::vector<unsigned char> levels;
+  for (const auto& layer : layers) levels.push_back(layer.level);
+
+  std::cout << "Loading image file (" << layers.size()
+            << " level layers)...\n";
+  auto decode_start = std::chrono::steady_clock::now();
+  std::vector<std::vector<Polygon>> polygons =
+      format_conversion_levels(input_file, levels, num_threads);
+  auto decode_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - decode_start).count();
+  for (size_t k = 0; k < layers.size(); ++k) {
+    std::cout << "  " << layers[k].name << " (level "
+              << static_cast<int>(layers[k].level) << "): "
+              << polygons[k].size() << " polygons\n";
+  }
+  std::cout << "  Decoded and traced in " << decode_ms << " ms\n\n";
+
+  std::cout << "Running EasyMRC...\n";
+  std::vector<EasyMRC::Results> results;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t k = 0; k < layers.size(); ++k) {
+    EasyMRC checker(layers[k].config);
+    results.push_back(checker.run(polygons[k]));
+    const auto& r = results.back();
+    std::cout << "  " << layers[k].name << ": R = "
+              << layers[k].config.rule_distance_R << ", space "
+              << r.total_space_violations() << ", width "
+              << r.width_violations.size() << ", total "
+              << r.total_violations() << "\n";
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::high_resolution_clock::now() - start);
+  std::cout << "  Execution time: " << duration.count() << " ms\n\n";
+
+  std::cout << "Writing violations to: " << output_file << "\n";
+  write_layers_json_output(output_file, layers, results, duration.count());
+}
+
 int main(int argc, char* argv[]) {
+  // オプションと引数の解析
+  std::vector<std::string> args;
+  bool tiled = false;
+  TiledRunner::Options tile_options;
+  bool streaming = false;
+  StreamingRunner::Options stream_options;
+  std::string gdsii_output;
+  std::string cache_file;
+  std::string artifact_dir;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--tiles" && i + 1 < argc) {
+      if (!parse_tiles(argv[++i], tile_options.columns, tile_options.rows)) {
+        std::cerr << "Error: Invalid tile grid '" << argv[i]
+                  << "' (expected <columns>x<rows>)" << std::endl;
+        return 1;
+      }
+      tiled = true;
+    } else if (arg == "--jobs" && i + 1 < argc) {
+      tile_options.jobs = std::atoi(argv[++i]);
+    } else if (arg == "--band-rows" && i + 1 < argc) {
+      stream_options.band_rows = std::atoi(argv[++i]);
+      if (stream_options.band_rows <= 0) {
+        std::cerr << "Error: Invalid band height '" << argv[i] << "'"
+                  << std::endl;
+        return 1;
+      }
+      streaming = true;
+    } else if (arg == "--gdsii" && i + 1 < argc) {
+      gdsii_output = argv[++i];
+    } else if (arg == "--cache" && i + 1 < argc) {
+      cache_file = argv[++i];
+    } else if (arg == "--artifacts" && i + 1 < argc) {
+      artifact_dir = argv[++i];
+    } else if (arg.size() > 1 && arg[0] == '-') {
+      std::cerr << "Error: Unknown option '" << arg << "'" << std::endl;
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      args.push_back(arg);
+    }
+  }
+
   // 引数チェック
-  if (argc != 4) {
-    std::cerr << "Error: Expected exactly 3 arguments, got " << (argc - 1) << std::endl;
+  if (args.size() != 3) {
+    std::cerr << "Error: Expected exactly 3 arguments, got " << args.size() << std::endl;
     print_usage(argv[0]);
     return 1;
   }
 
-  std::string input_file = argv[1];
-  std::string output_file = argv[2];
-  std::string rule_file = argv[3];
+  if (streaming && tiled) {
+    std::cerr << "Error: --band-rows cannot be combined with --tiles"
+              << std::endl;
+    return 1;
+  }
+
+  std::string input_file = args[0];
+  std::string output_file = args[1];
+  std::string rule_file = args[2];
 
   // 設定ファイル読み込み
   EasyMRC::Config config;
+  std::string layer_spec;
+  LayerSelection layers;
+  std::vector<LevelLayer> level_layers;
   try {
-    config = load_rule_file(rule_file);
+    config = load_rule_file(rule_file, &layer_spec, &level_layers);
+    layers = LayerSelection::parse(layer_spec);
   } catch (const std::exception& e) {
     std::cerr << "Error loading rule file: " << e.what() << std::endl;
     return 1;
@@ -207,9 +498,47 @@ int main(int argc, char* argv[]) {
 
   // 入力ファイルの拡張子チェック
   std::string ext = input_file.substr(input_file.find_last_of(".") + 1);
-  if (ext != "pgm" && ext != "png" && ext != "ppm") {
+  if (ext != "pgm" && ext != "png" && ext != "ppm" && ext != "gds" &&
+      ext != "oas") {
     std::cerr << "Error: Unsupported file type '" << ext << "'. "
-              << "Supported formats: pgm, png, ppm\n";
+              << "Supported formats: pgm, png, ppm, gds, oas\n";
+    return 1;
+  }
+  bool hierarchical = ext == "gds";
+  bool oasis_input = ext == "oas";
+  if (hierarchical && (streaming || tiled)) {
+    std::cerr << "Error: GDSII input cannot be combined with --tiles or "
+              << "--band-rows\n";
+    return 1;
+  }
+  if (!gdsii_output.empty() &&
+      (hierarchical || oasis_input || streaming || tiled)) {
+    std::cerr << "Error: --gdsii requires an image input without --tiles "
+              << "or --band-rows\n";
+    return 1;
+  }
+  if (!cache_file.empty() &&
+      (hierarchical || streaming || !gdsii_output.empty())) {
+    std::cerr << "Error: --cache requires an image or OASIS input without "
+              << "--band-rows or --gdsii\n";
+    return 1;
+  }
+  if (!artifact_dir.empty() && (hierarchical || streaming || tiled ||
+                                !gdsii_output.empty())) {
+    std::cerr << "Error: --artifacts requires an image or OASIS input without "
+              << "--tiles, --band-rows or --gdsii\n";
+    return 1;
+  }
+  if (streaming && ext != "pgm") {
+    std::cerr << "Error: Streaming (--band-rows) requires a binary PGM file\n";
+    return 1;
+  }
+  if (!level_layers.empty() &&
+      ((ext != "pgm" && ext != "png") || streaming || tiled ||
+       !gdsii_output.empty() || !cache_file.empty() ||
+       !artifact_dir.empty())) {
+    std::cerr << "Error: Level layers require a PGM or PNG input without "
+              << "--tiles, --band-rows, --gdsii, --cache or --artifacts\n";
     return 1;
   }
 
@@ -223,31 +552,224 @@ int main(int argc, char* argv[]) {
     std::cout << "  Rule distance: " << config.rule_distance_R << "\n";
     std::cout << "  Sampling multiplier: "
               << config.sampling_radius_multiplier << "\n";
+    const CpuTopology& topology = cpu_topology();
+    std::cout << "  CPUs: " << topology.allowed_cpus.size() << " allowed, "
+              << topology.l3_domains.size() << " L3 domain(s)";
+    if (topology.quota_cpus > 0.0) {
+      std::cout << ", quota " << topology.quota_cpus << " ("
+                << topology.quota_source << ")";
+    }
+    std::cout << "\n";
     std::cout << "  Threads: ";
     if (config.num_threads == 0) {
-      std::cout << "auto (" << std::thread::hardware_concurrency() << ")\n";
+      std::cout << "auto (" << topology.effective_cpus() << ")\n";
     } else {
       std::cout << config.num_threads << "\n";
     }
+    std::cout << "  Affinity: " << affinity_policy_name(config.affinity)
+              << "\n";
     std::cout << "  Space check: "
               << (config.enable_space_check ? "enabled" : "disabled") << "\n";
     std::cout << "  Width check: "
               << (config.enable_width_check ? "enabled" : "disabled") << "\n";
     std::cout << "  Parallel: "
-              << (config.enable_parallel ? "enabled" : "disabled") << "\n\n";
+              << (config.enable_parallel ? "enabled" : "disabled") << "\n";
+    if (!layers.empty()) {
+      std::cout << "  Layers: " << layer_spec
+                << (hierarchical ? "" : " (ignored: GDSII input only)")
+                << "\n";
+      if (hierarchical) {
+        std::cout << "  Layer index: " << GdsiiLayerIndex::sidecar(input_file)
+                  << "\n";
+      }
+    }
+    if (!level_layers.empty()) {
+      std::cout << "  Level layers:";
+      for (const auto& layer : level_layers) {
+        std::cout << " " << layer.name << " ("
+                  << static_cast<int>(layer.level) << ")";
+      }
+      std::cout << "\n";
+    }
+    if (tiled) {
+      std::cout << "  Tiles: " << tile_options.columns << "x"
+                << tile_options.rows << " (jobs: ";
+      if (tile_options.jobs > 0) {
+        std::cout << tile_options.jobs << ")\n";
+      } else {
+        std::cout << "auto)\n";
+      }
+    }
+    if (!cache_file.empty()) {
+      std::cout << "  Layout cache: " << cache_file << "\n";
+    }
+    if (!artifact_dir.empty()) {
+      std::cout << "  Rule artifacts: " << artifact_dir << "\n";
+    }
+    if (streaming) {
+      std::cout << "  Streaming: bands of " << stream_options.band_rows
+                << " rows\n";
+    }
+    std::cout << "\n";
+
+    if (!level_layers.empty()) {
+      run_level_layers(input_file, output_file, level_layers,
+                       config.num_threads);
+      std::cout << "\n========================================\n";
+      std::cout << "EasyMRC completed successfully!\n";
+      std::cout << "========================================\n";
+      return 0;
+    }
 
-    // 画像読み込み → ポリゴン抽出
-    std::cout << "Loading image file...\n";
-    std::vector<Polygon> polygons = format_conversion(input_file);
-    std::cout << "  Polygons extracted: " << polygons.size() << "\n\n";
+    // 画像読み込み → ポリゴン抽出 (ストリーミング時は帯ごとに実行)
+    std::vector<Polygon> polygons;
+    LayoutStore store;
+    GdsiiExport gdsii_export;
+    HierarchicalLayout layout;
+    LayoutCache cache;
+    if (!cache_file.empty() && cache.open(cache_file, input_file)) {
+      // 入力ファイルが変更されていなければキャッシュをそのまま使う
+      std::cout << "Loading layout cache...\n";
+      auto load_start = std::chrono::steady_clock::now();
+      if (tiled) {
+        polygons = cache.polygons(config.num_threads);
+      } else {
+        store = cache.store();
+      }
+      auto load_ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - load_start).count();
+      std::cout << "  Polygons: " << cache.size() << " ("
+                << cache.num_vertices() << " vertices) in " << load_ms
+                << " ms\n\n";
+    } else if (hierarchical) {
+      // layers: の指定があればレイヤーインデックスで必要な要素だけ読む
+      std::cout << "Loading GDSII file...\n";
+      layout = read_gdsii_hierarchy(input_file, 0, layers);
+      std::cout << "  Cells: " << layout.num_cells() << ", flat polygons: "
+                << layout.flat_size(layout.root()) << "\n\n";
+    } else if (oasis_input) {
+      std::cout << "Loading OASIS file...\n";
+      polygons = read_oasis(input_file);
+      std::cout << "  Polygons: " << polygons.size() << "\n\n";
+    } else if (!gdsii_output.empty()) {
+      // GDSII はチェックと並行してバックグラウンドで書き出す
+      std::cout << "Loading image file...\n";
+      gdsii_export = format_conversion_exporting(input_file, gdsii_output);
+      std::cout << "  Polygons extracted: " << gdsii_export.polygons().size()
+                << "\n";
+      std::cout << "  Writing GDSII in the background: " << gdsii_output
+                << "\n\n";
+    } else if (!streaming) {
+      std::cout << "Loading image file...\n";
+      polygons = format_conversion(input_file);
+      std::cout << "  Polygons extracted: " << polygons.size() << "\n\n";
+    }
+    // 単一プロセスのチェックはフラットなストアで行う (ポリゴンは解放)
+    if (!tiled && !hierarchical && !streaming && !cache.is_open() &&
+        !gdsii_export.pending()) {
+      store = LayoutStore(std::move(polygons));
+    }
+    if (!cache_file.empty() && !cache.is_open()) {
+      // キャッシュが無い・古い場合は作り直す (失敗してもチェックは続行)
+      try {
+        if (tiled) {
+          LayoutCache::write(polygons, cache_file, input_file);
+        } else {
+          LayoutCache::write(store, cache_file, input_file);
+        }
+        std::cout << "Layout cache written: " << cache_file << "\n\n";
+      } catch (const std::exception& e) {
+        std::cerr << "Warning: " << e.what() << "\n\n";
+      }
+    }
+    PolygonSource source = tiled ? PolygonSource(polygons)
+                                 : PolygonSource(store);
+
+    // 候補ペアとサンプリング情報はレイアウトとルールが同じなら再利用
+    RuleArtifacts artifacts;
+    uint64_t content_hash = 0;
+    if (!artifact_dir.empty()) {
+      auto artifact_start = std::chrono::steady_clock::now();
+      content_hash = cache.is_open() ? cache.content_hash()
+                                     : LayoutCache::layout_hash(source);
+      RuleArtifacts::Key key(content_hash, config.rule_distance_R,
+                             config.sampling_radius_multiplier);
+      std::string artifact_file = RuleArtifacts::filename(artifact_dir, key);
+      bool reused = artifacts.load(artifact_file, key, source.size());
+      if (!reused) {
+        artifacts = RuleArtifacts::compute(source, key, config.num_threads);
+        ::mkdir(artifact_dir.c_str(), 0755);
+        try {
+          artifacts.save(artifact_file);
+        } catch (const std::exception& e) {
+          std::cerr << "Warning: " << e.what() << "\n";
+        }
+      }
+      auto artifact_ms = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - artifact_start).count();
+      std::cout << "Rule artifacts " << (reused ? "loaded" : "computed")
+                << ": " << artifacts.pairs().size() << " candidate pairs in "
+                << artifact_ms << " ms\n\n";
+    }
 
     // MRC を実行
     std::cout << "Running EasyMRC...\n";
 
-    EasyMRC checker(config);
-
+    EasyMRC::Results results;
     auto start = std::chrono::high_resolution_clock::now();
-    auto results = checker.run(polygons);
+
+    if (hierarchical) {
+      // セル単位のチェック + 配置間の相互作用のみ展開
+      HierarchicalChecker checker(config);
+      HierarchicalResults cell_results = checker.run(layout);
+      results = cell_results.flatten();
+      const auto& stats = checker.statistics();
+      std::cout << "  Cells: " << stats.cells << ", polygons checked: "
+                << stats.cell_polygons << " of " << stats.flat_polygons
+                << "\n";
+      std::cout << "  Interactions: " << stats.unique_interactions
+                << " checked of " << stats.interactions << " ("
+                << stats.interaction_polygons << " polygons flattened)\n";
+    } else if (streaming) {
+      // 帯単位の読み込み + 逐次チェック
+      StreamingRunner runner(config, stream_options);
+      results = runner.run(input_file);
+      const auto& stats = runner.statistics();
+      std::cout << "  Bands: " << stats.bands << ", polygons: "
+                << stats.polygons << ", candidate pairs: "
+                << stats.candidate_pairs << "\n";
+      std::cout << "  Band buffer: " << stats.band_bytes / 1024
+                << " KiB, max carried runs: " << stats.max_open_runs
+                << ", max retained polygons: "
+                << stats.max_retained_polygons << "\n";
+    } else if (tiled) {
+      // タイル分割 + ワーカープロセス
+      TiledRunner runner(config, tile_options);
+      results = runner.run(std::move(polygons));
+      std::cout << "  Tiles: " << runner.statistics().tiles << ", jobs: "
+                << runner.statistics().jobs << ", max polygons per tile: "
+                << runner.statistics().max_tile_polygons << "\n";
+    } else {
+      EasyMRC checker(config);
+      std::signal(SIGINT, handle_interrupt);
+      std::signal(SIGTERM, handle_interrupt);
+
+      // GDSII 書き出し中は、書き出し完了後に結果が確定する
+      EasyMRC::RunHandle handle;
+      if (gdsii_export.pending()) {
+        handle = checker.run_async(std::move(gdsii_export));
+      } else if (!artifact_dir.empty()) {
+        handle = checker.run_async(source, artifacts, content_hash);
+      } else {
+        handle = checker.run_async(source);
+      }
+      while (!handle.wait_for(std::chrono::seconds(1))) {
+        if (g_interrupted) handle.cancel();
+        print_progress(handle.progress());
+      }
+      results = handle.get();
+    }
+
     auto end = std::chrono::high_resolution_clock::now();
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -261,18 +783,36 @@ int main(int argc, char* argv[]) {
               << results.space_violations_type_b.size() << "\n";
     std::cout << "  Width violations: "
               << results.width_violations.size() << "\n";
-    std::cout << "  Total violations: " << results.total_violations() << "\n\n";
+    std::cout << "  Total violations: " << results.total_violations() << "\n";
+    print_load_stats("Space", results.space_load);
+    print_load_stats("Width", results.width_load);
+    if (!results.gdsii_file.empty()) {
+      if (results.gdsii_written()) {
+        std::cout << "  GDSII written: " << results.gdsii_file << "\n";
+      } else {
+        std::cout << "  GDSII write failed: " << results.gdsii_error << "\n";
+      }
+    }
+    std::cout << "\n";
 
     // JSONファイルへ出力
     std::cout << "Writing violations to: " << output_file << "\n";
     write_json_output(output_file, results, duration.count());
 
+    if (!results.gdsii_file.empty() && !results.gdsii_written()) {
+      std::cerr << "\nError: " << results.gdsii_error << std::endl;
+      return 1;
+    }
+
     std::cout << "\n========================================\n";
     std::cout << "EasyMRC completed successfully!\n";
     std::cout << "========================================\n";
 
     return 0;
 
+  } catch (const RunCancelled&) {
+    std::cerr << "\nInterrupted: run cancelled" << std::endl;
+    return 130;
   } catch (const std::exception& e) {
     std::cerr << "\nError: " << e.what() << std::endl;
     return 1;
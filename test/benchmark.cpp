@@ -0,0 +1,845 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <fstream>
+#include <cstdio>
+
+#include "../src/easymrc/easymrc.hpp"
+#include "../src/easymrc/streaming.hpp"
+#include "../src/easymrc/hierarchy.hpp"
+#include "../src/easymrc/layout_cache.hpp"
+
+#include <sys/resource.h>
+
+using namespace easymrc;
+
+// EasyMRC micro-benchmarks
+// Usage: easymrc_bench [benchmark...]   (default: all)
+
+// Count every global heap allocation made by the process. Every form of
+// the global operators is replaced, all on malloc and free, so that none
+// is paired with the library's own counterpart.
+static std::atomic<size_t> g_allocations(0);
+
+// Null when out of memory
+static void* counted_alloc(std::size_t size, std::size_t align) noexcept {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (align <= alignof(std::max_align_t)) return std::malloc(size ? size : 1);
+  size = (size + align - 1) / align * align;
+  return std::aligned_alloc(align, size ? size : align);
+}
+
+static void* counted_new(std::size_t size, std::size_t align) {
+  if (void* ptr = counted_alloc(size, align)) return ptr;
+  throw std::bad_alloc();
+}
+
+static void counted_delete(void* ptr) noexcept { std::free(ptr); }
+
+void* operator new(std::size_t size) { return counted_new(size, 1); }
+void* operator new[](std::size_t size) { return counted_new(size, 1); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, 1);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return counted_alloc(size, 1);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+  return counted_new(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+  return counted_new(size, static_cast<std::size_t>(align));
+}
+void* operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t&) noexcept {
+  return counted_alloc(size, static_cast<std::size_t>(align));
+}
+void* operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t&) noexcept {
+  return counted_alloc(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void* ptr) noexcept { counted_delete(ptr); }
+void operator delete[](void* ptr) noexcept { counted_delete(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { counted_delete(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept {
+  counted_delete(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  counted_delete(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  counted_delete(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  counted_delete(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  counted_delete(ptr);
+}
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  counted_delete(ptr);
+}
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept {
+  counted_delete(ptr);
+}
+void operator delete(void* ptr, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  counted_delete(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  counted_delete(ptr);
+}
+
+// Staircase polygons of varying complexity placed on a grid, close enough
+// to their neighbours that every adjacent pair becomes a candidate
+std::vector<Polygon> make_staircase_layout(int columns, int rows) {
+  std::vector<Polygon> polygons;
+  int id = 0;
+  for (int row = 0; row < rows; ++row) {
+    for (int col = 0; col < columns; ++col) {
+      Polygon poly(id);
+      int steps = 2 + ((row * 7 + col * 13) % 9) * ((col % 5 == 0) ? 12 : 2);
+      int x0 = col * 130;
+      int y0 = row * 130;
+      poly.add_vertex(Point(x0, y0));
+      for (int s = 0; s < steps; ++s) {
+        int x = x0 + 120 - s * 100 / steps;
+        poly.add_vertex(Point(x, y0 + s * 120 / steps));
+        poly.add_vertex(Point(x, y0 + (s + 1) * 120 / steps));
+      }
+      poly.add_vertex(Point(x0, y0 + 120));
+      poly.build_segments();
+      polygons.push_back(poly);
+      id++;
+    }
+  }
+  return polygons;
+}
+
+std::vector<int> thread_counts() {
+  std::vector<int> counts;
+  int max_threads = resolve_num_threads(0);
+  for (int t = 1; t < max_threads; t *= 2) counts.push_back(t);
+  counts.push_back(max_threads);
+  return counts;
+}
+
+// Global allocations per second and thread scaling, with and without the
+// per-worker arenas
+void bench_arena() {
+  std::cout << "\n=== Benchmark: Per-Worker Arena ===" << std::endl;
+
+  auto polygons = make_staircase_layout(24, 24);
+  double R = 30.0;
+  auto pairs = candidate_pair_generation(polygons, R);
+  std::cout << "  Polygons: " << polygons.size()
+            << ", candidate pairs: " << pairs.size() << std::endl;
+
+  std::cout << "  " << std::setw(8) << "arena" << std::setw(9) << "threads"
+            << std::setw(12) << "time ms" << std::setw(14) << "allocs"
+            << std::setw(14) << "allocs/s" << std::setw(10) << "speedup"
+            << std::endl;
+
+  for (bool use_arena : {false, true}) {
+    double base_ms = 0.0;
+    for (int threads : thread_counts()) {
+      ParallelOptions options;
+      options.num_threads = threads;
+      options.arena_block_size = use_arena ? 256 * 1024 : 0;
+
+      std::vector<Violation> violations_a;
+      std::vector<ViolationTypeB> violations_b;
+      ParallelSpaceChecker checker(polygons, pairs, R, 4.0, options);
+
+      size_t allocs_before = g_allocations.load();
+      auto start = std::chrono::steady_clock::now();
+      checker.check_parallel(violations_a, violations_b);
+      double ms = elapsed_ms(start);
+      size_t allocs = g_allocations.load() - allocs_before;
+
+      if (threads == 1) base_ms = ms;
+      std::cout << "  " << std::setw(8) << (use_arena ? "on" : "off")
+                << std::setw(9) << threads
+                << std::setw(12) << std::fixed << std::setprecision(1) << ms
+                << std::setw(14) << allocs
+                << std::setw(14) << std::setprecision(0)
+                << (ms > 0 ? allocs / (ms / 1000.0) : 0.0)
+                << std::setw(9) << std::setprecision(2)
+                << (ms > 0 ? base_ms / ms : 0.0) << "x" << std::endl;
+    }
+  }
+}
+
+// Wall time of EasyMRC::run with the space and width phases run one after
+// the other versus overlapped in one task graph
+void bench_phases() {
+  std::cout << "\n=== Benchmark: Space/Width Phase Overlap ===" << std::endl;
+
+  auto polygons = make_staircase_layout(24, 24);
+  std::cout << "  Polygons: " << polygons.size() << std::endl;
+
+  std::cout << "  " << std::setw(12) << "threads" << std::setw(16)
+            << "sequential ms" << std::setw(16) << "overlapped ms"
+            << std::setw(10) << "gain" << std::endl;
+
+  for (int threads : thread_counts()) {
+    double ms[2];
+    size_t violations[2];
+    for (int overlap = 0; overlap < 2; ++overlap) {
+      EasyMRC::Config config;
+      config.rule_distance_R = 30.0;
+      config.num_threads = threads;
+      config.concurrent_phases = (overlap == 1);
+
+      auto start = std::chrono::steady_clock::now();
+      auto results = EasyMRC(config).run(polygons);
+      ms[overlap] = elapsed_ms(start);
+      violations[overlap] = results.total_violations();
+    }
+    if (violations[0] != violations[1]) {
+      throw std::runtime_error("Phase overlap changed the violation count");
+    }
+
+    std::cout << "  " << std::setw(12) << threads
+              << std::setw(16) << std::fixed << std::setprecision(1) << ms[0]
+              << std::setw(16) << ms[1]
+              << std::setw(9) << std::setprecision(2)
+              << (ms[1] > 0 ? ms[0] / ms[1] : 0.0) << "x" << std::endl;
+  }
+}
+
+// Write a size x size PGM of stripes and squares
+void write_bench_pgm(const std::string& filename, int size, bool binary) {
+  std::ofstream out(filename, std::ios::binary);
+  out << (binary ? "P5" : "P2") << "\n" << size << " " << size << "\n255\n";
+  std::string line;
+  for (int y = 0; y < size; ++y) {
+    line.clear();
+    for (int x = 0; x < size; ++x) {
+      bool mask = ((x / 16) % 3 == 0) || ((y / 24) % 4 == 0 && x % 40 < 30);
+      if (binary) {
+        line.push_back(mask ? char(255) : char(0));
+      } else {
+        line += mask ? "255 " : "0 ";
+      }
+    }
+    if (!binary) line.push_back('\n');
+    out << line;
+  }
+}
+
+// Load time of the stream reader versus the mapped reader. Both times
+// include one pass over every pixel, since mapped pages are only read when
+// touched.
+void bench_pgm() {
+  std::cout << "\n=== Benchmark: PGM Loading ===" << std::endl;
+
+  struct Case {
+    const char* name;
+    std::string file;
+    int size;
+    bool binary;
+  };
+  std::vector<Case> cases = {{"P5", "bench_p5.pgm", 8000, true},
+                             {"P2", "bench_p2.pgm", 4000, false}};
+
+  std::cout << "  " << std::setw(6) << "format" << std::setw(10) << "MB"
+            << std::setw(14) << "stream ms" << std::setw(14) << "mapped ms"
+            << std::setw(14) << "stream MB/s" << std::setw(14)
+            << "mapped MB/s" << std::setw(10) << "speedup" << std::endl;
+
+  auto checksum = [](const Image& img) {
+    size_t sum = 0;
+    for (int y = 0; y < img.height; ++y) {
+      const unsigned char* row = img.row(y);
+      for (int x = 0; x < img.width; ++x) sum += row[x];
+    }
+    return sum;
+  };
+
+  for (const auto& c : cases) {
+    write_bench_pgm(c.file, c.size, c.binary);
+    double mb = 0.0;
+    {
+      std::ifstream in(c.file, std::ios::binary | std::ios::ate);
+      mb = in.tellg() / (1024.0 * 1024.0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Image stream_img = read_pgm_stream(c.file);
+    size_t stream_sum = checksum(stream_img);
+    double stream_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    Image mapped_img = read_pgm_mapped(c.file);
+    size_t mapped_sum = checksum(mapped_img);
+    double mapped_ms = elapsed_ms(start);
+
+    if (stream_sum != mapped_sum) {
+      throw std::runtime_error("PGM readers disagree on " + c.file);
+    }
+
+    std::cout << "  " << std::setw(6) << c.name << std::setw(10)
+              << std::fixed << std::setprecision(1) << mb
+              << std::setw(14) << stream_ms << std::setw(14) << mapped_ms
+              << std::setw(14) << mb / (stream_ms / 1000.0)
+              << std::setw(14) << mb / (mapped_ms / 1000.0)
+              << std::setw(9) << std::setprecision(2)
+              << stream_ms / mapped_ms << "x" << std::endl;
+    std::remove(c.file.c_str());
+  }
+}
+
+// Byte image versus bit-packed mask: thresholding cost, memory, and a
+// neighbour test (mask pixels whose right neighbour is background) done
+// per pixel with is_mask_pixel versus 64 pixels per word operation
+void bench_bitimage() {
+  std::cout << "\n=== Benchmark: Bit-Packed Mask ===" << std::endl;
+
+  const int size = 8000;
+  write_bench_pgm("bench_bits.pgm", size, true);
+  Image img = read_pgm_mapped("bench_bits.pgm");
+
+  auto start = std::chrono::steady_clock::now();
+  BitImage bits = BitImage::threshold(img);
+  double threshold_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  size_t byte_edges = 0;
+  for (int y = 0; y < img.height; ++y) {
+    for (int x = 0; x < img.width; ++x) {
+      byte_edges += img.is_mask_pixel(x, y) && !img.is_mask_pixel(x + 1, y);
+    }
+  }
+  double byte_ms = elapsed_ms(start);
+
+  start = std::chrono::steady_clock::now();
+  size_t bit_edges = 0;
+  for (int y = 0; y < bits.height(); ++y) {
+    const uint64_t* row = bits.row(y);
+    for (int w = 0; w < bits.row_words(); ++w) {
+      uint64_t right = (row[w] >> 1) | (row[w + 1] << 63);
+      bit_edges += __builtin_popcountll(row[w] & ~right);
+    }
+  }
+  double bit_ms = elapsed_ms(start);
+
+  if (byte_edges != bit_edges) {
+    throw std::runtime_error("Bit-packed neighbour test disagrees");
+  }
+
+  double pixels = static_cast<double>(size) * size;
+  std::cout << "  image " << size << "x" << size << ", " << std::fixed
+            << std::setprecision(1) << pixels / (1024 * 1024)
+            << " MB as bytes, " << bits.bytes() / (1024.0 * 1024.0)
+            << " MB as bits" << std::endl;
+  std::cout << "  threshold (SIMD)    " << std::setw(10) << threshold_ms
+            << " ms  (" << pixels / 1e6 / (threshold_ms / 1000.0)
+            << " Mpixel/s)" << std::endl;
+  std::cout << "  neighbour test      " << std::setw(10) << byte_ms
+            << " ms bytes, " << bit_ms << " ms words  ("
+            << std::setprecision(2) << byte_ms / bit_ms << "x)" << std::endl;
+  std::remove("bench_bits.pgm");
+}
+
+// Scanline extraction time on two masks of the same size: time follows the
+// number of runs, not the number of pixels
+void bench_extract() {
+  std::cout << "\n=== Benchmark: Scanline Polygon Extraction ===" << std::endl;
+
+  const int size = 8000;
+  struct Case {
+    const char* name;
+    int period;  // Square pitch in pixels
+  };
+  std::vector<Case> cases = {{"fine", 12}, {"coarse", 400}};
+
+  std::cout << "  " << std::setw(8) << "mask" << std::setw(12) << "runs"
+            << std::setw(12) << "polygons" << std::setw(10) << "threads"
+            << std::setw(12) << "label ms" << std::setw(12) << "total ms"
+            << std::setw(14) << "Mruns/s" << std::endl;
+
+  for (const auto& c : cases) {
+    // Squares of 2/3 pitch with a bridge every fourth row of squares
+    BitImage mask(size, size);
+    for (int y = 0; y < size; ++y) {
+      bool bridge = (y / c.period) % 4 == 0;
+      for (int x = 0; x < size; ++x) {
+        int px = x % c.period, py = y % c.period;
+        if ((px < c.period * 2 / 3 && py < c.period * 2 / 3) ||
+            (bridge && py < c.period / 3)) {
+          mask.set(x, y);
+        }
+      }
+    }
+
+    for (int threads : thread_counts()) {
+      auto start = std::chrono::steady_clock::now();
+      { ComponentLabeling labeling(mask, threads); }
+      double label_ms = elapsed_ms(start);
+
+      ScanlineExtractor extractor(mask, threads);
+      start = std::chrono::steady_clock::now();
+      auto polygons = extractor.extract();
+      double ms = elapsed_ms(start);
+      const auto& stats = extractor.statistics();
+
+      std::cout << "  " << std::setw(8) << c.name << std::setw(12)
+                << stats.runs << std::setw(12) << polygons.size()
+                << std::setw(10) << threads << std::setw(12) << std::fixed
+                << std::setprecision(1) << label_ms << std::setw(12) << ms
+                << std::setw(14)
+                << std::setprecision(2) << stats.runs / 1e3 / ms
+                << std::endl;
+    }
+  }
+}
+
+// Peak resident set size of the process so far
+size_t peak_rss_mb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) / 1024;
+}
+
+// Streaming a large P5 mask in bands versus loading it whole. Streaming
+// runs first, since peak RSS only ever grows.
+void bench_stream() {
+  std::cout << "\n=== Benchmark: Out-of-Core Banded Processing ===" << std::endl;
+
+  // 30x30 squares at a pitch of 40 pixels
+  const int size = 6000;
+  {
+    std::ofstream out("bench_stream.pgm", std::ios::binary);
+    out << "P5\n" << size << " " << size << "\n255\n";
+    std::string line(size, 0);
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        line[x] = (x % 40 < 30 && y % 40 < 30) ? char(255) : char(0);
+      }
+      out << line;
+    }
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 12.0;
+  size_t base_rss = peak_rss_mb();
+
+  StreamingRunner::Options options;
+  options.band_rows = 256;
+  StreamingRunner runner(config, options);
+  auto start = std::chrono::steady_clock::now();
+  auto streamed = runner.run("bench_stream.pgm");
+  double stream_ms = elapsed_ms(start);
+  size_t stream_rss = peak_rss_mb();
+
+  start = std::chrono::steady_clock::now();
+  auto polygons = format_conversion("bench_stream.pgm");
+  auto loaded = EasyMRC(config).run(polygons);
+  double load_ms = elapsed_ms(start);
+  size_t load_rss = peak_rss_mb();
+
+  if (streamed.total_violations() != loaded.total_violations()) {
+    throw std::runtime_error("Streaming and in-memory runs disagree");
+  }
+
+  const auto& stats = runner.statistics();
+  std::cout << "  image " << size << "x" << size << ", " << stats.polygons
+            << " polygons, " << loaded.total_violations() << " violations"
+            << std::endl;
+  std::cout << "  streaming (" << options.band_rows << " rows): "
+            << std::fixed << std::setprecision(1) << stream_ms
+            << " ms, band buffer " << stats.band_bytes / 1024 << " KiB, "
+            << stats.max_retained_polygons << " polygons retained, "
+            << "peak RSS +" << stream_rss - base_rss << " MB" << std::endl;
+  std::cout << "  in memory:            " << load_ms << " ms, peak RSS +"
+            << load_rss - base_rss << " MB" << std::endl;
+  std::remove("bench_stream.pgm");
+}
+
+// GDSII loading: stream reader versus the memory-mapped reader, on a file
+// of EASYMRC_BENCH_GDSII_MB megabytes (default 256) of 1000-vertex
+// boundaries, one per structure
+void bench_gdsii() {
+  std::cout << "\n=== Benchmark: GDSII Loading ===" << std::endl;
+
+  size_t target_mb = 256;
+  if (const char* env = std::getenv("EASYMRC_BENCH_GDSII_MB")) {
+    target_mb = std::strtoul(env, nullptr, 10);
+  }
+  const int vertices = 1000;
+  const size_t structure_bytes = 28 + 14 + 4 + 6 + 6 + 4 +
+                                 (vertices + 1) * 8 + 4 + 4;
+  const size_t structures = target_mb * 1024 * 1024 / structure_bytes;
+  {
+    std::ofstream out("bench.gds", std::ios::binary);
+    gdsii::write_record_header(out, 6, gdsii::HEADER, gdsii::INT16);
+    gdsii::write_int16(out, 600);
+    for (size_t s = 0; s < structures; ++s) {
+      gdsii::write_record_header(out, 28, gdsii::BGNSTR, gdsii::INT16);
+      for (int i = 0; i < 12; ++i) gdsii::write_int16(out, 0);
+      gdsii::write_record_header(out, 14, gdsii::STRNAME, gdsii::ASCII);
+      gdsii::write_string(out, "POLY_BENCH");
+      gdsii::write_record_header(out, 4, gdsii::BOUNDARY, gdsii::NO_DATA);
+      gdsii::write_record_header(out, 6, gdsii::LAYER, gdsii::INT16);
+      gdsii::write_int16(out, 0);
+      gdsii::write_record_header(out, 6, gdsii::DATATYPE, gdsii::INT16);
+      gdsii::write_int16(out, 0);
+      gdsii::write_record_header(out, 4 + (vertices + 1) * 8, gdsii::XY,
+                                 gdsii::INT32);
+      // Staircase: alternating horizontal and vertical steps
+      int x0 = static_cast<int>(s % 1000) * 20000;
+      int y0 = static_cast<int>(s / 1000) * 20000;
+      for (int v = 0; v <= vertices; ++v) {
+        int k = v % vertices;
+        gdsii::write_int32(out, x0 + (k + 1) / 2 * 10);
+        gdsii::write_int32(out, y0 + k / 2 * 10);
+      }
+      gdsii::write_record_header(out, 4, gdsii::ENDEL, gdsii::NO_DATA);
+      gdsii::write_record_header(out, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+    }
+    gdsii::write_record_header(out, 4, gdsii::ENDLIB, gdsii::NO_DATA);
+  }
+
+  double mb = 0.0;
+  {
+    std::ifstream in("bench.gds", std::ios::binary | std::ios::ate);
+    mb = in.tellg() / (1024.0 * 1024.0);
+  }
+
+  auto checksum = [](const std::vector<Polygon>& polygons) {
+    size_t sum = 0;
+    for (const auto& poly : polygons) {
+      for (const auto& v : poly.vertices) sum += v.x() * 3 + v.y();
+    }
+    return sum;
+  };
+
+  // Results are released between runs to keep peak memory to one copy
+  auto start = std::chrono::steady_clock::now();
+  size_t stream_sum = checksum(read_gdsii_stream("bench.gds"));
+  double stream_ms = elapsed_ms(start);
+
+  std::cout << "  " << structures << " structures, " << std::fixed
+            << std::setprecision(1) << mb << " MB" << std::endl;
+  std::cout << "  stream:         " << std::setw(9) << stream_ms << " ms "
+            << std::setw(9) << mb / (stream_ms / 1000.0) << " MB/s"
+            << std::endl;
+  for (int threads : thread_counts()) {
+    start = std::chrono::steady_clock::now();
+    size_t mapped_sum = checksum(read_gdsii_mapped("bench.gds", threads));
+    double mapped_ms = elapsed_ms(start);
+    if (mapped_sum != stream_sum) {
+      throw std::runtime_error("GDSII readers disagree");
+    }
+    std::cout << "  mapped, " << std::setw(2) << threads << " thr: "
+              << std::setw(9) << mapped_ms << " ms " << std::setw(9)
+              << mb / (mapped_ms / 1000.0) << " MB/s  (" << std::setprecision(2)
+              << stream_ms / mapped_ms << "x)" << std::setprecision(1)
+              << std::endl;
+  }
+  std::remove("bench.gds");
+}
+
+// GDSII writing: stream writer versus the buffered writer, for about 64 MB
+// of 1000-vertex polygons (EASYMRC_BENCH_GDSII_MB / 4)
+void bench_gdsii_write() {
+  std::cout << "\n=== Benchmark: GDSII Writing ===" << std::endl;
+
+  size_t target_mb = 256;
+  if (const char* env = std::getenv("EASYMRC_BENCH_GDSII_MB")) {
+    target_mb = std::strtoul(env, nullptr, 10);
+  }
+  const int vertices = 1000;
+  const size_t count = target_mb / 4 * 1024 * 1024 / ((vertices + 1) * 8);
+  std::vector<Polygon> polygons(count);
+  for (size_t s = 0; s < count; ++s) {
+    polygons[s].id = static_cast<int>(s);
+    polygons[s].vertices.reserve(vertices);
+    int x0 = static_cast<int>(s % 1000) * 20000;
+    int y0 = static_cast<int>(s / 1000) * 20000;
+    for (int k = 0; k < vertices; ++k) {
+      polygons[s].vertices.emplace_back(x0 + (k + 1) / 2 * 10,
+                                        y0 + k / 2 * 10);
+    }
+  }
+
+  auto file_mb = []() {
+    std::ifstream in("bench_write.gds", std::ios::binary | std::ios::ate);
+    return in.tellg() / (1024.0 * 1024.0);
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  write_gdsii_stream(polygons, "bench_write.gds");
+  double stream_ms = elapsed_ms(start);
+  double mb = file_mb();
+
+  std::cout << "  " << count << " structures, " << std::fixed
+            << std::setprecision(1) << mb << " MB" << std::endl;
+  std::cout << "  stream:           " << std::setw(9) << stream_ms << " ms "
+            << std::setw(9) << mb / (stream_ms / 1000.0) << " MB/s"
+            << std::endl;
+  for (int threads : thread_counts()) {
+    start = std::chrono::steady_clock::now();
+    write_gdsii_buffered(polygons, "bench_write.gds", threads);
+    double buffered_ms = elapsed_ms(start);
+    if (file_mb() != mb) {
+      throw std::runtime_error("GDSII writers disagree");
+    }
+    std::cout << "  buffered, " << std::setw(2) << threads << " thr: "
+              << std::setw(9) << buffered_ms << " ms " << std::setw(9)
+              << mb / (buffered_ms / 1000.0) << " MB/s  ("
+              << std::setprecision(2) << stream_ms / buffered_ms << "x)"
+              << std::setprecision(1) << std::endl;
+  }
+  std::remove("bench_write.gds");
+}
+
+// Startup from a P5 mask (decode and trace) versus the binary layout cache
+// of its polygons: opening the mapping and viewing it as a LayoutStore,
+// then copying the polygons out
+void bench_layout_cache() {
+  std::cout << "\n=== Benchmark: Binary Layout Cache ===" << std::endl;
+
+  const int size = 8000, period = 12;
+  {
+    std::ofstream out("bench_cache.pgm", std::ios::binary);
+    out << "P5\n" << size << " " << size << "\n255\n";
+    std::string line(size, char(0));
+    for (int y = 0; y < size; ++y) {
+      for (int x = 0; x < size; ++x) {
+        bool mask = x % period < period * 2 / 3 && y % period < period * 2 / 3;
+        line[x] = mask ? char(255) : char(0);
+      }
+      out << line;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Polygon> polygons = format_conversion("bench_cache.pgm");
+  double convert_ms = elapsed_ms(start);
+  LayoutCache::write(polygons, "bench_cache.lcache", "bench_cache.pgm");
+
+  LayoutCache cache;
+  start = std::chrono::steady_clock::now();
+  if (!cache.open("bench_cache.lcache", "bench_cache.pgm")) {
+    throw std::runtime_error("Layout cache not reusable");
+  }
+  double open_ms = elapsed_ms(start);
+  LayoutStore store = cache.store();
+  size_t vertices = 0;
+  for (size_t i = 0; i < store.size(); ++i) vertices += store[i].size();
+  double view_ms = elapsed_ms(start);
+
+  std::cout << "  " << polygons.size() << " polygons, " << vertices
+            << " vertices" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  PGM decode + trace:    " << std::setw(9) << convert_ms
+            << " ms" << std::endl;
+  std::cout << "  cache open:            " << std::setw(9) << open_ms
+            << " ms" << std::endl;
+  std::cout << "  cache open + store():  " << std::setw(9) << view_ms
+            << " ms" << std::endl;
+  for (int threads : thread_counts()) {
+    start = std::chrono::steady_clock::now();
+    std::vector<Polygon> loaded = cache.polygons(threads);
+    double load_ms = elapsed_ms(start);
+    if (loaded.size() != polygons.size()) {
+      throw std::runtime_error("Layout cache disagrees with the mask");
+    }
+    std::cout << "  polygons(), " << std::setw(2) << threads << " thr:  "
+              << std::setw(9) << load_ms << " ms  (" << std::setprecision(2)
+              << convert_ms / (open_ms + load_ms) << "x)"
+              << std::setprecision(1) << std::endl;
+  }
+  std::remove("bench_cache.pgm");
+  std::remove("bench_cache.lcache");
+}
+
+// Candidate sweep and sampling estimates computed for a layout versus
+// mapped back from its saved rule artifacts
+void bench_artifacts() {
+  std::cout << "\n=== Benchmark: Rule Artifact Cache ===" << std::endl;
+
+  std::vector<Polygon> polygons = make_staircase_layout(400, 400);
+  RuleArtifacts::Key key(LayoutCache::layout_hash(polygons), 50.0, 4.0);
+  const std::string file = RuleArtifacts::filename(".", key);
+
+  auto start = std::chrono::steady_clock::now();
+  RuleArtifacts computed = RuleArtifacts::compute(polygons, key);
+  double compute_ms = elapsed_ms(start);
+  computed.save(file);
+
+  start = std::chrono::steady_clock::now();
+  uint64_t hash = LayoutCache::layout_hash(polygons);
+  double hash_ms = elapsed_ms(start);
+
+  RuleArtifacts loaded;
+  start = std::chrono::steady_clock::now();
+  if (hash != key.content_hash || !loaded.load(file, key, polygons.size())) {
+    throw std::runtime_error("Rule artifacts not reusable");
+  }
+  double load_ms = elapsed_ms(start);
+
+  std::cout << "  " << polygons.size() << " polygons, "
+            << computed.pairs().size() << " candidate pairs" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  computed:       " << std::setw(9) << compute_ms << " ms"
+            << std::endl;
+  std::cout << "  layout hash:    " << std::setw(9) << hash_ms << " ms"
+            << std::endl;
+  std::cout << "  loaded:         " << std::setw(9) << load_ms << " ms  ("
+            << std::setprecision(2) << compute_ms / (hash_ms + load_ms)
+            << "x with the hash)" << std::endl;
+  std::remove(file.c_str());
+}
+
+// Memory and check time of a layout held as std::vector<Polygon> versus
+// the flat LayoutStore built from it
+void bench_layout_store() {
+  std::cout << "\n=== Benchmark: Flat Layout Store ===" << std::endl;
+
+  std::vector<Polygon> polygons = make_staircase_layout(150, 150);
+  size_t allocs_before = g_allocations.load();
+  LayoutStore store(polygons);
+  size_t store_allocs = g_allocations.load() - allocs_before;
+
+  std::cout << "  " << store.size() << " polygons, " << store.num_vertices()
+            << " vertices" << std::endl;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "  vector<Polygon>: " << std::setw(9)
+            << LayoutStore::bytes(polygons) / 1048576.0 << " MiB, "
+            << 1 + 2 * polygons.size() << " allocations" << std::endl;
+  std::cout << "  LayoutStore:     " << std::setw(9)
+            << store.bytes() / 1048576.0 << " MiB, " << store_allocs
+            << " allocations" << std::endl;
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 50.0;
+  auto start = std::chrono::steady_clock::now();
+  auto pairs = candidate_pair_generation(polygons, config.rule_distance_R);
+  double vector_pairs_ms = elapsed_ms(start);
+  start = std::chrono::steady_clock::now();
+  auto store_pairs = candidate_pair_generation(store, config.rule_distance_R);
+  double store_pairs_ms = elapsed_ms(start);
+  if (pairs != store_pairs) {
+    throw std::runtime_error("Store and vector candidate pairs disagree");
+  }
+
+  start = std::chrono::steady_clock::now();
+  size_t vector_violations = EasyMRC(config).run(polygons).total_violations();
+  double vector_ms = elapsed_ms(start);
+  start = std::chrono::steady_clock::now();
+  size_t store_violations = EasyMRC(config).run(store).total_violations();
+  double store_ms = elapsed_ms(start);
+  if (vector_violations != store_violations) {
+    throw std::runtime_error("Store and vector runs disagree");
+  }
+
+  std::cout << "  " << std::setw(18) << "vector ms" << std::setw(12)
+            << "store ms" << std::endl;
+  std::cout << "  candidates " << std::setw(9) << vector_pairs_ms
+            << std::setw(12) << store_pairs_ms << std::endl;
+  std::cout << "  full check " << std::setw(9) << vector_ms << std::setw(12)
+            << store_ms << "  (" << vector_violations << " violations)"
+            << std::endl;
+}
+
+// Hierarchical versus flat checking of arrays of one cell: the cell check
+// and the interactions between neighbours are done once whatever the array
+// size, so the hierarchical time stays flat while the flat one grows
+void bench_hierarchy() {
+  std::cout << "\n=== Benchmark: Hierarchical Arrays ===" << std::endl;
+
+  HierarchicalLayout base;
+  int block = base.add_cell("block");
+  base.cell(block).polygons = make_staircase_layout(6, 6);
+  for (size_t i = 0; i < base.cell(block).polygons.size(); ++i) {
+    base.cell(block).polygons[i].id = static_cast<int>(i);
+  }
+  int top = base.add_cell("top");
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 30.0;
+
+  std::cout << "  " << std::setw(8) << "array" << std::setw(12)
+            << "polygons" << std::setw(10) << "stored" << std::setw(14)
+            << "hier. ms" << std::setw(12) << "flat ms" << std::setw(10)
+            << "speedup" << std::setw(14) << "interactions" << std::endl;
+  for (int n : {4, 8, 16, 32}) {
+    HierarchicalLayout layout = base;
+    CellReference array;
+    array.cell = block;
+    array.columns = array.rows = n;
+    array.column_step = Point(6 * 130 + 10, 0);
+    array.row_step = Point(0, 6 * 130 + 10);
+    layout.cell(top).references = {array};
+    layout.finalize();
+
+    auto start = std::chrono::steady_clock::now();
+    HierarchicalChecker checker(config);
+    size_t hierarchical = checker.run(layout).total_violations();
+    double hierarchical_ms = elapsed_ms(start);
+
+    auto polygons = layout.flatten();
+    start = std::chrono::steady_clock::now();
+    size_t flat = EasyMRC(config).run(polygons).total_violations();
+    double flat_ms = elapsed_ms(start);
+    if (flat != hierarchical) {
+      throw std::runtime_error("Hierarchical and flat runs disagree");
+    }
+
+    const auto& stats = checker.statistics();
+    std::cout << "  " << std::setw(4) << n << "x" << std::setw(3) << std::left
+              << n << std::right << std::setw(12) << polygons.size()
+              << std::setw(10) << stats.cell_polygons << std::setw(14)
+              << std::fixed << std::setprecision(1) << hierarchical_ms
+              << std::setw(12) << flat_ms << std::setw(9)
+              << std::setprecision(2) << flat_ms / hierarchical_ms << "x"
+              << std::setw(8) << stats.unique_interactions << " of "
+              << stats.interactions << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::cout << "========================================" << std::endl;
+  std::cout << "EasyMRC Benchmarks" << std::endl;
+  std::cout << "========================================" << std::endl;
+
+  std::vector<std::string> selected(argv + 1, argv + argc);
+  auto enabled = [&selected](const std::string& name) {
+    if (selected.empty()) return true;
+    for (const auto& s : selected) {
+      if (s == name) return true;
+    }
+    return false;
+  };
+
+  try {
+    if (enabled("arena")) bench_arena();
+    if (enabled("phases")) bench_phases();
+    if (enabled("pgm")) bench_pgm();
+    if (enabled("bitimage")) bench_bitimage();
+    if (enabled("extract")) bench_extract();
+    if (enabled("stream")) bench_stream();
+    if (enabled("gdsii")) bench_gdsii();
+    if (enabled("gdsii_write")) bench_gdsii_write();
+    if (enabled("hierarchy")) bench_hierarchy();
+    if (enabled("layout_cache")) bench_layout_cache();
+    if (enabled("artifacts")) bench_artifacts();
+    if (enabled("layout_store")) bench_layout_store();
+  } catch (const std::exception& e) {
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
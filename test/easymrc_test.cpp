@@ -3,8 +3,18 @@
 #include <cassert>
 #include <chrono>
 #include <fstream>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <tuple>
+#include <iterator>
 
 #include "../src/easymrc/easymrc.hpp"
+#include "../src/easymrc/tiling.hpp"
+#include "../src/easymrc/streaming.hpp"
+#include "../src/easymrc/hierarchy.hpp"
+#include "../src/easymrc/layout_cache.hpp"
 
 using namespace easymrc;
 
@@ -60,6 +70,1561 @@ void test_format_conversion() {
   }
 }
 
+void test_pgm_reader() {
+  std::cout << "\n=== Test: Memory-Mapped PGM Reader ===" << std::endl;
+
+  const int width = 37, height = 23;
+  auto value = [](int x, int y) { return (x * 7 + y * 13) % 256; };
+
+  // Same image as ASCII (P2) and binary (P5), stored top row first
+  {
+    std::ofstream p2("test_reader_p2.pgm");
+    p2 << "P2\n" << width << " " << height << "\n255\n";
+    std::ofstream p5("test_reader_p5.pgm", std::ios::binary);
+    p5 << "P5\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; --y) {
+      for (int x = 0; x < width; ++x) {
+        p2 << value(x, y) << ((x + 1) % 10 == 0 ? "\n" : " ");
+        p5.put(static_cast<char>(value(x, y)));
+      }
+      p2 << "\n";
+    }
+  }
+
+  for (const char* file : {"test_reader_p2.pgm", "test_reader_p5.pgm"}) {
+    Image reference = read_pgm_stream(file);
+    for (int threads : {1, 3}) {
+      Image img = read_pgm_mapped(file, threads);
+      assert(img.width == width && img.height == height);
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          assert(img.at(x, y) == value(x, y));
+          assert(img.at(x, y) == reference.at(x, y));
+        }
+      }
+    }
+  }
+
+  // P5 pixels are used in place from the mapping
+  Image mapped = read_pgm_mapped("test_reader_p5.pgm");
+  assert(mapped.storage && mapped.data.empty());
+  assert(mapped.stride == -width);
+
+  // Header comments are skipped
+  {
+    std::ofstream commented("test_reader_comment.pgm", std::ios::binary);
+    commented << "P5\n# created by a scanner\n2 1\n# max\n255\n";
+    commented.put(static_cast<char>(255));
+    commented.put(0);
+  }
+  Image small = read_pgm_mapped("test_reader_comment.pgm");
+  assert(small.width == 2 && small.height == 1);
+  assert(small.is_mask_pixel(0, 0) && !small.is_mask_pixel(1, 0));
+
+  // Truncated pixel data is rejected
+  {
+    std::ofstream truncated("test_reader_truncated.pgm", std::ios::binary);
+    truncated << "P5\n4 4\n255\n" << "abc";
+  }
+  [[maybe_unused]] bool thrown = false;
+  try {
+    read_pgm_mapped("test_reader_truncated.pgm");
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "  ✓ Memory-mapped PGM reader works" << std::endl;
+}
+
+// Minimal PNG writer: chunks with their CRCs, and zlib streams of stored
+// (uncompressed) deflate blocks
+struct PngBytes {
+  std::string data = std::string("\x89PNG\r\n\x1a\n", 8);
+
+  static std::string be32(uint32_t value) {
+    std::string bytes;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      bytes.push_back(static_cast<char>((value >> shift) & 0xff));
+    }
+    return bytes;
+  }
+
+  void chunk(const std::string& type, const std::string& body) {
+    std::string typed = type + body;
+    data += be32(body.size()) + typed;
+    data += be32(png_detail::crc32(
+        reinterpret_cast<const unsigned char*>(typed.data()), typed.size()));
+  }
+
+  void header(int width, int height, int depth, int color,
+              int interlace = 0) {
+    std::string body = be32(width) + be32(height);
+    body += {static_cast<char>(depth), static_cast<char>(color), 0, 0,
+             static_cast<char>(interlace)};
+    chunk("IHDR", body);
+  }
+
+  // zlib stream split into IDAT chunks of at most piece bytes
+  void image_data(const std::string& zlib, size_t piece) {
+    for (size_t pos = 0; pos < zlib.size(); pos += piece) {
+      chunk("IDAT", zlib.substr(pos, piece));
+    }
+  }
+
+  void end() { chunk("IEND", ""); }
+
+  static std::string stored_zlib(const std::string& raw, size_t block) {
+    std::string z = "\x78\x01";
+    uint32_t a = 1, b = 0;
+    for (unsigned char c : raw) {
+      a = (a + c) % 65521;
+      b = (b + a) % 65521;
+    }
+    size_t pos = 0;
+    do {
+      size_t n = std::min(block, raw.size() - pos);
+      z.push_back(pos + n == raw.size() ? 1 : 0);
+      z += {static_cast<char>(n & 0xff), static_cast<char>(n >> 8),
+            static_cast<char>(~n & 0xff), static_cast<char>((~n >> 8) & 0xff)};
+      z += raw.substr(pos, n);
+      pos += n;
+    } while (pos < raw.size());
+    return z + be32((b << 16) | a);
+  }
+
+  void save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    out.write(data.data(), data.size());
+  }
+};
+
+void test_png_reader() {
+  std::cout << "\n=== Test: PNG Reader ===" << std::endl;
+
+  // The same gray pattern, rows filtered None, Sub, Up, Average and Paeth
+  // in turn, compressed by zlib with dynamic (40x16 gray) and fixed
+  // (16x10 RGB, r = g = b) Huffman codes
+  auto value = [](int x, int row) {
+    return (x / 4 + row / 3) % 2 ? 255 : (x * 37 + row * 11) % 200;
+  };
+  static const unsigned char kDynamicGray[] = {
+      0x78, 0xda, 0x8d, 0xd2, 0x4d, 0x28, 0xc3, 0x61, 0x1c, 0x07, 0xf0, 0x67,
+      0x9b, 0xf2, 0xb2, 0x8b, 0x03, 0xf5, 0x1c, 0xa8, 0x1d, 0xf6, 0x68, 0x49,
+      0xd2, 0xbc, 0xc4, 0x34, 0x35, 0xda, 0x0e, 0x16, 0x56, 0x13, 0xb2, 0xe6,
+      0x65, 0xde, 0xda, 0x22, 0x23, 0xca, 0x81, 0x72, 0x40, 0x3b, 0x20, 0x29,
+      0x2b, 0x13, 0x65, 0xb2, 0x85, 0xcc, 0x61, 0x6b, 0x5e, 0x96, 0x77, 0x79,
+      0x59, 0x2e, 0x6e, 0x4a, 0x21, 0x47, 0xb5, 0x03, 0x71, 0x14, 0xdf, 0x9f,
+      0x5c, 0x28, 0xf2, 0x1c, 0xfe, 0x9f, 0xff, 0xf7, 0xf0, 0x7b, 0x9e, 0xdf,
+      0xf3, 0xff, 0xfd, 0x19, 0x13, 0xe5, 0xdd, 0xef, 0x58, 0x4d, 0xa3, 0xab,
+      0xf1, 0xe4, 0x41, 0x7a, 0x69, 0x07, 0x59, 0x37, 0xe4, 0x3d, 0x23, 0xb7,
+      0x52, 0x35, 0x8d, 0xa4, 0x44, 0x2e, 0x84, 0x18, 0x65, 0x8c, 0x75, 0x0a,
+      0x61, 0x8d, 0xc1, 0x38, 0xe4, 0x09, 0xd8, 0x8a, 0xfc, 0x0a, 0x4f, 0xac,
+      0x42, 0xcc, 0x40, 0xa9, 0x1c, 0x0b, 0xb2, 0xdf, 0x2c, 0xfb, 0x52, 0xf6,
+      0x62, 0x33, 0x69, 0xc3, 0x85, 0x1b, 0x87, 0x6e, 0xb5, 0xa2, 0xa7, 0xf2,
+      0xf2, 0xee, 0xc9, 0xd3, 0x5e, 0xad, 0x0b, 0xe4, 0xad, 0xed, 0x2e, 0x14,
+      0x28, 0xfb, 0x0d, 0xe7, 0x37, 0x31, 0xaf, 0xa3, 0x4e, 0xef, 0xcb, 0xf1,
+      0x6f, 0xc7, 0xfd, 0xb5, 0xdb, 0x37, 0xa9, 0x51, 0x99, 0xaa, 0xa2, 0x97,
+      0x6c, 0x71, 0xad, 0x27, 0x91, 0xc7, 0x0a, 0xbd, 0x83, 0xb4, 0x0c, 0x2f,
+      0x4b, 0xc9, 0x08, 0xd7, 0xda, 0x24, 0xa5, 0x68, 0xbe, 0x12, 0x55, 0x4b,
+      0xc2, 0x2a, 0xc2, 0xb0, 0x18, 0xb9, 0x06, 0xce, 0x21, 0xef, 0xc1, 0x5c,
+      0xe4, 0x86, 0x6f, 0x97, 0x29, 0xfb, 0x71, 0xdc, 0x8f, 0x2c, 0x53, 0x73,
+      0xce, 0xd3, 0xf0, 0xf2, 0x10, 0xe2, 0xdc, 0x04, 0x03, 0xc8, 0x0a, 0x78,
+      0x8b, 0x5c, 0x0d, 0x57, 0x91, 0x95, 0xf4, 0xd9, 0xfc, 0x78, 0xe4, 0x60,
+      0xfb, 0xe6, 0x47, 0xc6, 0xa6, 0x70, 0xdc, 0x05, 0xb2, 0x0a, 0xd9, 0xfe,
+      0xcc, 0x98, 0x0b, 0xf9, 0x0a, 0x59, 0x81, 0xfc, 0x79, 0x19, 0x4d, 0xe3,
+      0xc8, 0x0a, 0xe9, 0xd9, 0x4f, 0xd3, 0x91, 0xea, 0xda, 0xc1, 0x45, 0x72,
+      0x7a, 0x33, 0xa5, 0x88, 0xcc, 0xac, 0xea, 0x9b, 0x95, 0xbc, 0xa3, 0xc2,
+      0x80, 0x0a, 0x23, 0xf4, 0x61, 0x0a, 0x41, 0x58, 0x82, 0x6c, 0x86, 0x0b,
+      0xd8, 0x31, 0x02, 0x0b, 0x90, 0xa5, 0x18, 0x71, 0xd6, 0xce, 0x8c, 0xd3,
+      0x88, 0x11, 0x8f, 0xd7, 0xbf, 0x5d, 0x07, 0x31, 0x62, 0xe5, 0xd1, 0xfc,
+      0x80, 0x19, 0x23, 0x1e, 0xb1, 0x69, 0xef, 0x23, 0xfd, 0x38, 0x26, 0xba,
+      0x3c, 0x6c, 0x91, 0x55, 0xf0, 0x10, 0x6f, 0x43, 0x95, 0x07, 0x4d, 0xe7,
+      0xc3, 0x28, 0x37, 0x71, 0x3b, 0x74, 0x23, 0x17, 0xc1, 0x53, 0xe4, 0x2e,
+      0xba, 0xcc, 0xbf, 0xa6, 0x42, 0x8b, 0x9a, 0xed, 0x71, 0x47, 0x38, 0x99,
+      0x98, 0x6d, 0x1e, 0x20, 0xed, 0x93, 0xc1, 0xe4, 0xcf, 0x5f, 0x2b, 0xc3,
+      0xe8, 0x24, 0x9b, 0xc7, 0xd6, 0x12, 0x3e, 0x00, 0x67, 0xa9, 0xc7, 0xac,
+  };
+  static const unsigned char kFixedRgb[] = {
+      0x78, 0x01, 0x63, 0x60, 0x60, 0x60, 0x50, 0x55, 0x55, 0xf5, 0xf2, 0xf2,
+      0xca, 0xcf, 0xcf, 0xff, 0x8f, 0x04, 0x12, 0x12, 0x12, 0x5a, 0x5b, 0x5b,
+      0x57, 0xad, 0x5a, 0xc5, 0xce, 0xce, 0x8e, 0x2c, 0xce, 0xc8, 0xcd, 0xcd,
+      0xad, 0x0a, 0x03, 0x40, 0x15, 0x0c, 0x30, 0x90, 0x93, 0x93, 0x03, 0x11,
+      0x8c, 0x8d, 0x8d, 0x7d, 0xfb, 0xf6, 0x2d, 0x5c, 0x9c, 0x89, 0x1b, 0x09,
+      0x30, 0x20, 0x01, 0x5c, 0xe2, 0xcc, 0x5f, 0xbe, 0x7c, 0x49, 0x4a, 0x4a,
+      0x0a, 0x08, 0x08, 0xb0, 0xb5, 0xb5, 0xdd, 0xb6, 0x6d, 0x9b, 0x85, 0x85,
+      0xc5, 0xfa, 0xf5, 0xeb, 0x0f, 0x1e, 0x3c, 0x38, 0x6d, 0xda, 0x34, 0x23,
+      0x23, 0x23, 0x05, 0x05, 0x85, 0xc2, 0xc2, 0x42, 0x3f, 0x3f, 0xbf, 0x33,
+      0x67, 0xce, 0xdc, 0xbf, 0x7f, 0xff, 0xe3, 0xc7, 0x8f, 0x2c, 0xc4, 0x98,
+      0x8a, 0x22, 0x8e, 0xec, 0x21, 0x66, 0x66, 0x66, 0x0d, 0x0d, 0x0d, 0x5f,
+      0x5f, 0xdf, 0xa2, 0xa2, 0x22, 0x64, 0xf1, 0xe4, 0xe4, 0xe4, 0x8e, 0x8e,
+      0x8e, 0xb5, 0x6b, 0xd7, 0x72, 0x71, 0x71, 0x31, 0x3a, 0x39, 0x39, 0xc1,
+      0x3d, 0x0d, 0xb4, 0x1a, 0x6e, 0xea, 0xe2, 0xc5, 0x8b, 0x21, 0x3e, 0x06,
+      0x92, 0x40, 0xa7, 0x12, 0xe5, 0x69, 0x67, 0x67, 0x67, 0x2c, 0x9e, 0x06,
+      0xfa, 0x4c, 0x02, 0x06, 0x64, 0x64, 0x64, 0xe0, 0x12, 0x8f, 0x1e, 0x3d,
+      0xda, 0xb2, 0x65, 0x0b, 0x44, 0x1c, 0x18, 0x24, 0x70, 0x71, 0x96, 0xe5,
+      0xcb, 0x97, 0xc3, 0x39, 0x06, 0x06, 0x06, 0x70, 0xe7, 0x25, 0x26, 0x26,
+      0xbe, 0x7a, 0xf5, 0x0a, 0x22, 0x3e, 0x61, 0xc2, 0x04, 0xb8, 0xf3, 0x00,
+      0xd5, 0x8d, 0x81, 0x87,
+  };
+
+  auto check = [&value]([[maybe_unused]] const BitImage& mask, int width,
+                        int height, [[maybe_unused]] int threshold) {
+    assert(mask.width() == width && mask.height() == height);
+    for (int row = 0; row < height; ++row) {
+      for (int x = 0; x < width; ++x) {
+        assert(mask.get(x, height - 1 - row) == (value(x, row) >= threshold));
+      }
+    }
+  };
+
+  {
+    PngBytes png;
+    png.header(40, 16, 8, png_detail::GRAY);
+    png.chunk("tEXt", std::string("Comment\0test", 12));
+    png.image_data(std::string(reinterpret_cast<const char*>(kDynamicGray),
+                               sizeof(kDynamicGray)), 100);
+    png.end();
+    png.save("test_png_dynamic.png");
+  }
+  {
+    PngBytes png;
+    png.header(16, 10, 8, png_detail::RGB);
+    png.image_data(std::string(reinterpret_cast<const char*>(kFixedRgb),
+                               sizeof(kFixedRgb)), sizeof(kFixedRgb));
+    png.end();
+    png.save("test_png_fixed.png");
+  }
+  for (int threshold : {255, 100, 1}) {
+    check(read_png_mask("test_png_dynamic.png", threshold), 40, 16,
+          threshold);
+    check(read_png_mask("test_png_fixed.png", threshold), 16, 10, threshold);
+  }
+
+  // Converted like the same image in PGM
+  {
+    std::ofstream pgm("test_png_dynamic.pgm", std::ios::binary);
+    pgm << "P5\n40 16\n255\n";
+    for (int row = 0; row < 16; ++row) {
+      for (int x = 0; x < 40; ++x) pgm.put(static_cast<char>(value(x, row)));
+    }
+  }
+  auto from_png = format_conversion("test_png_dynamic.png");
+  auto from_pgm = format_conversion("test_png_dynamic.pgm");
+  assert(!from_png.empty() && from_png.size() == from_pgm.size());
+  for (size_t i = 0; i < from_png.size(); ++i) {
+    const auto& a = from_png[i].vertices;
+    [[maybe_unused]] const auto& b = from_pgm[i].vertices;
+    assert(a.size() == b.size());
+    for (size_t k = 0; k < a.size(); ++k) {
+      assert(a[k].x() == b[k].x() && a[k].y() == b[k].y());
+    }
+  }
+
+  // Other color types and bit depths, stored in small deflate blocks: a
+  // 9x3 image whose set pixels (gray 255, opaque) form a diagonal
+  auto stored = [](int depth, int color, const std::string& rows,
+                   const std::string& plte, const std::string& trns) {
+    PngBytes png;
+    png.header(9, 3, depth, color);
+    if (!plte.empty()) png.chunk("PLTE", plte);
+    if (!trns.empty()) png.chunk("tRNS", trns);
+    png.image_data(PngBytes::stored_zlib(rows, 7), 5);
+    png.end();
+    png.save("test_png_stored.png");
+    return read_png_mask("test_png_stored.png");
+  };
+  auto diagonal = []([[maybe_unused]] const BitImage& mask) {
+    for (int row = 0; row < 3; ++row) {
+      for (int x = 0; x < 9; ++x) {
+        assert(mask.get(x, 2 - row) == (x == row * 3 + 1));
+      }
+    }
+  };
+  // Pixel x of row as samples of size bytes: on, off, or off because of
+  // transparency (where the format has it)
+  auto rows = [](std::string on, std::string off, std::string hidden) {
+    std::string raw;
+    for (int row = 0; row < 3; ++row) {
+      raw.push_back(0);
+      for (int x = 0; x < 9; ++x) {
+        raw += x == row * 3 + 1 ? on : x % 2 ? off : hidden;
+      }
+    }
+    return raw;
+  };
+  const std::string full("\xff\xff", 2), zero("\0\0", 2);
+  diagonal(stored(16, png_detail::GRAY, rows(full, "\xfe\xff", zero), "",
+                  ""));
+  diagonal(stored(8, png_detail::GRAY_ALPHA, rows("\xff\xff", "\x80\xff",
+                                                  "\xff\x80"), "", ""));
+  diagonal(stored(16, png_detail::RGB_ALPHA,
+                  rows(full + full + full + full, full + zero + full + full,
+                       full + full + full + std::string("\xfe\x00", 2)),
+                  "", ""));
+  diagonal(stored(8, png_detail::RGB, rows("\xff\xff\xff", "\xff\xff\xfe",
+                                           std::string(3, '\0')), "", ""));
+  // tRNS color key: white is transparent, leaving an empty mask
+  {
+    BitImage keyed = stored(8, png_detail::GRAY,
+                            rows("\xff", "\xff", std::string(1, '\0')), "",
+                            std::string("\0\xff", 2));
+    assert(keyed.count() == 0);
+  }
+  // Low bit depths: samples packed most significant bit first
+  {
+    std::string bits;
+    for (int row = 0; row < 3; ++row) {
+      uint16_t word = uint16_t(0x8000) >> (row * 3 + 1);
+      bits += {0, static_cast<char>(word >> 8), static_cast<char>(word)};
+    }
+    diagonal(stored(1, png_detail::GRAY, bits, "", ""));
+
+    // 2-bit palette: black, white, white with alpha 0, gray
+    std::string palette("\0\0\0\xff\xff\xff\xff\xff\xff\x80\x80\x80", 12);
+    std::string indices;
+    for (int row = 0; row < 3; ++row) {
+      indices.push_back(0);
+      uint32_t word = 0;
+      for (int x = 0; x < 9; ++x) {
+        uint32_t index = x == row * 3 + 1 ? 1 : x % 3 == 0 ? 2 : 3;
+        word |= index << (30 - 2 * x);
+      }
+      indices += {static_cast<char>(word >> 24), static_cast<char>(word >> 16),
+                  static_cast<char>((word >> 8) & 0xc0)};
+    }
+    diagonal(stored(2, png_detail::PALETTE, indices, palette,
+                    std::string("\xff\xff\0", 3)));
+  }
+
+  // Unsupported or damaged files are rejected
+  [[maybe_unused]] auto rejected = [](const PngBytes& png,
+                                      const std::string& message) {
+    png.save("test_png_bad.png");
+    try {
+      read_png_mask("test_png_bad.png");
+    } catch (const std::runtime_error& e) {
+      return std::string(e.what()).find(message) != std::string::npos;
+    }
+    return false;
+  };
+  const std::string gray_rows = rows("\xff", std::string(1, '\0'),
+                                      std::string(1, '\0'));
+  {
+    PngBytes png;
+    png.header(9, 3, 8, png_detail::GRAY, 1);
+    png.image_data(PngBytes::stored_zlib(gray_rows, 64), 64);
+    png.end();
+    assert(rejected(png, "Interlaced PNG is not supported"));
+  }
+  {
+    PngBytes png;
+    png.header(9, 3, 8, png_detail::GRAY);
+    png.image_data(PngBytes::stored_zlib(gray_rows, 64), 64);
+    png.end();
+    PngBytes corrupt = png;
+    corrupt.data[45] ^= 0x10;  // Inside the IDAT data
+    assert(rejected(corrupt, "CRC mismatch"));
+    PngBytes truncated = png;
+    truncated.data.resize(png.data.size() - 20);
+    assert(rejected(truncated, "truncated chunk"));
+  }
+  {
+    // Image data ending a row early
+    PngBytes png;
+    png.header(9, 3, 8, png_detail::GRAY);
+    png.image_data(PngBytes::stored_zlib(gray_rows.substr(0, 25), 64), 64);
+    png.end();
+    assert(rejected(png, "missing image data"));
+  }
+  {
+    // Deflate stream cut short, with valid chunks
+    PngBytes png;
+    png.header(40, 16, 8, png_detail::GRAY);
+    png.image_data(std::string(reinterpret_cast<const char*>(kDynamicGray),
+                               sizeof(kDynamicGray) / 2), 100);
+    png.end();
+    assert(rejected(png, "unexpected end of image data"));
+  }
+
+  std::cout << "  ✓ PNG reader works" << std::endl;
+}
+
+void test_level_layers() {
+  std::cout << "\n=== Test: Gray-Level Layers ===" << std::endl;
+
+  // Three layers as gray levels 255, 128 and 64 of one 150x40 image (wide
+  // enough for the SSE2 path), stored top row first
+  const int width = 150, height = 40;
+  auto value = [](int x, int row) {
+    if (row >= 5 && row < 15 && x % 30 < 20) return 255;  // 5 bars
+    if (row >= 20 && row < 35 && x >= 10 && x < 140) {
+      return x % 40 < 8 ? 128 : 64;  // 3 via columns in a plane
+    }
+    return (x + row) % 2 ? 0 : 100;  // Background noise of no layer
+  };
+  std::string pixels, raw;
+  for (int row = 0; row < height; ++row) {
+    raw.push_back(0);
+    for (int x = 0; x < width; ++x) {
+      pixels.push_back(static_cast<char>(value(x, row)));
+      raw.push_back(static_cast<char>(value(x, row)));
+    }
+  }
+  {
+    std::ofstream pgm("test_levels.pgm", std::ios::binary);
+    pgm << "P5\n" << width << " " << height << "\n255\n" << pixels;
+    PngBytes png;
+    png.header(width, height, 8, png_detail::GRAY);
+    png.image_data(PngBytes::stored_zlib(raw, 4096), 8192);
+    png.end();
+    png.save("test_levels.png");
+  }
+
+  const std::vector<unsigned char> levels = {255, 128, 64};
+  for (const char* file : {"test_levels.pgm", "test_levels.png"}) {
+    std::vector<BitImage> masks = read_level_masks(file, levels, 2);
+    assert(masks.size() == levels.size());
+    for (size_t k = 0; k < levels.size(); ++k) {
+      assert(masks[k].width() == width && masks[k].height() == height);
+      for (int row = 0; row < height; ++row) {
+        for (int x = 0; x < width; ++x) {
+          assert(masks[k].get(x, height - 1 - row) ==
+                 (value(x, row) == levels[k]));
+        }
+      }
+    }
+    // The top level selects what the 255 threshold would
+    BitImage top = read_mask(file);
+    for (int y = 0; y < height; ++y) {
+      for (int w = 0; w < top.row_words(); ++w) {
+        assert(top.row(y)[w] == masks[0].row(y)[w]);
+      }
+    }
+
+    auto layers = format_conversion_levels(file, levels);
+    assert(layers.size() == 3);
+    assert(layers[0].size() == 5);
+    assert(layers[1].size() == 3);
+    // The plane is split into pieces by the via columns
+    assert(layers[2].size() == 4);
+    assert(layers[1][0].id == 0 && layers[2][0].id == 0);
+  }
+
+  std::cout << "  ✓ Gray levels decode into one mask per layer"
+            << std::endl;
+}
+
+void test_bit_image() {
+  std::cout << "\n=== Test: Bit-Packed Mask Image ===" << std::endl;
+
+  // Widths around the 16-pixel SIMD block and the 64-bit word size
+  for (int width : {1, 15, 63, 64, 65, 130}) {
+    const int height = 7;
+    Image img(width, height);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        int v = (x * 31 + y * 17) % 5;
+        img.at(x, y) = v == 0 ? 255 : (v == 1 ? 254 : v * 60);
+      }
+    }
+
+    BitImage bits = BitImage::threshold(img);
+    assert(bits.width() == width && bits.height() == height);
+    size_t expected = 0;
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        assert(bits.get(x, y) == img.is_mask_pixel(x, y));
+        expected += img.is_mask_pixel(x, y);
+      }
+    }
+    assert(bits.count() == expected);
+
+    // The sentinel border reads as background
+    for (int x = -1; x <= width; ++x) {
+      assert(!bits.get(x, -1) && !bits.get(x, height));
+    }
+    for (int y = -1; y <= height; ++y) {
+      assert(!bits.get(-1, y) && !bits.get(width, y));
+    }
+
+    // Lower thresholds keep everything at or above the level
+    BitImage half = BitImage::threshold(img, 128);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        assert(half.get(x, y) == (img.at(x, y) >= 128));
+      }
+    }
+  }
+  std::cout << "  ✓ Thresholding matches is_mask_pixel, border is empty"
+            << std::endl;
+
+  // Images read bottom-up from a file threshold the same way
+  {
+    std::ofstream p5("test_bits.pgm", std::ios::binary);
+    p5 << "P5\n3 2\n255\n";
+    const unsigned char pixels[] = {255, 0, 0, 0, 0, 255};  // Top row first
+    p5.write(reinterpret_cast<const char*>(pixels), sizeof(pixels));
+  }
+  BitImage file_bits = BitImage::threshold(read_pgm_mapped("test_bits.pgm"));
+  assert(file_bits.get(0, 1) && !file_bits.get(0, 0));
+  assert(file_bits.get(2, 0) && !file_bits.get(2, 1));
+
+  // The converter gives the same polygons from either representation
+  Image rect(80, 20);
+  for (int y = 5; y < 15; ++y) {
+    for (int x = 60; x < 75; ++x) {
+      rect.at(x, y) = 255;
+    }
+  }
+  FormatConverter from_image(rect);
+  FormatConverter from_bits(BitImage::threshold(rect));
+  auto a = from_image.convert();
+  auto b = from_bits.convert();
+  assert(a.size() == b.size() && !a.empty());
+  assert(a[0].vertices.size() == b[0].vertices.size());
+  assert(from_bits.mask().bytes() < rect.data.size());
+  std::cout << "  ✓ FormatConverter consumes the bit-packed mask" << std::endl;
+}
+
+// Signed area of a polygon outline (positive = counter-clockwise)
+long long outline_area(const Polygon& poly) {
+  long long twice = 0;
+  for (size_t i = 0; i < poly.vertices.size(); ++i) {
+    const Point& a = poly.vertices[i];
+    const Point& b = poly.vertices[(i + 1) % poly.vertices.size()];
+    twice += static_cast<long long>(a.x()) * b.y() -
+             static_cast<long long>(b.x()) * a.y();
+  }
+  return twice / 2;
+}
+
+// Mask with roughly percent % of the pixels set
+BitImage random_mask(int width, int height, int percent) {
+  BitImage mask(width, height);
+  unsigned seed = 12345;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      seed = seed * 1103515245u + 12345u;
+      if (static_cast<int>((seed >> 16) % 100) < percent) mask.set(x, y);
+    }
+  }
+  return mask;
+}
+
+// Reference 4-connected labelling; components are numbered in the order
+// a bottom-up raster scan first reaches them. Returns the component count.
+size_t flood_fill_labels(const BitImage& mask, std::vector<int>& labels) {
+  const int width = mask.width(), height = mask.height();
+  labels.assign(static_cast<size_t>(width) * height, -1);
+  int next = 0;
+  std::vector<std::pair<int, int>> stack;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (!mask.get(x, y) || labels[y * width + x] >= 0) continue;
+      stack.assign(1, {x, y});
+      labels[y * width + x] = next;
+      while (!stack.empty()) {
+        auto [px, py] = stack.back();
+        stack.pop_back();
+        const int nx[] = {px + 1, px - 1, px, px};
+        const int ny[] = {py, py, py + 1, py - 1};
+        for (int k = 0; k < 4; ++k) {
+          if (mask.get(nx[k], ny[k]) && labels[ny[k] * width + nx[k]] < 0) {
+            labels[ny[k] * width + nx[k]] = next;
+            stack.push_back({nx[k], ny[k]});
+          }
+        }
+      }
+      next++;
+    }
+  }
+  return next;
+}
+
+void test_component_labeling() {
+  std::cout << "\n=== Test: Parallel Component Labeling ===" << std::endl;
+
+  BitImage mask = random_mask(200, 400, 60);
+  std::vector<int> reference;
+  size_t components = flood_fill_labels(mask, reference);
+
+  for (int threads : {1, 3, 8}) {
+    ComponentLabeling labeling(mask, threads);
+    assert(labeling.bands() == std::min(threads, 400 / 64));
+    assert(labeling.num_components() == components);
+
+    // Every pixel of a run carries the flood-fill label of the run
+    const auto& runs = labeling.runs();
+    size_t pixels = 0;
+    for (size_t i = 0; i < runs.size(); ++i) {
+      for (int x = runs[i].x0; x < runs[i].x1; ++x) {
+        assert(reference[runs[i].y * 200 + x] == labeling.labels()[i]);
+      }
+      pixels += runs[i].x1 - runs[i].x0;
+    }
+    assert(pixels == mask.count());
+
+    // Grouped runs stay in raster order, lowest-leftmost first
+    for (size_t c = 0; c < components; ++c) {
+      const PixelRun* begin = labeling.component_begin(c);
+      assert(begin < labeling.component_end(c));
+      for (const PixelRun* run = begin + 1; run < labeling.component_end(c);
+           ++run) {
+        assert(run[-1].y < run->y ||
+               (run[-1].y == run->y && run[-1].x1 < run->x0));
+      }
+    }
+  }
+  std::cout << "  Components: " << components << std::endl;
+  std::cout << "  ✓ Labels match flood fill for 1/3/8 threads" << std::endl;
+}
+
+void test_scanline_extraction() {
+  std::cout << "\n=== Test: Scanline Polygon Extraction ===" << std::endl;
+
+  auto mask_from = [](const std::vector<std::string>& rows) {
+    // rows[0] is the top row
+    int height = rows.size(), width = rows[0].size();
+    BitImage bits(width, height);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        if (rows[height - 1 - y][x] == '#') bits.set(x, y);
+      }
+    }
+    return bits;
+  };
+
+  // Rectangle: four corners, counter-clockwise from the bottom-left
+  Image rect(15, 15);
+  for (int y = 2; y < 12; ++y) {
+    for (int x = 2; x < 12; ++x) rect.at(x, y) = 255;
+  }
+  auto polygons = FormatConverter(rect).convert();
+  assert(polygons.size() == 1 && polygons[0].vertices.size() == 4);
+  assert(polygons[0].vertices[0].x() == 2 && polygons[0].vertices[0].y() == 2);
+  assert(polygons[0].vertices[1].x() == 12 && polygons[0].vertices[1].y() == 2);
+  assert(polygons[0].segments.size() == 4);
+  assert(outline_area(polygons[0]) == 100);
+
+  // L shape, a ring (outer boundary only) and a diagonal neighbour, which
+  // is a separate polygon under 4-connectivity
+  polygons = extract_polygons(mask_from({"#.......",
+                                         "#..####.",
+                                         "#..#..#.",
+                                         "#######."}), 1);
+  assert(polygons.size() == 1);
+  assert(polygons[0].vertices.size() == 8);
+  polygons = extract_polygons(mask_from({"....#",
+                                         "###..",
+                                         "#.#..",
+                                         "###.."}), 1);
+  assert(polygons.size() == 2);
+  assert(polygons[0].vertices.size() == 4 && outline_area(polygons[0]) == 9);
+  assert(polygons[1].id == 1 && outline_area(polygons[1]) == 1);
+
+  // Pixels of one component touching at a corner are walked around
+  polygons = extract_polygons(mask_from({"###",
+                                         "#.#",
+                                         ".##"}), 1);
+  assert(polygons.size() == 1 && outline_area(polygons[0]) == 7);
+  std::cout << "  ✓ Outlines of simple shapes are correct" << std::endl;
+
+  // Random mask: component count matches a flood fill, and bands give the
+  // same polygons as a single thread
+  BitImage noise = random_mask(150, 300, 55);
+  std::vector<int> flood_labels;
+  size_t components = flood_fill_labels(noise, flood_labels);
+
+  ScanlineExtractor single(noise, 1);
+  auto reference = single.extract();
+  assert(reference.size() == components);
+  for (const auto& poly : reference) {
+    assert(outline_area(poly) > 0);
+    for (size_t i = 0; i < poly.vertices.size(); ++i) {
+      [[maybe_unused]] const Point& a = poly.vertices[i];
+      [[maybe_unused]] const Point& b =
+          poly.vertices[(i + 1) % poly.vertices.size()];
+      assert(a.x() == b.x() || a.y() == b.y());  // Rectilinear
+    }
+  }
+
+  ScanlineExtractor banded(noise, 4);
+  auto result = banded.extract();
+  assert(banded.statistics().bands == 4);
+  assert(result.size() == reference.size());
+  for (size_t i = 0; i < result.size(); ++i) {
+    assert(result[i].id == static_cast<int>(i));
+    assert(result[i].vertices.size() == reference[i].vertices.size());
+    for (size_t v = 0; v < result[i].vertices.size(); ++v) {
+      assert(result[i].vertices[v].x() == reference[i].vertices[v].x());
+      assert(result[i].vertices[v].y() == reference[i].vertices[v].y());
+    }
+  }
+  std::cout << "  Components: " << components << ", runs: "
+            << single.statistics().runs << std::endl;
+  std::cout << "  ✓ Banded extraction matches flood fill and single thread"
+            << std::endl;
+}
+
+void test_gdsii_reader() {
+  std::cout << "\n=== Test: Memory-Mapped GDSII Reader ===" << std::endl;
+
+  // Vertex counts around the two-point SIMD block, negative and large
+  // coordinates, and an empty structure that both readers drop
+  std::vector<Polygon> written;
+  for (int i = 0; i < 40; ++i) {
+    Polygon poly(i);
+    int count = (i == 7) ? 0 : 3 + i % 6;
+    for (int k = 0; k < count; ++k) {
+      poly.add_vertex(Point(k * 1000003 - 50000000 + i, (k % 2) * -70000 + i));
+    }
+    written.push_back(poly);
+  }
+  write_gdsii(written, "test_reader.gds");
+
+  std::vector<Polygon> reference = read_gdsii_stream("test_reader.gds");
+  assert(reference.size() == written.size() - 1);
+  for (int threads : {1, 3}) {
+    std::vector<Polygon> polygons = read_gdsii_mapped("test_reader.gds",
+                                                      threads);
+    assert(polygons.size() == reference.size());
+    for (size_t i = 0; i < polygons.size(); ++i) {
+      assert(polygons[i].id == reference[i].id);
+      assert(polygons[i].vertices.size() == reference[i].vertices.size());
+      assert(polygons[i].segments.size() == reference[i].segments.size());
+      for (size_t k = 0; k < polygons[i].vertices.size(); ++k) {
+        assert(polygons[i].vertices[k].x() == reference[i].vertices[k].x());
+        assert(polygons[i].vertices[k].y() == reference[i].vertices[k].y());
+      }
+    }
+    // Structure ids skip the empty structure
+    assert(polygons[7].id == 8);
+    assert(polygons[3].vertices[1].x() == 1000003 - 50000000 + 3);
+    assert(polygons[3].vertices[1].y() == -70000 + 3);
+  }
+
+  // A record running past the end of the file is rejected
+  {
+    std::ifstream in("test_reader.gds", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+    std::ofstream truncated("test_reader_truncated.gds", std::ios::binary);
+    truncated.write(bytes.data(), bytes.size() / 2 + 3);
+  }
+  [[maybe_unused]] bool thrown = false;
+  try {
+    read_gdsii_mapped("test_reader_truncated.gds");
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "  ✓ Memory-mapped GDSII reader works" << std::endl;
+}
+
+void test_gdsii_writer() {
+  std::cout << "\n=== Test: Buffered GDSII Writer ===" << std::endl;
+
+  // Odd and even name lengths, vertex counts around the SIMD block, an
+  // already closed polygon and an empty one
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 120; ++i) {
+    Polygon poly(i * 37);
+    int count = (i == 5) ? 0 : 1 + i % 7;
+    for (int k = 0; k < count; ++k) {
+      poly.add_vertex(Point(k * 999983 - 40000000 + i, (k % 3) * -65537 - i));
+    }
+    if (i == 9) poly.add_vertex(poly.vertices.front());
+    polygons.push_back(poly);
+  }
+
+  auto file_bytes = [](const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  };
+  write_gdsii_stream(polygons, "test_writer_stream.gds");
+  std::string reference = file_bytes("test_writer_stream.gds");
+  for (int threads : {1, 3}) {
+    // A small buffer splits the library into several writes
+    for (size_t buffer_bytes : {size_t(256), size_t(64) << 20}) {
+      write_gdsii_buffered(polygons, "test_writer.gds", threads, buffer_bytes);
+      assert(file_bytes("test_writer.gds") == reference);
+    }
+  }
+  write_gdsii_buffered({}, "test_writer.gds", 2, 64);
+  write_gdsii_stream({}, "test_writer_stream.gds");
+  assert(file_bytes("test_writer.gds") ==
+         file_bytes("test_writer_stream.gds"));
+
+  // XY records are limited to 8191 points
+  Polygon huge(0);
+  for (int k = 0; k < 8191; ++k) huge.add_vertex(Point(k, k % 2));
+  [[maybe_unused]] bool thrown = false;
+  try {
+    write_gdsii_buffered({huge}, "test_writer.gds");
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "  ✓ Buffered GDSII writer matches the stream writer"
+            << std::endl;
+}
+
+void test_gdsii_layers() {
+  std::cout << "\n=== Test: GDSII Layer Selection and Index ===" << std::endl;
+
+  // Structure s has boundaries on layers s % 3 (datatype s % 2) and 5/1,
+  // and one on layer 7 only when s is even; structure 4 has only layer 9
+  struct Element {
+    int layer, datatype;
+    std::vector<Point> points;
+  };
+  std::vector<std::vector<Element>> structures(12);
+  for (int s = 0; s < 12; ++s) {
+    auto square = [s](int k, int size) {
+      int x = s * 1000 + k * 100;
+      return std::vector<Point>{Point(x, 0), Point(x + size, 0),
+                                Point(x + size, size), Point(x, size)};
+    };
+    if (s == 4) {
+      structures[s].push_back({9, 0, square(0, 10)});
+      continue;
+    }
+    structures[s].push_back({s % 3, s % 2, square(0, 10 + s)});
+    structures[s].push_back({5, 1, square(1, 20)});
+    if (s % 2 == 0) structures[s].push_back({7, 0, square(2, 30)});
+  }
+  auto write_layers = [&structures](const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    gdsii::write_library_header(out);
+    for (size_t s = 0; s < structures.size(); ++s) {
+      gdsii::write_structure_header(out, "S" + std::to_string(s));
+      for (const auto& e : structures[s]) {
+        gdsii::write_record_header(out, 4, gdsii::BOUNDARY, gdsii::NO_DATA);
+        gdsii::write_record_header(out, 6, gdsii::LAYER, gdsii::INT16);
+        gdsii::write_int16(out, e.layer);
+        gdsii::write_record_header(out, 6, gdsii::DATATYPE, gdsii::INT16);
+        gdsii::write_int16(out, e.datatype);
+        gdsii::write_record_header(out, 4 + (e.points.size() + 1) * 8,
+                                   gdsii::XY, gdsii::INT32);
+        for (size_t k = 0; k <= e.points.size(); ++k) {
+          const Point& p = e.points[k % e.points.size()];
+          gdsii::write_int32(out, p.x());
+          gdsii::write_int32(out, p.y());
+        }
+        gdsii::write_record_header(out, 4, gdsii::ENDEL, gdsii::NO_DATA);
+      }
+      gdsii::write_record_header(out, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+    }
+    gdsii::write_record_header(out, 4, gdsii::ENDLIB, gdsii::NO_DATA);
+  };
+  write_layers("test_layers.gds");
+  std::remove("test_layers.gds.lidx");
+
+  // Polygon of each structure: its selected boundaries, concatenated
+  [[maybe_unused]] auto expected = [&structures](const LayerSelection& layers) {
+    std::vector<Polygon> polygons;
+    for (size_t s = 0; s < structures.size(); ++s) {
+      Polygon poly(static_cast<int>(s));
+      for (const auto& e : structures[s]) {
+        if (!layers.contains(e.layer, e.datatype)) continue;
+        poly.vertices.insert(poly.vertices.end(), e.points.begin(),
+                             e.points.end());
+      }
+      if (!poly.vertices.empty()) polygons.push_back(poly);
+    }
+    return polygons;
+  };
+  [[maybe_unused]] auto same = [](const std::vector<Polygon>& a,
+                                  const std::vector<Polygon>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].id != b[i].id || a[i].vertices.size() != b[i].vertices.size() ||
+          a[i].segments.size() != b[i].vertices.size()) {
+        return false;
+      }
+      for (size_t k = 0; k < a[i].vertices.size(); ++k) {
+        if (a[i].vertices[k].x() != b[i].vertices[k].x() ||
+            a[i].vertices[k].y() != b[i].vertices[k].y()) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  [[maybe_unused]] auto with_segments = [](std::vector<Polygon> polygons) {
+    for (auto& poly : polygons) poly.build_segments();
+    return polygons;
+  };
+
+  LayerSelection all;
+  assert(same(read_gdsii("test_layers.gds"), with_segments(expected(all))));
+  assert(same(read_gdsii_stream("test_layers.gds"),
+              with_segments(expected(all))));
+
+  LayerSelection some = LayerSelection::parse(" 2, 5/1,0/1 ");
+  assert(some.contains(2, 0) && some.contains(2, 7) && some.contains(5, 1));
+  assert(!some.contains(5, 0) && !some.contains(0, 0) && some.contains(0, 1));
+  for ([[maybe_unused]] int threads : {1, 3}) {
+    assert(same(read_gdsii_mapped("test_layers.gds", threads, some),
+                with_segments(expected(some))));
+  }
+
+  // The sidecar index is built by the first indexed read, then reused
+  LayerSelection seven = LayerSelection::parse("7");
+  assert(same(read_gdsii_indexed("test_layers.gds", some),
+              with_segments(expected(some))));
+  GdsiiLayerIndex index;
+  assert(index.load(GdsiiLayerIndex::sidecar("test_layers.gds"),
+                    "test_layers.gds"));
+  assert(index.num_structures() == 12);
+  assert(index.elements().size() == 11 * 2 + 5 + 1);
+  assert(index.headers().size() == 12 && index.references().empty());
+  for ([[maybe_unused]] int threads : {1, 3}) {
+    assert(same(index.read("test_layers.gds", seven, threads),
+                with_segments(expected(seven))));
+    assert(same(index.read("test_layers.gds", all, threads),
+                with_segments(expected(all))));
+  }
+
+  // Rewriting the GDSII file makes the index stale; it is rebuilt
+  structures[3].push_back({7, 0, {Point(0, 0), Point(5, 0), Point(5, 5)}});
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  write_layers("test_layers.gds");
+  assert(!index.load(GdsiiLayerIndex::sidecar("test_layers.gds"),
+                     "test_layers.gds"));
+  assert(same(read_gdsii_indexed("test_layers.gds", seven),
+              with_segments(expected(seven))));
+  assert(index.load(GdsiiLayerIndex::sidecar("test_layers.gds"),
+                    "test_layers.gds"));
+
+  // The hierarchical reader keeps only the selected boundaries
+  HierarchicalLayout layout = read_gdsii_hierarchy("test_layers.gds", 2,
+                                                   seven);
+  size_t kept = 0;
+  for (int c = 0; c < layout.num_cells(); ++c) {
+    kept += layout.cell(c).polygons.size();
+  }
+  assert(kept == 6);
+
+  for (const char* bad : {"x", "1/", "-2", "3/a"}) {
+    [[maybe_unused]] bool thrown = false;
+    try {
+      LayerSelection::parse(bad);
+    } catch (const std::runtime_error&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  std::cout << "  ✓ GDSII layer selection and index work" << std::endl;
+}
+
+// Minimal OASIS encoder for the reader test
+struct OasisBytes {
+  std::string data = "%SEMI-OASIS\r\n";
+
+  void uint(uint64_t value) {
+    do {
+      unsigned char b = value & 0x7f;
+      value >>= 7;
+      data.push_back(static_cast<char>(value ? (b | 0x80) : b));
+    } while (value);
+  }
+
+  void sint(int64_t value) {
+    uint(value < 0 ? (static_cast<uint64_t>(-value) << 1) | 1
+                   : static_cast<uint64_t>(value) << 1);
+  }
+
+  void string(const std::string& text) {
+    uint(text.size());
+    data += text;
+  }
+
+  // Free-form g-delta
+  void g_delta(int64_t x, int64_t y) {
+    uint((static_cast<uint64_t>(x < 0 ? -x : x) << 2) | (x < 0 ? 2 : 0) | 1);
+    uint((static_cast<uint64_t>(y < 0 ? -y : y) << 1) | (y < 0 ? 1 : 0));
+  }
+
+  void start() {
+    uint(1);
+    string("1.0");
+    uint(0);  // Unit: positive integer 1000
+    uint(1000);
+    uint(0);  // Table offsets in START, all zero
+    for (int i = 0; i < 12; ++i) uint(0);
+  }
+
+  void save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    out.write(data.data(), data.size());
+  }
+};
+
+void test_oasis_reader() {
+  std::cout << "\n=== Test: OASIS Reader ===" << std::endl;
+
+  // Each element exercises a point list, repetition or modal variable;
+  // the expected polygons follow in `expected`
+  OasisBytes oas;
+  oas.start();
+  oas.uint(3);  // CELLNAMEs 0 and 1
+  oas.string("TOP");
+  oas.uint(3);
+  oas.string("SUB");
+  oas.uint(8);  // PROPNAME with reference number
+  oas.string("P");
+  oas.uint(0);
+  oas.uint(13);  // CELL 0
+  oas.uint(0);
+
+  std::vector<std::vector<Point>> expected;
+  auto rect = [&expected](int x, int y, int w, int h) {
+    expected.push_back({Point(x, y), Point(x + w, y), Point(x + w, y + h),
+                        Point(x, y + h)});
+  };
+  auto l_shape = [&expected](int x, int y) {
+    expected.push_back({Point(x, y), Point(x + 30, y), Point(x + 30, y + 10),
+                        Point(x + 10, y + 10), Point(x + 10, y + 30),
+                        Point(x, y + 30)});
+  };
+
+  oas.uint(20);  // RECTANGLE: layer, datatype, w, h, x, y
+  oas.data.push_back(0x7B);
+  oas.uint(1);
+  oas.uint(0);
+  oas.uint(10);
+  oas.uint(20);
+  oas.sint(100);
+  oas.sint(-200);
+  rect(100, -200, 10, 20);
+
+  oas.uint(28);  // PROPERTY with two values
+  oas.data.push_back(0x26);
+  oas.uint(0);
+  oas.uint(8);
+  oas.uint(5);
+  oas.uint(10);
+  oas.string("ab");
+
+  oas.uint(16);  // XYRELATIVE
+  oas.uint(20);  // Square, x relative, 2 x 3 grid
+  oas.data.push_back(static_cast<char>(0xD4));
+  oas.uint(5);
+  oas.sint(50);
+  oas.uint(1);
+  oas.uint(0);
+  oas.uint(1);
+  oas.uint(30);
+  oas.uint(40);
+  for (int j = 0; j < 3; ++j) {
+    for (int i = 0; i < 2; ++i) rect(150 + 30 * i, -200 + 40 * j, 5, 5);
+  }
+
+  oas.uint(19);  // TEXT: string, textlayer, texttype, x, y
+  oas.data.push_back(0x5B);
+  oas.string("label");
+  oas.uint(1);
+  oas.uint(2);
+  oas.sint(7);
+  oas.sint(8);
+
+  oas.uint(21);  // POLYGON: Manhattan point list, implicit last vertex
+  oas.data.push_back(0x39);
+  oas.uint(2);
+  oas.uint(0);
+  oas.uint(4);
+  for (int d : {30, 10, -20, 20}) oas.sint(d);
+  oas.sint(-50);
+  oas.sint(300);
+  l_shape(100, 100);
+
+  oas.uint(17);  // PLACEMENT of SUB with a 3-element x repetition
+  oas.data.push_back(static_cast<char>(0xF8));
+  oas.uint(1);
+  oas.sint(1000);
+  oas.sint(1000);
+  oas.uint(2);
+  oas.uint(1);
+  oas.uint(500);
+
+  oas.uint(21);  // POLYGON reusing the point list and the repetition
+  oas.data.push_back(0x14);
+  oas.sint(1000);
+  oas.uint(0);
+  for (int k = 0; k < 3; ++k) l_shape(1100 + 500 * k, 100);
+
+  oas.uint(23);  // TRAPEZOID: sets the modal width, height and x
+  oas.data.push_back(0x70);
+  oas.uint(8);
+  oas.uint(6);
+  oas.sint(1);
+  oas.sint(-1);
+  oas.sint(-1100);
+  oas.uint(27);  // CIRCLE: sets the modal y
+  oas.data.push_back(0x28);
+  oas.uint(3);
+  oas.sint(-100);
+  oas.uint(20);  // RECTANGLE entirely from modal variables
+  oas.data.push_back(0x00);
+  rect(0, 0, 8, 6);
+
+  oas.uint(22);  // PATH with explicit extensions
+  oas.data.push_back(static_cast<char>(0xF0));
+  oas.uint(2);
+  oas.uint(0x0F);
+  oas.sint(1);
+  oas.sint(2);
+  oas.uint(4);
+  oas.uint(2);
+  oas.g_delta(10, 0);
+  oas.g_delta(0, 10);
+  oas.sint(500);
+
+  oas.uint(15);  // XYABSOLUTE
+  oas.uint(21);  // POLYGON: octangular triangle
+  oas.data.push_back(0x38);
+  oas.uint(3);
+  oas.uint(2);
+  oas.uint((10 << 3) | 0);
+  oas.uint((10 << 3) | 5);
+  oas.sint(-7);
+  oas.sint(-9);
+  expected.push_back({Point(-7, -9), Point(3, -9), Point(-7, 1)});
+
+  oas.uint(21);  // POLYGON: explicitly closed square on a 2 x 2 lattice
+  oas.data.push_back(0x3C);
+  oas.uint(2);
+  oas.uint(4);
+  for (int dir = 0; dir < 4; ++dir) oas.uint((4 << 2) | dir);
+  oas.sint(0);
+  oas.sint(0);
+  oas.uint(8);
+  oas.uint(0);
+  oas.uint(0);
+  oas.g_delta(100, 10);
+  oas.g_delta(-10, 100);
+  rect(0, 0, 4, 4);
+  rect(100, 10, 4, 4);
+  rect(-10, 100, 4, 4);
+  rect(90, 110, 4, 4);
+
+  oas.uint(21);  // POLYGON: double-delta point list
+  oas.data.push_back(0x38);
+  oas.uint(5);
+  oas.uint(3);
+  oas.g_delta(10, 0);
+  oas.g_delta(-10, 10);
+  oas.g_delta(-10, -10);
+  oas.sint(1000);
+  oas.sint(1000);
+  rect(1000, 1000, 10, 10);
+
+  oas.uint(20);  // RECTANGLE with arbitrary displacements
+  oas.data.push_back(0x7C);
+  oas.uint(2);
+  oas.uint(2);
+  oas.sint(0);
+  oas.sint(-500);
+  oas.uint(10);
+  oas.uint(1);
+  oas.g_delta(3, 4);
+  oas.g_delta(-6, 0);
+  rect(0, -500, 2, 2);
+  rect(3, -496, 2, 2);
+  rect(-3, -496, 2, 2);
+
+  oas.uint(20);  // RECTANGLE with y spacings on a grid
+  oas.data.push_back(0x04);
+  oas.uint(7);
+  oas.uint(0);
+  oas.uint(5);
+  oas.uint(3);
+  rect(0, -500, 2, 2);
+  rect(0, -485, 2, 2);
+
+  oas.uint(14);  // CELL by name: modal variables are reset
+  oas.string("SUB");
+  oas.uint(16);
+  oas.uint(20);
+  oas.data.push_back(0x70);
+  oas.uint(1);
+  oas.uint(1);
+  oas.sint(5);
+
+  // PLACEMENT of LEAF with magnification (double), angle (float), flip
+  oas.uint(18);
+  oas.data.push_back(static_cast<char>(0xA7));
+  oas.string("LEAF");
+  double magnification = 1.0;
+  float angle = 90.0f;
+  oas.uint(7);
+  oas.data.append(reinterpret_cast<const char*>(&magnification), 8);
+  oas.uint(6);
+  oas.data.append(reinterpret_cast<const char*>(&angle), 4);
+  oas.sint(20);
+  oas.uint(14);  // CELL LEAF
+  oas.string("LEAF");
+  oas.uint(20);
+  oas.data.push_back(0x7B);
+  oas.uint(1);
+  oas.uint(0);
+  oas.uint(4);
+  oas.uint(2);
+  oas.sint(0);
+  oas.sint(0);
+  // TOP's polygons, then each placed SUB: its rectangle and the flipped,
+  // turned LEAF
+  for (int k = 0; k < 3; ++k) {
+    rect(1005 + 500 * k, 1000, 1, 1);
+    rect(1020 + 500 * k, 1000, 2, 4);
+  }
+  oas.uint(11);  // LAYERNAME
+  oas.string("M1");
+  oas.uint(4);
+  oas.uint(1);
+  oas.uint(2);
+  oas.uint(0);
+  oas.uint(30);  // XNAME
+  oas.uint(1);
+  oas.string("x");
+  oas.uint(0);  // PAD
+  oas.uint(2);  // END
+  oas.string(std::string(200, '\0'));
+  oas.uint(0);
+  oas.save("test_reader.oas");
+
+  std::vector<Polygon> polygons = read_oasis("test_reader.oas");
+  std::cout << "  Polygons: " << polygons.size() << " from "
+            << oas.data.size() << " bytes" << std::endl;
+  assert(polygons.size() == expected.size());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    assert(polygons[i].id == static_cast<int>(i));
+    assert(polygons[i].vertices.size() == expected[i].size());
+    assert(polygons[i].segments.size() == expected[i].size());
+    for (size_t k = 0; k < expected[i].size(); ++k) {
+      assert(polygons[i].vertices[k].x() == expected[i][k].x());
+      assert(polygons[i].vertices[k].y() == expected[i][k].y());
+    }
+  }
+
+  // Compressed, truncated and non-OASIS files are rejected
+  [[maybe_unused]] auto rejects = [](const std::string& bytes) {
+    {
+      std::ofstream out("test_reader_bad.oas", std::ios::binary);
+      out.write(bytes.data(), bytes.size());
+    }
+    try {
+      read_oasis("test_reader_bad.oas");
+    } catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  OasisBytes compressed;
+  compressed.start();
+  compressed.uint(34);
+  compressed.uint(0);
+  assert(rejects(compressed.data));
+  assert(rejects(oas.data.substr(0, oas.data.size() / 2)));
+  assert(rejects("%SEMI-OASIS\n"));
+
+  // A cell placed twice, the second time turned, gives both instances
+  auto placing = [](auto top) {
+    OasisBytes bytes;
+    bytes.start();
+    bytes.uint(14);  // CELL VIA: a 10 x 20 rectangle
+    bytes.string("VIA");
+    bytes.uint(20);
+    bytes.data.push_back(0x7B);
+    bytes.uint(1);
+    bytes.uint(0);
+    bytes.uint(10);
+    bytes.uint(20);
+    bytes.sint(0);
+    bytes.sint(0);
+    bytes.uint(14);
+    bytes.string("TOP");
+    top(bytes);
+    bytes.uint(2);
+    bytes.string(std::string(200, '\0'));
+    bytes.uint(0);
+    return bytes;
+  };
+  OasisBytes twice = placing([](OasisBytes& bytes) {
+    bytes.uint(17);  // VIA at (100, 0)
+    bytes.data.push_back(static_cast<char>(0xB0));
+    bytes.string("VIA");
+    bytes.sint(100);
+    bytes.sint(0);
+    bytes.uint(17);  // The same cell at (300, 0), turned by 90 degrees
+    bytes.data.push_back(0x22);
+    bytes.sint(300);
+  });
+  twice.save("test_reader.oas");
+  polygons = read_oasis("test_reader.oas");
+  std::vector<std::vector<Point>> placed = {
+      {Point(100, 0), Point(110, 0), Point(110, 20), Point(100, 20)},
+      {Point(300, 0), Point(300, 10), Point(280, 10), Point(280, 0)}};
+  assert(polygons.size() == placed.size());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    assert(polygons[i].id == static_cast<int>(i));
+    assert(polygons[i].segments.size() == placed[i].size());
+    for (size_t k = 0; k < placed[i].size(); ++k) {
+      assert(polygons[i].vertices[k].x() == placed[i][k].x());
+      assert(polygons[i].vertices[k].y() == placed[i][k].y());
+    }
+  }
+
+  // Scaled, recursive and dangling placements are rejected
+  assert(rejects(placing([](OasisBytes& bytes) {
+    bytes.uint(18);
+    bytes.data.push_back(static_cast<char>(0x84));
+    bytes.string("VIA");
+    bytes.uint(0);
+    bytes.uint(2);
+  }).data));
+  assert(rejects(placing([](OasisBytes& bytes) {
+    bytes.uint(17);
+    bytes.data.push_back(static_cast<char>(0x80));
+    bytes.string("TOP");
+  }).data));
+  assert(rejects(placing([](OasisBytes& bytes) {
+    bytes.uint(17);
+    bytes.data.push_back(static_cast<char>(0x80));
+    bytes.string("NONE");
+  }).data));
+
+  std::cout << "  ✓ OASIS reader works" << std::endl;
+}
+
+void test_layout_cache() {
+  std::cout << "\n=== Test: Binary Layout Cache ===" << std::endl;
+
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 3000; ++i) {
+    Polygon poly(i * 2 + 1);
+    int x = (i % 50) * 40 - 1000, y = (i / 50) * 40;
+    poly.add_vertex(Point(x, y));
+    poly.add_vertex(Point(x + 10 + i % 7, y));
+    if (i % 3 == 0) {
+      poly.add_vertex(Point(x + 5, y + 20));  // Slanted edges
+    } else {
+      poly.add_vertex(Point(x + 10 + i % 7, y + 20));
+      poly.add_vertex(Point(x, y + 20));
+    }
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+  polygons.push_back(Polygon(-5));  // No vertices
+
+  std::ofstream("test_cache_source.txt") << "source\n";
+  std::remove("test_layout.lcache");
+  LayoutCache cache;
+  assert(!cache.open("test_layout.lcache"));
+  LayoutCache::write(polygons, "test_layout.lcache", "test_cache_source.txt");
+
+  // Views read straight from the mapping
+  assert(cache.open("test_layout.lcache", "test_cache_source.txt"));
+  assert(cache.size() == polygons.size());
+  assert(cache.content_hash() == LayoutCache::layout_hash(polygons));
+  [[maybe_unused]] BoundingBox extent = cache.extent();
+  assert(extent.min_x == -1000 && extent.min_y == 0);
+  assert(extent.max_x == 49 * 40 - 1000 + 10 + 6);
+  assert(extent.max_y == 59 * 40 + 20);
+  size_t vertices = 0;
+  for (size_t i = 0; i + 1 < polygons.size(); ++i) {
+    assert(cache.id(i) == polygons[i].id);
+    assert(cache.num_vertices(i) == polygons[i].vertices.size());
+    [[maybe_unused]] BoundingBox expected = compute_bounding_box(polygons[i]);
+    [[maybe_unused]] BoundingBox box = cache.bbox(i);
+    assert(box.min_x == expected.min_x && box.min_y == expected.min_y &&
+           box.max_x == expected.max_x && box.max_y == expected.max_y &&
+           box.polygon_id == polygons[i].id);
+    vertices += cache.num_vertices(i);
+  }
+  assert(cache.num_vertices(polygons.size() - 1) == 0);
+  assert(cache.num_vertices() == vertices);
+
+  // A store borrowing the mapped arrays, with the values LayoutStore caches
+  LayoutStore store = cache.store();
+  LayoutStore reference(polygons);
+  assert(store.borrowed() && store.bytes() == 0);
+  assert(store.size() == reference.size());
+  assert(store.num_vertices() == reference.num_vertices());
+  for (size_t i = 0; i < store.size(); ++i) {
+    [[maybe_unused]] PolygonView view = store[i], expected = reference[i];
+    assert(view.id() == expected.id() && view.size() == expected.size());
+    assert(store.perimeter(i) == reference.perimeter(i));
+    for (size_t k = 0; k < view.num_edges(); ++k) {
+      assert(view.vertex(k).x() == expected.vertex(k).x());
+      assert(view.vertex(k).y() == expected.vertex(k).y());
+      assert(view.edge_length(k) == expected.edge_length(k));
+    }
+  }
+  EasyMRC::Config config;
+  config.rule_distance_R = 30.0;
+  auto from_cache = EasyMRC(config).run(store);
+  auto from_polygons = EasyMRC(config).run(polygons);
+  assert(from_polygons.total_violations() > 0);
+  assert(from_cache.total_violations() == from_polygons.total_violations());
+  [[maybe_unused]] bool refused_add = false;
+  try {
+    store.add(polygons[0]);
+  } catch (const std::logic_error&) {
+    refused_add = true;
+  }
+  assert(refused_add);
+
+  for (int threads : {1, 3}) {
+    std::vector<Polygon> loaded = cache.polygons(threads);
+    assert(loaded.size() == polygons.size());
+    for (size_t i = 0; i < loaded.size(); ++i) {
+      assert(loaded[i].id == polygons[i].id);
+      assert(loaded[i].segments.size() == polygons[i].segments.size());
+      for (size_t k = 0; k < loaded[i].vertices.size(); ++k) {
+        assert(loaded[i].vertices[k].x() == polygons[i].vertices[k].x());
+        assert(loaded[i].vertices[k].y() == polygons[i].vertices[k].y());
+      }
+    }
+  }
+
+  // An edited source, a truncated file or another version is refused
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  std::ofstream("test_cache_source.txt") << "edited\n";
+  assert(!cache.open("test_layout.lcache", "test_cache_source.txt"));
+  assert(!cache.is_open());
+  assert(cache.open("test_layout.lcache"));
+  cache.close();
+
+  std::string bytes;
+  {
+    std::ifstream in("test_layout.lcache", std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+  }
+  [[maybe_unused]] auto refused = [&cache](const std::string& data) {
+    std::ofstream("test_layout_bad.lcache", std::ios::binary) << data;
+    return !cache.open("test_layout_bad.lcache");
+  };
+  assert(!refused(bytes));
+  assert(refused(bytes.substr(0, bytes.size() - 8)));
+  assert(refused(bytes.substr(0, 20)));
+  std::string other_version = bytes;
+  other_version[8] ^= 0x7f;
+  assert(refused(other_version));
+
+  std::cout << "  ✓ Binary layout cache works" << std::endl;
+}
+
+void test_layout_store() {
+  std::cout << "\n=== Test: Flat Layout Store ===" << std::endl;
+
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 40; ++i) {
+    Polygon poly(100 + i);
+    int x = (i % 8) * 18 - 50, y = (i / 8) * 22;
+    int w = 3 + i % 6 * 2;
+    poly.add_vertex(Point(x, y));
+    poly.add_vertex(Point(x + w, y));
+    if (i % 4 == 0) {
+      poly.add_vertex(Point(x + w / 2, y + 15));  // Slanted edges
+    } else {
+      poly.add_vertex(Point(x + w, y + 15));
+      poly.add_vertex(Point(x, y + 15));
+    }
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+  polygons.push_back(Polygon(7));  // No vertices
+
+  LayoutStore store(polygons);
+  assert(store.size() == polygons.size());
+  size_t vertices = 0;
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    const Polygon& poly = polygons[i];
+    PolygonView view = store[i];
+    assert(view.id() == poly.id && store.id(i) == poly.id);
+    assert(view.size() == poly.vertices.size());
+    assert(view.num_edges() == poly.segments.size());
+    for (size_t k = 0; k < view.size(); ++k) {
+      assert(view.vertex(k).x() == poly.vertices[k].x());
+      assert(view.vertex(k).y() == poly.vertices[k].y());
+    }
+    // Derived edges and cached values as from the segments
+    double perimeter = 0.0;
+    for (size_t k = 0; k < view.num_edges(); ++k) {
+      const Segment& seg = poly.segments[k];
+      [[maybe_unused]] Segment edge = view.edge(k);
+      assert(edge.start.x() == seg.start.x() && edge.end.x() == seg.end.x());
+      assert(edge.start.y() == seg.start.y() && edge.end.y() == seg.end.y());
+      assert(view.edge_length(k) == seg.length());
+      perimeter += seg.length();
+    }
+    assert(store.perimeter(i) == perimeter);
+    assert(view.average_edge_length() ==
+           PolygonView(poly).average_edge_length());
+    assert(calculate_sampling_radius(view, 4.0) ==
+           calculate_sampling_radius(poly, 4.0));
+    [[maybe_unused]] BoundingBox expected = compute_bounding_box(poly);
+    [[maybe_unused]] BoundingBox box = store.bbox(i);
+    assert(box.min_x == expected.min_x && box.min_y == expected.min_y &&
+           box.max_x == expected.max_x && box.max_y == expected.max_y &&
+           box.polygon_id == expected.polygon_id);
+    vertices += poly.vertices.size();
+  }
+  assert(store.num_vertices() == vertices);
+  assert(LayoutCache::layout_hash(store) == LayoutCache::layout_hash(polygons));
+  assert(candidate_pair_generation(store, 6.0) ==
+         candidate_pair_generation(polygons, 6.0));
+
+  // Copied back out with segments
+  std::vector<Polygon> copied = store.polygons();
+  assert(copied.size() == polygons.size());
+  assert(copied[3].segments.size() == polygons[3].segments.size());
+  assert(copied[3].vertices[2].x() == polygons[3].vertices[2].x());
+
+  // Same results from the store as from the vector, either path
+  EasyMRC::Config config;
+  config.rule_distance_R = 8.0;
+  for (bool parallel : {false, true}) {
+    config.enable_parallel = parallel;
+    auto reference = EasyMRC(config).run(polygons);
+    auto results = EasyMRC(config).run(store);
+    assert(reference.total_violations() > 0);
+    assert(results.space_violations_type_a.size() ==
+           reference.space_violations_type_a.size());
+    assert(results.space_violations_type_b.size() ==
+           reference.space_violations_type_b.size());
+    assert(results.width_violations.size() ==
+           reference.width_violations.size());
+    for (size_t i = 0; i < results.space_violations_type_a.size(); ++i) {
+      assert(results.space_violations_type_a[i].distance ==
+             reference.space_violations_type_a[i].distance);
+    }
+    for (size_t i = 0; i < results.width_violations.size(); ++i) {
+      assert(results.width_violations[i].distance ==
+             reference.width_violations[i].distance);
+    }
+  }
+
+  // Built by moving the polygons in, which releases them
+  size_t vector_bytes = LayoutStore::bytes(polygons);
+  LayoutStore moved(std::move(polygons));
+  assert(polygons.empty());
+  assert(moved.size() == store.size() && moved.num_vertices() == vertices);
+  std::cout << "  Memory: " << moved.bytes() << " bytes stored, "
+            << vector_bytes << " as polygons" << std::endl;
+  assert(moved.bytes() < vector_bytes);
+
+  std::cout << "  ✓ Flat layout store works" << std::endl;
+}
+
 void test_candidate_pairs() {
   std::cout << "\n=== Test: Candidate Pair Generation ===" << std::endl;
 
@@ -196,6 +1761,65 @@ void test_width_violations() {
   }
 }
 
+void test_exact_geometry() {
+  std::cout << "\n=== Test: Exact Integer Geometry ===" << std::endl;
+
+  // Largest squared distance strictly below R^2
+  assert(squared_limit(5.0) == 24);
+  assert(squared_limit(std::nextafter(5.0, 6.0)) == 25);
+  assert(squared_limit(std::sqrt(2.0)) == 2);  // sqrt(2.0)^2 > 2 exactly
+  assert(squared_limit(0.5) == 0);
+  assert(squared_limit(0.0) == -1 && squared_limit(-3.0) == -1);
+  assert(integer_reach(2.5) == 2 && integer_reach(3.0) == 3);
+  assert(integer_reach(-0.5) == -1);
+
+  assert(squared_distance(Point(1, 2), Point(4, 6)) == 25);
+  assert(squared_distance(Point(-2000000000, 0), Point(2000000000, 0)) ==
+         std::numeric_limits<int64_t>::max());
+  assert(squared_distance(Point(5, 7), Segment(0, 0, 10, 0)) == 49);
+  assert(squared_distance(Point(13, 4), Segment(10, 0, 10, 20)) == 9);
+  assert(squared_distance(Point(13, 24), Segment(10, 20, 10, 0)) == 25);
+
+  // Expanded boxes overlap when at most 2R apart: 5 for R = 2.5
+  ExactBox a(0, 0, 10, 10), b(15, 3, 20, 8), c(16, 3, 20, 8);
+  a.expand(2.5);
+  b.expand(2.5);
+  c.expand(2.5);
+  assert(a.overlaps(b) && b.overlaps(a));
+  assert(!a.overlaps(c) && !c.overlaps(a));
+  std::vector<Polygon> boxes(3);
+  boxes[0].vertices = {Point(0, 0), Point(10, 0), Point(10, 10), Point(0, 10)};
+  boxes[1].vertices = {Point(15, 0), Point(20, 0), Point(20, 5), Point(15, 5)};
+  boxes[2].vertices = {Point(0, 16), Point(4, 16), Point(4, 20), Point(0, 20)};
+  for (auto& poly : boxes) poly.build_segments();
+  assert((candidate_pair_generation(boxes, 2.5) ==
+          std::vector<std::pair<int, int>>{{0, 1}}));
+  assert((candidate_pair_generation(boxes, 3.0) ==
+          std::vector<std::pair<int, int>>{{0, 1}, {0, 2}}));
+
+  // A distance of exactly R is not a violation; the reported distance is
+  // the same floating-point value as before
+  RepresentativePoints p1, p2;
+  p1.emplace_back(Point(0, 0), 0);
+  p1.back().shielded_vertices = {Point(0, 0), Point(0, 1)};
+  p2.emplace_back(Point(3, 4), 1);
+  p2.back().shielded_vertices = {Point(3, 4)};
+  auto at_five = detect_type_a_violations(p1, p2, 5.0, 1.0);
+  assert(at_five.size() == 1);  // (0, 1)-(3, 4) only
+  assert(at_five[0].distance == euclidean_distance(Point(0, 1), Point(3, 4)));
+  assert(detect_type_a_violations(p1, p2, std::nextafter(5.0, 6.0), 1.0)
+             .size() == 2);
+
+  Polygon thin(0);
+  thin.vertices = {Point(0, 0), Point(100, 0), Point(100, 4), Point(0, 4)};
+  thin.build_segments();
+  assert(check_width_violations(thin, 4.0, 8.0).empty());
+  auto width = check_width_violations(thin, 4.5, 8.0);
+  assert(width.size() == 1 && width[0].distance == 4.0);
+
+  std::cout << "  ✓ Exact integer geometry works" << std::endl;
+}
+
 void test_parallel_execution() {
   std::cout << "\n=== Test: Parallel Execution ===" << std::endl;
 
@@ -279,6 +1903,1078 @@ void test_parallel_execution() {
   std::cout << "  ✓ Parallel execution works" << std::endl;
 }
 
+void test_cost_scheduling() {
+  std::cout << "\n=== Test: Cost-Model Scheduling ===" << std::endl;
+
+  // Polygons with very different vertex counts (staircases of n steps)
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 12; ++i) {
+    Polygon poly(i);
+    int steps = 1 + (i % 4) * 10;
+    int x0 = i * 60;
+    poly.add_vertex(Point(x0, 0));
+    for (int s = 0; s < steps; ++s) {
+      poly.add_vertex(Point(x0 + 40 - s, s));
+      poly.add_vertex(Point(x0 + 40 - s, s + 1));
+    }
+    poly.add_vertex(Point(x0, steps));
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+
+  std::vector<double> costs;
+  for (const auto& poly : polygons) {
+    costs.push_back(estimate_polygon_cost(
+        compute_polygon_cost_info(poly, 4.0)));
+  }
+
+  // Every task is scheduled exactly once, most expensive first
+  CostSchedule schedule(costs, 4);
+  std::vector<int> seen(costs.size(), 0);
+  size_t begin, end;
+  [[maybe_unused]] double previous = std::numeric_limits<double>::max();
+  while (schedule.next(begin, end)) {
+    for (size_t k = begin; k < end; ++k) {
+      size_t task = schedule.order()[k];
+      seen[task]++;
+      assert(costs[task] <= previous);
+      previous = costs[task];
+    }
+  }
+  for ([[maybe_unused]] int count : seen) assert(count == 1);
+  std::cout << "  Chunks: " << schedule.num_chunks() << std::endl;
+
+  // Scheduled parallel run finds the same violations as the sequential one
+  double R = 30;
+  auto pairs = candidate_pair_generation(polygons, R);
+
+  std::vector<Violation> violations_a_par;
+  std::vector<ViolationTypeB> violations_b_par;
+  LoadStats space_load;
+  parallel_space_check(polygons, pairs, R, violations_a_par,
+                       violations_b_par, 4.0, 4, &space_load);
+
+  size_t sequential_a = 0;
+  for (const auto& pair : pairs) {
+    double r = std::max(calculate_sampling_radius(polygons[pair.first]),
+                        calculate_sampling_radius(polygons[pair.second]));
+    std::vector<Violation> vio_a;
+    std::vector<ViolationTypeB> vio_b;
+    check_space_violations_complete(polygons[pair.first],
+                                    polygons[pair.second], R, r,
+                                    vio_a, vio_b);
+    sequential_a += vio_a.size();
+  }
+  assert(violations_a_par.size() == sequential_a);
+
+  std::cout << "  Space load imbalance: " << space_load.imbalance()
+            << " over " << space_load.busy_ms.size() << " threads"
+            << std::endl;
+
+  size_t tasks = 0;
+  for (size_t n : space_load.tasks_done) tasks += n;
+  assert(tasks == pairs.size());
+
+  std::cout << "  ✓ Cost-model scheduling works" << std::endl;
+}
+
+void test_worker_arena() {
+  std::cout << "\n=== Test: Per-Worker Arena ===" << std::endl;
+
+  WorkerArena arena(1024);
+
+  // Spill over the first block, then reset: the blocks are merged
+  std::pmr::vector<int> values(&arena);
+  for (int i = 0; i < 10000; ++i) values.push_back(i);
+  assert(values[9999] == 9999);
+  [[maybe_unused]] size_t capacity = arena.capacity();
+  values = std::pmr::vector<int>(&arena);
+  arena.reset();
+  assert(arena.capacity() == capacity);
+
+  // Over-aligned requests get aligned addresses, also in a fresh block
+  [[maybe_unused]] auto aligned = [&arena](size_t bytes, size_t alignment) {
+    void* p = arena.allocate(bytes, alignment);
+    return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+  };
+  for ([[maybe_unused]] size_t alignment : {64, 256, 4096}) {
+    assert(aligned(3, 1));  // Leaves an odd offset
+    assert(aligned(100, alignment));
+    assert(aligned(capacity * 2, alignment));
+  }
+  arena.reset();
+
+  // Sampling and detection inside the arena match the global allocator
+  Polygon poly1(0);
+  poly1.vertices = {Point(0,0), Point(10,0), Point(10,10), Point(0,10)};
+  poly1.build_segments();
+
+  Polygon poly2(1);
+  poly2.vertices = {Point(12,0), Point(22,0), Point(22,10), Point(12,10)};
+  poly2.build_segments();
+
+  double R = 5;
+  double r = calculate_sampling_radius(poly1, 4.0);
+
+  [[maybe_unused]] size_t expected_a;
+  {
+    std::vector<RepresentativePoint> rep_points_1, rep_points_2;
+    std::vector<RepresentativeEdge> rep_edges_1, rep_edges_2;
+    sample_representatives(poly1, r, rep_points_1, rep_edges_1);
+    sample_representatives(poly2, r, rep_points_2, rep_edges_2);
+    expected_a = detect_type_a_violations(rep_points_1, rep_points_2,
+                                          R, r).size();
+  }
+
+  for (int round = 0; round < 3; ++round) {
+    {
+      RepresentativePoints rep_points_1(&arena), rep_points_2(&arena);
+      RepresentativeEdges rep_edges_1(&arena), rep_edges_2(&arena);
+      sample_representatives(poly1, r, rep_points_1, rep_edges_1);
+      sample_representatives(poly2, r, rep_points_2, rep_edges_2);
+
+      assert(rep_points_1[0].shielded_vertices.get_allocator().resource() ==
+             &arena);
+
+      auto violations = detect_type_a_violations(rep_points_1, rep_points_2,
+                                                 R, r, &arena);
+      assert(violations.size() == expected_a);
+    }
+    arena.reset();
+  }
+
+  std::cout << "  Arena capacity: " << arena.capacity() << " bytes, "
+            << arena.allocations() << " allocations served" << std::endl;
+  std::cout << "  ✓ Per-worker arena works" << std::endl;
+}
+
+void test_parallel_concat() {
+  std::cout << "\n=== Test: Count-Then-Fill Aggregation ===" << std::endl;
+
+  // Uneven buffers, large enough to be filled by several threads
+  std::vector<std::vector<int>> parts(5);
+  int value = 0;
+  for (size_t p = 0; p < parts.size(); ++p) {
+    size_t count = (p == 2) ? 0 : (p + 1) * 40000;
+    for (size_t i = 0; i < count; ++i) parts[p].push_back(value++);
+  }
+
+  // One slot per buffer: the output keeps buffer order
+  std::vector<TaskSlot> slots(parts.size());
+  for (size_t p = 0; p < parts.size(); ++p) {
+    slots[p].worker = p;
+    slots[p].count = parts[p].size();
+  }
+  std::vector<int> out = {-3, -2, -1};
+  ordered_concat(parts, slots, out, 4);
+
+  assert(out.size() == 3 + static_cast<size_t>(value));
+  assert(out[0] == -3 && out[2] == -1);
+  for (int i = 0; i < value; ++i) assert(out[3 + i] == i);
+  assert(parts.empty());
+
+  std::cout << "  Aggregated elements: " << out.size() << std::endl;
+  std::cout << "  ✓ Count-then-fill aggregation works" << std::endl;
+}
+
+void test_cpu_topology() {
+  std::cout << "\n=== Test: CPU Topology and Affinity ===" << std::endl;
+
+  auto cpus = topology_detail::parse_cpu_list("0-2,5,8-9");
+  assert((cpus == std::vector<int>{0, 1, 2, 5, 8, 9}));
+
+  // Two L3 domains of four CPUs, limited by a 2.5 CPU quota
+  CpuTopology topology;
+  topology.allowed_cpus = {0, 1, 2, 3, 4, 5, 6, 7};
+  topology.l3_domains = {{0, 1, 2, 3}, {4, 5, 6, 7}};
+  topology.quota_cpus = 2.5;
+  assert(topology.effective_cpus() == 3);
+
+  auto compact = affinity_order(topology, AffinityPolicy::COMPACT);
+  auto scatter = affinity_order(topology, AffinityPolicy::SCATTER);
+  assert((compact == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}));
+  assert((scatter == std::vector<int>{0, 4, 1, 5, 2, 6, 3, 7}));
+  assert(affinity_order(topology, AffinityPolicy::NONE).empty());
+
+  const CpuTopology& detected = cpu_topology();
+  assert(detected.effective_cpus() >= 1);
+  std::cout << "  Detected CPUs: " << detected.allowed_cpus.size()
+            << " allowed, " << detected.l3_domains.size()
+            << " L3 domain(s), effective " << detected.effective_cpus()
+            << std::endl;
+
+  // Pinned workers produce the same results
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 12; ++i) {
+    Polygon poly(i);
+    poly.vertices = {Point(i * 15, 0), Point(i * 15 + 10, 0),
+                     Point(i * 15 + 10, 10), Point(i * 15, 10)};
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+  auto pairs = candidate_pair_generation(polygons, 20.0);
+
+  std::vector<Violation> free_a, pinned_a;
+  std::vector<ViolationTypeB> free_b, pinned_b;
+  ParallelOptions options;
+  options.num_threads = 2;
+  ParallelSpaceChecker(polygons, pairs, 20.0, 4.0, options)
+      .check_parallel(free_a, free_b);
+  options.affinity = AffinityPolicy::SCATTER;
+  ParallelSpaceChecker(polygons, pairs, 20.0, 4.0, options)
+      .check_parallel(pinned_a, pinned_b);
+  assert(free_a.size() == pinned_a.size());
+
+  std::cout << "  ✓ CPU topology detection works" << std::endl;
+}
+
+void test_task_graph() {
+  std::cout << "\n=== Test: Task Graph ===" << std::endl;
+
+  // Diamond: a -> (b, c) -> d; b is parallel and processes 100 items
+  std::mutex mutex;
+  std::vector<std::string> log;
+  std::atomic<int> next_item(0), items_done(0);
+  auto record = [&mutex, &log](const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    log.push_back(name);
+  };
+
+  TaskGraph graph;
+  auto a = graph.add_serial("a", [&]() { record("a"); });
+  auto b = graph.add_parallel("b", [&](int) {
+    if (next_item.fetch_add(10) >= 100) return false;
+    items_done += 10;
+    return true;
+  }, {a});
+  auto c = graph.add_serial("c", [&]() { record("c"); }, {a});
+  graph.add_serial("d", [&]() {
+    record("d");
+    assert(items_done == 100);
+  }, {b, c});
+  graph.run(4);
+
+  assert(log.size() == 3);
+  assert(log.front() == "a" && log.back() == "d");
+
+  // Exceptions are propagated to the caller
+  TaskGraph failing;
+  failing.add_serial("throws", []() {
+    throw std::runtime_error("node failed");
+  });
+  [[maybe_unused]] bool thrown = false;
+  try {
+    failing.run(2);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  // Overlapped phases produce the same violations as the sequential order
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 20; ++i) {
+    Polygon poly(i);
+    poly.vertices = {Point(i * 15, 0), Point(i * 15 + 10, 0),
+                     Point(i * 15 + 10, 10 + i), Point(i * 15, 10 + i)};
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 20.0;
+  config.num_threads = 3;
+  config.concurrent_phases = false;
+  auto sequential = EasyMRC(config).run(polygons);
+  config.concurrent_phases = true;
+  auto overlapped = EasyMRC(config).run(polygons);
+
+  assert(overlapped.space_violations_type_a.size() ==
+         sequential.space_violations_type_a.size());
+  assert(overlapped.space_violations_type_b.size() ==
+         sequential.space_violations_type_b.size());
+  assert(overlapped.width_violations.size() ==
+         sequential.width_violations.size());
+  std::cout << "  Violations: " << overlapped.total_violations()
+            << std::endl;
+
+  std::cout << "  ✓ Task graph works" << std::endl;
+}
+
+void test_tiled_execution() {
+  std::cout << "\n=== Test: Tiled Multi-Process Execution ===" << std::endl;
+
+  // Grid of rectangles of varying width, closer than R to their
+  // neighbours, so violations cross every tile boundary
+  std::vector<Polygon> polygons;
+  for (int row = 0; row < 6; ++row) {
+    for (int col = 0; col < 8; ++col) {
+      Polygon poly(row * 8 + col);
+      int x = col * 24, y = row * 30;
+      int w = 6 + (row + col) % 4 * 4;
+      poly.vertices = {Point(x, y), Point(x + w, y),
+                       Point(x + w, y + 22), Point(x, y + 22)};
+      poly.build_segments();
+      polygons.push_back(poly);
+    }
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 12.0;
+  config.num_threads = 2;
+
+  auto single = EasyMRC(config).run(polygons);
+  sort_results(single);
+
+  TiledRunner::Options options;
+  options.columns = 3;
+  options.rows = 2;
+  options.jobs = 2;
+  TiledRunner runner(config, options);
+  auto tiled = runner.run(polygons);
+
+  std::cout << "  Tiles: " << runner.statistics().tiles
+            << ", max polygons per tile: "
+            << runner.statistics().max_tile_polygons << " of "
+            << polygons.size() << std::endl;
+  std::cout << "  Violations: " << tiled.total_violations()
+            << " (single process: " << single.total_violations() << ")"
+            << std::endl;
+
+  assert(runner.statistics().max_tile_polygons < polygons.size());
+  assert(single.total_violations() > 0);
+  assert(tiled.space_violations_type_a.size() ==
+         single.space_violations_type_a.size());
+  assert(tiled.space_violations_type_b.size() ==
+         single.space_violations_type_b.size());
+  assert(tiled.width_violations.size() == single.width_violations.size());
+  for (size_t i = 0; i < single.space_violations_type_a.size(); ++i) {
+    [[maybe_unused]] const auto& a = single.space_violations_type_a[i];
+    [[maybe_unused]] const auto& b = tiled.space_violations_type_a[i];
+    assert(a.polygon_id_1 == b.polygon_id_1 &&
+           a.polygon_id_2 == b.polygon_id_2);
+    assert(a.point1.x() == b.point1.x() && a.point1.y() == b.point1.y());
+    assert(a.point2.x() == b.point2.x() && a.point2.y() == b.point2.y());
+  }
+  for (size_t i = 0; i < single.width_violations.size(); ++i) {
+    assert(single.width_violations[i].polygon_id ==
+           tiled.width_violations[i].polygon_id);
+    assert(single.width_violations[i].distance ==
+           tiled.width_violations[i].distance);
+  }
+
+  std::cout << "  ✓ Tiled execution matches single process" << std::endl;
+}
+
+void test_streaming() {
+  std::cout << "\n=== Test: Out-of-Core Banded Processing ===" << std::endl;
+
+  // Rectangles closer than R, some tall enough to span several bands, a
+  // thin stripe (width violation) and a comb whose teeth merge at the top
+  const int width = 180, height = 200;
+  Image img(width, height);
+  auto fill = [&img](int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) img.at(x, y) = 255;
+    }
+  };
+  for (int row = 0; row < 5; ++row) {
+    for (int col = 0; col < 6; ++col) {
+      int x = 4 + col * 20, y = 4 + row * 26;
+      fill(x, y, x + 8 + (row + col) % 3 * 3, y + 14 + col % 2 * 8);
+    }
+  }
+  fill(130, 10, 133, 70);
+  for (int tooth = 0; tooth < 5; ++tooth) {
+    fill(140 + tooth * 8, 150, 144 + tooth * 8, 185);
+  }
+  fill(140, 185, 176, 190);
+  {
+    std::ofstream out("test_streaming.pgm", std::ios::binary);
+    out << "P5\n" << width << " " << height << "\n255\n";
+    for (int y = height - 1; y >= 0; --y) {
+      out.write(reinterpret_cast<const char*>(img.row(y)), width);
+    }
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 8.0;
+  config.num_threads = 2;
+
+  auto polygons = format_conversion("test_streaming.pgm");
+  auto reference = EasyMRC(config).run(polygons);
+
+  // Violations compared by geometry, since ids follow completion order
+  [[maybe_unused]] auto space_keys = [](const EasyMRC::Results& r) {
+    std::multiset<std::tuple<int, int, int, int, double>> keys;
+    for (const auto& v : r.space_violations_type_a) {
+      auto a = std::make_pair(v.point1.x(), v.point1.y());
+      auto b = std::make_pair(v.point2.x(), v.point2.y());
+      if (b < a) std::swap(a, b);
+      keys.insert({a.first, a.second, b.first, b.second, v.distance});
+    }
+    return keys;
+  };
+  [[maybe_unused]] auto width_keys = [](const EasyMRC::Results& r) {
+    std::multiset<std::tuple<int, int, int, int, double>> keys;
+    for (const auto& v : r.width_violations) {
+      keys.insert({v.edge1.start.x(), v.edge1.start.y(), v.edge2.start.x(),
+                   v.edge2.start.y(), v.distance});
+    }
+    return keys;
+  };
+  auto outline = [](const Polygon& poly) {
+    std::vector<std::pair<int, int>> vertices;
+    for (const auto& v : poly.vertices) vertices.push_back({v.x(), v.y()});
+    return vertices;
+  };
+  std::multiset<std::vector<std::pair<int, int>>> reference_outlines;
+  for (const auto& poly : polygons) reference_outlines.insert(outline(poly));
+
+  assert(reference.space_violations_type_a.size() > 0);
+
+  for (int band_rows : {7, 64, 1000}) {
+    StreamingRunner::Options options;
+    options.band_rows = band_rows;
+    StreamingRunner runner(config, options);
+
+    std::multiset<std::vector<std::pair<int, int>>> outlines;
+    [[maybe_unused]] int next_id = 0;
+    runner.set_polygon_callback([&](const Polygon& poly) {
+      assert(poly.id == next_id++);
+      outlines.insert(outline(poly));
+    });
+    auto streamed = runner.run("test_streaming.pgm");
+    const auto& stats = runner.statistics();
+
+    assert(outlines == reference_outlines);
+    assert(stats.polygons == polygons.size());
+    assert(space_keys(streamed) == space_keys(reference));
+    assert(width_keys(streamed) == width_keys(reference));
+    assert(streamed.space_violations_type_b.size() ==
+           reference.space_violations_type_b.size());
+    // One band of bytes plus its bit mask, whatever the image height
+    [[maybe_unused]] size_t rows = std::min(band_rows, height);
+    assert(stats.band_bytes ==
+           rows * width + (rows + 2) * ((width + 63) / 64 + 2) * 8);
+    if (band_rows == 7) {
+      assert(stats.bands == (height + 6) / 7);
+      assert(stats.max_retained_polygons < polygons.size());
+    }
+    std::cout << "  Band rows " << band_rows << ": " << stats.bands
+              << " bands, " << stats.band_bytes << " band bytes, "
+              << stats.max_open_runs << " carried runs, "
+              << stats.max_retained_polygons << " of " << stats.polygons
+              << " polygons retained" << std::endl;
+  }
+
+  // The sweep over batches finds the same pairs as the full sweep
+  std::vector<std::pair<int, int>> incremental;
+  IncrementalPairSweep sweep(config.rule_distance_R);
+  for (size_t i = 0; i < polygons.size(); i += 7) {
+    std::vector<Polygon> batch(polygons.begin() + i,
+                               polygons.begin() +
+                                   std::min(polygons.size(), i + 7));
+    sweep.add(batch, incremental);
+  }
+  std::sort(incremental.begin(), incremental.end());
+  assert(incremental ==
+         candidate_pair_generation(polygons, config.rule_distance_R));
+
+  std::cout << "  ✓ Streaming matches the in-memory run" << std::endl;
+}
+
+void test_hierarchy() {
+  std::cout << "\n=== Test: Hierarchical GDSII Checking ===" << std::endl;
+
+  auto rect = [](int id, int x0, int y0, int x1, int y1) {
+    Polygon poly(id);
+    poly.vertices = {Point(x0, y0), Point(x1, y0), Point(x1, y1),
+                     Point(x0, y1)};
+    poly.build_segments();
+    return poly;
+  };
+
+  // "via": two squares 6 apart. "pair": a bar above a via and a rotated
+  // via. "top": a 4 x 3 array of pairs within R of each other, a bar
+  // below the array and a reflected pair on its own.
+  HierarchicalLayout built;
+  int via = built.add_cell("via");
+  built.cell(via).polygons = {rect(0, 0, 0, 20, 20), rect(1, 26, 0, 46, 20)};
+  int pair = built.add_cell("pair");
+  built.cell(pair).polygons = {rect(0, 0, 25, 45, 35)};
+  CellReference plain;
+  plain.cell = via;
+  built.cell(pair).references.push_back(plain);
+  CellReference turned = plain;
+  turned.origin = Point(70, 0);
+  turned.quarter_turns = 1;
+  built.cell(pair).references.push_back(turned);
+  int top = built.add_cell("top");
+  built.cell(top).polygons = {rect(0, 0, -15, 300, -8)};
+  CellReference array;
+  array.cell = pair;
+  array.columns = 4;
+  array.rows = 3;
+  array.column_step = Point(78, 0);
+  array.row_step = Point(0, 52);
+  built.cell(top).references.push_back(array);
+  CellReference mirrored;
+  mirrored.cell = pair;
+  mirrored.origin = Point(500, 300);
+  mirrored.reflect = true;
+  built.cell(top).references.push_back(mirrored);
+  built.finalize();
+  assert(built.root() == top && !built.virtual_root());
+  assert(built.flat_size(top) == 1 + 13 * 5);
+
+  // GDSII round trip keeps cells and placements
+  write_gdsii_hierarchy(built, "test_hierarchy.gds");
+  HierarchicalLayout layout = read_gdsii_hierarchy("test_hierarchy.gds");
+  assert(layout.num_cells() == 3);
+  assert(layout.root() == layout.find_cell("top"));
+  [[maybe_unused]] const CellReference& loaded =
+      layout.cell(layout.root()).references[0];
+  assert(loaded.columns == 4 && loaded.rows == 3);
+  assert(loaded.column_step.x() == 78 && loaded.row_step.y() == 52);
+  assert(layout.cell(layout.find_cell("pair")).references[1].quarter_turns ==
+         1);
+  assert(layout.cell(layout.root()).references[1].reflect);
+  std::vector<Polygon> flat = layout.flatten();
+  std::vector<Polygon> expected = built.flatten();
+
+  // With a layer selection the reader goes through the sidecar index,
+  // which keeps the references of every structure
+  std::remove("test_hierarchy.gds.lidx");
+  for (const char* spec : {"0", "0/0", "3"}) {
+    LayerSelection selection = LayerSelection::parse(spec);
+    HierarchicalLayout indexed = read_gdsii_hierarchy("test_hierarchy.gds",
+                                                      2, selection);
+    assert(indexed.num_cells() == 3 && indexed.root() == layout.root());
+    for (int c = 0; c < indexed.num_cells(); ++c) {
+      assert(indexed.cell(c).name == layout.cell(c).name);
+      assert(indexed.cell(c).references.size() ==
+             layout.cell(c).references.size());
+    }
+    [[maybe_unused]] bool selected = selection.contains(0, 0);
+    assert(indexed.flatten().size() == (selected ? flat.size() : 0u));
+  }
+  GdsiiLayerIndex hierarchy_index;
+  assert(hierarchy_index.load(GdsiiLayerIndex::sidecar("test_hierarchy.gds"),
+                              "test_hierarchy.gds"));
+  assert(hierarchy_index.references().size() == 4);
+  assert(flat.size() == expected.size());
+  for (size_t i = 0; i < flat.size(); ++i) {
+    assert(flat[i].id == static_cast<int>(i));
+    assert(flat[i].vertices.size() == expected[i].vertices.size());
+    for (size_t k = 0; k < flat[i].vertices.size(); ++k) {
+      assert(flat[i].vertices[k].x() == expected[i].vertices[k].x());
+      assert(flat[i].vertices[k].y() == expected[i].vertices[k].y());
+    }
+  }
+
+  // A scaled, absolute-angle text next to a reference keeps its own
+  // transformation records out of the placement
+  {
+    std::ofstream out("test_hierarchy_text.gds", std::ios::binary);
+    gdsii::write_library_header(out);
+    gdsii::write_structure_header(out, "via");
+    gdsii::write_boundary(out, rect(0, 0, 0, 20, 20));
+    gdsii::write_record_header(out, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+    gdsii::write_structure_header(out, "top");
+    gdsii::write_record_header(out, 4, gdsii::TEXT, gdsii::NO_DATA);
+    gdsii::write_record_header(out, 6, gdsii::LAYER, gdsii::INT16);
+    gdsii::write_int16(out, 63);
+    gdsii::write_record_header(out, 6, gdsii::TEXTTYPE, gdsii::INT16);
+    gdsii::write_int16(out, 0);
+    gdsii::write_record_header(out, 6, gdsii::STRANS, gdsii::BIT_ARRAY);
+    gdsii::write_int16(out, 0x0006);
+    gdsii::write_record_header(out, 12, gdsii::MAG, gdsii::REAL64);
+    gdsii::write_real64(out, 2.0);
+    gdsii::write_record_header(out, 12, gdsii::ANGLE, gdsii::REAL64);
+    gdsii::write_real64(out, 45.0);
+    gdsii::write_record_header(out, 12, gdsii::XY, gdsii::INT32);
+    gdsii::write_int32(out, 5);
+    gdsii::write_int32(out, 5);
+    gdsii::write_record_header(out, 8, gdsii::STRING, gdsii::ASCII);
+    gdsii::write_string(out, "VDD");
+    gdsii::write_record_header(out, 4, gdsii::ENDEL, gdsii::NO_DATA);
+    gdsii::write_record_header(out, 4, gdsii::SREF, gdsii::NO_DATA);
+    gdsii::write_record_header(out, 8, gdsii::SNAME, gdsii::ASCII);
+    gdsii::write_string(out, "via");
+    gdsii::write_record_header(out, 6, gdsii::STRANS, gdsii::BIT_ARRAY);
+    gdsii::write_int16(out, int16_t(0x8000));
+    gdsii::write_record_header(out, 12, gdsii::ANGLE, gdsii::REAL64);
+    gdsii::write_real64(out, 90.0);
+    gdsii::write_record_header(out, 12, gdsii::XY, gdsii::INT32);
+    gdsii::write_int32(out, 100);
+    gdsii::write_int32(out, 0);
+    gdsii::write_record_header(out, 4, gdsii::ENDEL, gdsii::NO_DATA);
+    gdsii::write_record_header(out, 4, gdsii::ENDSTR, gdsii::NO_DATA);
+    gdsii::write_record_header(out, 4, gdsii::ENDLIB, gdsii::NO_DATA);
+  }
+  HierarchicalLayout texted = read_gdsii_hierarchy("test_hierarchy_text.gds");
+  assert(texted.root() == texted.find_cell("top"));
+  [[maybe_unused]] const LayoutCell& texted_top = texted.cell(texted.root());
+  assert(texted_top.polygons.empty() && texted_top.references.size() == 1);
+  assert(texted_top.references[0].reflect);
+  assert(texted_top.references[0].quarter_turns == 1);
+  assert(texted_top.references[0].origin.x() == 100);
+  assert(texted.flatten().size() == 1);
+  std::remove("test_hierarchy_text.gds");
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 10.0;
+  config.num_threads = 2;
+  HierarchicalChecker checker(config);
+  HierarchicalResults hierarchical = checker.run(layout);
+  EasyMRC::Results placed = hierarchical.flatten();
+  EasyMRC::Results reference = EasyMRC(config).run(flat);
+
+  const auto& stats = checker.statistics();
+  std::cout << "  Cells: " << stats.cells << ", own polygons checked: "
+            << stats.cell_polygons << " of " << stats.flat_polygons
+            << ", interactions: " << stats.unique_interactions
+            << " checked of " << stats.interactions << std::endl;
+  std::cout << "  Violations: " << placed.total_violations()
+            << " (flat: " << reference.total_violations() << ")"
+            << std::endl;
+
+  // Same violations as the flat check, whichever polygon comes first
+  [[maybe_unused]] auto space_keys = [](const EasyMRC::Results& results) {
+    std::vector<std::tuple<int, int, int, int, int, int, double>> keys;
+    for (const auto& v : results.space_violations_type_a) {
+      Point p1 = v.point1, p2 = v.point2;
+      int id1 = v.polygon_id_1, id2 = v.polygon_id_2;
+      if (id1 > id2) {
+        std::swap(id1, id2);
+        std::swap(p1, p2);
+      }
+      keys.emplace_back(id1, id2, p1.x(), p1.y(), p2.x(), p2.y(),
+                        v.distance);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  };
+  assert(reference.space_violations_type_a.size() > 0);
+  assert(space_keys(placed) == space_keys(reference));
+  assert(placed.space_violations_type_b.size() ==
+         reference.space_violations_type_b.size());
+  assert(placed.width_violations.size() ==
+         reference.width_violations.size());
+  assert(hierarchical.total_violations() ==
+         static_cast<size_t>(placed.total_violations()));
+
+  // Array neighbours share their interaction checks, and only the cells'
+  // own polygons are checked directly
+  assert(stats.unique_interactions < stats.interactions);
+  assert(stats.cell_polygons == 4);
+
+  // Recursive placements are rejected
+  HierarchicalLayout cyclic;
+  int a = cyclic.add_cell("a");
+  int b = cyclic.add_cell("b");
+  CellReference to_b;
+  to_b.cell = b;
+  cyclic.cell(a).references.push_back(to_b);
+  CellReference to_a;
+  to_a.cell = a;
+  cyclic.cell(b).references.push_back(to_a);
+  [[maybe_unused]] bool thrown = false;
+  try {
+    cyclic.finalize();
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "  ✓ Hierarchical checking matches the flat layout"
+            << std::endl;
+}
+
+void test_async_run() {
+  std::cout << "\n=== Test: Async Run with Progress and Cancellation ==="
+            << std::endl;
+
+  // Staircases of varying complexity, close enough to form many pairs
+  auto make_layout = [](int columns, int rows) {
+    std::vector<Polygon> polygons;
+    for (int i = 0; i < columns * rows; ++i) {
+      Polygon poly(i);
+      int x0 = (i % columns) * 40, y0 = (i / columns) * 40;
+      int steps = 2 + i % 7 * 3;
+      poly.add_vertex(Point(x0, y0));
+      for (int s = 0; s < steps; ++s) {
+        int x = x0 + 36 - s * 30 / steps;
+        poly.add_vertex(Point(x, y0 + s * 36 / steps));
+        poly.add_vertex(Point(x, y0 + (s + 1) * 36 / steps));
+      }
+      poly.add_vertex(Point(x0, y0 + 36));
+      poly.build_segments();
+      polygons.push_back(poly);
+    }
+    return polygons;
+  };
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 10.0;
+  config.num_threads = 2;
+  EasyMRC checker(config);
+
+  auto polygons = make_layout(8, 8);
+  auto expected = checker.run(polygons);
+
+  auto handle = checker.run_async(polygons);
+  while (!handle.wait_for(std::chrono::milliseconds(1))) {
+    [[maybe_unused]] auto progress = handle.progress();
+    assert(progress.pairs_done <= progress.pairs_total);
+    assert(progress.polygons_done <= progress.polygons_total);
+    assert(progress.fraction >= 0.0 && progress.fraction <= 1.0);
+  }
+  auto final_progress = handle.progress();
+  auto results = handle.get();
+
+  std::cout << "  Pairs: " << final_progress.pairs_done << "/"
+            << final_progress.pairs_total << ", polygons: "
+            << final_progress.polygons_done << "/"
+            << final_progress.polygons_total << ", elapsed "
+            << final_progress.elapsed_ms << " ms" << std::endl;
+  assert(final_progress.phase == RunPhase::DONE);
+  assert(final_progress.fraction == 1.0);
+  assert(final_progress.pairs_done == final_progress.pairs_total);
+  assert(final_progress.polygons_done == polygons.size());
+  assert(results.total_violations() == expected.total_violations());
+
+  // Cancel a long run straight away
+  auto large = make_layout(40, 40);
+  auto start = std::chrono::steady_clock::now();
+  auto cancelled_handle = checker.run_async(large);
+  cancelled_handle.cancel();
+  [[maybe_unused]] bool cancelled = false;
+  try {
+    cancelled_handle.get();
+  } catch (const RunCancelled&) {
+    cancelled = true;
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cout << "  Cancelled after " << ms << " ms" << std::endl;
+  assert(cancelled);
+
+  // Handles without a run report PENDING and ignore cancel(); assigning
+  // over a running handle cancels its run and waits for it
+  EasyMRC::RunHandle empty;
+  assert(!empty.valid() && empty.progress().phase == RunPhase::PENDING);
+  empty.cancel();
+  assert(!empty.ready());
+  int refused = 0;
+  try { empty.wait(); } catch (const std::logic_error&) { ++refused; }
+  try {
+    empty.wait_for(std::chrono::milliseconds(1));
+  } catch (const std::logic_error&) {
+    ++refused;
+  }
+  try { empty.get(); } catch (const std::logic_error&) { ++refused; }
+  assert(refused == 3);
+  EasyMRC::RunHandle running = checker.run_async(large);
+  EasyMRC::RunHandle moved = std::move(running);
+  assert(!running.valid() && running.progress().phase == RunPhase::PENDING);
+  running.cancel();
+  moved = checker.run_async(polygons);
+  assert(moved.get().total_violations() == expected.total_violations());
+  moved = EasyMRC::RunHandle();
+  assert(!moved.valid());
+
+  std::cout << "  ✓ Async run works" << std::endl;
+}
+
+void test_background_export() {
+  std::cout << "\n=== Test: Background GDSII Export ===" << std::endl;
+
+  // Bars 3 pixels apart, so the check finds space violations
+  std::vector<std::vector<int>> pattern(40, std::vector<int>(60, 0));
+  for (int y = 5; y < 35; ++y) {
+    for (int x = 0; x < 60; ++x) {
+      if (x % 8 >= 3) pattern[y][x] = 255;
+    }
+  }
+  create_test_image("test_export.pgm", pattern);
+
+  auto direct = format_conversion("test_export.pgm");
+  auto round_trip = format_conversion("test_export.pgm", "test_export_rt.gds");
+  GdsiiExport pending =
+      format_conversion_exporting("test_export.pgm", "test_export.gds");
+  const auto& polygons = pending.polygons();
+  assert(polygons.size() == direct.size() && polygons.size() == 8);
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    assert(polygons[i].id == round_trip[i].id);
+    assert(polygons[i].vertices.size() == round_trip[i].vertices.size());
+    for (size_t k = 0; k < polygons[i].vertices.size(); ++k) {
+      assert(polygons[i].vertices[k].x() == round_trip[i].vertices[k].x());
+      assert(polygons[i].vertices[k].y() == round_trip[i].vertices[k].y());
+    }
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 5.0;
+  config.num_threads = 2;
+  EasyMRC checker(config);
+  auto expected = checker.run(direct);
+  assert(expected.total_space_violations() > 0);
+  assert(!expected.gdsii_written() && expected.gdsii_file.empty());
+
+  // Synchronous run: the file is complete when the results are returned
+  auto results = checker.run(pending);
+  assert(!pending.pending());
+  assert(results.gdsii_written());
+  assert(results.gdsii_file == "test_export.gds");
+  assert(results.total_violations() == expected.total_violations());
+  assert(read_gdsii("test_export.gds").size() == polygons.size());
+
+  // Asynchronous run: the handle owns the export
+  auto handle = checker.run_async(
+      format_conversion_exporting("test_export.pgm", "test_export.gds"));
+  results = handle.get();
+  assert(results.gdsii_written());
+  assert(results.total_violations() == expected.total_violations());
+
+  // A failed write is recorded without losing the check results
+  handle = checker.run_async(format_conversion_exporting(
+      "test_export.pgm", "no_such_directory/test_export.gds"));
+  results = handle.get();
+  assert(!results.gdsii_written());
+  assert(!results.gdsii_error.empty());
+  assert(results.total_violations() == expected.total_violations());
+  std::cout << "  Failed export: " << results.gdsii_error << std::endl;
+
+  std::cout << "  ✓ Background GDSII export works" << std::endl;
+}
+
+void test_deterministic_order() {
+  std::cout << "\n=== Test: Deterministic Result Order ===" << std::endl;
+
+  // Tasks 0..5 ran on two workers in an arbitrary order; task 3 was empty
+  std::vector<std::vector<int>> parts = {{40, 41, 10, 11, 12}, {50, 20, 0}};
+  std::vector<TaskSlot> slots(6);
+  auto set_slot = [&slots](size_t task, size_t worker, size_t offset,
+                           size_t count) {
+    slots[task].worker = worker;
+    slots[task].offset = offset;
+    slots[task].count = count;
+  };
+  set_slot(4, 0, 0, 2);
+  set_slot(1, 0, 2, 3);
+  set_slot(5, 1, 0, 1);
+  set_slot(2, 1, 1, 1);
+  set_slot(0, 1, 2, 1);
+  set_slot(3, 0, 5, 0);
+
+  std::vector<int> out;
+  ordered_concat(parts, slots, out, 4);
+  assert((out == std::vector<int>{0, 10, 11, 12, 20, 40, 41, 50}));
+
+  // Same violations in the same order for every thread count, and the same
+  // order as the sequential path
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 30; ++i) {
+    Polygon poly(i);
+    int x = (i % 6) * 20, y = (i / 6) * 25;
+    int w = 4 + i % 5 * 3;
+    poly.vertices = {Point(x, y), Point(x + w, y),
+                     Point(x + w, y + 18), Point(x, y + 18)};
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+
+  EasyMRC::Config config;
+  config.rule_distance_R = 12.0;
+  config.enable_parallel = false;
+  auto reference = EasyMRC(config).run(polygons);
+  assert(reference.total_violations() > 0);
+
+  config.enable_parallel = true;
+  for (int threads : {1, 2, 3, 5}) {
+    for (bool concurrent : {false, true}) {
+      config.num_threads = threads;
+      config.concurrent_phases = concurrent;
+      auto results = EasyMRC(config).run(polygons);
+
+      const auto& a = results.space_violations_type_a;
+      [[maybe_unused]] const auto& ref_a = reference.space_violations_type_a;
+      assert(a.size() == ref_a.size());
+      for (size_t i = 0; i < a.size(); ++i) {
+        assert(a[i].polygon_id_1 == ref_a[i].polygon_id_1);
+        assert(a[i].polygon_id_2 == ref_a[i].polygon_id_2);
+        assert(a[i].point1.x() == ref_a[i].point1.x());
+        assert(a[i].point1.y() == ref_a[i].point1.y());
+        assert(a[i].point2.x() == ref_a[i].point2.x());
+        assert(a[i].point2.y() == ref_a[i].point2.y());
+        assert(a[i].distance == ref_a[i].distance);
+      }
+
+      const auto& w = results.width_violations;
+      [[maybe_unused]] const auto& ref_w = reference.width_violations;
+      assert(w.size() == ref_w.size());
+      for (size_t i = 0; i < w.size(); ++i) {
+        assert(w[i].polygon_id == ref_w[i].polygon_id);
+        assert(w[i].edge1.start.x() == ref_w[i].edge1.start.x());
+        assert(w[i].edge1.start.y() == ref_w[i].edge1.start.y());
+        assert(w[i].edge2.end.x() == ref_w[i].edge2.end.x());
+        assert(w[i].edge2.end.y() == ref_w[i].edge2.end.y());
+        assert(w[i].distance == ref_w[i].distance);
+      }
+    }
+  }
+
+  std::cout << "  Violations: " << reference.total_violations()
+            << " in identical order for 1/2/3/5 threads" << std::endl;
+  std::cout << "  ✓ Deterministic result order works" << std::endl;
+}
+
+void test_rule_artifacts() {
+  std::cout << "\n=== Test: Rule Artifact Cache ===" << std::endl;
+
+  std::vector<Polygon> polygons;
+  for (int i = 0; i < 40; ++i) {
+    Polygon poly(i);
+    int x = (i % 8) * 20, y = (i / 8) * 25;
+    int w = 4 + i % 5 * 3;
+    poly.vertices = {Point(x, y), Point(x + w, y), Point(x + w, y + 18),
+                     Point(x + w / 2, y + 18), Point(x + w / 2, y + 9),
+                     Point(x, y + 9)};
+    poly.build_segments();
+    polygons.push_back(poly);
+  }
+
+  // A small multiplier leaves long edges to find width violations with
+  EasyMRC::Config config;
+  config.rule_distance_R = 12.0;
+  config.sampling_radius_multiplier = 0.5;
+  config.num_threads = 3;
+  RuleArtifacts::Key key(LayoutCache::layout_hash(polygons),
+                         config.rule_distance_R,
+                         config.sampling_radius_multiplier);
+  RuleArtifacts computed = RuleArtifacts::compute(polygons, key, 2);
+  assert(computed.pairs() ==
+         candidate_pair_generation(polygons, config.rule_distance_R));
+  [[maybe_unused]] SamplingTable table = computed.sampling();
+  assert(table.size == polygons.size());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    assert(table.radius[i] == calculate_sampling_radius(polygons[i], 0.5));
+    assert(table.info[i].num_long_edges ==
+           compute_polygon_cost_info(polygons[i], 0.5).num_long_edges);
+  }
+
+  // Saved and mapped back under the same key only
+  const std::string file = RuleArtifacts::filename(".", key);
+  std::remove(file.c_str());
+  RuleArtifacts loaded;
+  assert(!loaded.load(file, key, polygons.size()));
+  computed.save(file);
+  RuleArtifacts::Key other_r(key.content_hash, 12.5, 0.5);
+  RuleArtifacts::Key other_layout(key.content_hash + 1, 12.0, 0.5);
+  assert(RuleArtifacts::filename(".", other_r) != file);
+  assert(!loaded.load(file, other_r, polygons.size()));
+  assert(!loaded.load(file, other_layout, polygons.size()));
+  assert(!loaded.load(file, key, polygons.size() - 1));
+  assert(loaded.load(file, key, polygons.size()));
+  assert(loaded.pairs() == computed.pairs());
+  for (size_t i = 0; i < polygons.size(); ++i) {
+    assert(loaded.sampling().radius[i] == table.radius[i]);
+    assert(loaded.sampling().info[i].num_long_edges ==
+           table.info[i].num_long_edges);
+  }
+  {
+    std::ifstream in(file, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+    std::ofstream("test_bad.mrca", std::ios::binary)
+        << bytes.substr(0, bytes.size() - 4);
+    RuleArtifacts truncated;
+    assert(!truncated.load("test_bad.mrca", key, polygons.size()));
+  }
+
+  // Identical violations with and without artifacts, on every path, and
+  // with only the width check enabled
+  [[maybe_unused]] auto same = [](const EasyMRC::Results& a,
+                                  const EasyMRC::Results& b) {
+    if (a.space_violations_type_a.size() !=
+            b.space_violations_type_a.size() ||
+        a.space_violations_type_b.size() !=
+            b.space_violations_type_b.size() ||
+        a.width_violations.size() != b.width_violations.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < a.space_violations_type_a.size(); ++i) {
+      const auto& va = a.space_violations_type_a[i];
+      const auto& vb = b.space_violations_type_a[i];
+      if (va.polygon_id_1 != vb.polygon_id_1 ||
+          va.polygon_id_2 != vb.polygon_id_2 || va.distance != vb.distance) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < a.width_violations.size(); ++i) {
+      if (a.width_violations[i].polygon_id !=
+              b.width_violations[i].polygon_id ||
+          a.width_violations[i].distance != b.width_violations[i].distance) {
+        return false;
+      }
+    }
+    return true;
+  };
+  struct Mode {
+    bool parallel, concurrent, space;
+  };
+  for (Mode mode : {Mode{false, false, true}, Mode{true, false, true},
+                    Mode{true, true, true}, Mode{true, true, false}}) {
+    EasyMRC::Config run_config = config;
+    run_config.enable_parallel = mode.parallel;
+    run_config.concurrent_phases = mode.concurrent;
+    run_config.enable_space_check = mode.space;
+    EasyMRC checker(run_config);
+    auto reference = checker.run(polygons);
+    assert(reference.width_violations.size() > 0);
+    assert(reference.total_space_violations() > 0 || !mode.space);
+    const uint64_t hash = key.content_hash;
+    assert(same(checker.run(polygons, computed, hash), reference));
+    assert(same(checker.run(polygons, loaded, hash), reference));
+    auto handle = checker.run_async(polygons, loaded, hash);
+    assert(same(handle.get(), reference));
+  }
+
+  // Artifacts of other rules, or of other polygons of the same count,
+  // are refused, also by run_async()
+  EasyMRC::Config other_config = config;
+  other_config.rule_distance_R = 13.0;
+  [[maybe_unused]] bool thrown = false;
+  try {
+    EasyMRC(other_config).run(polygons, loaded, key.content_hash);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+  std::vector<Polygon> moved = polygons;
+  for (auto& v : moved[0].vertices) v = Point(v.x() + 1, v.y());
+  moved[0].build_segments();
+  const uint64_t moved_hash = LayoutCache::layout_hash(moved);
+  thrown = false;
+  try {
+    EasyMRC(config).run(moved, loaded, moved_hash);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+  thrown = false;
+  try {
+    EasyMRC(config).run_async(moved, loaded, moved_hash).get();
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  std::cout << "  Candidate pairs: " << loaded.pairs().size() << std::endl;
+  std::cout << "  ✓ Rule artifact cache works" << std::endl;
+}
+
 void test_complete_pipeline() {
   std::cout << "\n=== Test: Complete EasyMRC Pipeline ===" << std::endl;
 
@@ -339,11 +3035,36 @@ int main() {
 
   try {
     test_format_conversion();
+    test_pgm_reader();
+    test_png_reader();
+    test_level_layers();
+    test_bit_image();
+    test_component_labeling();
+    test_scanline_extraction();
+    test_gdsii_reader();
+    test_gdsii_writer();
+    test_gdsii_layers();
+    test_oasis_reader();
+    test_layout_cache();
+    test_layout_store();
     test_candidate_pairs();
     test_sampling();
     test_space_violations();
     test_width_violations();
+    test_exact_geometry();
     test_parallel_execution();
+    test_cost_scheduling();
+    test_worker_arena();
+    test_parallel_concat();
+    test_cpu_topology();
+    test_task_graph();
+    test_tiled_execution();
+    test_streaming();
+    test_hierarchy();
+    test_async_run();
+    test_background_export();
+    test_deterministic_order();
+    test_rule_artifacts();
     test_complete_pipeline();
 
     std::cout << "\n========================================" << std::endl;